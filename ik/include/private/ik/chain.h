@@ -52,6 +52,23 @@ chain_destruct(struct chain_t* chain);
 IK_PRIVATE_API void
 chain_clear_free(struct chain_t* chain);
 
+/*!
+ * @brief Clears the chain and all of its children and moves them into a list
+ * of spare chains, so the memory of their node and child lists can be reused
+ * by chain_construct_from_spares() instead of being freed. If the list of
+ * spare chains can't grow, the chain is destructed instead.
+ * @note The chain object itself is not deallocated.
+ */
+IK_PRIVATE_API void
+chain_recycle(struct chain_t* chain, struct vector_t* spare_chains);
+
+/*!
+ * @brief Initializes an allocated chain object, taking over the memory of a
+ * spare chain if there is one.
+ */
+IK_PRIVATE_API void
+chain_construct_from_spares(struct chain_t* chain, struct vector_t* spare_chains);
+
 IK_PRIVATE_API struct chain_t*
 chain_create_child(struct chain_t* chain);
 
@@ -72,12 +89,30 @@ chain_add_node(struct chain_t* chain, const struct ik_node_t* node);
  * This algorithm finds all sub-base joints and generates chains between
  * base, sub-base joints, and end effectors. These chains are inserted into
  * the chain tree.
+ *
+ * Existing chains are recycled into spare_chains and new chains are taken
+ * from there, so rebuilding the same tree again doesn't allocate.
  */
 IK_PRIVATE_API ikret_t
 chain_tree_rebuild(struct vector_t* chain_list,
-                   const struct ik_node_t* base_node,
+                   struct vector_t* spare_chains,
+                   struct ik_node_t* base_node,
                    const struct vector_t* effector_nodes_list);
 
+/*!
+ * @brief Replaces only the chains affected by the specified nodes, which had
+ * effectors attached, detached or their chain length changed. Produces the
+ * same chains as chain_tree_rebuild() would. Segment lengths are computed for
+ * the replaced chains only.
+ * @param[in] effector_nodes_list Must already contain all effector nodes of
+ * the tree, including the changed ones.
+ */
+IK_PRIVATE_API ikret_t
+chain_tree_rebuild_partial(struct vector_t* chain_list,
+                           struct vector_t* spare_chains,
+                           const struct vector_t* effector_nodes_list,
+                           const struct vector_t* changed_nodes);
+
 /*!
  * Computes the distances between the nodes and stores them in
  * node->segment_length. The positions used for this computation are those of
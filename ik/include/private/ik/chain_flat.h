@@ -0,0 +1,399 @@
+/*!
+ * @file chain_flat.h
+ * @brief Compiles the chain tree (see chain.h) into a flat, contiguous
+ * structure-of-arrays which solvers can iterate linearly instead of chasing
+ * ik_node_t pointers through nested chain_t vectors.
+ *
+ * Chains are stored in pre-order, i.e. every chain comes before all of its
+ * child chains and all chains belonging to the same island are adjacent.
+ * Iterating the chains backwards therefore visits children before parents
+ * (FABRIK forward pass) and iterating them forwards visits parents before
+ * children (FABRIK backward pass).
+ *
+ * The nodes of each chain occupy a contiguous range of "slots" and are
+ * ordered the same way as in chain_t::nodes, that is, the first slot holds
+ * the tip (effector) node and the last slot holds the base node. A sub-base
+ * node is shared by the parent chain (as its tip) and all child chains (as
+ * their base), so it occupies one slot in each of those chains. Solvers have
+ * to copy the parent's tip slot (chain_flat_chain_t::base_source) into the
+ * child's base slot before processing a child chain.
+ *
+ * Chains which are not connected to each other (islands) can be solved
+ * independently. Every island occupies a contiguous range of chains, slots
+ * and effectors, which is described by chain_flat_island_t.
+ *
+ * Large islands can additionally be split into branches (see
+ * chain_flat_find_branches()). A branch is the sub-tree below one child of a
+ * sub-base and, since chains are in pre-order, also occupies a contiguous
+ * range of chains. Sibling branches only depend on each other through the
+ * sub-base they share, so they can be solved in parallel as long as the
+ * chains above them (the island's "trunk") are solved after them in the
+ * forwards pass and before them in the backwards pass.
+ *
+ * Additionally, every node referenced by the chains is assigned a unique
+ * "pose index". Pose indices are handed out in the same order in which
+ * ik_solver_iterate_affected_nodes() visits the nodes, i.e. island base
+ * first, then each chain from base to tip, depth first. This is the layout
+ * used for the positions of solver instances (see ik_instances_t).
+ */
+#ifndef IK_CHAIN_FLAT_H
+#define IK_CHAIN_FLAT_H
+
+#include "ik/config.h"
+#include "ik/quat.h"
+#include "ik/vec3.h"
+#include "ik/vector.h"
+
+C_BEGIN
+
+struct ik_node_t;
+
+/*!
+ * @brief How the backwards pass places the nodes of a chain. Solvers which
+ * don't know about analytic kernels can ignore this and treat every chain as
+ * CHAIN_FLAT_KERNEL_ITERATIVE.
+ */
+enum chain_flat_kernel_e
+{
+    CHAIN_FLAT_KERNEL_ITERATIVE,
+    CHAIN_FLAT_KERNEL_ONE_BONE,
+    CHAIN_FLAT_KERNEL_TWO_BONE
+};
+
+struct chain_flat_chain_t
+{
+    /* Index of the first (tip) slot belonging to this chain */
+    uint32_t slot_begin;
+    /* Number of slots in this chain, including the base node */
+    uint32_t slot_count;
+    /* Index of the parent chain, or -1 if this chain is the base of an island */
+    int32_t parent;
+    /* Slot in the parent chain holding our base node (the parent's tip) */
+    uint32_t base_source;
+    /* Number of direct child chains. If 0, the tip node has an effector */
+    uint32_t child_count;
+    /* Index into effector_slots of the tip node's effector, or -1 */
+    int32_t effector_index;
+    /* Index of the branch this chain belongs to, or -1 if it is part of the trunk */
+    int32_t branch;
+    /* enum chain_flat_kernel_e, see chain_flat_select_analytic_kernels() */
+    uint32_t kernel;
+};
+
+struct chain_flat_branch_t
+{
+    uint32_t chain_begin;
+    uint32_t chain_count;
+
+    /*
+     * Written by the solver: Base target computed by the forwards pass for
+     * the branch's first chain. Added to the parent chain's accumulator once
+     * all branches are joined, so the result doesn't depend on the order in
+     * which the branches were solved.
+     */
+    ik_vec3_t base_target;
+};
+
+struct chain_flat_island_t
+{
+    uint32_t chain_begin;
+    uint32_t chain_count;
+    uint32_t slot_begin;
+    uint32_t slot_count;
+    uint32_t effector_begin;
+    uint32_t effector_count;
+    uint32_t branch_begin;
+    uint32_t branch_count;
+    /* Number of chains which don't use CHAIN_FLAT_KERNEL_ITERATIVE */
+    uint32_t analytic_chain_count;
+    /* Pose indices of an island are contiguous, starting with its base node */
+    uint32_t pose_begin;
+    uint32_t pose_end;
+
+    /* Written by the solver: Result and number of iterations of the last solve */
+    ikret_t result;
+    int32_t iterations_used;
+};
+
+struct chain_flat_t
+{
+    /* list of chain_flat_island_t, in the same order as their chains */
+    struct vector_t islands;
+
+    /* list of chain_flat_chain_t, in pre-order */
+    struct vector_t chains;
+
+    /* list of chain_flat_branch_t, grouped by island, in pre-order */
+    struct vector_t branches;
+
+    /* Per-slot data. All of these have the same number of elements */
+    struct vector_t nodes;            /* struct ik_node_t* */
+    struct vector_t slot_pose_index;  /* uint32_t, index into pose_nodes */
+    struct vector_t positions;        /* ik_vec3_t */
+    struct vector_t segment_lengths;  /* ikreal_t, copy of node->dist_to_parent */
+    struct vector_t rotation_weights; /* ikreal_t, copy of node->rotation_weight */
+
+    /* Per-chain data. All of these have the same number of elements as chains */
+    struct vector_t directions;       /* ik_vec3_t, target direction (see chain_flat_gather()) */
+    struct vector_t accumulators;     /* ik_vec3_t, scratch space for averaging child chains */
+
+    /* Per-effector data. Effectors are in the order their chains appear in */
+    struct vector_t effector_slots;   /* uint32_t, slot of the chain tip holding the effector */
+    struct vector_t effector_targets; /* ik_vec3_t, actual target position */
+    struct vector_t effector_target_rotations; /* ik_quat_t */
+
+    /* Every node referenced by the chains exactly once (struct ik_node_t*) */
+    struct vector_t pose_nodes;
+
+    /*
+     * Per-pose data. All of these have the same number of elements as
+     * pose_nodes. The global pose is cached between solves, so only the
+     * sub-trees whose local transforms changed have to be transformed again
+     * (see chain_flat_update_global_pose()).
+     */
+    struct vector_t pose_slots;            /* uint32_t, a slot holding the node */
+    struct vector_t pose_parents;          /* int32_t, pose index of the parent node, or -1 for island bases */
+    struct vector_t pose_local_positions;  /* ik_vec3_t, node->position the global pose was derived from */
+    struct vector_t pose_local_rotations;  /* ik_quat_t, node->rotation the global pose was derived from */
+    struct vector_t pose_global_positions; /* ik_vec3_t */
+    struct vector_t pose_global_rotations; /* ik_quat_t, accumulated rotation of the node and its parents */
+    struct vector_t pose_dirty;            /* uint8_t, scratch space */
+    struct vector_t pose_accumulators;     /* ikreal_t[7], scratch space for chain_flat_transform() */
+    int has_global_pose;
+
+    /*
+     * State carried over from the previous solve for warm starting (see
+     * chain_flat_warm_start()). Per-slot, same number of elements as nodes.
+     */
+    struct vector_t warm_input_positions;  /* ik_vec3_t, positions before solving */
+    struct vector_t warm_solved_positions; /* ik_vec3_t, positions after solving */
+    int has_warm_start;
+
+    /*
+     * Set by solvers which defer joint rotations (see
+     * IK_ENABLE_LAZY_ROTATIONS) while the nodes hold the initial transform
+     * the pending rotations are relative to.
+     */
+    int has_pending_rotations;
+
+    /*
+     * Lane buffers for solving several instances at once (see chain_lanes.h).
+     * These have the same number of elements as the per-slot, per-chain and
+     * per-effector arrays above, respectively. Depending on the precision the
+     * instances are solved with, they hold either kind of lane vector.
+     */
+    struct vector_t lane_positions;    /* struct chain_lanes_vec3_t or chain_lanes_vec3f_t */
+    struct vector_t lane_accumulators; /* struct chain_lanes_vec3_t or chain_lanes_vec3f_t */
+    struct vector_t lane_targets;      /* struct chain_lanes_vec3_t or chain_lanes_vec3f_t */
+
+    /* Scratch space for chain_flat_find_branches() */
+    struct vector_t subtree_sizes;     /* uint32_t */
+};
+
+IK_PRIVATE_API struct chain_flat_t*
+chain_flat_create(void);
+
+IK_PRIVATE_API void
+chain_flat_destroy(struct chain_flat_t* flat);
+
+IK_PRIVATE_API void
+chain_flat_construct(struct chain_flat_t* flat);
+
+/*!
+ * @brief Frees all members, but does not deallocate the object itself.
+ */
+IK_PRIVATE_API void
+chain_flat_destruct(struct chain_flat_t* flat);
+
+/*!
+ * @brief Removes all chains, but keeps the memory of all arrays so the next
+ * build can reuse it.
+ */
+IK_PRIVATE_API void
+chain_flat_clear(struct chain_flat_t* flat);
+
+/*!
+ * @brief Discards the previous contents and compiles the specified list of
+ * base chains. Segment lengths are copied from node->dist_to_parent, so make
+ * sure update_distances() was called on the chain list beforehand.
+ */
+IK_PRIVATE_API ikret_t
+chain_flat_build(struct chain_flat_t* flat, const struct vector_t* chain_list);
+
+/*!
+ * @brief Splits every island with more than min_fork_slots slots into
+ * branches which can be solved in parallel. Sub-bases are split recursively
+ * from the island's base chain downwards, until the remaining sub-trees have
+ * at most min_fork_slots slots each. Passing 0 removes all branches. Has to
+ * be called again after chain_flat_build().
+ */
+IK_PRIVATE_API ikret_t
+chain_flat_find_branches(struct chain_flat_t* flat, uint32_t min_fork_slots);
+
+/*!
+ * @brief Tags every leaf chain with one or two segments (i.e. a chain without
+ * child chains and with 2 or 3 slots) with CHAIN_FLAT_KERNEL_ONE_BONE or
+ * CHAIN_FLAT_KERNEL_TWO_BONE, so it can be solved in closed form once its
+ * base position is known. All other chains use CHAIN_FLAT_KERNEL_ITERATIVE.
+ * Returns the number of tagged chains. Has to be called again after
+ * chain_flat_build().
+ */
+IK_PRIVATE_API uint32_t
+chain_flat_select_analytic_kernels(struct chain_flat_t* flat);
+
+/*!
+ * @brief Copies node->dist_to_parent into the flattened segment lengths.
+ * Needs to be called whenever the node distances are recomputed.
+ */
+IK_PRIVATE_API void
+chain_flat_update_distances(struct chain_flat_t* flat);
+
+/*!
+ * @brief Brings the cached global pose up to date with the nodes' local
+ * transforms.
+ *
+ * The local position and rotation of every node are compared with the values
+ * the cache was derived from. Only nodes which changed, and all nodes below
+ * them, are transformed into global space again. The first call after
+ * chain_flat_build() transforms all nodes. The nodes themselves are not
+ * modified.
+ */
+IK_PRIVATE_API void
+chain_flat_update_global_pose(struct chain_flat_t* flat);
+
+/*!
+ * @brief Transforms the poses pose_begin to pose_end into global space, the
+ * same way chain_flat_update_global_pose() does, but from the specified local
+ * rotations instead of from the nodes and without comparing against the
+ * cache. Local positions are taken from the cached global pose. Solvers which
+ * rotate joints (see chain_flat_island_t::pose_begin) use this to update
+ * their scratch pose after every iteration.
+ * @param[in] normalize If 0, the accumulated rotations aren't normalized.
+ * This is faster and fine as long as they're recomputed from normalized
+ * local rotations every iteration instead of being carried over.
+ */
+IK_PRIVATE_API void
+chain_flat_forward_kinematics(const struct chain_flat_t* flat,
+                              uint32_t pose_begin,
+                              uint32_t pose_end,
+                              const ik_quat_t* local_rotations,
+                              ik_vec3_t* positions,
+                              ik_quat_t* rotations,
+                              int normalize);
+
+/*!
+ * @brief Copies the cached global positions into node->position, i.e.
+ * transforms the nodes into global space. Use chain_flat_transform() with
+ * TR_G2L | TR_TRANSLATIONS to transform them back afterwards. Must be called
+ * after chain_flat_update_global_pose().
+ */
+IK_PRIVATE_API void
+chain_flat_load_global_pose(const struct chain_flat_t* flat);
+
+/*!
+ * @brief Transforms the nodes of all chains, the same as
+ * ik_transform_chain_list() would, but without flattening the chains first.
+ */
+IK_PRIVATE_API void
+chain_flat_transform(struct chain_flat_t* flat, uint8_t flags);
+
+/*!
+ * @brief Loads the cached global positions and the effector targets into the
+ * flat arrays. Must be called at the beginning of every solve, after
+ * chain_flat_update_global_pose() and after the effector's actual targets
+ * were updated.
+ * @param[in] solver_flags If IK_ENABLE_TARGET_ROTATIONS is set, the target
+ * directions and rotation weights are loaded as well.
+ */
+IK_PRIVATE_API void
+chain_flat_gather(struct chain_flat_t* flat, uint8_t solver_flags);
+
+/*!
+ * @brief Turns the gathered positions into an initial guess based on the
+ * previous solve. Must be called after chain_flat_gather().
+ *
+ * Each node is moved from its current (input) position towards its solved
+ * position of the previous solve by blend, i.e. blend=1 resumes exactly
+ * where the previous solve stopped. Island base nodes aren't moved by the
+ * solver, so they always keep their input position.
+ *
+ * If there is no previous solve or if any node's input position moved by
+ * more than threshold since the previous solve (e.g. the animation cut or
+ * the character teleported), the positions are left as they are (cold
+ * start). A threshold of 0 disables this check.
+ * @return Returns 1 if the positions were warm started, 0 otherwise.
+ */
+IK_PRIVATE_API int
+chain_flat_warm_start(struct chain_flat_t* flat, ikreal_t blend, ikreal_t threshold);
+
+/*!
+ * @brief Remembers the solved positions for the next call to
+ * chain_flat_warm_start(). Must be called before chain_flat_scatter().
+ */
+IK_PRIVATE_API void
+chain_flat_store_warm_start(struct chain_flat_t* flat);
+
+/*!
+ * @brief Writes the solved positions back to the nodes, in global space.
+ */
+IK_PRIVATE_API void
+chain_flat_scatter(const struct chain_flat_t* flat);
+
+/*!
+ * @brief Writes the solved positions back to the nodes, in local space, and
+ * updates the cached global pose.
+ *
+ * Only nodes which were moved by the solver, or whose parent was moved, are
+ * written to. All other nodes keep their local position exactly. Assumes the
+ * solver didn't change any rotations, i.e. IK_ENABLE_JOINT_ROTATIONS is not
+ * set.
+ */
+IK_PRIVATE_API void
+chain_flat_scatter_local(struct chain_flat_t* flat);
+
+/*!
+ * @brief Writes the solution of a solver which rotates joints back to the
+ * nodes. If IK_ENABLE_JOINT_ROTATIONS is set, only the local rotations are
+ * written and the local positions stay the same. Otherwise, only the global
+ * positions are written back using chain_flat_scatter_local(), like FABRIK
+ * does.
+ * @param[in] positions Global positions indexed by pose index.
+ * @param[in] local_rotations Local rotations indexed by pose index.
+ */
+IK_PRIVATE_API void
+chain_flat_scatter_pose(struct chain_flat_t* flat,
+                        uint8_t solver_flags,
+                        const ik_vec3_t* positions,
+                        const ik_quat_t* local_rotations);
+
+/*!
+ * @brief Same as chain_flat_gather(), except the positions and targets are
+ * loaded from arrays instead of from the nodes and effectors.
+ * @param[in] positions Global positions indexed by pose index.
+ * @param[in] targets Target positions indexed by effector index.
+ * @param[in] target_rotations Target rotations indexed by effector index.
+ * Only read if IK_ENABLE_TARGET_ROTATIONS is set.
+ */
+IK_PRIVATE_API void
+chain_flat_gather_array(struct chain_flat_t* flat,
+                        uint8_t solver_flags,
+                        const ik_vec3_t* positions,
+                        const ik_vec3_t* targets,
+                        const ik_quat_t* target_rotations);
+
+/*!
+ * @brief Writes the solved positions to an array indexed by pose index.
+ */
+IK_PRIVATE_API void
+chain_flat_scatter_array(const struct chain_flat_t* flat, ik_vec3_t* positions);
+
+/*!
+ * @brief Helper macro for retrieving a typed pointer to the first element of
+ * one of the flat arrays.
+ */
+#define chain_flat_data(flat_var, member, type) \
+    ((type*)(flat_var)->member.data)
+
+C_END
+
+#endif /* IK_CHAIN_FLAT_H */
@@ -0,0 +1,142 @@
+/*!
+ * @file chain_lanes.h
+ * @brief Lane-wide (SIMD) versions of the flat FABRIK passes which solve
+ * several instances of the same chain program at once.
+ *
+ * FABRIK is sequential along a chain, but the same chain belonging to many
+ * different instances (see ik_instances_t) can be solved in parallel. The
+ * lane buffers in chain_flat_t store CHAIN_LANES_WIDTH instances side by
+ * side in structure-of-arrays form, i.e. every slot holds x[WIDTH], y[WIDTH]
+ * and z[WIDTH], and every lane is one instance.
+ *
+ * Lanes hold either ikreal_t or float components. Float lanes are used when
+ * IK_ENABLE_FLOAT_INSTANCES is set, independently of IK_PRECISION. They fit
+ * twice as many instances into the same buffers and registers when ikreal_t
+ * is double.
+ *
+ * There is always a portable scalar kernel. If the library was configured
+ * with IK_SIMD=AVX2, an AVX2 kernel is compiled in as well and is selected
+ * at runtime if the CPU supports it.
+ */
+#ifndef IK_CHAIN_LANES_H
+#define IK_CHAIN_LANES_H
+
+#include "ik/config.h"
+#include "ik/vec3.h"
+
+C_BEGIN
+
+struct chain_flat_t;
+struct chain_flat_island_t;
+
+/*
+ * Number of instances solved at once. This is two 256-bit registers worth of
+ * reals so two independent dependency chains can be in flight at once.
+ */
+#if defined(IK_PRECISION_FLOAT)
+#   define CHAIN_LANES_WIDTH 16
+#else
+#   define CHAIN_LANES_WIDTH 8
+#endif
+
+/*
+ * Number of instances solved at once with float lanes. A float lane vector
+ * has the same size as an ikreal_t one, so the lane buffers can hold either.
+ */
+#define CHAIN_LANES_FLOAT_WIDTH (int)(CHAIN_LANES_WIDTH * sizeof(ikreal_t) / sizeof(float))
+
+struct chain_lanes_vec3_t
+{
+    ikreal_t x[CHAIN_LANES_WIDTH];
+    ikreal_t y[CHAIN_LANES_WIDTH];
+    ikreal_t z[CHAIN_LANES_WIDTH];
+};
+
+struct chain_lanes_vec3f_t
+{
+    float x[CHAIN_LANES_FLOAT_WIDTH];
+    float y[CHAIN_LANES_FLOAT_WIDTH];
+    float z[CHAIN_LANES_FLOAT_WIDTH];
+};
+
+struct chain_lanes_kernel_t
+{
+    const char* name;
+    /* Same as the scalar forward pass, operating on chain_flat_t::lane_* */
+    void (*solve_forwards)(struct chain_flat_t* flat, const struct chain_flat_island_t* island);
+    /* Same as the scalar backward pass, operating on chain_flat_t::lane_* */
+    void (*solve_backwards)(struct chain_flat_t* flat, const struct chain_flat_island_t* island);
+    /* Same as solve_forwards, for lane buffers holding float lanes */
+    void (*solve_forwards_float)(struct chain_flat_t* flat, const struct chain_flat_island_t* island);
+    /* Same as solve_backwards, for lane buffers holding float lanes */
+    void (*solve_backwards_float)(struct chain_flat_t* flat, const struct chain_flat_island_t* island);
+};
+
+/*!
+ * @brief Returns the fastest kernel supported by the CPU we're running on.
+ */
+IK_PRIVATE_API const struct chain_lanes_kernel_t*
+chain_lanes_kernel(void);
+
+/*!
+ * @brief Loads the positions and targets of lane_count consecutive instances
+ * into the lane buffers. Unused lanes are filled with copies of the first
+ * lane so the kernels never operate on garbage.
+ * @param[in] positions Global positions of the first instance, indexed by
+ * pose index. Consecutive instances are node_stride elements apart.
+ * @param[in] targets Target positions of the first instance, indexed by
+ * effector index. Consecutive instances are effector_stride elements apart.
+ */
+IK_PRIVATE_API void
+chain_lanes_gather(struct chain_flat_t* flat,
+                   const ik_vec3_t* positions, uint32_t node_stride,
+                   const ik_vec3_t* targets, uint32_t effector_stride,
+                   uint32_t lane_count);
+
+/*!
+ * @brief Writes the solved positions of a single lane and island to an
+ * array indexed by pose index.
+ */
+IK_PRIVATE_API void
+chain_lanes_scatter(const struct chain_flat_t* flat,
+                    const struct chain_flat_island_t* island,
+                    uint32_t lane,
+                    ik_vec3_t* positions);
+
+/*!
+ * @brief Extracts a single lane.
+ */
+IK_PRIVATE_API ik_vec3_t
+chain_lanes_get(const struct chain_lanes_vec3_t* v, uint32_t lane);
+
+/*!
+ * @brief Same as chain_lanes_gather(), but converts to float lanes.
+ */
+IK_PRIVATE_API void
+chain_lanes_gather_float(struct chain_flat_t* flat,
+                         const ik_vec3_t* positions, uint32_t node_stride,
+                         const ik_vec3_t* targets, uint32_t effector_stride,
+                         uint32_t lane_count);
+
+/*!
+ * @brief Same as chain_lanes_scatter(), but reads float lanes.
+ */
+IK_PRIVATE_API void
+chain_lanes_scatter_float(const struct chain_flat_t* flat,
+                          const struct chain_flat_island_t* island,
+                          uint32_t lane,
+                          ik_vec3_t* positions);
+
+/*!
+ * @brief Same as chain_lanes_get(), but reads float lanes.
+ */
+IK_PRIVATE_API ik_vec3_t
+chain_lanes_get_float(const struct chain_lanes_vec3f_t* v, uint32_t lane);
+
+#if defined(IK_SIMD_AVX2)
+IK_PRIVATE_API extern const struct chain_lanes_kernel_t chain_lanes_kernel_avx2;
+#endif
+
+C_END
+
+#endif /* IK_CHAIN_LANES_H */
@@ -0,0 +1,217 @@
+/*!
+ * @file chain_lanes_avx2_template.h
+ * @brief The AVX2 lane kernel, written once for any lane precision.
+ * chain_lanes_avx2.c includes this file once for ikreal_t lanes and once for
+ * float lanes, after defining:
+ *
+ *   LANES_REAL    Type of the lane components
+ *   LANES_WIDTH   Number of lanes
+ *   LANES_VEC3    Lane vector type holding LANES_WIDTH components per axis
+ *   LANES_FN(fn)  Name of fn for this precision
+ *   lane_t        Register type holding LANES_REAL components
+ *   lane_*        Intrinsics operating on lane_t
+ *
+ * There is deliberately no include guard.
+ */
+
+/*
+ * FABRIK is latency bound, because every segment depends on the result of
+ * the previous one. Each lane group is therefore split across multiple
+ * registers which are processed interleaved.
+ */
+#define REGISTER_COUNT (int)(LANES_WIDTH * sizeof(LANES_REAL) / sizeof(lane_t))
+#define REGISTER_WIDTH (int)(sizeof(lane_t) / sizeof(LANES_REAL))
+#define REGISTER_FOR_EACH(r) for (r = 0; r != REGISTER_COUNT; ++r)
+
+struct LANES_FN(lanes_t)
+{
+    lane_t x[REGISTER_COUNT];
+    lane_t y[REGISTER_COUNT];
+    lane_t z[REGISTER_COUNT];
+};
+
+/* ------------------------------------------------------------------------- */
+static struct LANES_FN(lanes_t)
+LANES_FN(lanes_load)(const LANES_VEC3* v)
+{
+    int r;
+    struct LANES_FN(lanes_t) result;
+    REGISTER_FOR_EACH(r)
+    {
+        result.x[r] = lane_load(v->x + r * REGISTER_WIDTH);
+        result.y[r] = lane_load(v->y + r * REGISTER_WIDTH);
+        result.z[r] = lane_load(v->z + r * REGISTER_WIDTH);
+    }
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(lanes_store)(LANES_VEC3* v, const struct LANES_FN(lanes_t)* value)
+{
+    int r;
+    REGISTER_FOR_EACH(r)
+    {
+        lane_store(v->x + r * REGISTER_WIDTH, value->x[r]);
+        lane_store(v->y + r * REGISTER_WIDTH, value->y[r]);
+        lane_store(v->z + r * REGISTER_WIDTH, value->z[r]);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(lanes_add)(struct LANES_FN(lanes_t)* a, const struct LANES_FN(lanes_t)* b)
+{
+    int r;
+    REGISTER_FOR_EACH(r)
+    {
+        a->x[r] = lane_add(a->x[r], b->x[r]);
+        a->y[r] = lane_add(a->y[r], b->y[r]);
+        a->z[r] = lane_add(a->z[r], b->z[r]);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(lanes_sub)(struct LANES_FN(lanes_t)* a, const struct LANES_FN(lanes_t)* b)
+{
+    int r;
+    REGISTER_FOR_EACH(r)
+    {
+        a->x[r] = lane_sub(a->x[r], b->x[r]);
+        a->y[r] = lane_sub(a->y[r], b->y[r]);
+        a->z[r] = lane_sub(a->z[r], b->z[r]);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(lanes_mul_scalar)(struct LANES_FN(lanes_t)* a, LANES_REAL scalar)
+{
+    int r;
+    lane_t s = lane_set1(scalar);
+    REGISTER_FOR_EACH(r)
+    {
+        a->x[r] = lane_mul(a->x[r], s);
+        a->y[r] = lane_mul(a->y[r], s);
+        a->z[r] = lane_mul(a->z[r], s);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(lanes_normalize)(struct LANES_FN(lanes_t)* a)
+{
+    int r;
+    lane_t one = lane_set1(1.0);
+
+    /*
+     * Same as ik_vec3_static_normalize(). Lanes with a length of 0 become
+     * (1, y, z) and have to be masked out, because 1/0 would otherwise turn
+     * them into NaN.
+     */
+    REGISTER_FOR_EACH(r)
+    {
+        lane_t length = lane_sqrt(lane_add(lane_add(
+            lane_mul(a->x[r], a->x[r]),
+            lane_mul(a->y[r], a->y[r])),
+            lane_mul(a->z[r], a->z[r])));
+        lane_t mask = lane_not_zero(length);
+        lane_t inv_length = lane_div(one, length);
+        a->x[r] = lane_select(one, lane_mul(a->x[r], inv_length), mask);
+        a->y[r] = lane_select(a->y[r], lane_mul(a->y[r], inv_length), mask);
+        a->z[r] = lane_select(a->z[r], lane_mul(a->z[r], inv_length), mask);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(solve_forwards_avx2)(struct chain_flat_t* flat, const struct chain_flat_island_t* island)
+{
+    const struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    const ikreal_t* segment_lengths = chain_flat_data(flat, segment_lengths, ikreal_t);
+    const LANES_VEC3* targets = chain_flat_data(flat, lane_targets, LANES_VEC3);
+    LANES_VEC3* positions = chain_flat_data(flat, lane_positions, LANES_VEC3);
+    LANES_VEC3* accumulators = chain_flat_data(flat, lane_accumulators, LANES_VEC3);
+    uint32_t chain_idx = island->chain_begin + island->chain_count;
+
+    memset(accumulators + island->chain_begin, 0, sizeof(LANES_VEC3) * island->chain_count);
+
+    while (chain_idx-- > island->chain_begin)
+    {
+        const struct chain_flat_chain_t* chain = &chains[chain_idx];
+        uint32_t slot = chain->slot_begin;
+        uint32_t slot_base = chain->slot_begin + chain->slot_count - 1;
+        struct LANES_FN(lanes_t) target_position;
+
+        if (chain->child_count == 0)
+        {
+            target_position = LANES_FN(lanes_load)(&targets[chain->effector_index]);
+        }
+        else
+        {
+            target_position = LANES_FN(lanes_load)(&accumulators[chain_idx]);
+            LANES_FN(lanes_mul_scalar)(&target_position, (LANES_REAL)(1.0 / chain->child_count));
+        }
+
+        for (; slot != slot_base; ++slot)
+        {
+            struct LANES_FN(lanes_t) parent_position = LANES_FN(lanes_load)(&positions[slot + 1]);
+            struct LANES_FN(lanes_t) child_position = target_position;
+
+            /* move node to target */
+            LANES_FN(lanes_store)(&positions[slot], &child_position);
+
+            LANES_FN(lanes_sub)(&target_position, &parent_position);
+            LANES_FN(lanes_normalize)(&target_position);
+            LANES_FN(lanes_mul_scalar)(&target_position, (LANES_REAL)-segment_lengths[slot]);
+            LANES_FN(lanes_add)(&target_position, &child_position);
+        }
+
+        if (chain->parent >= 0)
+        {
+            struct LANES_FN(lanes_t) accumulator = LANES_FN(lanes_load)(&accumulators[chain->parent]);
+            LANES_FN(lanes_add)(&accumulator, &target_position);
+            LANES_FN(lanes_store)(&accumulators[chain->parent], &accumulator);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(solve_backwards_avx2)(struct chain_flat_t* flat, const struct chain_flat_island_t* island)
+{
+    const struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    const ikreal_t* segment_lengths = chain_flat_data(flat, segment_lengths, ikreal_t);
+    LANES_VEC3* positions = chain_flat_data(flat, lane_positions, LANES_VEC3);
+    uint32_t chain_end = island->chain_begin + island->chain_count;
+    uint32_t chain_idx;
+
+    for (chain_idx = island->chain_begin; chain_idx != chain_end; ++chain_idx)
+    {
+        const struct chain_flat_chain_t* chain = &chains[chain_idx];
+        uint32_t slot = chain->slot_begin + chain->slot_count - 1;
+        struct LANES_FN(lanes_t) target_position;
+
+        if (chain->parent >= 0)
+            positions[slot] = positions[chain->base_source];
+        target_position = LANES_FN(lanes_load)(&positions[slot]);
+
+        while (slot-- > chain->slot_begin)
+        {
+            /* target_position holds the (already solved) parent position here */
+            struct LANES_FN(lanes_t) parent_position = target_position;
+            struct LANES_FN(lanes_t) child_position = LANES_FN(lanes_load)(&positions[slot]);
+
+            LANES_FN(lanes_sub)(&target_position, &child_position);
+            LANES_FN(lanes_normalize)(&target_position);
+            LANES_FN(lanes_mul_scalar)(&target_position, (LANES_REAL)-segment_lengths[slot]);
+            LANES_FN(lanes_add)(&target_position, &parent_position);
+            LANES_FN(lanes_store)(&positions[slot], &target_position);
+        }
+    }
+}
+
+#undef REGISTER_COUNT
+#undef REGISTER_WIDTH
+#undef REGISTER_FOR_EACH
@@ -0,0 +1,218 @@
+/*!
+ * @file chain_lanes_scalar_template.h
+ * @brief The portable lane kernel and the lane buffer accessors, written once
+ * for any lane precision. chain_lanes.c includes this file once for ikreal_t
+ * lanes and once for float lanes, after defining:
+ *
+ *   LANES_REAL    Type of the lane components
+ *   LANES_WIDTH   Number of lanes
+ *   LANES_VEC3    Lane vector type holding LANES_WIDTH components per axis
+ *   LANES_SQRT    sqrt() for LANES_REAL
+ *   LANES_FN(fn)  Name of fn for this precision
+ *
+ * There is deliberately no include guard.
+ */
+
+#define LANE_FOR_EACH(lane) for (lane = 0; lane != LANES_WIDTH; ++lane)
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(lanes_add)(LANES_VEC3* v, const LANES_VEC3* other)
+{
+    int lane;
+    LANE_FOR_EACH(lane)
+    {
+        v->x[lane] += other->x[lane];
+        v->y[lane] += other->y[lane];
+        v->z[lane] += other->z[lane];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(lanes_sub)(LANES_VEC3* v, const LANES_VEC3* other)
+{
+    int lane;
+    LANE_FOR_EACH(lane)
+    {
+        v->x[lane] -= other->x[lane];
+        v->y[lane] -= other->y[lane];
+        v->z[lane] -= other->z[lane];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(lanes_mul_scalar)(LANES_VEC3* v, LANES_REAL scalar)
+{
+    int lane;
+    LANE_FOR_EACH(lane)
+    {
+        v->x[lane] *= scalar;
+        v->y[lane] *= scalar;
+        v->z[lane] *= scalar;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(lanes_normalize)(LANES_VEC3* v)
+{
+    int lane;
+    LANE_FOR_EACH(lane)
+    {
+        /* Same as ik_vec3_static_normalize() */
+        LANES_REAL length = LANES_SQRT(v->x[lane]*v->x[lane] + v->y[lane]*v->y[lane] + v->z[lane]*v->z[lane]);
+        if (length != 0.0)
+        {
+            length = (LANES_REAL)1.0 / length;
+            v->x[lane] *= length;
+            v->y[lane] *= length;
+            v->z[lane] *= length;
+        }
+        else
+        {
+            v->x[lane] = 1;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(solve_forwards_scalar)(struct chain_flat_t* flat, const struct chain_flat_island_t* island)
+{
+    const struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    const ikreal_t* segment_lengths = chain_flat_data(flat, segment_lengths, ikreal_t);
+    const LANES_VEC3* targets = chain_flat_data(flat, lane_targets, LANES_VEC3);
+    LANES_VEC3* positions = chain_flat_data(flat, lane_positions, LANES_VEC3);
+    LANES_VEC3* accumulators = chain_flat_data(flat, lane_accumulators, LANES_VEC3);
+    uint32_t chain_idx = island->chain_begin + island->chain_count;
+
+    memset(accumulators + island->chain_begin, 0, sizeof(LANES_VEC3) * island->chain_count);
+
+    while (chain_idx-- > island->chain_begin)
+    {
+        const struct chain_flat_chain_t* chain = &chains[chain_idx];
+        uint32_t slot = chain->slot_begin;
+        uint32_t slot_base = chain->slot_begin + chain->slot_count - 1;
+        LANES_VEC3 target_position;
+
+        if (chain->child_count == 0)
+        {
+            target_position = targets[chain->effector_index];
+        }
+        else
+        {
+            target_position = accumulators[chain_idx];
+            LANES_FN(lanes_mul_scalar)(&target_position, (LANES_REAL)(1.0 / chain->child_count));
+        }
+
+        for (; slot != slot_base; ++slot)
+        {
+            positions[slot] = target_position;
+            LANES_FN(lanes_sub)(&target_position, &positions[slot + 1]);
+            LANES_FN(lanes_normalize)(&target_position);
+            LANES_FN(lanes_mul_scalar)(&target_position, (LANES_REAL)-segment_lengths[slot]);
+            LANES_FN(lanes_add)(&target_position, &positions[slot]);
+        }
+
+        if (chain->parent >= 0)
+            LANES_FN(lanes_add)(&accumulators[chain->parent], &target_position);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(solve_backwards_scalar)(struct chain_flat_t* flat, const struct chain_flat_island_t* island)
+{
+    const struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    const ikreal_t* segment_lengths = chain_flat_data(flat, segment_lengths, ikreal_t);
+    LANES_VEC3* positions = chain_flat_data(flat, lane_positions, LANES_VEC3);
+    uint32_t chain_end = island->chain_begin + island->chain_count;
+    uint32_t chain_idx;
+
+    for (chain_idx = island->chain_begin; chain_idx != chain_end; ++chain_idx)
+    {
+        const struct chain_flat_chain_t* chain = &chains[chain_idx];
+        uint32_t slot = chain->slot_begin + chain->slot_count - 1;
+        LANES_VEC3 target_position;
+
+        if (chain->parent >= 0)
+            positions[slot] = positions[chain->base_source];
+        target_position = positions[slot];
+
+        while (slot-- > chain->slot_begin)
+        {
+            LANES_FN(lanes_sub)(&target_position, &positions[slot]);
+            LANES_FN(lanes_normalize)(&target_position);
+            LANES_FN(lanes_mul_scalar)(&target_position, (LANES_REAL)-segment_lengths[slot]);
+            LANES_FN(lanes_add)(&target_position, &positions[slot + 1]);
+            positions[slot] = target_position;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(lanes_set)(LANES_VEC3* v, uint32_t lane, const ik_vec3_t* value)
+{
+    v->x[lane] = (LANES_REAL)value->x;
+    v->y[lane] = (LANES_REAL)value->y;
+    v->z[lane] = (LANES_REAL)value->z;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+LANES_FN(chain_lanes_gather)(struct chain_flat_t* flat,
+                             const ik_vec3_t* positions, uint32_t node_stride,
+                             const ik_vec3_t* targets, uint32_t effector_stride,
+                             uint32_t lane_count)
+{
+    const uint32_t* slot_pose_index = chain_flat_data(flat, slot_pose_index, uint32_t);
+    LANES_VEC3* lane_positions = chain_flat_data(flat, lane_positions, LANES_VEC3);
+    LANES_VEC3* lane_targets = chain_flat_data(flat, lane_targets, LANES_VEC3);
+    uint32_t slot_count = vector_count(&flat->lane_positions);
+    uint32_t effector_count = vector_count(&flat->lane_targets);
+    uint32_t lane, idx;
+
+    for (lane = 0; lane != LANES_WIDTH; ++lane)
+    {
+        /* Pad unused lanes with the first instance */
+        uint32_t instance = lane < lane_count ? lane : 0;
+        const ik_vec3_t* instance_positions = positions + instance * node_stride;
+        const ik_vec3_t* instance_targets = targets + instance * effector_stride;
+
+        for (idx = 0; idx != slot_count; ++idx)
+            LANES_FN(lanes_set)(&lane_positions[idx], lane, &instance_positions[slot_pose_index[idx]]);
+        for (idx = 0; idx != effector_count; ++idx)
+            LANES_FN(lanes_set)(&lane_targets[idx], lane, &instance_targets[idx]);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void
+LANES_FN(chain_lanes_scatter)(const struct chain_flat_t* flat,
+                              const struct chain_flat_island_t* island,
+                              uint32_t lane,
+                              ik_vec3_t* positions)
+{
+    const uint32_t* slot_pose_index = chain_flat_data(flat, slot_pose_index, uint32_t);
+    const LANES_VEC3* lane_positions = chain_flat_data(flat, lane_positions, LANES_VEC3);
+    uint32_t slot_idx = island->slot_begin + island->slot_count;
+
+    while (slot_idx-- > island->slot_begin)
+        positions[slot_pose_index[slot_idx]] = LANES_FN(chain_lanes_get)(&lane_positions[slot_idx], lane);
+}
+
+/* ------------------------------------------------------------------------- */
+ik_vec3_t
+LANES_FN(chain_lanes_get)(const LANES_VEC3* v, uint32_t lane)
+{
+    ik_vec3_t result;
+    result.x = v->x[lane];
+    result.y = v->y[lane];
+    result.z = v->z[lane];
+    return result;
+}
+
+#undef LANE_FOR_EACH
@@ -0,0 +1,398 @@
+/*!
+ * @file math_inline.h
+ * @brief Inline versions of the vec3 and quaternion kernels used in the
+ * solvers' inner loops.
+ *
+ * The functions in vec3_static.c and quat_static.c are exported through the
+ * IKAPI.vec3 and IKAPI.quat interfaces, so calls to them can't be inlined
+ * and every call has to assume that its arguments overlap. Internally, hot
+ * loops use these instead. They compute exactly the same results as their
+ * exported counterparts, which are implemented in terms of them.
+ *
+ * Unless stated otherwise, arguments marked with IK_RESTRICT must not
+ * overlap.
+ *
+ * The *_fast() variants are used when IK_ENABLE_FAST_MATH is set. They
+ * replace sqrt() and the following division with an approximate reciprocal
+ * square root refined by one Newton-Raphson step, and construct rotations
+ * without trigonometric functions. Their error bounds are documented with
+ * each function.
+ */
+#ifndef IK_MATH_INLINE_H
+#define IK_MATH_INLINE_H
+
+#include "ik/config.h"
+#include "ik/quat.h"
+#include "ik/vec3.h"
+#include <float.h>
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#   include <xmmintrin.h>
+#   define IK_HAVE_RSQRTSS
+#endif
+
+C_BEGIN
+
+/* ------------------------------------------------------------------------- */
+/*!
+ * @brief Approximates 1/sqrt(x). The relative error is below 2.5e-7 if
+ * rsqrtss is available (the initial estimate is good to 12 bits) and below
+ * 5e-6 otherwise (the initial estimate is derived from the float's bits and
+ * needs a second Newton-Raphson step). These bounds hold for all ikreal_t
+ * types, but a float ikreal_t adds its own rounding error on top.
+ *
+ * The estimate is computed in single precision. Values outside of the normal
+ * float range, including 0, take the precise path.
+ */
+static inline ikreal_t
+fast_rsqrt(ikreal_t x)
+{
+    ikreal_t y;
+
+    if (!(x >= FLT_MIN && x <= FLT_MAX))
+        return 1.0 / sqrt(x);
+
+#if defined(IK_HAVE_RSQRTSS)
+    y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss((float)x)));
+#else
+    {
+        union { float f; uint32_t i; } estimate;
+        estimate.f = (float)x;
+        estimate.i = 0x5f375a86 - (estimate.i >> 1);
+        y = estimate.f;
+        y = y * (1.5 - 0.5 * x * y * y);
+    }
+#endif
+
+    return y * (1.5 - 0.5 * x * y * y);
+}
+
+/*!
+ * @brief Approximates sqrt(x) as x * fast_rsqrt(x), with the same error
+ * bound. Returns the same result as sqrt() for 0 and negative values.
+ */
+static inline ikreal_t
+fast_sqrt(ikreal_t x)
+{
+    return x > 0.0 ? x * fast_rsqrt(x) : sqrt(x);
+}
+
+/* ------------------------------------------------------------------------- */
+static inline void
+vec3_set(ikreal_t* v, const ikreal_t* src)
+{
+    v[0] = src[0];
+    v[1] = src[1];
+    v[2] = src[2];
+}
+
+static inline void
+vec3_set_zero(ikreal_t* v)
+{
+    v[0] = 0.0;
+    v[1] = 0.0;
+    v[2] = 0.0;
+}
+
+static inline void
+vec3_add_vec3(ikreal_t* IK_RESTRICT v1, const ikreal_t* IK_RESTRICT v2)
+{
+    v1[0] += v2[0];
+    v1[1] += v2[1];
+    v1[2] += v2[2];
+}
+
+static inline void
+vec3_sub_vec3(ikreal_t* IK_RESTRICT v1, const ikreal_t* IK_RESTRICT v2)
+{
+    v1[0] -= v2[0];
+    v1[1] -= v2[1];
+    v1[2] -= v2[2];
+}
+
+static inline void
+vec3_mul_scalar(ikreal_t* v, ikreal_t scalar)
+{
+    v[0] *= scalar;
+    v[1] *= scalar;
+    v[2] *= scalar;
+}
+
+static inline void
+vec3_div_scalar(ikreal_t* v, ikreal_t scalar)
+{
+    ikreal_t det = 1.0 / scalar;
+    v[0] *= det;
+    v[1] *= det;
+    v[2] *= det;
+}
+
+static inline ikreal_t
+vec3_dot(const ikreal_t* v1, const ikreal_t* v2)
+{
+    return v1[0] * v2[0] +
+           v1[1] * v2[1] +
+           v1[2] * v2[2];
+}
+
+static inline ikreal_t
+vec3_length_squared(const ikreal_t* v)
+{
+    return vec3_dot(v, v);
+}
+
+static inline ikreal_t
+vec3_length(const ikreal_t* v)
+{
+    return sqrt(vec3_length_squared(v));
+}
+
+/* A zero length vector becomes the X axis */
+static inline void
+vec3_normalize(ikreal_t* v)
+{
+    ikreal_t length = vec3_length(v);
+    if (length != 0.0)
+    {
+        length = 1.0 / length;
+        v[0] *= length;
+        v[1] *= length;
+        v[2] *= length;
+    }
+    else
+    {
+        v[0] = 1;
+    }
+}
+
+/*! @brief Same as vec3_normalize(), with the error bound of fast_rsqrt(). */
+static inline void
+vec3_normalize_fast(ikreal_t* v)
+{
+    ikreal_t length_squared = vec3_length_squared(v);
+    if (length_squared != 0.0)
+    {
+        ikreal_t inv_length = fast_rsqrt(length_squared);
+        v[0] *= inv_length;
+        v[1] *= inv_length;
+        v[2] *= inv_length;
+    }
+    else
+    {
+        v[0] = 1;
+    }
+}
+
+static inline void
+vec3_cross(ikreal_t* IK_RESTRICT v1, const ikreal_t* IK_RESTRICT v2)
+{
+    ikreal_t v1x = v1[1] * v2[2] - v2[1] * v1[2];
+    ikreal_t v1z = v1[0] * v2[1] - v2[0] * v1[1];
+    v1[1]       = v1[2] * v2[0] - v2[2] * v1[0];
+    v1[0] = v1x;
+    v1[2] = v1z;
+}
+
+static inline int
+vec3_equal(const ikreal_t* v1, const ikreal_t* v2)
+{
+    return v1[0] == v2[0] && v1[1] == v2[1] && v1[2] == v2[2];
+}
+
+/*!
+ * @brief The FABRIK step: Writes the point which lies at the specified
+ * distance from "from", in the direction of "towards", to out. If both points
+ * coincide, the point is placed along the negative X axis. out may overlap
+ * with either input.
+ */
+static inline void
+vec3_point_towards(ikreal_t* out, const ikreal_t* from, const ikreal_t* towards, ikreal_t distance)
+{
+    ik_vec3_t direction;
+    direction.f[0] = from[0] - towards[0];
+    direction.f[1] = from[1] - towards[1];
+    direction.f[2] = from[2] - towards[2];
+    vec3_normalize(direction.f);
+    vec3_mul_scalar(direction.f, -distance);
+    out[0] = direction.f[0] + from[0];
+    out[1] = direction.f[1] + from[1];
+    out[2] = direction.f[2] + from[2];
+}
+
+/*!
+ * @brief Same as vec3_point_towards(). The distance of out from "from" has
+ * the relative error bound of fast_rsqrt().
+ */
+static inline void
+vec3_point_towards_fast(ikreal_t* out, const ikreal_t* from, const ikreal_t* towards, ikreal_t distance)
+{
+    ik_vec3_t direction;
+    direction.f[0] = from[0] - towards[0];
+    direction.f[1] = from[1] - towards[1];
+    direction.f[2] = from[2] - towards[2];
+    vec3_normalize_fast(direction.f);
+    vec3_mul_scalar(direction.f, -distance);
+    out[0] = direction.f[0] + from[0];
+    out[1] = direction.f[1] + from[1];
+    out[2] = direction.f[2] + from[2];
+}
+
+/* ------------------------------------------------------------------------- */
+static inline void
+quat_set(ikreal_t* q, const ikreal_t* src)
+{
+    q[0] = src[0];
+    q[1] = src[1];
+    q[2] = src[2];
+    q[3] = src[3];
+}
+
+static inline void
+quat_conj(ikreal_t* q)
+{
+    q[0] = -q[0];
+    q[1] = -q[1];
+    q[2] = -q[2];
+}
+
+static inline ikreal_t
+quat_mag(const ikreal_t* q)
+{
+    return sqrt(q[3]*q[3] + q[2]*q[2] + q[1]*q[1] + q[0]*q[0]);
+}
+
+static inline void
+quat_normalize(ikreal_t* q)
+{
+    ikreal_t mag = quat_mag(q);
+    if (mag != 0.0)
+        mag = 1.0 / mag;
+    q[0] *= mag;
+    q[1] *= mag;
+    q[2] *= mag;
+    q[3] *= mag;
+}
+
+static inline ikreal_t
+quat_dot(const ikreal_t* q1, const ikreal_t* q2)
+{
+    return q1[0] * q2[0] +
+           q1[1] * q2[1] +
+           q1[2] * q2[2] +
+           q1[3] * q2[3];
+}
+
+static inline int
+quat_equal(const ikreal_t* q1, const ikreal_t* q2)
+{
+    return q1[0] == q2[0] && q1[1] == q2[1] && q1[2] == q2[2] && q1[3] == q2[3];
+}
+
+static inline void
+quat_mul_no_normalize(ikreal_t* IK_RESTRICT q1, const ikreal_t* IK_RESTRICT q2)
+{
+    ik_vec3_t v1;
+    ik_vec3_t v2;
+    vec3_set(v1.f, q1);
+    vec3_set(v2.f, q2);
+
+    vec3_mul_scalar(v1.f, q2[3]);
+    vec3_mul_scalar(v2.f, q1[3]);
+    q1[3] = q1[3]*q2[3] - vec3_dot(q1, q2);
+    vec3_cross(q1, q2);
+    vec3_add_vec3(q1, v1.f);
+    vec3_add_vec3(q1, v2.f);
+}
+
+static inline void
+quat_mul_quat(ikreal_t* IK_RESTRICT q1, const ikreal_t* IK_RESTRICT q2)
+{
+    quat_mul_no_normalize(q1, q2);
+    quat_normalize(q1);
+}
+
+/* ------------------------------------------------------------------------- */
+static inline void
+vec3_rotate(ikreal_t* IK_RESTRICT v, const ikreal_t* IK_RESTRICT q)
+{
+    /* P' = RPR' */
+    ik_quat_t result;
+    ik_quat_t conj;
+    ik_quat_t point;
+
+    vec3_set(point.f, v);
+    point.w = 0.0;
+
+    quat_set(conj.f, q);
+    quat_conj(conj.f);
+
+    quat_set(result.f, q);
+    quat_mul_no_normalize(result.f, point.f);
+    quat_mul_no_normalize(result.f, conj.f);
+    vec3_set(v, result.f);
+}
+
+/*!
+ * @brief Same as ik_quat_static_angle(): Writes the rotation which rotates
+ * the direction of v1 onto the direction of v2 to q. Neither vector needs to
+ * be normalized.
+ *
+ * Instead of acos() followed by cos() and sin() of the half angle, this uses
+ * the fact that the quaternion (v1 x v2, |v1||v2| + v1.v2) rotates by the
+ * same angle around the same axis, so normalizing it yields the rotation
+ * directly. The normalization has the error bound of fast_rsqrt(). |v1||v2|
+ * is computed with a precise sqrt(), because near 180 degrees the w
+ * component is the difference of two almost equal values. If the vectors are
+ * within about 1e-8 radians of opposite directions, the result is a rotation
+ * by 180 degrees around an axis perpendicular to v1. If either vector has
+ * zero length, q is set to identity.
+ */
+static inline void
+quat_angle_fast(ikreal_t* IK_RESTRICT q, const ikreal_t* v1, const ikreal_t* v2)
+{
+    ikreal_t length_product_squared = vec3_length_squared(v1) * vec3_length_squared(v2);
+    ikreal_t length_product = sqrt(length_product_squared);
+    ikreal_t magnitude_squared;
+
+    vec3_set(q, v1);
+    vec3_cross(q, v2);
+    q[3] = length_product + vec3_dot(v1, v2);
+
+    magnitude_squared = quat_dot(q, q);
+    if (magnitude_squared > length_product_squared * IK_EPSILON)
+    {
+        ikreal_t inv_magnitude = fast_rsqrt(magnitude_squared);
+        q[0] *= inv_magnitude;
+        q[1] *= inv_magnitude;
+        q[2] *= inv_magnitude;
+        q[3] *= inv_magnitude;
+    }
+    else if (length_product_squared > 0.0)
+    {
+        /* Cross v1 with the axis it has the smallest component along */
+        ik_vec3_t axis = {{0, 0, 0}};
+        if (ik_fabs(v1[0]) <= ik_fabs(v1[1]) && ik_fabs(v1[0]) <= ik_fabs(v1[2]))
+            axis.f[0] = 1;
+        else if (ik_fabs(v1[1]) <= ik_fabs(v1[2]))
+            axis.f[1] = 1;
+        else
+            axis.f[2] = 1;
+
+        vec3_set(q, v1);
+        vec3_cross(q, axis.f);
+        vec3_normalize(q);
+        q[3] = 0;
+    }
+    else
+    {
+        q[0] = 0;
+        q[1] = 0;
+        q[2] = 0;
+        q[3] = 1;
+    }
+}
+
+C_END
+
+#endif /* IK_MATH_INLINE_H */
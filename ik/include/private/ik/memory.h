@@ -2,16 +2,23 @@
 #define MEMORY_H
 
 #include "ik/config.h"
+#include <stdlib.h>
 
 #ifdef IK_MEMORY_DEBUGGING
-#   define MALLOC malloc_wrapper
-#   define FREE   free_wrapper
+#   define MALLOC  malloc_wrapper
+#   define REALLOC realloc_wrapper
+#   define FREE    free_wrapper
 #else
-#   include <stdlib.h>
-#   define MALLOC malloc
-#   define FREE   free
+#   define MALLOC  ik_malloc
+#   define REALLOC ik_realloc
+#   define FREE    ik_free
 #endif
 
+/* Nodes, effectors and constraints are carved out of fixed-size pools */
+#include "ik/pool.h"
+#define MALLOC_OBJECT pool_malloc
+#define FREE_OBJECT   pool_free
+
 C_BEGIN
 
 /*!
@@ -33,6 +40,27 @@ ik_memory_init(void);
 IK_PRIVATE_API uintptr_t
 ik_memory_deinit(void);
 
+/*!
+ * @brief Allocates memory through the allocator set with
+ * IKAPI.implement_callbacks(), or malloc() if none was set.
+ */
+IK_PRIVATE_API void*
+ik_malloc(uintptr_t size);
+
+/*!
+ * @brief Resizes memory through the allocator set with
+ * IKAPI.implement_callbacks(), or realloc() if none was set.
+ */
+IK_PRIVATE_API void*
+ik_realloc(void* ptr, uintptr_t size);
+
+/*!
+ * @brief Frees memory through the allocator set with
+ * IKAPI.implement_callbacks(), or free() if none was set.
+ */
+IK_PRIVATE_API void
+ik_free(void* ptr);
+
 #ifdef IK_MEMORY_DEBUGGING
 /*!
  * @brief Does the same thing as a normal call to malloc(), but does some
@@ -41,12 +69,31 @@ ik_memory_deinit(void);
 IK_PRIVATE_API void*
 malloc_wrapper(intptr_t size);
 
+/*!
+ * @brief Does the same thing as a normal call to realloc(), but does some
+ * additional work to monitor and track down memory leaks.
+ */
+IK_PRIVATE_API void*
+realloc_wrapper(void* ptr, intptr_t size);
+
 /*!
  * @brief Does the same thing as a normal call to fee(), but does some
  * additional work to monitor and track down memory leaks.
  */
 IK_PRIVATE_API void
 free_wrapper(void* ptr);
+
+/*!
+ * @brief Returns the number of calls to malloc_wrapper(), realloc_wrapper()
+ * and free_wrapper() respectively since ik_memory_init(). Used by the unit
+ * tests to check that a piece of code doesn't touch the heap.
+ */
+IK_PRIVATE_API uintptr_t
+ik_memory_allocation_count(void);
+IK_PRIVATE_API uintptr_t
+ik_memory_reallocation_count(void);
+IK_PRIVATE_API uintptr_t
+ik_memory_deallocation_count(void);
 #endif /* IK_MEMORY_DEBUGGING */
 
 IK_PRIVATE_API void
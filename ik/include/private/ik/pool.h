@@ -0,0 +1,59 @@
+/*!
+ * @file pool.h
+ * @brief Fixed-size object pools for nodes, effectors and constraints.
+ *
+ * Building a tree creates thousands of small objects of only a handful of
+ * distinct sizes. Instead of going to MALLOC() for every one of them, objects
+ * are carved out of larger blocks. Each size class has its own pool with a
+ * free list, so allocating and freeing an object is a pointer swap and
+ * destroying a whole tree never returns memory to the system one object at a
+ * time. The blocks themselves are allocated with MALLOC() and are released in
+ * bulk when the library is de-initialized.
+ *
+ * Every object is prefixed with a small header remembering which pool it came
+ * from, so pool_free() does not need to know the size of the object (a node
+ * may have been allocated as a larger, solver specific type).
+ *
+ * Objects larger than the largest size class fall back to MALLOC().
+ */
+#ifndef IK_POOL_H
+#define IK_POOL_H
+
+#include "ik/config.h"
+
+C_BEGIN
+
+/*!
+ * @brief Allocates an object of the specified size from the pool of the
+ * matching size class. The returned memory is not initialized.
+ * @return Returns NULL if the underlying allocation failed.
+ */
+IK_PRIVATE_API void*
+pool_malloc(uintptr_t size);
+
+/*!
+ * @brief Returns an object allocated with pool_malloc() to its pool.
+ * @note ptr must not be NULL.
+ */
+IK_PRIVATE_API void
+pool_free(void* ptr);
+
+/*!
+ * @brief Returns the number of objects currently allocated from all pools.
+ */
+IK_PRIVATE_API uintptr_t
+pool_live_objects(void);
+
+/*!
+ * @brief Releases the blocks of all pools back to the system.
+ *
+ * Pools that still have live objects keep their blocks, since those objects
+ * may still be freed later.
+ * @return Returns the number of objects that were never freed.
+ */
+IK_PRIVATE_API uintptr_t
+pool_deinit(void);
+
+C_END
+
+#endif /* IK_POOL_H */
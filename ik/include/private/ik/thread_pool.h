@@ -0,0 +1,58 @@
+/*!
+ * @file thread_pool.h
+ * @brief A minimal fork-join thread pool for running a batch of independent
+ * tasks (e.g. chain islands) in parallel.
+ *
+ * Tasks are identified by their index. When a batch is started, every thread
+ * (including the calling thread) is handed a contiguous range of task
+ * indices. Threads take tasks from the front of their own range and, once it
+ * is empty, steal from the back of the other threads' ranges, so batches of
+ * unevenly sized tasks still balance out.
+ *
+ * Only available if the library was built with IK_THREADS. Otherwise
+ * thread_pool_create() fails and callers are expected to run their tasks on
+ * the calling thread.
+ */
+#ifndef IK_THREAD_POOL_H
+#define IK_THREAD_POOL_H
+
+#include "ik/config.h"
+
+C_BEGIN
+
+struct thread_pool_t;
+
+typedef void (*thread_pool_task_func)(void* context, uint32_t task_idx);
+
+/*!
+ * @brief Starts thread_count-1 worker threads. The thread calling
+ * thread_pool_run() acts as the remaining worker.
+ * @return Returns NULL if thread support isn't available or if the threads
+ * could not be created.
+ */
+IK_PRIVATE_API struct thread_pool_t*
+thread_pool_create(uint32_t thread_count);
+
+/*!
+ * @brief Joins all worker threads and frees the pool.
+ */
+IK_PRIVATE_API void
+thread_pool_destroy(struct thread_pool_t* pool);
+
+IK_PRIVATE_API uint32_t
+thread_pool_thread_count(const struct thread_pool_t* pool);
+
+/*!
+ * @brief Calls func(context, i) for every i in [0, task_count) and blocks
+ * until all calls have returned. Calls may happen concurrently and in any
+ * order.
+ */
+IK_PRIVATE_API void
+thread_pool_run(struct thread_pool_t* pool,
+                uint32_t task_count,
+                thread_pool_task_func func,
+                void* context);
+
+C_END
+
+#endif /* IK_THREAD_POOL_H */
@@ -0,0 +1,98 @@
+/*!
+ * @file tree_flat.h
+ * @brief Flattens the whole node tree into a contiguous array so the tree can
+ * be traversed and searched without chasing child pointers.
+ *
+ * Nodes are stored in depth-first pre-order, i.e. every node comes before all
+ * of its children and all nodes of a sub-tree are adjacent. Children of a node
+ * are in the same order as in the tree. The tree structure is stored as
+ * indices into the same array: the first child of a node (always the next
+ * node, if it has children) and its next sibling (the first node after its
+ * sub-tree, if it has a next sibling).
+ *
+ * Additionally, a hash table maps guids to indices, so nodes can be found in
+ * constant time instead of searching the tree recursively.
+ *
+ * The flat tree holds pointers to the nodes and becomes invalid as soon as
+ * nodes are added to or removed from the tree. The solver rebuilds it in
+ * rebuild() whenever that happens.
+ */
+#ifndef IK_TREE_FLAT_H
+#define IK_TREE_FLAT_H
+
+#include "ik/config.h"
+#include "ik/vector.h"
+
+C_BEGIN
+
+struct ik_node_t;
+
+struct tree_flat_t
+{
+    /* Per-node data. All of these have the same number of elements */
+    struct vector_t nodes;        /* struct ik_node_t*, in pre-order */
+    struct vector_t parents;      /* int32_t, index of the parent node, or -1 for the root */
+    struct vector_t first_child;  /* int32_t, index of the first child, or -1 */
+    struct vector_t next_sibling; /* int32_t, index of the next sibling, or -1 */
+
+    /*
+     * Open addressing hash table with linear probing, mapping guids to node
+     * indices. The number of buckets is a power of two and empty buckets are
+     * -1.
+     */
+    struct vector_t buckets;      /* int32_t */
+};
+
+IK_PRIVATE_API struct tree_flat_t*
+tree_flat_create(void);
+
+IK_PRIVATE_API void
+tree_flat_destroy(struct tree_flat_t* flat);
+
+IK_PRIVATE_API void
+tree_flat_construct(struct tree_flat_t* flat);
+
+IK_PRIVATE_API void
+tree_flat_destruct(struct tree_flat_t* flat);
+
+/*!
+ * @brief Releases all references to nodes. tree_flat_find() returns NULL
+ * until the tree is built again.
+ */
+IK_PRIVATE_API void
+tree_flat_clear(struct tree_flat_t* flat);
+
+/*!
+ * @brief Flattens the tree below (and including) the specified node.
+ * Anything previously stored is discarded.
+ */
+IK_PRIVATE_API ikret_t
+tree_flat_build(struct tree_flat_t* flat, struct ik_node_t* root);
+
+/*!
+ * @brief Returns the index of the node with the specified guid, or -1 if no
+ * such node exists. If several nodes share a guid, the first one in pre-order
+ * is returned.
+ */
+IK_PRIVATE_API int32_t
+tree_flat_find_index(const struct tree_flat_t* flat, uint32_t guid);
+
+/*!
+ * @brief Returns the node with the specified guid, or NULL if no such node
+ * exists.
+ */
+IK_PRIVATE_API struct ik_node_t*
+tree_flat_find(const struct tree_flat_t* flat, uint32_t guid);
+
+#define tree_flat_node_count(flat) \
+    vector_count(&(flat)->nodes)
+
+#define tree_flat_data(flat_var, member, type) \
+    ((type*)(flat_var)->member.data)
+
+#define tree_flat_get_node(flat, idx) \
+    (tree_flat_data(flat, nodes, struct ik_node_t*)[idx])
+
+C_END
+
+#endif /* IK_TREE_FLAT_H */
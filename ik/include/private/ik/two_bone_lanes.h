@@ -0,0 +1,45 @@
+/*!
+ * @file two_bone_lanes.h
+ * @brief Lane-wide (SIMD) analytic two bone solver for ik_limbs_t.
+ *
+ * Unlike FABRIK, the two bone solution is closed-form and every limb is
+ * independent of every other limb, so the kernels load a register's worth
+ * of consecutive limbs straight from the structure-of-arrays in ik_limbs_t
+ * and solve them without any branches.
+ *
+ * There is always a portable scalar kernel. If the library was configured
+ * with IK_SIMD=AVX2, an AVX2 kernel is compiled in as well and is selected
+ * at runtime if the CPU supports it.
+ */
+#ifndef IK_TWO_BONE_LANES_H
+#define IK_TWO_BONE_LANES_H
+
+#include "ik/config.h"
+
+C_BEGIN
+
+struct ik_limbs_t;
+
+struct two_bone_lanes_kernel_t
+{
+    const char* name;
+    /*!
+     * Solves every limb. Returns the number of limbs whose target was out
+     * of reach.
+     */
+    uint32_t (*solve)(struct ik_limbs_t* limbs);
+};
+
+/*!
+ * @brief Returns the fastest kernel supported by the CPU we're running on.
+ */
+IK_PRIVATE_API const struct two_bone_lanes_kernel_t*
+two_bone_lanes_kernel(void);
+
+#if defined(IK_SIMD_AVX2)
+IK_PRIVATE_API extern const struct two_bone_lanes_kernel_t two_bone_lanes_kernel_avx2;
+#endif
+
+C_END
+
+#endif /* IK_TWO_BONE_LANES_H */
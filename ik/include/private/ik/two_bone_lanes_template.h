@@ -0,0 +1,365 @@
+/*!
+ * @file two_bone_lanes_template.h
+ * @brief The two bone lane kernel, written once for any lane type.
+ * two_bone_lanes.c and two_bone_lanes_avx2.c include this file after
+ * defining:
+ *
+ *   LANES_WIDTH   Number of ikreal_t components in a lane_t
+ *   LANES_FN(fn)  Name of fn for this kernel
+ *   lane_t        Register type holding LANES_WIDTH ikreal_t components
+ *   lane_*        Operations on lane_t. Comparisons return a mask which
+ *                 lane_select(a, b, mask) uses to pick b over a.
+ *
+ * There is deliberately no include guard.
+ */
+
+struct LANES_FN(vec3_t)
+{
+    lane_t x, y, z;
+};
+
+struct LANES_FN(quat_t)
+{
+    lane_t x, y, z, w;
+};
+
+/* ------------------------------------------------------------------------- */
+static inline struct LANES_FN(vec3_t)
+LANES_FN(load)(const struct ik_vec3_array_t* array, uint32_t idx)
+{
+    struct LANES_FN(vec3_t) result;
+    result.x = lane_load(array->x + idx);
+    result.y = lane_load(array->y + idx);
+    result.z = lane_load(array->z + idx);
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static inline void
+LANES_FN(store)(struct ik_vec3_array_t* array, uint32_t idx, struct LANES_FN(vec3_t) v)
+{
+    lane_store(array->x + idx, v.x);
+    lane_store(array->y + idx, v.y);
+    lane_store(array->z + idx, v.z);
+}
+
+/* ------------------------------------------------------------------------- */
+static inline void
+LANES_FN(store_quat)(struct ik_quat_array_t* array, uint32_t idx, struct LANES_FN(quat_t) q)
+{
+    lane_store(array->x + idx, q.x);
+    lane_store(array->y + idx, q.y);
+    lane_store(array->z + idx, q.z);
+    lane_store(array->w + idx, q.w);
+}
+
+/* ------------------------------------------------------------------------- */
+static inline struct LANES_FN(vec3_t)
+LANES_FN(sub)(struct LANES_FN(vec3_t) a, struct LANES_FN(vec3_t) b)
+{
+    struct LANES_FN(vec3_t) result;
+    result.x = lane_sub(a.x, b.x);
+    result.y = lane_sub(a.y, b.y);
+    result.z = lane_sub(a.z, b.z);
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Returns a + b * s */
+static inline struct LANES_FN(vec3_t)
+LANES_FN(mul_add)(struct LANES_FN(vec3_t) a, struct LANES_FN(vec3_t) b, lane_t s)
+{
+    struct LANES_FN(vec3_t) result;
+    result.x = lane_add(a.x, lane_mul(b.x, s));
+    result.y = lane_add(a.y, lane_mul(b.y, s));
+    result.z = lane_add(a.z, lane_mul(b.z, s));
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static inline struct LANES_FN(vec3_t)
+LANES_FN(scale)(struct LANES_FN(vec3_t) v, lane_t s)
+{
+    v.x = lane_mul(v.x, s);
+    v.y = lane_mul(v.y, s);
+    v.z = lane_mul(v.z, s);
+    return v;
+}
+
+/* ------------------------------------------------------------------------- */
+static inline lane_t
+LANES_FN(dot)(struct LANES_FN(vec3_t) a, struct LANES_FN(vec3_t) b)
+{
+    return lane_add(lane_add(lane_mul(a.x, b.x), lane_mul(a.y, b.y)), lane_mul(a.z, b.z));
+}
+
+/* ------------------------------------------------------------------------- */
+static inline struct LANES_FN(vec3_t)
+LANES_FN(cross)(struct LANES_FN(vec3_t) a, struct LANES_FN(vec3_t) b)
+{
+    struct LANES_FN(vec3_t) result;
+    result.x = lane_sub(lane_mul(a.y, b.z), lane_mul(a.z, b.y));
+    result.y = lane_sub(lane_mul(a.z, b.x), lane_mul(a.x, b.z));
+    result.z = lane_sub(lane_mul(a.x, b.y), lane_mul(a.y, b.x));
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static inline struct LANES_FN(vec3_t)
+LANES_FN(select)(struct LANES_FN(vec3_t) a, struct LANES_FN(vec3_t) b, lane_t mask)
+{
+    struct LANES_FN(vec3_t) result;
+    result.x = lane_select(a.x, b.x, mask);
+    result.y = lane_select(a.y, b.y, mask);
+    result.z = lane_select(a.z, b.z, mask);
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static inline lane_t
+LANES_FN(abs)(lane_t a)
+{
+    return lane_max(a, lane_sub(lane_set1(0), a));
+}
+
+/* ------------------------------------------------------------------------- */
+/* Removes the component along the normalized direction dir from v */
+static inline struct LANES_FN(vec3_t)
+LANES_FN(reject)(struct LANES_FN(vec3_t) v, struct LANES_FN(vec3_t) dir)
+{
+    return LANES_FN(mul_add)(v, dir, lane_sub(lane_set1(0), LANES_FN(dot)(v, dir)));
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Returns a vector perpendicular to v by crossing it with the X or Y axis,
+ * whichever v has the smaller component along. Only zero if v is zero.
+ */
+static inline struct LANES_FN(vec3_t)
+LANES_FN(perpendicular)(struct LANES_FN(vec3_t) v)
+{
+    struct LANES_FN(vec3_t) cross_x, cross_y;
+    lane_t zero = lane_set1(0);
+    cross_x.x = zero;
+    cross_x.y = v.z;
+    cross_x.z = lane_sub(zero, v.y);
+    cross_y.x = lane_sub(zero, v.z);
+    cross_y.y = zero;
+    cross_y.z = v.x;
+    return LANES_FN(select)(cross_x, cross_y, lane_gt(LANES_FN(abs)(v.x), LANES_FN(abs)(v.y)));
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Same as quat_angle_fast(), with a precise normalization: The rotation
+ * which rotates the direction of v1 onto the direction of v2, constructed as
+ * the normalized quaternion (v1 x v2, |v1||v2| + v1.v2). Opposite vectors
+ * result in a rotation of 180 degrees around an axis perpendicular to v1.
+ */
+static inline struct LANES_FN(quat_t)
+LANES_FN(angle)(struct LANES_FN(vec3_t) v1, struct LANES_FN(vec3_t) v2)
+{
+    struct LANES_FN(quat_t) result;
+    struct LANES_FN(vec3_t) axis = LANES_FN(cross)(v1, v2);
+    struct LANES_FN(vec3_t) turn_axis = LANES_FN(perpendicular)(v1);
+    lane_t length_product_squared = lane_mul(LANES_FN(dot)(v1, v1), LANES_FN(dot)(v2, v2));
+    lane_t w = lane_add(lane_sqrt(length_product_squared), LANES_FN(dot)(v1, v2));
+    lane_t magnitude_squared = lane_add(LANES_FN(dot)(axis, axis), lane_mul(w, w));
+    lane_t not_opposite = lane_gt(magnitude_squared, lane_mul(length_product_squared, lane_set1(IK_EPSILON)));
+    lane_t inv_magnitude;
+
+    axis = LANES_FN(select)(turn_axis, axis, not_opposite);
+    w = lane_select(lane_set1(0), w, not_opposite);
+    magnitude_squared = lane_select(LANES_FN(dot)(turn_axis, turn_axis), magnitude_squared, not_opposite);
+    inv_magnitude = lane_div(lane_set1(1), lane_sqrt(magnitude_squared));
+
+    result.x = lane_mul(axis.x, inv_magnitude);
+    result.y = lane_mul(axis.y, inv_magnitude);
+    result.z = lane_mul(axis.z, inv_magnitude);
+    result.w = lane_mul(w, inv_magnitude);
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Solves the LANES_WIDTH limbs starting at idx and returns a lane holding 1
+ * for every limb whose target was out of reach and 0 otherwise.
+ */
+static lane_t
+LANES_FN(solve_lanes)(struct ik_limbs_t* limbs, uint32_t idx)
+{
+    struct LANES_FN(vec3_t) base   = LANES_FN(load)(&limbs->bases, idx);
+    struct LANES_FN(vec3_t) mid    = LANES_FN(load)(&limbs->mids, idx);
+    struct LANES_FN(vec3_t) tip    = LANES_FN(load)(&limbs->tips, idx);
+    struct LANES_FN(vec3_t) target = LANES_FN(load)(&limbs->targets, idx);
+    struct LANES_FN(vec3_t) pole   = LANES_FN(load)(&limbs->poles, idx);
+    struct LANES_FN(vec3_t) upper, lower, to_target, dir, bend, solved_mid, solved_tip;
+    lane_t aa, bb, dd, a, b, d, c, x, h, max_reach, min_reach, epsilon, has_direction, has_bend, out_of_reach;
+    lane_t zero = lane_set1(0);
+    lane_t one = lane_set1(1);
+
+    upper = LANES_FN(sub)(mid, base);
+    lower = LANES_FN(sub)(tip, mid);
+    to_target = LANES_FN(sub)(target, base);
+    aa = LANES_FN(dot)(upper, upper);
+    bb = LANES_FN(dot)(lower, lower);
+    dd = LANES_FN(dot)(to_target, to_target);
+    a = lane_sqrt(aa);
+    b = lane_sqrt(bb);
+    d = lane_sqrt(dd);
+    epsilon = lane_mul(aa, lane_set1(IK_EPSILON));
+
+    /* Clamp the distance to the target to the range the limb can reach */
+    max_reach = lane_add(a, b);
+    min_reach = LANES_FN(abs)(lane_sub(a, b));
+    out_of_reach = lane_add(
+        lane_select(zero, one, lane_gt(d, max_reach)),
+        lane_select(zero, one, lane_gt(min_reach, d)));
+    c = lane_min(lane_max(d, min_reach), max_reach);
+
+    /* If the target coincides with the base, keep the upper segment's direction */
+    has_direction = lane_gt(dd, epsilon);
+    dir = LANES_FN(scale)(
+        LANES_FN(select)(upper, to_target, has_direction),
+        lane_div(one, lane_select(a, d, has_direction)));
+
+    /*
+     * The mid node moves within the plane spanned by dir and the direction
+     * it bends towards. That's the pole, or if the pole lies on the line to
+     * the target, the direction within the current bend plane which keeps
+     * the mid node on the same side. dir x (upper x lower) is
+     * upper (dir.lower) - lower (dir.upper), which is perpendicular to dir
+     * and points to where upper lies relative to the line from the base to
+     * the tip if dir points at the tip. If the limb is straight, it keeps
+     * pointing in the direction of the upper segment, and if that's along
+     * dir as well, in any direction.
+     */
+    bend = LANES_FN(reject)(LANES_FN(sub)(pole, base), dir);
+    has_bend = lane_gt(LANES_FN(dot)(bend, bend), epsilon);
+    bend = LANES_FN(select)(LANES_FN(cross)(dir, LANES_FN(cross)(upper, lower)), bend, has_bend);
+    has_bend = lane_gt(LANES_FN(dot)(bend, bend), lane_mul(epsilon, bb));
+    bend = LANES_FN(select)(LANES_FN(reject)(upper, dir), bend, has_bend);
+    has_bend = lane_gt(LANES_FN(dot)(bend, bend), epsilon);
+    bend = LANES_FN(select)(LANES_FN(perpendicular)(dir), bend, has_bend);
+    bend = LANES_FN(scale)(bend, lane_div(one, lane_sqrt(LANES_FN(dot)(bend, bend))));
+
+    /*
+     * Law of cosines. The mid node projected onto the line from the base to
+     * the target lies x away from the base, and the mid node lies h away
+     * from that line.
+     *
+     *              mid
+     *            _-|-_
+     *         a_-  |h -_b
+     *        _-    |    -_
+     *   base *-----+------* target
+     *           x
+     *        |<-----c---->|
+     */
+    x = lane_div(lane_add(lane_sub(aa, bb), lane_mul(c, c)),
+                 lane_mul(lane_set1(2), lane_max(c, lane_mul(a, lane_set1(IK_EPSILON)))));
+    x = lane_select(zero, x, lane_gt(c, lane_mul(a, lane_set1(IK_EPSILON))));
+    h = lane_sqrt(lane_max(lane_sub(aa, lane_mul(x, x)), zero));
+
+    /* Stretched or folded limbs are straight, whatever rounding says about h */
+    h = lane_select(zero, h, lane_gt(max_reach, c));
+    h = lane_select(zero, h, lane_gt(c, min_reach));
+
+    solved_mid = LANES_FN(mul_add)(LANES_FN(mul_add)(base, dir, x), bend, h);
+    solved_tip = LANES_FN(mul_add)(base, dir, c);
+
+    LANES_FN(store)(&limbs->mids, idx, solved_mid);
+    LANES_FN(store)(&limbs->tips, idx, solved_tip);
+    LANES_FN(store_quat)(&limbs->base_rotations, idx,
+        LANES_FN(angle)(upper, LANES_FN(sub)(solved_mid, base)));
+    LANES_FN(store_quat)(&limbs->mid_rotations, idx,
+        LANES_FN(angle)(lower, LANES_FN(sub)(solved_tip, solved_mid)));
+
+    return out_of_reach;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+LANES_FN(copy_limb)(struct ik_limbs_t* dst, uint32_t dst_idx,
+                    const struct ik_limbs_t* src, uint32_t src_idx)
+{
+#define COPY_VEC3(array) \
+    dst->array.x[dst_idx] = src->array.x[src_idx]; \
+    dst->array.y[dst_idx] = src->array.y[src_idx]; \
+    dst->array.z[dst_idx] = src->array.z[src_idx];
+#define COPY_QUAT(array) \
+    COPY_VEC3(array) \
+    dst->array.w[dst_idx] = src->array.w[src_idx];
+    COPY_VEC3(bases)
+    COPY_VEC3(mids)
+    COPY_VEC3(tips)
+    COPY_VEC3(targets)
+    COPY_VEC3(poles)
+    COPY_QUAT(base_rotations)
+    COPY_QUAT(mid_rotations)
+#undef COPY_QUAT
+#undef COPY_VEC3
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+LANES_FN(solve)(struct ik_limbs_t* limbs)
+{
+    ikreal_t out_of_reach[LANES_WIDTH];
+    lane_t out_of_reach_lanes = lane_set1(0);
+    uint32_t full_count = limbs->count - limbs->count % LANES_WIDTH;
+    uint32_t idx, lane, result;
+
+    for (idx = 0; idx != full_count; idx += LANES_WIDTH)
+        out_of_reach_lanes = lane_add(out_of_reach_lanes, LANES_FN(solve_lanes)(limbs, idx));
+
+    lane_store(out_of_reach, out_of_reach_lanes);
+    result = 0;
+    for (lane = 0; lane != LANES_WIDTH; ++lane)
+        result += (uint32_t)out_of_reach[lane];
+
+    /*
+     * The remaining limbs are copied into a full set of lanes. Unused lanes
+     * are filled with copies of the last limb so the kernel never operates on
+     * garbage, and are discarded afterwards.
+     */
+    if (full_count != limbs->count)
+    {
+        ikreal_t memory[5*3 + 2*4][LANES_WIDTH];
+        struct ik_limbs_t tail;
+        uint32_t tail_count = limbs->count - full_count;
+        int i = 0;
+
+#define CARVE_VEC3(array) \
+        tail.array.x = memory[i++]; \
+        tail.array.y = memory[i++]; \
+        tail.array.z = memory[i++];
+#define CARVE_QUAT(array) \
+        CARVE_VEC3(array) \
+        tail.array.w = memory[i++];
+        CARVE_VEC3(bases)
+        CARVE_VEC3(mids)
+        CARVE_VEC3(tips)
+        CARVE_VEC3(targets)
+        CARVE_VEC3(poles)
+        CARVE_QUAT(base_rotations)
+        CARVE_QUAT(mid_rotations)
+#undef CARVE_QUAT
+#undef CARVE_VEC3
+        tail.count = LANES_WIDTH;
+
+        for (lane = 0; lane != LANES_WIDTH; ++lane)
+            LANES_FN(copy_limb)(&tail, lane, limbs,
+                                full_count + (lane < tail_count ? lane : tail_count - 1));
+
+        lane_store(out_of_reach, LANES_FN(solve_lanes)(&tail, 0));
+
+        for (lane = 0; lane != tail_count; ++lane)
+        {
+            LANES_FN(copy_limb)(limbs, full_count + lane, &tail, lane);
+            result += (uint32_t)out_of_reach[lane];
+        }
+    }
+
+    return result;
+}
@@ -76,6 +76,13 @@ struct ik_effector_t
     ikreal_t rotation_weight;
     ikreal_t rotation_decay;
 
+    /*!
+     * @brief Specifies the acceptable distance between the node and its
+     * (weighted) target. If set to 0, solver->tolerance is used instead.
+     * @note Default value is 0.
+     */
+    ikreal_t tolerance;
+
     /*!
      * @brief Specifies how many parent nodes should be affected. A value of
      * 0 means all of the parents, including the base node.
@@ -84,6 +91,12 @@ struct ik_effector_t
      */
     uint16_t chain_length;
 
+    /*!
+     * Used internally to hold the chain length the solver's chains were last
+     * built with, so rebuild() can detect changes to chain_length.
+     */
+    uint16_t _built_chain_length;
+
     /*!
      * @brief Various behavioural settings. Check the enum effector_flags_e for
      * more information.
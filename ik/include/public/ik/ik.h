@@ -19,6 +19,27 @@ struct ik_callback_interface_t
 
     void
     (*on_node_destroy)(struct ik_node_t* node);
+
+    /*!
+     * Optional allocator for all memory the library uses. Either all three
+     * functions are set or none are, in which case malloc(), realloc() and
+     * free() are used. allocator_context is passed through unchanged.
+     *
+     * Memory is always returned to the allocator it was taken from, so the
+     * allocator must not change while the library holds memory. Implement
+     * the callbacks before creating any solvers, and don't replace them
+     * before destroying all solvers and calling IKAPI.deinit().
+     */
+    void*
+    (*on_malloc)(void* context, uintptr_t size);
+
+    void*
+    (*on_realloc)(void* context, void* ptr, uintptr_t size);
+
+    void
+    (*on_free)(void* context, void* ptr);
+
+    void* allocator_context;
 };
 
 struct ik_internal_interface_t
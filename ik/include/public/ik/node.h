@@ -2,7 +2,6 @@
 #define IK_NODE_H
 
 #include "ik/config.h"
-#include "ik/bstv.h"
 #include "ik/vec3.h"
 #include "ik/quat.h"
 
@@ -15,7 +14,15 @@ struct ik_node_interface_t;
 #define IK_NODE_HEAD                                                          \
     const struct ik_node_interface_t* v;                                      \
     struct ik_node_t* parent;                                                 \
-    struct bstv_t children;                                                   \
+                                                                              \
+    /*!                                                                       \
+     * @brief Children are kept in a list in the order they were added.      \
+     * Use NODE_FOR_EACH() to iterate them.                                   \
+     */                                                                       \
+    struct ik_node_t* first_child;                                            \
+    struct ik_node_t* last_child;                                             \
+    struct ik_node_t* next_sibling;                                           \
+    struct ik_node_t* prev_sibling;                                           \
     uint32_t guid;                                                            \
                                                                               \
     union                                                                     \
@@ -71,7 +78,32 @@ struct ik_node_interface_t;
     struct ik_constraint_t* constraint;                                       \
                                                                               \
     ikreal_t rotation_weight;                                                 \
-    ikreal_t dist_to_parent;
+    ikreal_t dist_to_parent;                                                  \
+                                                                              \
+    /*!                                                                       \
+     * @brief Bitmask of enum ik_node_dirty_e. Set by the node, effector and  \
+     * constraint functions that change the tree and cleared by the solver's  \
+     * rebuild(), which uses it to only rebuild the parts of the tree that    \
+     * changed. Use node->v->mark_dirty() to set it.                          \
+     */                                                                       \
+    uint8_t dirty;                                                            \
+                                                                              \
+    /*!                                                                       \
+     * Used internally by rebuild() to mark the nodes that are part of a     \
+     * chain, and how many more parents the chain reaches past this node.    \
+     */                                                                       \
+    uint8_t _chain_mark;                                                      \
+    uint32_t _chain_reach;
+
+enum ik_node_dirty_e
+{
+    /* An effector was attached to or detached from this node */
+    IK_NODE_DIRTY_EFFECTOR   = 0x01,
+    /* Children were added to or removed from this node */
+    IK_NODE_DIRTY_CHILDREN   = 0x02,
+    /* A node somewhere below this node is dirty */
+    IK_NODE_DIRTY_DESCENDANT = 0x04
+};
 
 /*!
  * @brief Base structure used to build the tree structure to be solved.
@@ -115,6 +147,8 @@ IK_INTERFACE(node_interface)
      * @brief Creates a new node, attaches it as a child to the specified node,
      * and returns it. Each node requires a tree-unique ID, which can be used
      * later to search for nodes in the tree.
+     * @return Returns NULL if the node already has a child with the same guid
+     * or if allocation failed.
      */
     struct ik_node_t*
     (*create_child)(struct ik_node_t* node, uint32_t child_guid);
@@ -122,6 +156,10 @@ IK_INTERFACE(node_interface)
     /*!
      * @brief Attaches a node as a child to another node. The parent node gains
      * ownership of the child node and is responsible for deallocating it.
+     * The child is appended after all existing children.
+     * @return Returns IK_DUPLICATE_GUID if the node already has a child with
+     * the same guid, in which case nothing is changed.
+     * @note It is up to you to make sure guids are unique in the tree.
      * @note You will need to rebuild the solver's tree before solving.
      */
     ikret_t
@@ -154,12 +192,30 @@ IK_INTERFACE(node_interface)
      */
     void
     (*dump_to_dot)(struct ik_node_t* node, const char* file_name);
-};
 
-#define NODE_FOR_EACH(node, key, value) \
-    BSTV_FOR_EACH(&(node)->children, struct ik_node_t, key, value)
+    /*!
+     * @brief Sets the specified enum ik_node_dirty_e flags on the node and
+     * flags all of its parents with IK_NODE_DIRTY_DESCENDANT, so the solver
+     * can find the node again on the next rebuild without searching the
+     * whole tree. This is called for you by functions that change the tree,
+     * you only need it if you modify the tree yourself.
+     */
+    void
+    (*mark_dirty)(struct ik_node_t* node, uint8_t flags);
+};
 
-#define NODE_END_EACH BSTV_END_EACH
+/*!
+ * @brief Iterates the children of a node in the order they were added. The
+ * key is set to the guid of each child.
+ */
+#define NODE_FOR_EACH(node, key, value) {                                    \
+    uint32_t key;                                                            \
+    struct ik_node_t* value;                                                 \
+    for(value = (node)->first_child;                                         \
+        value != NULL && ((key = value->guid) || 1);                         \
+        value = value->next_sibling) {
+
+#define NODE_END_EACH }}
 
 C_END
 
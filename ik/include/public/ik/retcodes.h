@@ -16,7 +16,12 @@ typedef enum ikret_t
     IK_SOLVER_HAS_NO_TREE = -5,
     IK_UNIT_TESTS_FAILED = -6,
     IK_BUILT_WITHOUT_TESTS = -7,
-    IK_WRONG_FUNCTION_FOR_CUSTOM_CONSTRAINT = -8
+    IK_WRONG_FUNCTION_FOR_CUSTOM_CONSTRAINT = -8,
+    IK_INSTANCES_DONT_MATCH_TREE = -9,
+    IK_SOLVER_DOESNT_SUPPORT_INSTANCES = -10,
+    IK_SOLVER_DOESNT_SUPPORT_LIMBS = -11,
+    IK_TREE_NOT_REBUILT = -12,
+    IK_DUPLICATE_GUID = -13
 } ikret_t;
 
 #ifdef __cplusplus
@@ -4,6 +4,8 @@
 #include "ik/config.h"
 #include "ik/vector.h"
 #include "ik/constraint.h"
+#include "ik/quat.h"
+#include "ik/vec3.h"
 
 /*!
  * @brief Only the algorithms listed here are actually enabled.
@@ -21,7 +23,10 @@
     X(ONE_BONE) \
     X(TWO_BONE) \
     X(FABRIK) \
-    X(MSS)
+    X(MSS) \
+    X(DLS) \
+    X(CCD) \
+    X(HYBRID)
 
 C_BEGIN
 
@@ -37,13 +42,24 @@ typedef void(*ik_solver_iterate_node_cb_func)(struct ik_node_t*);
 struct ik_solver_interface_t;
 struct ik_solver_t;
 struct ik_node_t;
+struct chain_flat_t;
+struct thread_pool_t;
+struct tree_flat_t;
 
 #define IK_SOLVER_HEAD                                                        \
     const struct ik_solver_interface_t*      v;                               \
                                                                               \
     int32_t                                  max_iterations;                  \
     ikreal_t                                 tolerance;                       \
+    ikreal_t                                 stall_ratio;                     \
     uint8_t                                  flags;                           \
+    uint32_t                                 thread_count;                    \
+    uint32_t                                 fork_threshold;                  \
+    ikreal_t                                 warm_start_blend;                \
+    ikreal_t                                 warm_start_threshold;            \
+                                                                              \
+    /* number of iterations the last call to solve() needed */               \
+    int32_t                                  iterations_used;                 \
                                                                               \
     /* API functions */                                                       \
     const struct ik_constraint_interface_t*  constraint;                      \
@@ -55,7 +71,116 @@ struct ik_node_t;
     /* list of effector_t* references (not owned by us) */                    \
     struct vector_t                          effector_nodes_list;             \
     /* list of chain_t objects (allocated in-place, i.e. ik_solver_t owns them) */ \
-    struct vector_t                          chain_list;
+    struct vector_t                          chain_list;                      \
+    /* destructed chain_t objects whose memory is reused by the next rebuild */ \
+    struct vector_t                          spare_chains;                    \
+    /* nodes that changed since the last rebuild, kept to reuse its memory */ \
+    struct vector_t                          changed_nodes;                   \
+    /* chain_list compiled into contiguous arrays (see chain_flat.h) */       \
+    struct chain_flat_t*                     chain_flat;                      \
+    /* the whole tree in depth-first order with a guid index (see tree_flat.h) */ \
+    struct tree_flat_t*                      tree_flat;                       \
+    /* worker threads for solving islands and branches, if thread_count > 1 */ \
+    struct thread_pool_t*                    thread_pool;
+
+/*!
+ * @brief Holds the poses and targets of many instances of the same tree, e.g.
+ * a crowd of characters sharing one skeleton. The solver's tree acts as a
+ * template: Segment lengths, weights and tolerances are taken from the
+ * template, whereas positions and targets are stored per instance in
+ * contiguous arrays. See ik_solver_interface_t::solve_instances.
+ */
+struct ik_instances_t
+{
+    /* Number of instances */
+    uint32_t count;
+    /* Number of nodes per instance (length of nodes) */
+    uint32_t node_count;
+    /* Number of effectors per instance (length of effectors) */
+    uint32_t effector_count;
+
+    /*!
+     * The template nodes, in the order in which their positions are stored.
+     * This is the same order in which ik_solver_iterate_affected_nodes()
+     * visits the nodes, starting with the island base nodes.
+     */
+    struct ik_node_t** nodes;
+    /* The template effectors, in the order in which their targets are stored */
+    struct ik_effector_t** effectors;
+
+    /* count * node_count global (world) positions */
+    ik_vec3_t* positions;
+    /* count * effector_count global (world) target positions */
+    ik_vec3_t* targets;
+    /* count * effector_count global (world) target rotations */
+    ik_quat_t* target_rotations;
+
+    /* Per instance result of the last call to solve_instances() */
+    ikret_t* results;
+    /* Per instance number of iterations used by the last call to solve_instances() */
+    int32_t* iterations_used;
+};
+
+/*!
+ * @brief count vectors in structure-of-arrays form, i.e. every component is
+ * stored in its own contiguous array.
+ */
+struct ik_vec3_array_t
+{
+    ikreal_t* x;
+    ikreal_t* y;
+    ikreal_t* z;
+};
+
+/*!
+ * @brief count quaternions in structure-of-arrays form.
+ */
+struct ik_quat_array_t
+{
+    ikreal_t* x;
+    ikreal_t* y;
+    ikreal_t* z;
+    ikreal_t* w;
+};
+
+/*!
+ * @brief Holds many independent two bone limbs (e.g. the arms and legs of a
+ * crowd) so they can be solved analytically without building a tree for
+ * each of them. See ik_solver_interface_t::solve_limbs.
+ *
+ * All positions are global (world) positions. The segment lengths are taken
+ * from the current distances between base, mid and tip, so both segments
+ * must have a non-zero length.
+ */
+struct ik_limbs_t
+{
+    /* Number of limbs */
+    uint32_t count;
+
+    /* Positions of the base nodes (e.g. shoulders), never changed */
+    struct ik_vec3_array_t bases;
+    /* Positions of the mid nodes (e.g. elbows), updated in-place */
+    struct ik_vec3_array_t mids;
+    /* Positions of the tip nodes (e.g. wrists), updated in-place */
+    struct ik_vec3_array_t tips;
+    /* Target positions of the tip nodes */
+    struct ik_vec3_array_t targets;
+    /*!
+     * Pole positions. Each limb bends towards its pole, i.e. the mid node
+     * ends up in the plane through base, target and pole, on the side of the
+     * pole. If a pole lies on the line through base and target, the limb
+     * keeps bending in the plane it currently bends in.
+     */
+    struct ik_vec3_array_t poles;
+
+    /*!
+     * Global rotations which rotate the upper (base to mid) segments from
+     * their previous to their solved direction. Written by solve_limbs().
+     */
+    struct ik_quat_array_t base_rotations;
+    /* Same as base_rotations, for the lower (mid to tip) segments */
+    struct ik_quat_array_t mid_rotations;
+};
 
 /*!
  * @brief This is a base for all solvers.
@@ -65,6 +190,70 @@ struct ik_solver_t
     IK_SOLVER_HEAD
 };
 
+/*!
+ * @brief Attributes specific to the DLS solver. A solver created with IK_DLS
+ * can be cast to this type. They can be changed at any point.
+ *  + lambda_min
+ *       The smallest damping factor (lambda) of the least squares step.
+ *       Larger values make the solver more stable close to singular poses
+ *       (e.g. fully stretched chains) but slower to converge. The damping is
+ *       increased automatically while steps overshoot. The default value is
+ *       0.1.
+ */
+#define IK_SOLVER_DLS_HEAD                                                    \
+    IK_SOLVER_HEAD                                                            \
+    ikreal_t                                 lambda_min;
+
+struct ik_solver_DLS_t
+{
+    IK_SOLVER_DLS_HEAD
+};
+
+/*!
+ * @brief Attributes specific to the MSS solver. A solver created with IK_MSS
+ * can be cast to this type. They can be changed at any point.
+ *  + timestep
+ *       The simulated time in seconds every call to solve() advances the
+ *       simulation by. The default value is 1/60.
+ *  + substeps
+ *       If 0, the simulation is integrated with an adaptive step size which
+ *       keeps the estimated position error of every step below
+ *       error_tolerance, using at most solver->max_iterations steps per
+ *       solve. Otherwise, exactly this many steps of size timestep/substeps
+ *       are taken without error control, which has a fixed cost per solve.
+ *       The steps become unstable if they're much larger than
+ *       1/sqrt(stiffness). The default value is 0.
+ *  + error_tolerance
+ *       Largest estimated position error a single adaptive step may have.
+ *       Smaller values take more, smaller steps. Not to be confused with
+ *       solver->tolerance, which has the same meaning as for the other
+ *       solvers: solve() returns IK_RESULT_CONVERGED if every effector is
+ *       within that distance of its target after the time step, and IK_OK
+ *       otherwise. The default value is 1e-3.
+ *  + stiffness
+ *       Spring constant of the segments and of the springs pulling effectors
+ *       towards their targets. Every node has unit mass. The default value
+ *       is 1000.
+ *  + damping
+ *       Damps the velocity of every node relative to its parent. The default
+ *       value is 10.
+ *  + gravity
+ *       Acceleration applied to every node. The default value is zero.
+ */
+#define IK_SOLVER_MSS_HEAD                                                    \
+    IK_SOLVER_HEAD                                                            \
+    ikreal_t                                 timestep;                        \
+    int32_t                                  substeps;                        \
+    ikreal_t                                 error_tolerance;                 \
+    ikreal_t                                 stiffness;                       \
+    ikreal_t                                 damping;                         \
+    ik_vec3_t                                gravity;
+
+struct ik_solver_MSS_t
+{
+    IK_SOLVER_MSS_HEAD
+};
+
 enum ik_flags_e
 {
     /*!
@@ -76,7 +265,70 @@ enum ik_flags_e
 
     IK_ENABLE_TARGET_ROTATIONS = 0x02,
 
-    IK_ENABLE_JOINT_ROTATIONS = 0x04
+    IK_ENABLE_JOINT_ROTATIONS = 0x04,
+
+    /*!
+     * @brief Starts every solve from the result of the previous solve
+     * instead of from the current node positions. When the targets move
+     * smoothly from one frame to the next, this reduces the number of
+     * iterations needed to one or two. See solver->warm_start_blend and
+     * solver->warm_start_threshold. Only supported by FABRIK without
+     * IK_ENABLE_CONSTRAINTS.
+     */
+    IK_ENABLE_WARM_START = 0x08,
+
+    /*!
+     * @brief Trades accuracy for speed. Normalizations use an approximate
+     * reciprocal square root (relative error below 5e-6, typically below
+     * 2.5e-7) instead of sqrt() followed by a division, and joint rotations
+     * are constructed without acos(), cos() and sin(). For trees with
+     * segment lengths around 1, solved positions and rotations stay within
+     * 1e-5 of the precise result.
+     * Used by FABRIK without IK_ENABLE_CONSTRAINTS and by TWO_BONE.
+     */
+    IK_ENABLE_FAST_MATH = 0x10,
+
+    /*!
+     * @brief Solves instances (see solve_instances()) with single precision
+     * arithmetic, regardless of the precision the library was built with.
+     * The arrays in ik_instances_t keep their precision and are converted
+     * while loading and storing them. With double precision builds, twice as
+     * many instances are solved at once for the same memory traffic. Use this
+     * for crowds where accuracy doesn't matter as much, and solve hero
+     * characters with a separate solver. Only supported by FABRIK without
+     * IK_ENABLE_TARGET_ROTATIONS.
+     */
+    IK_ENABLE_FLOAT_INSTANCES = 0x20,
+
+    /*!
+     * @brief Together with IK_ENABLE_JOINT_ROTATIONS, solve() only writes
+     * node positions and leaves the rotations untouched. The joint rotations
+     * are calculated by the next call to update_rotations(), for all solves
+     * since the previous call at once. Use this if the rotations are only
+     * needed occasionally, or solve several times per frame and update the
+     * rotations once at the end of it. Rebuilding discards rotations which
+     * weren't updated yet. Used by FABRIK without IK_ENABLE_CONSTRAINTS.
+     */
+    IK_ENABLE_LAZY_ROTATIONS = 0x40
+};
+
+/*!
+ * @brief Selects the space of the transforms passed to
+ * ik_solver_set_pose() and ik_solver_get_pose().
+ */
+enum ik_pose_flags_e
+{
+    /*!
+     * @brief Each transform is relative to the parent node, the same as
+     * node->rotation and node->position.
+     */
+    IK_POSE_LOCAL = 0x00,
+
+    /*!
+     * @brief Each transform is relative to the root of the tree. Rotations
+     * accumulate the same way as in ik_transform_tree() (TR_L2G).
+     */
+    IK_POSE_GLOBAL = 0x01
 };
 
 IK_INTERFACE(solver_interface)
@@ -94,16 +346,62 @@ IK_INTERFACE(solver_interface)
      *  + solver->max_iterations
      *       Specifies the maximum number of iterations. The more iterations, the
      *       more exact the result will be. The default value for the FABRIK solver
-     *       is 20, but you can get away with values as low as 5.
+     *       is 20, but you can get away with values as low as 5. The DLS
+     *       solver defaults to 10. The CCD solver defaults to 20 and usually
+     *       needs more iterations than FABRIK on long chains, but it
+     *       produces joint rotations without any extra work after the last
+     *       iteration. The HYBRID solver has the same defaults as FABRIK. It
+     *       places limbs with one or two segments at the end of the tree in
+     *       closed form instead of iterating on them, so islands consisting
+     *       of a single such limb are solved in one iteration. Limbs are only
+     *       solved in closed form without IK_ENABLE_TARGET_ROTATIONS and
+     *       IK_ENABLE_CONSTRAINTS.
      *  + solver->tolerance
      *       This value can be changed at any point. Specifies the acceptable
      *       distance each effector needs to be to its target position. The solver
      *       will stop iterating if the effectors are within this distance. The
      *       default value is 1e-3. Recommended values are 100th of your world
-     *       unit.
+     *       unit. Effectors can override this value with effector->tolerance.
+     *  + solver->stall_ratio
+     *       The solver will stop iterating if the summed squared distance of
+     *       all effectors to their targets improves by less than this fraction
+     *       from one iteration to the next (e.g. when the targets are out of
+     *       reach). Set to 0 to disable. The default value for the FABRIK,
+     *       HYBRID, DLS and CCD solvers is 1e-3.
      *  + solver->flags
      *       Changes the behaviour of the solver. See the enum solver_flags_e for
      *       more information.
+     *  + solver->thread_count
+     *       Chains which aren't connected to each other (islands, e.g. the
+     *       limbs of a character if the torso isn't solved) are solved
+     *       independently. If this is greater than 1, the islands are
+     *       distributed across this many threads (including the thread calling
+     *       solve()). Takes effect on the next call to rebuild(). Only
+     *       supported by FABRIK without IK_ENABLE_CONSTRAINTS and only if the
+     *       library was built with IK_THREADS. The default value is 1.
+     *  + solver->fork_threshold
+     *       If there are fewer islands than threads, large islands are split
+     *       at their sub-bases instead and the child chains below each
+     *       sub-base (e.g. the tentacles of a creature) are solved in
+     *       parallel. Sub-trees are only split if they have more than this
+     *       many nodes, because every split costs two synchronizations per
+     *       iteration. Set to 0 to disable. Takes effect on the next call to
+     *       rebuild(). The default value is 512.
+     *  + solver->warm_start_blend
+     *       If IK_ENABLE_WARM_START is set, every node starts moved this far
+     *       from its current position towards its solved position of the
+     *       previous solve. 1 uses the previous solution as is, smaller values
+     *       blend in the incoming (e.g. animated) pose. The default value is 1.
+     *  + solver->warm_start_threshold
+     *       If IK_ENABLE_WARM_START is set and any node moved further than
+     *       this since the previous solve (e.g. because the animation cut to a
+     *       different pose), the solve starts from the current node positions
+     *       instead. Set to 0 to always warm start. The warm start is also
+     *       discarded if rebuild() has to change any chains. The default value
+     *       is 1.
+     *
+     * Attributes specific to a single solver are declared in
+     * ik_solver_DLS_t and ik_solver_MSS_t.
      *
      * The following attributes can be accessed (read from) but should not be
      * modified.
@@ -118,6 +416,9 @@ IK_INTERFACE(solver_interface)
      *       A vector containing pointers to nodes in the tree which have an
      *       effector attached to them. You may not modify this list, but you may
      *       iterate it.
+     *  + solver->iterations_used
+     *       The number of iterations the last call to solve() performed before
+     *       terminating.
      * @param[in] algorithm The algorithm to use. Currently, only FABRIK is
      * supported.
      */
@@ -143,6 +444,12 @@ IK_INTERFACE(solver_interface)
      * @note Needs to be called whenever the tree changes in any way. I.e. if you
      * remove nodes or add nodes, or if you remove effectors or add effectors,
      * you must call this again before invoking the solver.
+     * @note Only the parts of the tree that changed since the last call are
+     * processed again. Adding or removing nodes rebuilds all chains, while
+     * attaching or detaching effectors and changing effector chain lengths
+     * only rebuilds the chains around the affected nodes. Segment lengths are
+     * only computed for chains that were rebuilt, call (*update_distances)()
+     * if you moved nodes of existing chains.
      * @return Returns non-zero if any of the chain trees are invalid for any
      * reason. If this happens, check the log for error messages.
      * @warning If this functions fails, the internal structures are in an
@@ -162,7 +469,8 @@ IK_INTERFACE(solver_interface)
      * has translational motions. In this case, you will have to recalculate the
      * segment lengths every time node positions change.
      *
-     * @note This function gets called by (*rebuild_data)().
+     * @note (*rebuild)() only computes the segment lengths of chains it had
+     * to rebuild.
      */
     void
     (*update_distances)(struct ik_solver_t* solver);
@@ -177,6 +485,71 @@ IK_INTERFACE(solver_interface)
     ikret_t
     (*solve)(struct ik_solver_t* solver);
 
+    /*!
+     * @brief Calculates the joint rotations deferred by IK_ENABLE_LAZY_ROTATIONS
+     * and writes them to the nodes. The rotations turn the pose of the first
+     * solve since the previous update into the current pose, so the nodes
+     * shouldn't be moved between those solves other than by the solver.
+     * Does nothing if no rotations are pending, e.g. for solvers which always
+     * calculate them while solving.
+     */
+    ikret_t
+    (*update_rotations)(struct ik_solver_t* solver);
+
+    /*!
+     * @brief Allocates the pose and target arrays for the specified number of
+     * instances of the solver's tree. Every instance is initialized with the
+     * current global pose and effector targets of the tree.
+     * @note Requires a rebuild before calling this. If the solver is rebuilt,
+     * instances created beforehand must be destroyed and created again.
+     * @return Returns NULL if the solver was not rebuilt or if allocation
+     * failed.
+     */
+    struct ik_instances_t*
+    (*create_instances)(struct ik_solver_t* solver, uint32_t count);
+
+    void
+    (*destroy_instances)(struct ik_instances_t* instances);
+
+    /*!
+     * @brief Solves every instance in one call. The positions of each instance
+     * are updated in-place and remain in global space. Effector targets are
+     * used as-is, i.e. effector weights are not applied, and only the node
+     * positions are solved (no constraints or joint rotations).
+     * @return Returns IK_RESULT_CONVERGED if every instance converged, IK_OK
+     * if at least one instance didn't converge and a negative value if an
+     * error occurred. The result of every individual instance is written to
+     * instances->results.
+     */
+    ikret_t
+    (*solve_instances)(struct ik_solver_t* solver, struct ik_instances_t* instances);
+
+    /*!
+     * @brief Allocates the arrays for the specified number of limbs in a
+     * single block. All positions are initialized to zero and all rotations
+     * to identity.
+     * @return Returns NULL if allocation failed.
+     */
+    struct ik_limbs_t*
+    (*create_limbs)(uint32_t count);
+
+    void
+    (*destroy_limbs)(struct ik_limbs_t* limbs);
+
+    /*!
+     * @brief Solves every limb analytically in one call. Several limbs are
+     * solved at once with SIMD instructions if the CPU supports it. The mid
+     * and tip positions are updated in-place and the rotations of both
+     * segments are written to limbs->base_rotations and limbs->mid_rotations.
+     * Targets out of reach are approached as closely as possible. The
+     * solver's tree isn't used, so the solver doesn't need one.
+     * Only supported by TWO_BONE.
+     * @return Returns IK_RESULT_CONVERGED if every target was in reach, IK_OK
+     * if at least one wasn't and a negative value if an error occurred.
+     */
+    ikret_t
+    (*solve_limbs)(struct ik_solver_t* solver, struct ik_limbs_t* limbs);
+
     /*!
      * @brief Sets the tree to solve. The solver takes ownership of the tree, so
      * destroying the solver will destroy all nodes in the tree. Note that you will
@@ -203,8 +576,9 @@ IK_INTERFACE(solver_interface)
     (*destroy_tree)(struct ik_solver_t* solver);
 
     /*!
-     * @brief Iterates all nodes in the internal tree, breadth first, and passes
-     * each node to the specified callback function.
+     * @brief Iterates all nodes in the internal tree, depth first, and passes
+     * each node to the specified callback function. Parents are always passed
+     * before their children.
      */
     void
     (*iterate_all_nodes)(struct ik_solver_t* solver,
@@ -240,6 +614,68 @@ IK_INTERFACE(solver_interface)
     void
     (*iterate_base_nodes)(struct ik_solver_t* solver,
                           ik_solver_iterate_node_cb_func callback);
+
+    /*!
+     * @brief Searches the tree for a node with the specified guid. Unlike
+     * node->v->find_child(), this is a constant time lookup as long as the
+     * tree hasn't changed since the last rebuild. Otherwise, it falls back to
+     * searching the tree.
+     * @return Returns NULL if the node was not found.
+     */
+    struct ik_node_t*
+    (*find_node)(struct ik_solver_t* solver, uint32_t guid);
+
+    /*!
+     * @brief Returns the number of nodes in the tree, which is the number of
+     * transforms ik_solver_set_pose() and ik_solver_get_pose() expect.
+     * @note Requires a rebuild before this data is valid. Returns 0 if the
+     * tree changed since the last rebuild.
+     */
+    uint32_t
+    (*node_count)(struct ik_solver_t* solver);
+
+    /*!
+     * @brief Returns the index of the node with the specified guid in the
+     * buffers passed to ik_solver_set_pose() and ik_solver_get_pose(). Nodes
+     * are indexed depth first, parents before their children, and the indices
+     * stay the same until the tree is changed and rebuilt.
+     * @return Returns -1 if the node was not found or if the tree changed
+     * since the last rebuild.
+     */
+    int32_t
+    (*find_node_index)(struct ik_solver_t* solver, uint32_t guid);
+
+    /*!
+     * @brief Copies the transforms of all nodes from a buffer into the tree.
+     * @param[in] transforms Points to one transform per node, in the order
+     * given by ik_solver_find_node_index(). A transform is 7 ikreal_t's, the
+     * rotation (x, y, z, w) followed by the position (x, y, z), the same
+     * layout as node->transform.
+     * @param[in] stride Distance in bytes between the start of two
+     * transforms, so the buffer can interleave other data. 0 means the
+     * transforms are tightly packed.
+     * @param[in] flags See ik_pose_flags_e. Global transforms are converted
+     * to local transforms before they are stored in the nodes.
+     * @note Requires a rebuild before this data is valid.
+     */
+    ikret_t
+    (*set_pose)(struct ik_solver_t* solver,
+                const ikreal_t* transforms,
+                uint32_t stride,
+                uint8_t flags);
+
+    /*!
+     * @brief Writes the transforms of all nodes into a buffer in a single
+     * pass over the tree. This is the counterpart to ik_solver_set_pose(),
+     * see there for the buffer layout.
+     * @note Call ik_solver_update_rotations() first if IK_ENABLE_LAZY_ROTATIONS
+     * is used.
+     */
+    ikret_t
+    (*get_pose)(struct ik_solver_t* solver,
+                ikreal_t* transforms,
+                uint32_t stride,
+                uint8_t flags);
 };
 
 #define SOLVER_FOR_EACH_EFFECTOR_NODE(solver_var, effector_var) \
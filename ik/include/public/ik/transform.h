@@ -19,13 +19,45 @@ enum ik_transform_flags_e
 
 /* XXX: Should be part of the public API */
 
+/*!
+ * @brief Transforms a list of nodes which is ordered parents first, e.g. in
+ * depth-first pre-order or breadth-first order. This is a single forward scan
+ * over the arrays, so arbitrarily deep trees can be transformed without
+ * recursion.
+ * @param[in] nodes The nodes to transform.
+ * @param[in] parents parents[i] is the index of the node nodes[i] is relative
+ * to, or -1 if nodes[i] is relative to nothing. Such "root" nodes are left
+ * untouched, but their children are transformed relative to them. A parent
+ * must come before all of its children.
+ * @param[in] count Number of elements in nodes and parents.
+ * @param[in] accumulators Scratch space for count * 7 ikreal_t's. Receives the
+ * accumulated rotation (first 4) and position (last 3) of each node.
+ */
 IK_PRIVATE_API void
+ik_transform_nodes(struct ik_node_t* const* nodes,
+                   const int32_t* parents,
+                   uint32_t count,
+                   ikreal_t* accumulators,
+                   uint8_t flags);
+
+/*!
+ * @brief Transforms all nodes below the specified node. The node itself is
+ * relative to nothing and stays as it is.
+ * @note Allocates temporary memory for flattening the tree.
+ */
+IK_PRIVATE_API ikret_t
 ik_transform_tree(struct ik_node_t* node, uint8_t flags);
 
-IK_PRIVATE_API void
+/*!
+ * @brief Transforms all nodes in a list of chains. Island base nodes are
+ * relative to nothing and stay as they are.
+ * @note Allocates temporary memory for flattening the chains. Solvers
+ * should use chain_flat_transform() instead.
+ */
+IK_PRIVATE_API ikret_t
 ik_transform_chain_list(const struct vector_t* chain_list, uint8_t flags);
 
-IK_PRIVATE_API void
+IK_PRIVATE_API ikret_t
 ik_transform_chain(struct chain_t* chain, uint8_t flags);
 
 C_END
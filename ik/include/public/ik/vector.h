@@ -91,6 +91,16 @@ vector_clear_free(struct vector_t* vector);
 IK_PRIVATE_API ikret_t
 vector_resize(struct vector_t* vector, uint32_t size);
 
+/*!
+ * @brief Makes sure the vector can hold at least the specified number of
+ * elements without reallocating. The size of the vector doesn't change.
+ * @param[in] vector The vector to reserve memory for.
+ * @param[in] capacity The number of elements to make room for.
+ * @return Returns IK_RAN_OUT_OF_MEMORY on failure, IK_OK on success.
+ */
+IK_PRIVATE_API ikret_t
+vector_reserve(struct vector_t* vector, uint32_t capacity);
+
 /*!
  * @brief Gets the number of elements that have been inserted into the vector.
  */
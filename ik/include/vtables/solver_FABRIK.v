@@ -6,6 +6,8 @@ IK_IMPLEMENT(solver_FABRIK, solver_base)
     IK_CONSTRUCTOR(construct)
     IK_BEFORE(destruct)
     IK_AFTER(solve)
+    IK_OVERRIDE(update_rotations)
+    IK_OVERRIDE(solve_instances)
 }
 
 /*
@@ -0,0 +1,29 @@
+#include "ik/solver_FABRIK.h"
+
+IK_IMPLEMENT(solver_HYBRID, solver_FABRIK)
+{
+    IK_AFTER(rebuild)
+}
+
+/*
+ * Because we use X macros to fill in the ik interface struct, we have to
+ * generate the implementation defines for the node, effector and constraint
+ * interfaces as well. These don't actually override anything. Nodes need the
+ * initial transform FABRIK uses to calculate joint rotations.
+ */
+IK_IMPLEMENT(node_HYBRID, node_FABRIK)
+IK_IMPLEMENT(effector_HYBRID, effector_FABRIK)
+IK_IMPLEMENT(constraint_HYBRID, constraint_FABRIK)
+
+/*
+ * Need to combine multiple ikret_t return values from the various before/after
+ * functions.
+ */
+static inline ikret_t ik_solver_HYBRID_harness_rebuild_return_value(ikret_t a, ikret_t b) {
+    if (a != IK_OK) return a;
+    return b;
+}
+static inline ikret_t ik_solver_HYBRID_harness_solve_return_value(ikret_t a, ikret_t b) {
+    if (a != IK_OK) return a;
+    return b;
+}
@@ -9,7 +9,7 @@ IK_IMPLEMENT(solver_MSS, solver_base)
     IK_OVERRIDE(type_size)
     IK_CONSTRUCTOR(construct)
     IK_DESTRUCTOR(destruct)
-    IK_AFTER(rebuild_data)
+    IK_AFTER(rebuild)
     IK_AFTER(solve)
 }
 
@@ -7,6 +7,7 @@ IK_IMPLEMENT(solver_TWO_BONE, solver_base)
     IK_DESTRUCTOR(destruct)
     IK_AFTER(rebuild_data)
     IK_AFTER(solve)
+    IK_OVERRIDE(solve_limbs)
 }
 
 /*
@@ -0,0 +1,61 @@
+#include "benchmark/benchmark.h"
+#include "ik/ik.h"
+
+using namespace benchmark;
+
+/*
+ * A tail of 32 segments reaching for a target, writing joint rotations like
+ * a background character would.
+ */
+static void BM_tail(State& state, int algorithm)
+{
+    ik_node_t* nodes[33];
+    ik_vec3_t initial_positions[33];
+    ik_quat_t initial_rotations[33];
+    ik_solver_t* solver = IKAPI.solver.create((enum ik_algorithm_e)algorithm);
+    solver->flags = IK_ENABLE_JOINT_ROTATIONS;
+    solver->tolerance = 1e-2;
+    solver->max_iterations = 50;
+
+    nodes[0] = solver->node->create(0);
+    IKAPI.solver.set_tree(solver, nodes[0]);
+    for (int i = 1; i != 33; ++i)
+    {
+        nodes[i] = solver->node->create_child(nodes[i - 1], i);
+        nodes[i]->position.y = 0.25;
+    }
+    ik_effector_t* eff = solver->effector->create();
+    eff->target_position = IKAPI.vec3.vec3(4, 2, 1);
+    solver->effector->attach(eff, nodes[32]);
+    IKAPI.solver.rebuild(solver);
+
+    for (int i = 0; i != 33; ++i)
+    {
+        initial_positions[i] = nodes[i]->position;
+        initial_rotations[i] = nodes[i]->rotation;
+    }
+
+    int64_t iterations = 0;
+    int64_t converged = 0;
+    while (state.KeepRunning())
+    {
+        for (int i = 0; i != 33; ++i)
+        {
+            nodes[i]->position = initial_positions[i];
+            nodes[i]->rotation = initial_rotations[i];
+        }
+        if (IKAPI.solver.solve(solver) == IK_RESULT_CONVERGED)
+            converged++;
+        iterations += solver->iterations_used;
+    }
+
+    state.counters["iterations"] = (double)iterations / state.iterations();
+    state.counters["converged"] = (double)converged / state.iterations();
+    IKAPI.solver.destroy(solver);
+}
+
+static void BM_CCD_tail(State& state)    { BM_tail(state, IK_CCD); }
+static void BM_FABRIK_tail(State& state) { BM_tail(state, IK_FABRIK); }
+
+BENCHMARK(BM_CCD_tail);
+BENCHMARK(BM_FABRIK_tail);
@@ -0,0 +1,83 @@
+#include "benchmark/benchmark.h"
+#include "ik/ik.h"
+
+using namespace benchmark;
+
+/*
+ * Two arms with 3 segments each on top of a trunk with 3 segments, reaching
+ * for targets with a position and a rotation.
+ */
+static ik_solver_t* create_arms(int algorithm, uint8_t flags, ik_node_t* nodes[10])
+{
+    ik_solver_t* solver = IKAPI.solver.create((enum ik_algorithm_e)algorithm);
+    solver->flags = flags;
+
+    int guid = 0;
+    ik_node_t* parent = nodes[guid] = solver->node->create(guid);
+    IKAPI.solver.set_tree(solver, parent);
+    for (int i = 0; i != 3; ++i)
+    {
+        ++guid;
+        parent = nodes[guid] = solver->node->create_child(parent, guid);
+        parent->position.y = 1;
+    }
+
+    ik_node_t* trunk = parent;
+    for (int arm = 0; arm != 2; ++arm)
+    {
+        parent = trunk;
+        for (int i = 0; i != 3; ++i)
+        {
+            ++guid;
+            parent = nodes[guid] = solver->node->create_child(parent, guid);
+            parent->position.x = arm ? 1 : -1;
+        }
+        ik_effector_t* eff = solver->effector->create();
+        eff->target_position = IKAPI.vec3.vec3(arm ? 1.5 : -1.5, 2, 1);
+        ik_vec3_t z = IKAPI.vec3.vec3(0, 0, 1);
+        ik_vec3_t down = IKAPI.vec3.vec3(0, -1, 0);
+        IKAPI.quat.angle(eff->target_rotation.f, z.f, down.f);
+        solver->effector->attach(eff, parent);
+    }
+
+    IKAPI.solver.rebuild(solver);
+    return solver;
+}
+
+static void BM_arms(State& state, int algorithm, uint8_t flags)
+{
+    ik_node_t* nodes[10];
+    ik_vec3_t initial[10];
+    ik_solver_t* solver = create_arms(algorithm, flags, nodes);
+    solver->tolerance = 1e-4;
+    solver->max_iterations = 100;
+
+    /* Without joint rotations only the positions change, so restoring those restores the pose */
+    for (int i = 0; i != 10; ++i)
+        initial[i] = nodes[i]->position;
+
+    int64_t iterations = 0;
+    int64_t converged = 0;
+    while (state.KeepRunning())
+    {
+        for (int i = 0; i != 10; ++i)
+            nodes[i]->position = initial[i];
+        if (IKAPI.solver.solve(solver) == IK_RESULT_CONVERGED)
+            converged++;
+        iterations += solver->iterations_used;
+    }
+
+    state.counters["iterations"] = (double)iterations / state.iterations();
+    state.counters["converged"] = (double)converged / state.iterations();
+    IKAPI.solver.destroy(solver);
+}
+
+static void BM_DLS_arms(State& state)                     { BM_arms(state, IK_DLS, 0); }
+static void BM_DLS_arms_target_rotations(State& state)    { BM_arms(state, IK_DLS, IK_ENABLE_TARGET_ROTATIONS); }
+static void BM_FABRIK_arms(State& state)                  { BM_arms(state, IK_FABRIK, 0); }
+static void BM_FABRIK_arms_target_rotations(State& state) { BM_arms(state, IK_FABRIK, IK_ENABLE_TARGET_ROTATIONS); }
+
+BENCHMARK(BM_DLS_arms);
+BENCHMARK(BM_DLS_arms_target_rotations);
+BENCHMARK(BM_FABRIK_arms);
+BENCHMARK(BM_FABRIK_arms_target_rotations);
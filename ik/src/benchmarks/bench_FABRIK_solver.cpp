@@ -1,5 +1,7 @@
 #include "benchmark/benchmark.h"
 #include "ik/ik.h"
+#include <algorithm>
+#include <vector>
 
 using namespace benchmark;
 
@@ -7,7 +9,9 @@ enum Type
 {
     CHAIN_10,
     TWO_ARMS,
-    BINARY_TREE
+    BINARY_TREE,
+    ISLANDS_32,
+    TENTACLES_32
 };
 
 static void build_tree_long_chains(ik_solver_t* solver, ik_node_t* parent, int depth, int* guid)
@@ -103,6 +107,53 @@ static ik_node_t* create_tree(ik_solver_t* solver, Type type)
         {
             build_tree_long_chains(solver, root, 10, &guid);
         } break;
+
+        case ISLANDS_32:
+        {
+            /* Every chain attached to the root is solved independently */
+            for (int island = 0; island != 32; ++island)
+            {
+                ik_node_t* parent = root;
+                for (int i = 0; i != 32; ++i)
+                {
+                    ik_node_t* child = solver->node->create(guid++);
+                    child->position.x = (island % 2) ? 1 : -1;
+                    child->position.y = 1;
+                    child->position.z = island * 0.1;
+                    solver->node->add_child(parent, child);
+                    parent = child;
+                }
+                ik_effector_t* eff = solver->effector->create();
+                eff->target_position.x = island;
+                eff->target_position.y = 10;
+                solver->effector->attach(eff, parent);
+            }
+        } break;
+
+        case TENTACLES_32:
+        {
+            /* 32 tentacles sharing one sub-base, all in the same island */
+            ik_node_t* stem = solver->node->create(guid++);
+            stem->position.y = 1;
+            solver->node->add_child(root, stem);
+            for (int tentacle = 0; tentacle != 32; ++tentacle)
+            {
+                ik_node_t* parent = stem;
+                for (int i = 0; i != 32; ++i)
+                {
+                    ik_node_t* child = solver->node->create(guid++);
+                    child->position.x = (tentacle % 2) ? 1 : -1;
+                    child->position.y = 1;
+                    child->position.z = tentacle * 0.1;
+                    solver->node->add_child(parent, child);
+                    parent = child;
+                }
+                ik_effector_t* eff = solver->effector->create();
+                eff->target_position.x = tentacle;
+                eff->target_position.y = 10;
+                solver->effector->attach(eff, parent);
+            }
+        } break;
     };
 
     return root;
@@ -124,7 +175,11 @@ static void BM_rebuild_tree(State& state)
     IKAPI.solver.set_tree(solver, root);
 
     while (state.KeepRunning())
+    {
+        /* Otherwise rebuild() sees nothing changed and returns early */
+        root->v->mark_dirty(root, IK_NODE_DIRTY_CHILDREN);
         IKAPI.solver.rebuild(solver);
+    }
 
     IKAPI.solver.destroy(solver);
 }
@@ -152,6 +207,42 @@ BENCHMARK(BM_FABRIK_solve)
     ->Arg(BINARY_TREE)
     ;
 
+static void BM_FABRIK_solve_positions_only(State& state)
+{
+    ik_solver_t* solver = create_solver((Type)state.range(0));
+    solver->flags = 0;
+
+    while (state.KeepRunning())
+    {
+        IKAPI.solver.solve(solver);
+    }
+
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_FABRIK_solve_positions_only)
+    ->Arg(CHAIN_10)
+    ->Arg(TWO_ARMS)
+    ->Arg(BINARY_TREE)
+    ;
+
+static void BM_FABRIK_solve_fast_math(State& state)
+{
+    ik_solver_t* solver = create_solver((Type)state.range(0));
+    solver->flags |= IK_ENABLE_FAST_MATH;
+
+    while (state.KeepRunning())
+    {
+        IKAPI.solver.solve(solver);
+    }
+
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_FABRIK_solve_fast_math)
+    ->Arg(CHAIN_10)
+    ->Arg(TWO_ARMS)
+    ->Arg(BINARY_TREE)
+    ;
+
 static void BM_FABRIK_solve_final_rotations(State& state)
 {
     ik_solver_t* solver = create_solver((Type)state.range(0));
@@ -170,3 +261,115 @@ BENCHMARK(BM_FABRIK_solve_final_rotations)
     ->Arg(BINARY_TREE)
     ;
 
+/* A frame which solves the tree several times, e.g. once per sub-step */
+static void BM_FABRIK_solve_frame(State& state)
+{
+    ik_solver_t* solver = create_solver((Type)state.range(0));
+
+    while (state.KeepRunning())
+    {
+        for (int i = 0; i != 4; ++i)
+            IKAPI.solver.solve(solver);
+    }
+
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_FABRIK_solve_frame)
+    ->Arg(CHAIN_10)
+    ->Arg(TWO_ARMS)
+    ->Arg(BINARY_TREE)
+    ;
+
+static void BM_FABRIK_solve_frame_lazy_rotations(State& state)
+{
+    ik_solver_t* solver = create_solver((Type)state.range(0));
+    solver->flags |= IK_ENABLE_LAZY_ROTATIONS;
+
+    while (state.KeepRunning())
+    {
+        for (int i = 0; i != 4; ++i)
+            IKAPI.solver.solve(solver);
+        IKAPI.solver.update_rotations(solver);
+    }
+
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_FABRIK_solve_frame_lazy_rotations)
+    ->Arg(CHAIN_10)
+    ->Arg(TWO_ARMS)
+    ->Arg(BINARY_TREE)
+    ;
+
+static void BM_FABRIK_solve_instances(State& state)
+{
+    ik_solver_t* solver = create_solver((Type)state.range(0));
+    solver->flags |= (uint8_t)state.range(2);
+    ik_instances_t* instances = IKAPI.solver.create_instances(solver, (uint32_t)state.range(1));
+    std::vector<ik_vec3_t> initial_positions(instances->positions, instances->positions + instances->count * instances->node_count);
+
+    while (state.KeepRunning())
+    {
+        /* Otherwise every solve after the first starts out converged */
+        std::copy(initial_positions.begin(), initial_positions.end(), instances->positions);
+        IKAPI.solver.solve_instances(solver, instances);
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+    IKAPI.solver.destroy_instances(instances);
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_FABRIK_solve_instances)
+    ->Args({CHAIN_10, 256, 0})
+    ->Args({TWO_ARMS, 256, 0})
+    ->Args({BINARY_TREE, 16, 0})
+    ->Args({CHAIN_10, 256, IK_ENABLE_FLOAT_INSTANCES})
+    ->Args({TWO_ARMS, 256, IK_ENABLE_FLOAT_INSTANCES})
+    ->Args({BINARY_TREE, 16, IK_ENABLE_FLOAT_INSTANCES})
+    ;
+
+static void BM_FABRIK_solve_threads(State& state)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* root = create_tree(solver, ISLANDS_32);
+    IKAPI.solver.set_tree(solver, root);
+    solver->thread_count = (uint32_t)state.range(0);
+    solver->stall_ratio = 0; /* always use all iterations */
+    IKAPI.solver.rebuild(solver);
+
+    while (state.KeepRunning())
+    {
+        IKAPI.solver.solve(solver);
+    }
+
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_FABRIK_solve_threads)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->UseRealTime()
+    ;
+
+static void BM_FABRIK_solve_branches(State& state)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* root = create_tree(solver, TENTACLES_32);
+    IKAPI.solver.set_tree(solver, root);
+    solver->thread_count = (uint32_t)state.range(0);
+    solver->fork_threshold = 16;
+    solver->stall_ratio = 0; /* always use all iterations */
+    IKAPI.solver.rebuild(solver);
+
+    while (state.KeepRunning())
+    {
+        IKAPI.solver.solve(solver);
+    }
+
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_FABRIK_solve_branches)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->UseRealTime()
+    ;
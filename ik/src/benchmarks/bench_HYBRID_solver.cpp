@@ -0,0 +1,77 @@
+#include "benchmark/benchmark.h"
+#include "ik/ik.h"
+
+using namespace benchmark;
+
+/*
+ * A humanoid: Spine of 3 segments, a head, and two arms and two legs of 2
+ * segments each. Only the spine and the head are solved iteratively by the
+ * hybrid solver.
+ */
+static void BM_humanoid(State& state, int algorithm)
+{
+    ik_node_t* nodes[13];
+    ik_vec3_t initial_positions[13];
+    ik_quat_t initial_rotations[13];
+    static const int parents[13] = { -1, 0, 1, 2, 3, 4, 3, 6, 3, 0, 9, 0, 11 };
+    static const ikreal_t offsets[13][3] = {
+        { 0, 0, 0 }, { 0, 0.2, 0 }, { 0, 0.2, 0 }, { 0, 0.2, 0 },
+        { -0.3, 0, 0 }, { 0, -0.3, 0 }, { 0.3, 0, 0 }, { 0, -0.3, 0 },
+        { 0, 0.2, 0 },
+        { -0.1, -0.4, 0 }, { 0, -0.4, 0.05 }, { 0.1, -0.4, 0 }, { 0, -0.4, 0.05 }
+    };
+    ik_effector_t* effectors[5];
+    static const int effector_nodes[5] = { 5, 7, 8, 10, 12 };
+    static const ikreal_t targets[5][3] = {
+        { -0.4, 0.3, 0.3 }, { 0.5, 0.5, 0.1 }, { 0.05, 0.75, 0.05 }, { -0.1, -0.7, 0.2 }, { 0.15, -0.75, -0.1 }
+    };
+
+    ik_solver_t* solver = IKAPI.solver.create((enum ik_algorithm_e)algorithm);
+    solver->flags = IK_ENABLE_JOINT_ROTATIONS;
+    solver->tolerance = 1e-3;
+
+    nodes[0] = solver->node->create(0);
+    IKAPI.solver.set_tree(solver, nodes[0]);
+    for (int i = 1; i != 13; ++i)
+    {
+        nodes[i] = solver->node->create_child(nodes[parents[i]], i);
+        nodes[i]->position = IKAPI.vec3.vec3(offsets[i][0], offsets[i][1], offsets[i][2]);
+    }
+    for (int i = 0; i != 5; ++i)
+    {
+        effectors[i] = solver->effector->create();
+        effectors[i]->target_position = IKAPI.vec3.vec3(targets[i][0], targets[i][1], targets[i][2]);
+        solver->effector->attach(effectors[i], nodes[effector_nodes[i]]);
+    }
+    IKAPI.solver.rebuild(solver);
+
+    for (int i = 0; i != 13; ++i)
+    {
+        initial_positions[i] = nodes[i]->position;
+        initial_rotations[i] = nodes[i]->rotation;
+    }
+
+    int64_t iterations = 0;
+    int64_t converged = 0;
+    while (state.KeepRunning())
+    {
+        for (int i = 0; i != 13; ++i)
+        {
+            nodes[i]->position = initial_positions[i];
+            nodes[i]->rotation = initial_rotations[i];
+        }
+        if (IKAPI.solver.solve(solver) == IK_RESULT_CONVERGED)
+            converged++;
+        iterations += solver->iterations_used;
+    }
+
+    state.counters["iterations"] = (double)iterations / state.iterations();
+    state.counters["converged"] = (double)converged / state.iterations();
+    IKAPI.solver.destroy(solver);
+}
+
+static void BM_HYBRID_humanoid(State& state) { BM_humanoid(state, IK_HYBRID); }
+static void BM_FABRIK_humanoid(State& state) { BM_humanoid(state, IK_FABRIK); }
+
+BENCHMARK(BM_HYBRID_humanoid);
+BENCHMARK(BM_FABRIK_humanoid);
@@ -0,0 +1,64 @@
+#include "benchmark/benchmark.h"
+#include "ik/ik.h"
+
+using namespace benchmark;
+
+/* Tentacles of 16 segments growing out of a common root, each with an effector on its tip */
+static ik_solver_t* create_tentacles(uint32_t tentacle_count, int32_t substeps)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_MSS);
+    ik_solver_MSS_t* mss = (ik_solver_MSS_t*)solver;
+    solver->flags = 0;
+    mss->substeps = substeps;
+    mss->gravity.y = -9.81;
+
+    int guid = 0;
+    ik_node_t* root = solver->node->create(guid++);
+    IKAPI.solver.set_tree(solver, root);
+    for (uint32_t t = 0; t != tentacle_count; ++t)
+    {
+        ik_node_t* parent = root;
+        for (int i = 0; i != 16; ++i)
+        {
+            ik_node_t* child = solver->node->create_child(parent, guid++);
+            child->position.x = (i == 0) ? (ikreal_t)t : 0;
+            child->position.y = 1;
+            parent = child;
+        }
+        ik_effector_t* eff = solver->effector->create();
+        eff->target_position.x = t + 4;
+        eff->target_position.y = 8;
+        eff->target_position.z = (t % 3) * 2.0;
+        solver->effector->attach(eff, parent);
+    }
+
+    IKAPI.solver.rebuild(solver);
+    return solver;
+}
+
+static void BM_MSS_solve(State& state, int32_t substeps)
+{
+    uint32_t tentacle_count = (uint32_t)state.range(0);
+    ik_solver_t* solver = create_tentacles(tentacle_count, substeps);
+
+    /* Every solve advances the simulation by one frame */
+    while (state.KeepRunning())
+        IKAPI.solver.solve(solver);
+
+    state.SetItemsProcessed(state.iterations() * tentacle_count * 16);
+    IKAPI.solver.destroy(solver);
+}
+
+static void BM_MSS_solve_adaptive(State& state) { BM_MSS_solve(state, 0); }
+static void BM_MSS_solve_fixed_4(State& state) { BM_MSS_solve(state, 4); }
+
+BENCHMARK(BM_MSS_solve_adaptive)
+    ->Arg(4)
+    ->Arg(64)
+    ->Arg(256)
+    ;
+BENCHMARK(BM_MSS_solve_fixed_4)
+    ->Arg(4)
+    ->Arg(64)
+    ->Arg(256)
+    ;
@@ -0,0 +1,53 @@
+#include "benchmark/benchmark.h"
+#include "ik/ik.h"
+#include <algorithm>
+
+using namespace benchmark;
+
+static void copy_array(ik_vec3_array_t* dst, const ik_vec3_array_t* src, uint32_t count)
+{
+    std::copy(src->x, src->x + count, dst->x);
+    std::copy(src->y, src->y + count, dst->y);
+    std::copy(src->z, src->z + count, dst->z);
+}
+
+static void copy_pose(ik_limbs_t* dst, const ik_limbs_t* src)
+{
+    copy_array(&dst->mids, &src->mids, src->count);
+    copy_array(&dst->tips, &src->tips, src->count);
+}
+
+static void BM_TWO_BONE_solve_limbs(State& state)
+{
+    uint32_t count = (uint32_t)state.range(0);
+    ik_solver_t* solver = IKAPI.solver.create(IK_TWO_BONE);
+    ik_limbs_t* limbs = IKAPI.solver.create_limbs(count);
+
+    /* Arms with segment lengths 2 and 1, reaching for targets spread around them */
+    for (uint32_t i = 0; i != count; ++i)
+    {
+        limbs->bases.x[i] = i;
+        limbs->mids.x[i] = i;   limbs->mids.y[i] = 2;
+        limbs->tips.x[i] = i+1; limbs->tips.y[i] = 2;
+        limbs->targets.x[i] = i + (i % 5) * 0.5; limbs->targets.y[i] = 1; limbs->targets.z[i] = (i % 3) * 0.5;
+        limbs->poles.x[i] = i;  limbs->poles.z[i] = 5;
+    }
+    ik_limbs_t* initial = IKAPI.solver.create_limbs(count);
+    copy_pose(initial, limbs);
+
+    while (state.KeepRunning())
+    {
+        /* Otherwise every solve after the first starts out solved */
+        copy_pose(limbs, initial);
+        IKAPI.solver.solve_limbs(solver, limbs);
+    }
+
+    state.SetItemsProcessed(state.iterations() * count);
+    IKAPI.solver.destroy_limbs(initial);
+    IKAPI.solver.destroy_limbs(limbs);
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_TWO_BONE_solve_limbs)
+    ->Arg(256)
+    ->Arg(4096)
+    ;
@@ -0,0 +1,82 @@
+#include "benchmark/benchmark.h"
+#include "ik/ik.h"
+#include <vector>
+
+using namespace benchmark;
+
+/*
+ * Copying the global transforms of a skeleton into a skinning buffer. The
+ * callback has no user context, so it writes through a global.
+ */
+static ikreal_t* g_buffer;
+
+static void build_skeleton(ik_solver_t* solver, int bones)
+{
+    ik_node_t* parent = solver->node->create(0);
+    IKAPI.solver.set_tree(solver, parent);
+    for (int i = 1; i != bones; ++i)
+    {
+        /* Branch off the spine every 4 bones */
+        ik_node_t* child = solver->node->create_child(parent, i);
+        child->position.y = 0.25;
+        child->rotation = IKAPI.quat.quat(0.1, 0, 0, 1);
+        IKAPI.quat.normalize(child->rotation.f);
+        if (i % 4 != 0)
+            parent = child;
+    }
+    IKAPI.solver.rebuild(solver);
+}
+
+static void copy_global_transform(ik_node_t* node)
+{
+    ik_quat_t rotation = node->rotation;
+    ik_vec3_t position = node->position;
+    if (node->parent != NULL)
+    {
+        ik_node_t* parent;
+        for (parent = node->parent; parent != NULL; parent = parent->parent)
+        {
+            ik_quat_t accumulated = parent->rotation;
+            IKAPI.vec3.rotate(position.f, parent->rotation.f);
+            IKAPI.vec3.add_vec3(position.f, parent->position.f);
+            IKAPI.quat.mul_quat(accumulated.f, rotation.f);
+            rotation = accumulated;
+        }
+    }
+    for (int i = 0; i != 4; ++i) *g_buffer++ = rotation.f[i];
+    for (int i = 0; i != 3; ++i) *g_buffer++ = position.f[i];
+}
+
+static void BM_pose_iterate_all_nodes(State& state)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    build_skeleton(solver, state.range(0));
+    std::vector<ikreal_t> buffer(state.range(0) * 7);
+
+    while (state.KeepRunning())
+    {
+        g_buffer = buffer.data();
+        IKAPI.solver.iterate_all_nodes(solver, copy_global_transform);
+        DoNotOptimize(buffer.data());
+    }
+
+    IKAPI.solver.destroy(solver);
+}
+
+static void BM_pose_get_pose(State& state)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    build_skeleton(solver, state.range(0));
+    std::vector<ikreal_t> buffer(state.range(0) * 7);
+
+    while (state.KeepRunning())
+    {
+        IKAPI.solver.get_pose(solver, buffer.data(), 0, IK_POSE_GLOBAL);
+        DoNotOptimize(buffer.data());
+    }
+
+    IKAPI.solver.destroy(solver);
+}
+
+BENCHMARK(BM_pose_iterate_all_nodes)->Arg(64)->Arg(256);
+BENCHMARK(BM_pose_get_pose)->Arg(64)->Arg(256);
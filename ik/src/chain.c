@@ -10,9 +10,13 @@ enum node_marking_e
 {
     MARK_NONE = 0,
     MARK_BASE,
-    MARK_SECTION
+    MARK_SECTION,
+    /* Not part of a chain, but there are chains further down the tree */
+    MARK_ABOVE_CHAIN
 };
 
+#define CHAIN_REACH_TO_ROOT ((uint32_t)-1)
+
 /* ------------------------------------------------------------------------- */
 struct chain_t*
 chain_create(void)
@@ -61,6 +65,35 @@ chain_clear_free(struct chain_t* chain)
     chain_destruct(chain); /* does the same thing */
 }
 
+/* ------------------------------------------------------------------------- */
+void
+chain_recycle(struct chain_t* chain, struct vector_t* spare_chains)
+{
+    /*
+     * Spares are handed out last in, first out. Recycling in reverse pre-order
+     * means rebuilding the same chains gives every chain its old memory back.
+     */
+    uint32_t idx = vector_count(&chain->children);
+    while (idx--)
+        chain_recycle(vector_get_element(&chain->children, idx), spare_chains);
+    vector_clear(&chain->children);
+    vector_clear(&chain->nodes);
+
+    if (vector_push(spare_chains, chain) != IK_OK)
+        chain_destruct(chain);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_construct_from_spares(struct chain_t* chain, struct vector_t* spare_chains)
+{
+    struct chain_t* spare = vector_pop(spare_chains);
+    if (spare != NULL)
+        *chain = *spare;
+    else
+        chain_construct(chain);
+}
+
 /* ------------------------------------------------------------------------- */
 struct chain_t*
 chain_create_child(struct chain_t* chain)
@@ -96,87 +129,123 @@ count_chains(const struct vector_t* chains)
 }
 
 /* ------------------------------------------------------------------------- */
-static ikret_t
-mark_involved_nodes(struct bstv_t* involved_nodes,
-                    const struct vector_t* effector_nodes_list)
+static int
+node_is_in_subtree(const struct ik_node_t* node, const struct ik_node_t* subtree_base)
 {
+    for (; node != NULL; node = node->parent)
+        if (node == subtree_base)
+            return 1;
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+mark_involved_nodes(const struct vector_t* effector_nodes_list,
+                    const struct ik_node_t* subtree_base)
+{
+    int involved_nodes_count = 0;
+
     /*
      * Traverse the chain of parents starting at each effector node and ending
      * at the sub-base node of the tree and mark every node on the way. Each
      * effector specifies a maximum chain length, which means it's possible
      * that we won't hit the base node.
+     *
+     * The markings are stored in the nodes themselves, and
+     * recursively_build_chain_tree() resets them again.
      */
     VECTOR_FOR_EACH(effector_nodes_list, struct ik_node_t*, p_effector_node)
 
         /*
          * Set up chain length counter. If the chain length is 0 then it is
-         * infinitely long. Set the counter to -1 in this case to skip the
-         * escape condition.
+         * infinitely long.
          */
-        int chain_length_counter;
         struct ik_node_t* node = *p_effector_node;
+        uint32_t chain_reach;
         assert(node->effector != NULL);
-        chain_length_counter = node->effector->chain_length == 0 ? -1 : (int)node->effector->chain_length;
+        if (subtree_base->parent != NULL && node_is_in_subtree(node, subtree_base) == 0)
+            continue;
+        chain_reach = node->effector->chain_length == 0 ? CHAIN_REACH_TO_ROOT : node->effector->chain_length;
 
         /*
          * Mark nodes that are at the base of the chain differently, so the
          * chains can be split correctly later. Section markings will overwrite
-         * break markings.
-         *
-         * Additionally, there is a special constraint (IK_CONSTRAINT_STIFF)
-         * that restricts all rotations of a node. If this constraint is
-         * imposed on a particular node, mark it differently as well so the
-         * surrounding nodes can be combined into a single bone properly later.
+         * base markings.
          *
-         * NOTE: The node->constraint field specifies constraints for
-         * the *parent* node, not for the current node. However, we will be
-         * marking the *current* node, not the parent node.
+         * If a node was already marked as a section by a chain that reaches
+         * at least as far as this one, then the rest of the way has been
+         * marked already. This keeps marking linear in the number of nodes
+         * instead of the number of effectors times the depth of the tree.
          */
         for (; node != NULL; node = node->parent)
         {
-            enum node_marking_e* current_marking;
-            enum node_marking_e marking = MARK_SECTION;
-            if (chain_length_counter == 0)
-                marking = MARK_BASE;
-
-            current_marking = (enum node_marking_e*)bstv_find_ptr(involved_nodes, node->guid);
-            if (current_marking == NULL)
+            if (chain_reach == 0)
             {
-                if (bstv_insert(involved_nodes, node->guid, (void*)(intptr_t)marking) < 0)
-                {
-                    IKAPI.log.message("Ran out of memory while marking involved nodes");
-                    return IK_RAN_OUT_OF_MEMORY;
-                }
-            }
-            else
-            {
-                if (chain_length_counter != 0)
-                    *current_marking = marking;
+                if (node->_chain_mark == MARK_NONE)
+                    involved_nodes_count++;
+                else if (node->_chain_mark != MARK_ABOVE_CHAIN)
+                    break; /* nodes above have been marked already */
+
+                node->_chain_mark = MARK_BASE;
+                break;
             }
 
-            if (chain_length_counter-- == 0)
+            if (node->_chain_mark == MARK_SECTION && node->_chain_reach >= chain_reach)
+                break;
+            if (node->_chain_mark == MARK_NONE)
+                involved_nodes_count++;
+
+            node->_chain_mark = MARK_SECTION;
+            node->_chain_reach = chain_reach;
+            if (chain_reach != CHAIN_REACH_TO_ROOT)
+                chain_reach--;
+        }
+
+        /*
+         * Flag the nodes between the base of the chain and the base of the
+         * tree so recursively_build_chain_tree() knows which children have
+         * chains further down and can skip all others.
+         */
+        if (node == NULL || node == subtree_base)
+            continue;
+        for (node = node->parent; node != NULL; node = node->parent)
+        {
+            if (node->_chain_mark != MARK_NONE)
+                break;
+            node->_chain_mark = MARK_ABOVE_CHAIN;
+            if (node == subtree_base)
                 break;
         }
     VECTOR_END_EACH
 
-    return IK_OK;
+    return involved_nodes_count;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+clear_markings(struct ik_node_t* node)
+{
+    node->_chain_mark = MARK_NONE;
+    NODE_FOR_EACH(node, guid, child)
+        clear_markings(child);
+    NODE_END_EACH
 }
 
 /* ------------------------------------------------------------------------- */
 static ikret_t
 recursively_build_chain_tree(struct vector_t* chain_list,
+                             struct vector_t* spare_chains,
                              struct chain_t* chain_current,
                              const struct ik_node_t* node_base,
-                             const struct ik_node_t* node_current,
-                             struct bstv_t* involved_nodes)
+                             struct ik_node_t* node_current)
 {
     int marked_children_count;
     const struct ik_node_t* child_node_base = node_base;
     struct chain_t* child_chain = chain_current;
 
-    /* can remove the mark from the set to speed up future checks */
-    enum node_marking_e marking =
-        (enum node_marking_e)(intptr_t)bstv_erase(involved_nodes, node_current->guid);
+    /* Reset the marking so the next rebuild starts out clean */
+    enum node_marking_e marking = (enum node_marking_e)node_current->_chain_mark;
+    node_current->_chain_mark = MARK_NONE;
 
     switch(marking)
     {
@@ -197,6 +266,7 @@ recursively_build_chain_tree(struct vector_t* chain_list,
          * that there are isolated chains somewhere further down the tree.
          */
         case MARK_NONE:
+        case MARK_ABOVE_CHAIN:
             node_base = node_current;
             /* falling through on purpose */
 
@@ -210,13 +280,15 @@ recursively_build_chain_tree(struct vector_t* chain_list,
              */
             marked_children_count = 0;
             NODE_FOR_EACH(node_current, child_guid, child)
-                if ((enum node_marking_e)(intptr_t)bstv_find(involved_nodes, child_guid) == MARK_SECTION)
+                if (child->_chain_mark == MARK_SECTION)
                     if (++marked_children_count == 2)
                         break;
             NODE_END_EACH
             if ((marked_children_count == 2 || node_current->effector != NULL) && node_current != node_base)
             {
                 const struct ik_node_t* node;
+                uint32_t node_count = 1;
+                uint32_t node_idx = 0;
 
                 if (chain_current == NULL) /* First chain in the tree? */
                 {
@@ -227,7 +299,7 @@ recursively_build_chain_tree(struct vector_t* chain_list,
                         IKAPI.log.message("Failed to create base chain: Ran out of memory");
                         return IK_RAN_OUT_OF_MEMORY;
                     }
-                    chain_construct(child_chain);
+                    chain_construct_from_spares(child_chain, spare_chains);
                 }
                 else /* This is not the first chain in the tree */
                 {
@@ -241,24 +313,24 @@ recursively_build_chain_tree(struct vector_t* chain_list,
                         IKAPI.log.message("Failed to create child chain: Ran out of memory");
                         return IK_RAN_OUT_OF_MEMORY;
                     }
-                    chain_construct(child_chain);
+                    chain_construct_from_spares(child_chain, spare_chains);
                 }
 
                 /*
                  * Add pointers to all nodes that are part of this chain into
-                 * the chain's list, starting with the end node.
+                 * the chain's list, starting with the end node. The list is
+                 * sized up front so it's allocated at most once.
                  */
                 for (node = node_current; node != node_base; node = node->parent)
-                    if (chain_add_node(child_chain, node) != 0)
-                    {
-                        IKAPI.log.message("Failed to insert node into chain: Ran out of memory");
-                        return IK_RAN_OUT_OF_MEMORY;
-                    }
-                if (chain_add_node(child_chain, node_base) != 0)
+                    node_count++;
+                if (vector_resize(&child_chain->nodes, node_count) != IK_OK)
                 {
                     IKAPI.log.message("Failed to insert node into chain: Ran out of memory");
                     return IK_RAN_OUT_OF_MEMORY;
                 }
+                for (node = node_current; node != node_base; node = node->parent)
+                    chain_get_node(child_chain, node_idx++) = (struct ik_node_t*)node;
+                chain_get_node(child_chain, node_idx) = (struct ik_node_t*)node_base;
 
                 /*
                  * Update the base node to be this node so deeper chains are
@@ -269,51 +341,67 @@ recursively_build_chain_tree(struct vector_t* chain_list,
             break;
     }
 
-    /* Recurse into children of the current node. */
+    /*
+     * Recurse into children of the current node. Children without a marking
+     * have no chains anywhere below them.
+     */
     NODE_FOR_EACH(node_current, child_guid, child_node)
         ikret_t result;
+        if (child_node->_chain_mark == MARK_NONE)
+            continue;
         if ((result = recursively_build_chain_tree(
                 chain_list,
+                spare_chains,
                 child_chain,
                 child_node_base,
-                child_node,
-                involved_nodes)) != IK_OK)
+                child_node)) != IK_OK)
             return result;
     NODE_END_EACH
 
     return IK_OK;
 }
 
+/* ------------------------------------------------------------------------- */
+static void
+reserve_spare_chains(const struct vector_t* chain_list, struct vector_t* spare_chains)
+{
+    /*
+     * Make room for every chain in the list of spares, so recycling them in
+     * the next rebuild doesn't allocate. Not fatal if this fails, chains are
+     * destructed instead.
+     */
+    vector_reserve(spare_chains, vector_count(spare_chains) + count_chains(chain_list));
+}
+
 /* ------------------------------------------------------------------------- */
 ikret_t
 chain_tree_rebuild(struct vector_t* chain_list,
-                   const struct ik_node_t* base_node,
+                   struct vector_t* spare_chains,
+                   struct ik_node_t* base_node,
                    const struct vector_t* effector_nodes_list)
 {
     ikret_t result;
-    struct bstv_t involved_nodes;
     int involved_nodes_count;
+    uint32_t idx;
 #ifdef IK_DOT_OUTPUT
     char buffer[20];
     static int file_name_counter = 0;
 #endif
 
-    /* Clear all existing chain trees */
-    VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
-        chain_destruct(chain);
-    VECTOR_END_EACH
-    vector_clear_free(chain_list);
+    /* Clear all existing chain trees, keeping their memory for the new ones */
+    idx = vector_count(chain_list);
+    while (idx--)
+        chain_recycle(vector_get_element(chain_list, idx), spare_chains);
+    vector_clear(chain_list);
 
-    /*
-     * Build a set of all nodes that are in a direct path with all of the
-     * effectors.
-     */
-    bstv_construct(&involved_nodes);
-    if ((result = mark_involved_nodes(&involved_nodes, effector_nodes_list)) != IK_OK)
-        goto mark_involved_nodes_failed;
-    involved_nodes_count = bstv_count(&involved_nodes);
+    /* Mark all nodes that are in a direct path with all of the effectors. */
+    involved_nodes_count = mark_involved_nodes(effector_nodes_list, base_node);
 
-    recursively_build_chain_tree(chain_list, NULL, base_node, base_node, &involved_nodes);
+    if ((result = recursively_build_chain_tree(chain_list, spare_chains, NULL, base_node, base_node)) != IK_OK)
+    {
+        clear_markings(base_node);
+        return result;
+    }
 
     /* DEBUG: Save chain tree to DOT */
 #ifdef IK_DOT_OUTPUT
@@ -326,11 +414,182 @@ chain_tree_rebuild(struct vector_t* chain_list,
                    involved_nodes_count,
                    count_chains(chain_list));
 
-    bstv_clear_free(&involved_nodes);
+    reserve_spare_chains(chain_list, spare_chains);
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+static struct ik_node_t*
+find_effector_chain_base(struct ik_node_t* node)
+{
+    /* Same walk as mark_involved_nodes(). A chain length of 0 reaches the root */
+    int chain_length_counter = node->effector->chain_length == 0 ? -1 : (int)node->effector->chain_length;
+    for (; node->parent != NULL && chain_length_counter-- != 0; node = node->parent) {}
+    return node;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+chain_contains_node(const struct chain_t* chain, const struct ik_node_t* node)
+{
+    int idx = chain_length(chain);
+    while (idx--)
+        if (chain_get_node(chain, idx) == node)
+            return 1;
+
+    CHAIN_FOR_EACH_CHILD(chain, child)
+        if (chain_contains_node(child, node))
+            return 1;
+    CHAIN_END_EACH
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static struct ik_node_t*
+find_affected_subtree_base(const struct vector_t* chain_list,
+                           const struct vector_t* effector_nodes_list,
+                           struct ik_node_t* changed_node)
+{
+    /*
+     * Building chains from a node only produces the same chains as a full
+     * rebuild would if nothing above that node reaches into its sub-tree.
+     * Move up until no existing island passes through the base node, and
+     * until no effector below the base node has a chain reaching above it.
+     * The first catches effectors that were detached or shortened, the second
+     * those that were attached or lengthened.
+     */
+    struct ik_node_t* subtree_base = changed_node;
+    int moved;
+    do
+    {
+        moved = 0;
+
+        VECTOR_FOR_EACH(chain_list, struct chain_t, island)
+            struct ik_node_t* island_base = chain_get_base_node(island);
+            if (island_base != subtree_base &&
+                node_is_in_subtree(subtree_base, island_base) &&
+                chain_contains_node(island, subtree_base))
+            {
+                subtree_base = island_base;
+                moved = 1;
+            }
+        VECTOR_END_EACH
+
+        VECTOR_FOR_EACH(effector_nodes_list, struct ik_node_t*, p_effector_node)
+            struct ik_node_t* chain_base;
+            if (node_is_in_subtree(*p_effector_node, subtree_base) == 0)
+                continue;
+            chain_base = find_effector_chain_base(*p_effector_node);
+            if (chain_base != subtree_base && node_is_in_subtree(subtree_base, chain_base))
+            {
+                subtree_base = chain_base;
+                moved = 1;
+            }
+        VECTOR_END_EACH
+    } while (moved);
+
+    return subtree_base;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+calculate_segment_lengths_in_island(struct chain_t* chain);
+
+/* ------------------------------------------------------------------------- */
+static void
+reverse_islands(struct vector_t* chain_list, uint32_t begin, uint32_t end)
+{
+    while (begin + 1 < end)
+    {
+        struct chain_t* a = vector_get_element(chain_list, begin++);
+        struct chain_t* b = vector_get_element(chain_list, --end);
+        struct chain_t tmp = *a;
+        *a = *b;
+        *b = tmp;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+rebuild_subtree_chains(struct vector_t* chain_list,
+                       struct vector_t* spare_chains,
+                       const struct vector_t* effector_nodes_list,
+                       struct ik_node_t* subtree_base)
+{
+    ikret_t result;
+    uint32_t idx;
+    uint32_t insert_idx;
+    uint32_t new_begin;
+
+    /*
+     * Islands are in the same order as their base nodes in the tree, so all
+     * islands of the sub-tree are replaced in place.
+     */
+    insert_idx = vector_count(chain_list);
+    for (idx = 0; idx < vector_count(chain_list); )
+    {
+        struct chain_t* island = vector_get_element(chain_list, idx);
+        if (node_is_in_subtree(chain_get_base_node(island), subtree_base))
+        {
+            chain_recycle(island, spare_chains);
+            vector_erase_index(chain_list, idx);
+            if (insert_idx > idx)
+                insert_idx = idx;
+        }
+        else
+            ++idx;
+    }
+
+    /* New islands are appended to the list and then rotated into place */
+    new_begin = vector_count(chain_list);
+    mark_involved_nodes(effector_nodes_list, subtree_base);
+    if ((result = recursively_build_chain_tree(
+            chain_list, spare_chains, NULL, subtree_base, subtree_base)) != IK_OK)
+    {
+        clear_markings(subtree_base);
+        return result;
+    }
+
+    /* Only the new islands need their segment lengths computed */
+    for (idx = new_begin; idx != vector_count(chain_list); ++idx)
+        calculate_segment_lengths_in_island(vector_get_element(chain_list, idx));
+
+    reverse_islands(chain_list, insert_idx, new_begin);
+    reverse_islands(chain_list, new_begin, vector_count(chain_list));
+    reverse_islands(chain_list, insert_idx, vector_count(chain_list));
+
+    IKAPI.log.message("Rebuilt chains below node %d: %d island(s)",
+                   subtree_base->guid,
+                   vector_count(chain_list) - new_begin);
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+chain_tree_rebuild_partial(struct vector_t* chain_list,
+                           struct vector_t* spare_chains,
+                           const struct vector_t* effector_nodes_list,
+                           const struct vector_t* changed_nodes)
+{
+    ikret_t result;
+
+    /*
+     * Rebuilding one changed node can already cover another one, in which case
+     * the second rebuild finds the chains are correct and produces them again.
+     */
+    VECTOR_FOR_EACH(changed_nodes, struct ik_node_t*, p_changed_node)
+        struct ik_node_t* subtree_base = find_affected_subtree_base(
+                chain_list, effector_nodes_list, *p_changed_node);
+        if ((result = rebuild_subtree_chains(
+                chain_list, spare_chains, effector_nodes_list, subtree_base)) != IK_OK)
+            return result;
+    VECTOR_END_EACH
 
-    return result;
+    reserve_spare_chains(chain_list, spare_chains);
 
-    mark_involved_nodes_failed : bstv_clear_free(&involved_nodes);
     return IK_OK;
 }
 
@@ -0,0 +1,883 @@
+#include "ik/chain_flat.h"
+#include "ik/chain.h"
+#include "ik/chain_lanes.h"
+#include "ik/effector.h"
+#include "ik/ik.h"
+#include "ik/math_inline.h"
+#include "ik/memory.h"
+#include "ik/node.h"
+#include "ik/solver.h"
+#include "ik/transform.h"
+#include "ik/vec3_static.h"
+#include <assert.h>
+#include <string.h>
+
+/* ------------------------------------------------------------------------- */
+struct chain_flat_t*
+chain_flat_create(void)
+{
+    struct chain_flat_t* flat = MALLOC(sizeof *flat);
+    if (flat == NULL)
+    {
+        IKAPI.log.message("Failed to allocate flat chain: out of memory");
+        return NULL;
+    }
+    chain_flat_construct(flat);
+    return flat;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_destroy(struct chain_flat_t* flat)
+{
+    chain_flat_destruct(flat);
+    FREE(flat);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_construct(struct chain_flat_t* flat)
+{
+    vector_construct(&flat->islands, sizeof(struct chain_flat_island_t));
+    vector_construct(&flat->chains, sizeof(struct chain_flat_chain_t));
+    vector_construct(&flat->branches, sizeof(struct chain_flat_branch_t));
+    vector_construct(&flat->nodes, sizeof(struct ik_node_t*));
+    vector_construct(&flat->slot_pose_index, sizeof(uint32_t));
+    vector_construct(&flat->positions, sizeof(ik_vec3_t));
+    vector_construct(&flat->segment_lengths, sizeof(ikreal_t));
+    vector_construct(&flat->rotation_weights, sizeof(ikreal_t));
+    vector_construct(&flat->directions, sizeof(ik_vec3_t));
+    vector_construct(&flat->accumulators, sizeof(ik_vec3_t));
+    vector_construct(&flat->effector_slots, sizeof(uint32_t));
+    vector_construct(&flat->effector_targets, sizeof(ik_vec3_t));
+    vector_construct(&flat->effector_target_rotations, sizeof(ik_quat_t));
+    vector_construct(&flat->pose_nodes, sizeof(struct ik_node_t*));
+    vector_construct(&flat->pose_slots, sizeof(uint32_t));
+    vector_construct(&flat->pose_parents, sizeof(int32_t));
+    vector_construct(&flat->pose_local_positions, sizeof(ik_vec3_t));
+    vector_construct(&flat->pose_local_rotations, sizeof(ik_quat_t));
+    vector_construct(&flat->pose_global_positions, sizeof(ik_vec3_t));
+    vector_construct(&flat->pose_global_rotations, sizeof(ik_quat_t));
+    vector_construct(&flat->pose_dirty, sizeof(uint8_t));
+    vector_construct(&flat->pose_accumulators, sizeof(ikreal_t) * 7);
+    flat->has_global_pose = 0;
+    vector_construct(&flat->warm_input_positions, sizeof(ik_vec3_t));
+    vector_construct(&flat->warm_solved_positions, sizeof(ik_vec3_t));
+    flat->has_warm_start = 0;
+    flat->has_pending_rotations = 0;
+    vector_construct(&flat->lane_positions, sizeof(struct chain_lanes_vec3_t));
+    vector_construct(&flat->lane_accumulators, sizeof(struct chain_lanes_vec3_t));
+    vector_construct(&flat->lane_targets, sizeof(struct chain_lanes_vec3_t));
+    vector_construct(&flat->subtree_sizes, sizeof(uint32_t));
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_destruct(struct chain_flat_t* flat)
+{
+    vector_clear_free(&flat->subtree_sizes);
+    vector_clear_free(&flat->lane_targets);
+    vector_clear_free(&flat->lane_accumulators);
+    vector_clear_free(&flat->lane_positions);
+    vector_clear_free(&flat->warm_solved_positions);
+    vector_clear_free(&flat->warm_input_positions);
+    vector_clear_free(&flat->pose_accumulators);
+    vector_clear_free(&flat->pose_dirty);
+    vector_clear_free(&flat->pose_global_rotations);
+    vector_clear_free(&flat->pose_global_positions);
+    vector_clear_free(&flat->pose_local_rotations);
+    vector_clear_free(&flat->pose_local_positions);
+    vector_clear_free(&flat->pose_parents);
+    vector_clear_free(&flat->pose_slots);
+    vector_clear_free(&flat->pose_nodes);
+    vector_clear_free(&flat->effector_target_rotations);
+    vector_clear_free(&flat->effector_targets);
+    vector_clear_free(&flat->effector_slots);
+    vector_clear_free(&flat->accumulators);
+    vector_clear_free(&flat->directions);
+    vector_clear_free(&flat->rotation_weights);
+    vector_clear_free(&flat->segment_lengths);
+    vector_clear_free(&flat->positions);
+    vector_clear_free(&flat->slot_pose_index);
+    vector_clear_free(&flat->nodes);
+    vector_clear_free(&flat->branches);
+    vector_clear_free(&flat->chains);
+    vector_clear_free(&flat->islands);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_clear(struct chain_flat_t* flat)
+{
+    vector_clear(&flat->islands);
+    vector_clear(&flat->chains);
+    vector_clear(&flat->branches);
+    vector_clear(&flat->nodes);
+    vector_clear(&flat->slot_pose_index);
+    vector_clear(&flat->positions);
+    vector_clear(&flat->segment_lengths);
+    vector_clear(&flat->rotation_weights);
+    vector_clear(&flat->directions);
+    vector_clear(&flat->accumulators);
+    vector_clear(&flat->effector_slots);
+    vector_clear(&flat->effector_targets);
+    vector_clear(&flat->effector_target_rotations);
+    vector_clear(&flat->pose_nodes);
+    vector_clear(&flat->pose_slots);
+    vector_clear(&flat->pose_parents);
+    vector_clear(&flat->pose_local_positions);
+    vector_clear(&flat->pose_local_rotations);
+    vector_clear(&flat->pose_global_positions);
+    vector_clear(&flat->pose_global_rotations);
+    vector_clear(&flat->pose_dirty);
+    vector_clear(&flat->pose_accumulators);
+    flat->has_global_pose = 0;
+    vector_clear(&flat->warm_input_positions);
+    vector_clear(&flat->warm_solved_positions);
+    flat->has_warm_start = 0;
+    flat->has_pending_rotations = 0;
+    vector_clear(&flat->lane_positions);
+    vector_clear(&flat->lane_accumulators);
+    vector_clear(&flat->lane_targets);
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+count_slots_recursive(const struct chain_t* chain)
+{
+    uint32_t counter = chain_length(chain);
+    CHAIN_FOR_EACH_CHILD(chain, child)
+        counter += count_slots_recursive(child);
+    CHAIN_END_EACH
+    return counter;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+push_pose_node(struct chain_flat_t* flat, uint32_t slot, int32_t parent)
+{
+    ikret_t result;
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    uint32_t* slot_pose_index = chain_flat_data(flat, slot_pose_index, uint32_t);
+
+    slot_pose_index[slot] = vector_count(&flat->pose_nodes);
+    if ((result = vector_push(&flat->pose_nodes, &nodes[slot])) != IK_OK)
+        return result;
+    if ((result = vector_push(&flat->pose_slots, &slot)) != IK_OK)
+        return result;
+    if ((result = vector_push(&flat->pose_parents, &parent)) != IK_OK)
+        return result;
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+flatten_chain_recursive(struct chain_flat_t* flat,
+                        const struct chain_t* chain,
+                        int32_t parent,
+                        uint32_t base_source,
+                        uint32_t* chain_idx,
+                        uint32_t* slot_idx)
+{
+    ikret_t result;
+    uint32_t slot;
+    uint32_t this_chain_idx = (*chain_idx)++;
+    struct chain_flat_chain_t* flat_chain = chain_flat_data(flat, chains, struct chain_flat_chain_t) + this_chain_idx;
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    uint32_t* slot_pose_index = chain_flat_data(flat, slot_pose_index, uint32_t);
+
+    /* The algorithm assumes chains have at least one bone */
+    assert(chain_length(chain) >= 2);
+
+    flat_chain->slot_begin = *slot_idx;
+    flat_chain->slot_count = chain_length(chain);
+    flat_chain->parent = parent;
+    flat_chain->base_source = (parent < 0 ? *slot_idx + flat_chain->slot_count - 1 : base_source);
+    flat_chain->child_count = vector_count(&chain->children);
+    flat_chain->effector_index = -1;
+    flat_chain->branch = -1;
+    flat_chain->kernel = CHAIN_FLAT_KERNEL_ITERATIVE;
+
+    /* Remember where the effectors are so solvers can check for convergence */
+    if (chain_get_tip_node(chain)->effector != NULL)
+    {
+        flat_chain->effector_index = (int32_t)vector_count(&flat->effector_slots);
+        if ((result = vector_push(&flat->effector_slots, slot_idx)) != IK_OK)
+            return result;
+    }
+
+    CHAIN_FOR_EACH_NODE(chain, node)
+        nodes[(*slot_idx)++] = node;
+    CHAIN_END_EACH
+
+    /*
+     * Assign pose indices from base to tip. The base node of a child chain was
+     * already assigned an index as the tip of its parent chain.
+     */
+    slot = flat_chain->slot_begin + flat_chain->slot_count - 1;
+    if (parent < 0)
+    {
+        if ((result = push_pose_node(flat, slot, -1)) != IK_OK)
+            return result;
+    }
+    else
+    {
+        slot_pose_index[slot] = slot_pose_index[base_source];
+    }
+    while (slot-- > flat_chain->slot_begin)
+    {
+        if ((result = push_pose_node(flat, slot, (int32_t)slot_pose_index[slot + 1])) != IK_OK)
+            return result;
+    }
+
+    /* Child chains are attached to our tip node, which is in our first slot */
+    CHAIN_FOR_EACH_CHILD(chain, child)
+        if ((result = flatten_chain_recursive(flat, child, (int32_t)this_chain_idx,
+                flat_chain->slot_begin, chain_idx, slot_idx)) != IK_OK)
+            return result;
+    CHAIN_END_EACH
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+find_islands(struct chain_flat_t* flat)
+{
+    const struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    const uint32_t* slot_pose_index = chain_flat_data(flat, slot_pose_index, uint32_t);
+    struct chain_flat_island_t* islands;
+    struct chain_flat_island_t* island = NULL;
+    uint32_t chain_count = vector_count(&flat->chains);
+    uint32_t island_count;
+    uint32_t chain_idx, island_idx;
+
+    /* Chains are in pre-order, so a new island begins at every base chain */
+    for (chain_idx = 0; chain_idx != chain_count; ++chain_idx)
+    {
+        const struct chain_flat_chain_t* chain = &chains[chain_idx];
+        if (chain->parent < 0)
+        {
+            if ((island = vector_push_emplace(&flat->islands)) == NULL)
+                return IK_RAN_OUT_OF_MEMORY;
+            island->chain_begin = chain_idx;
+            island->chain_count = 0;
+            island->slot_begin = chain->slot_begin;
+            island->slot_count = 0;
+            island->effector_begin = 0;
+            island->effector_count = 0;
+            island->branch_begin = 0;
+            island->branch_count = 0;
+            island->analytic_chain_count = 0;
+            island->pose_begin = 0;
+            island->pose_end = 0;
+            island->result = IK_OK;
+            island->iterations_used = 0;
+        }
+
+        ++island->chain_count;
+        island->slot_count += chain->slot_count;
+        if (chain->effector_index >= 0)
+        {
+            if (island->effector_count++ == 0)
+                island->effector_begin = (uint32_t)chain->effector_index;
+        }
+    }
+
+    /* An island's poses begin with its base node and end where the next island begins */
+    island_count = vector_count(&flat->islands);
+    islands = chain_flat_data(flat, islands, struct chain_flat_island_t);
+    for (island_idx = 0; island_idx != island_count; ++island_idx)
+    {
+        const struct chain_flat_chain_t* base_chain = &chains[islands[island_idx].chain_begin];
+        islands[island_idx].pose_begin = slot_pose_index[base_chain->slot_begin + base_chain->slot_count - 1];
+        islands[island_idx].pose_end = vector_count(&flat->pose_nodes);
+        if (island_idx > 0)
+            islands[island_idx - 1].pose_end = islands[island_idx].pose_begin;
+    }
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+chain_flat_build(struct chain_flat_t* flat, const struct vector_t* chain_list)
+{
+    ikret_t result;
+    uint32_t chain_count = (uint32_t)count_chains(chain_list);
+    uint32_t slot_count = 0;
+    uint32_t chain_idx = 0;
+    uint32_t slot_idx = 0;
+
+    VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
+        slot_count += count_slots_recursive(chain);
+    VECTOR_END_EACH
+
+    chain_flat_clear(flat);
+
+    if ((result = vector_resize(&flat->chains, chain_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->directions, chain_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->accumulators, chain_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->nodes, slot_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->slot_pose_index, slot_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->positions, slot_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->segment_lengths, slot_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->rotation_weights, slot_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->lane_positions, slot_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->warm_input_positions, slot_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->warm_solved_positions, slot_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->lane_accumulators, chain_count)) != IK_OK) goto build_failed;
+
+    VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
+        if ((result = flatten_chain_recursive(flat, chain, -1, 0, &chain_idx, &slot_idx)) != IK_OK)
+            goto build_failed;
+    VECTOR_END_EACH
+
+    if ((result = vector_resize(&flat->effector_targets, vector_count(&flat->effector_slots))) != IK_OK)
+        goto build_failed;
+    if ((result = vector_resize(&flat->effector_target_rotations, vector_count(&flat->effector_slots))) != IK_OK)
+        goto build_failed;
+    if ((result = vector_resize(&flat->lane_targets, vector_count(&flat->effector_slots))) != IK_OK)
+        goto build_failed;
+    if ((result = vector_resize(&flat->pose_local_positions, vector_count(&flat->pose_nodes))) != IK_OK)
+        goto build_failed;
+    if ((result = vector_resize(&flat->pose_local_rotations, vector_count(&flat->pose_nodes))) != IK_OK)
+        goto build_failed;
+    if ((result = vector_resize(&flat->pose_global_positions, vector_count(&flat->pose_nodes))) != IK_OK)
+        goto build_failed;
+    if ((result = vector_resize(&flat->pose_global_rotations, vector_count(&flat->pose_nodes))) != IK_OK)
+        goto build_failed;
+    if ((result = vector_resize(&flat->pose_dirty, vector_count(&flat->pose_nodes))) != IK_OK)
+        goto build_failed;
+    if ((result = vector_resize(&flat->pose_accumulators, vector_count(&flat->pose_nodes))) != IK_OK)
+        goto build_failed;
+
+    assert(chain_idx == chain_count);
+    assert(slot_idx == slot_count);
+
+    if ((result = find_islands(flat)) != IK_OK)
+        goto build_failed;
+
+    chain_flat_update_distances(flat);
+
+    return IK_OK;
+
+    build_failed : chain_flat_clear(flat);
+                   IKAPI.log.message("Failed to build flat chain: ran out of memory");
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+uint32_t
+chain_flat_select_analytic_kernels(struct chain_flat_t* flat)
+{
+    struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    uint32_t total = 0;
+
+    VECTOR_FOR_EACH(&flat->islands, struct chain_flat_island_t, island)
+        uint32_t chain_end = island->chain_begin + island->chain_count;
+        uint32_t chain_idx;
+
+        island->analytic_chain_count = 0;
+        for (chain_idx = island->chain_begin; chain_idx != chain_end; ++chain_idx)
+        {
+            struct chain_flat_chain_t* chain = &chains[chain_idx];
+
+            /* Leaf chains always end in an effector */
+            chain->kernel = CHAIN_FLAT_KERNEL_ITERATIVE;
+            if (chain->child_count != 0 || chain->effector_index < 0)
+                continue;
+
+            if (chain->slot_count == 2)
+                chain->kernel = CHAIN_FLAT_KERNEL_ONE_BONE;
+            else if (chain->slot_count == 3)
+                chain->kernel = CHAIN_FLAT_KERNEL_TWO_BONE;
+            else
+                continue;
+
+            ++island->analytic_chain_count;
+        }
+        total += island->analytic_chain_count;
+    VECTOR_END_EACH
+
+    return total;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+chain_flat_find_branches(struct chain_flat_t* flat, uint32_t min_fork_slots)
+{
+    struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    uint32_t chain_count = vector_count(&flat->chains);
+    uint32_t* subtree_slots;
+    uint32_t* subtree_chains;
+    uint32_t chain_idx;
+    ikret_t result = IK_OK;
+
+    vector_clear(&flat->branches);
+    for (chain_idx = 0; chain_idx != chain_count; ++chain_idx)
+        chains[chain_idx].branch = -1;
+    VECTOR_FOR_EACH(&flat->islands, struct chain_flat_island_t, island)
+        island->branch_begin = 0;
+        island->branch_count = 0;
+    VECTOR_END_EACH
+
+    if (min_fork_slots == 0)
+        return IK_OK;
+
+    /* Number of slots and chains in the sub-tree of every chain, including itself */
+    vector_clear(&flat->subtree_sizes);
+    if ((result = vector_resize(&flat->subtree_sizes, chain_count * 2)) != IK_OK)
+        goto find_failed;
+    subtree_slots = (uint32_t*)flat->subtree_sizes.data;
+    subtree_chains = subtree_slots + chain_count;
+    for (chain_idx = 0; chain_idx != chain_count; ++chain_idx)
+    {
+        subtree_slots[chain_idx] = chains[chain_idx].slot_count;
+        subtree_chains[chain_idx] = 1;
+    }
+    chain_idx = chain_count;
+    while (chain_idx-- > 0)
+    {
+        int32_t parent = chains[chain_idx].parent;
+        if (parent >= 0)
+        {
+            subtree_slots[parent] += subtree_slots[chain_idx];
+            subtree_chains[parent] += subtree_chains[chain_idx];
+        }
+    }
+
+    /*
+     * Walk each island in pre-order. The parents of a chain are always
+     * visited first, so a chain is either in the trunk (if it, or one of its
+     * parents, started a branch, it was skipped) or its parent is in the
+     * trunk. Sub-trees which are still too large to be solved as one task
+     * are split again at their tip.
+     */
+    VECTOR_FOR_EACH(&flat->islands, struct chain_flat_island_t, island)
+        uint32_t chain_end = island->chain_begin + island->chain_count;
+        island->branch_begin = vector_count(&flat->branches);
+
+        if (island->slot_count <= min_fork_slots)
+            continue;
+
+        for (chain_idx = island->chain_begin + 1; chain_idx < chain_end; )
+        {
+            uint32_t i;
+            struct chain_flat_branch_t* branch;
+
+            if (subtree_slots[chain_idx] > min_fork_slots && chains[chain_idx].child_count > 0)
+            {
+                ++chain_idx;
+                continue;
+            }
+
+            if ((branch = vector_push_emplace(&flat->branches)) == NULL)
+            {
+                result = IK_RAN_OUT_OF_MEMORY;
+                goto find_failed;
+            }
+            branch->chain_begin = chain_idx;
+            branch->chain_count = subtree_chains[chain_idx];
+            vec3_set_zero(branch->base_target.f);
+            for (i = 0; i != branch->chain_count; ++i)
+                chains[chain_idx + i].branch = (int32_t)(island->branch_begin + island->branch_count);
+            ++island->branch_count;
+
+            chain_idx += branch->chain_count;
+        }
+    VECTOR_END_EACH
+
+    return IK_OK;
+
+    find_failed : chain_flat_find_branches(flat, 0);
+                  IKAPI.log.message("Failed to find branches: ran out of memory");
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_update_distances(struct chain_flat_t* flat)
+{
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    ikreal_t* segment_lengths = chain_flat_data(flat, segment_lengths, ikreal_t);
+    uint32_t slot_idx = vector_count(&flat->nodes);
+
+    while (slot_idx-- > 0)
+        segment_lengths[slot_idx] = nodes[slot_idx]->dist_to_parent;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+gather_rotation_weights(struct chain_flat_t* flat)
+{
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    ikreal_t* rotation_weights = chain_flat_data(flat, rotation_weights, ikreal_t);
+    uint32_t slot_idx = vector_count(&flat->nodes);
+
+    while (slot_idx-- > 0)
+        rotation_weights[slot_idx] = nodes[slot_idx]->rotation_weight;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+calculate_directions(struct chain_flat_t* flat, const ik_quat_t* target_rotations)
+{
+    const struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    ik_vec3_t* directions = chain_flat_data(flat, directions, ik_vec3_t);
+    ik_vec3_t* accumulators = chain_flat_data(flat, accumulators, ik_vec3_t);
+    uint32_t chain_idx = vector_count(&flat->chains);
+
+    /*
+     * The target direction of a chain doesn't depend on the solved
+     * positions: Leaf chains point in the direction of their effector's
+     * target rotation, and all other chains point in the normalized
+     * average direction of their child chains. Compute these once here
+     * instead of during every iteration. Iterating in reverse pre-order
+     * guarantees that child chains are visited before their parents.
+     */
+    memset(accumulators, 0, sizeof(ik_vec3_t) * vector_count(&flat->accumulators));
+    while (chain_idx-- > 0)
+    {
+        const struct chain_flat_chain_t* chain = &chains[chain_idx];
+        if (chain->child_count == 0)
+        {
+            /* TODO This "global direction" could be made configurable if needed */
+            directions[chain_idx] = ik_vec3_static_vec3(0, 0, 1);
+            vec3_rotate(directions[chain_idx].f, target_rotations[chain->effector_index].f);
+        }
+        else
+        {
+            directions[chain_idx] = accumulators[chain_idx];
+            vec3_normalize(directions[chain_idx].f);
+        }
+
+        if (chain->parent >= 0)
+            vec3_add_vec3(accumulators[chain->parent].f, directions[chain_idx].f);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_update_global_pose(struct chain_flat_t* flat)
+{
+    struct ik_node_t** pose_nodes = chain_flat_data(flat, pose_nodes, struct ik_node_t*);
+    const int32_t* parents = chain_flat_data(flat, pose_parents, int32_t);
+    ik_vec3_t* local_positions = chain_flat_data(flat, pose_local_positions, ik_vec3_t);
+    ik_quat_t* local_rotations = chain_flat_data(flat, pose_local_rotations, ik_quat_t);
+    ik_vec3_t* global_positions = chain_flat_data(flat, pose_global_positions, ik_vec3_t);
+    ik_quat_t* global_rotations = chain_flat_data(flat, pose_global_rotations, ik_quat_t);
+    uint8_t* dirty = chain_flat_data(flat, pose_dirty, uint8_t);
+    uint32_t pose_count = vector_count(&flat->pose_nodes);
+    uint32_t pose_idx;
+
+    /*
+     * Pose indices are assigned parents first, so a single forward pass
+     * propagates changes down the tree. The math is the same as in
+     * ik_transform_chain() (TR_L2G), so the results are identical: The base
+     * node of an island is relative to nothing, every other node is relative
+     * to its parent's accumulated rotation and global position.
+     */
+    for (pose_idx = 0; pose_idx != pose_count; ++pose_idx)
+    {
+        const struct ik_node_t* node = pose_nodes[pose_idx];
+        int32_t parent = parents[pose_idx];
+
+        dirty[pose_idx] = (flat->has_global_pose == 0 ||
+                           (parent >= 0 && dirty[parent]) ||
+                           !vec3_equal(node->position.f, local_positions[pose_idx].f) ||
+                           !quat_equal(node->rotation.f, local_rotations[pose_idx].f));
+        if (dirty[pose_idx] == 0)
+            continue;
+
+        local_positions[pose_idx] = node->position;
+        local_rotations[pose_idx] = node->rotation;
+        global_positions[pose_idx] = node->position;
+        global_rotations[pose_idx] = node->rotation;
+        if (parent >= 0)
+        {
+            vec3_rotate(global_positions[pose_idx].f, global_rotations[parent].f);
+            vec3_add_vec3(global_positions[pose_idx].f, global_positions[parent].f);
+            global_rotations[pose_idx] = global_rotations[parent];
+            quat_mul_quat(global_rotations[pose_idx].f, node->rotation.f);
+        }
+    }
+
+    flat->has_global_pose = 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_forward_kinematics(const struct chain_flat_t* flat,
+                              uint32_t pose_begin,
+                              uint32_t pose_end,
+                              const ik_quat_t* local_rotations,
+                              ik_vec3_t* positions,
+                              ik_quat_t* rotations,
+                              int normalize)
+{
+    const int32_t* parents = chain_flat_data(flat, pose_parents, int32_t);
+    const ik_vec3_t* local_positions = chain_flat_data(flat, pose_local_positions, ik_vec3_t);
+    uint32_t pose_idx;
+
+    /* Same math as chain_flat_update_global_pose() */
+    for (pose_idx = pose_begin; pose_idx != pose_end; ++pose_idx)
+    {
+        int32_t parent = parents[pose_idx];
+
+        positions[pose_idx] = local_positions[pose_idx];
+        rotations[pose_idx] = local_rotations[pose_idx];
+        if (parent >= 0)
+        {
+            vec3_rotate(positions[pose_idx].f, rotations[parent].f);
+            vec3_add_vec3(positions[pose_idx].f, positions[parent].f);
+            rotations[pose_idx] = rotations[parent];
+            if (normalize)
+                quat_mul_quat(rotations[pose_idx].f, local_rotations[pose_idx].f);
+            else
+                quat_mul_no_normalize(rotations[pose_idx].f, local_rotations[pose_idx].f);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_load_global_pose(const struct chain_flat_t* flat)
+{
+    struct ik_node_t** pose_nodes = chain_flat_data(flat, pose_nodes, struct ik_node_t*);
+    const ik_vec3_t* global_positions = chain_flat_data(flat, pose_global_positions, ik_vec3_t);
+    uint32_t pose_idx = vector_count(&flat->pose_nodes);
+
+    while (pose_idx-- > 0)
+        pose_nodes[pose_idx]->position = global_positions[pose_idx];
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_transform(struct chain_flat_t* flat, uint8_t flags)
+{
+    ik_transform_nodes(chain_flat_data(flat, pose_nodes, struct ik_node_t*),
+                       chain_flat_data(flat, pose_parents, int32_t),
+                       vector_count(&flat->pose_nodes),
+                       chain_flat_data(flat, pose_accumulators, ikreal_t),
+                       flags);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_gather(struct chain_flat_t* flat, uint8_t solver_flags)
+{
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    const uint32_t* effector_slots = chain_flat_data(flat, effector_slots, uint32_t);
+    ik_vec3_t* positions = chain_flat_data(flat, positions, ik_vec3_t);
+    ik_vec3_t* effector_targets = chain_flat_data(flat, effector_targets, ik_vec3_t);
+    const uint32_t* slot_pose_index = chain_flat_data(flat, slot_pose_index, uint32_t);
+    const ik_vec3_t* global_positions = chain_flat_data(flat, pose_global_positions, ik_vec3_t);
+    uint32_t slot_idx = vector_count(&flat->nodes);
+    uint32_t effector_idx = vector_count(&flat->effector_slots);
+
+    assert(flat->has_global_pose);
+    while (slot_idx-- > 0)
+        positions[slot_idx] = global_positions[slot_pose_index[slot_idx]];
+
+    while (effector_idx-- > 0)
+        effector_targets[effector_idx] = nodes[effector_slots[effector_idx]]->effector->_actual_target;
+
+    if (solver_flags & IK_ENABLE_TARGET_ROTATIONS)
+    {
+        ik_quat_t* effector_target_rotations = chain_flat_data(flat, effector_target_rotations, ik_quat_t);
+
+        effector_idx = vector_count(&flat->effector_slots);
+        while (effector_idx-- > 0)
+            effector_target_rotations[effector_idx] = nodes[effector_slots[effector_idx]]->effector->target_rotation;
+
+        gather_rotation_weights(flat);
+        calculate_directions(flat, effector_target_rotations);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+int
+chain_flat_warm_start(struct chain_flat_t* flat, ikreal_t blend, ikreal_t threshold)
+{
+    const struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    ik_vec3_t* positions = chain_flat_data(flat, positions, ik_vec3_t);
+    ik_vec3_t* input_positions = chain_flat_data(flat, warm_input_positions, ik_vec3_t);
+    const ik_vec3_t* solved_positions = chain_flat_data(flat, warm_solved_positions, ik_vec3_t);
+    uint32_t slot_count = vector_count(&flat->nodes);
+    uint32_t slot_idx;
+    int warm = flat->has_warm_start;
+
+    /* Fall back to a cold start if the input pose jumped */
+    if (warm && threshold > 0)
+    {
+        for (slot_idx = 0; slot_idx != slot_count; ++slot_idx)
+        {
+            ik_vec3_t diff = positions[slot_idx];
+            vec3_sub_vec3(diff.f, input_positions[slot_idx].f);
+            if (vec3_length_squared(diff.f) > threshold * threshold)
+            {
+                warm = 0;
+                break;
+            }
+        }
+    }
+
+    memcpy(input_positions, positions, sizeof(ik_vec3_t) * slot_count);
+    if (warm == 0)
+        return 0;
+
+    for (slot_idx = 0; slot_idx != slot_count; ++slot_idx)
+    {
+        ik_vec3_t* position = &positions[slot_idx];
+        ik_vec3_t towards_solved = solved_positions[slot_idx];
+        vec3_sub_vec3(towards_solved.f, position->f);
+        vec3_mul_scalar(towards_solved.f, blend);
+        vec3_add_vec3(position->f, towards_solved.f);
+    }
+
+    /* The base nodes of islands stay where they are during solving */
+    VECTOR_FOR_EACH(&flat->islands, struct chain_flat_island_t, island)
+        const struct chain_flat_chain_t* base_chain = &chains[island->chain_begin];
+        uint32_t base_slot = base_chain->slot_begin + base_chain->slot_count - 1;
+        positions[base_slot] = input_positions[base_slot];
+    VECTOR_END_EACH
+
+    return warm;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_store_warm_start(struct chain_flat_t* flat)
+{
+    memcpy(flat->warm_solved_positions.data, flat->positions.data,
+           sizeof(ik_vec3_t) * vector_count(&flat->positions));
+    flat->has_warm_start = 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_scatter(const struct chain_flat_t* flat)
+{
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    const ik_vec3_t* positions = chain_flat_data(flat, positions, ik_vec3_t);
+    uint32_t slot_idx = vector_count(&flat->nodes);
+
+    /*
+     * Sub-base nodes occupy more than one slot, but all of those slots hold
+     * the same position after a backwards pass.
+     */
+    while (slot_idx-- > 0)
+        nodes[slot_idx]->position = positions[slot_idx];
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_scatter_local(struct chain_flat_t* flat)
+{
+    struct ik_node_t** pose_nodes = chain_flat_data(flat, pose_nodes, struct ik_node_t*);
+    const uint32_t* pose_slots = chain_flat_data(flat, pose_slots, uint32_t);
+    const int32_t* parents = chain_flat_data(flat, pose_parents, int32_t);
+    const ik_vec3_t* positions = chain_flat_data(flat, positions, ik_vec3_t);
+    ik_vec3_t* local_positions = chain_flat_data(flat, pose_local_positions, ik_vec3_t);
+    ik_vec3_t* global_positions = chain_flat_data(flat, pose_global_positions, ik_vec3_t);
+    const ik_quat_t* global_rotations = chain_flat_data(flat, pose_global_rotations, ik_quat_t);
+    uint8_t* moved = chain_flat_data(flat, pose_dirty, uint8_t);
+    uint32_t pose_count = vector_count(&flat->pose_nodes);
+    uint32_t pose_idx;
+
+    /*
+     * A node's local position changes if the node moved or if its parent
+     * moved. Since rotations aren't touched, the accumulated rotations of the
+     * cached global pose are still valid and the cache stays in sync with the
+     * nodes, so the next solve doesn't have to transform anything.
+     */
+    for (pose_idx = 0; pose_idx != pose_count; ++pose_idx)
+    {
+        const ik_vec3_t* solved = &positions[pose_slots[pose_idx]];
+        int32_t parent = parents[pose_idx];
+        ik_vec3_t local;
+        ik_quat_t inv_rotation;
+
+        moved[pose_idx] = !vec3_equal(solved->f, global_positions[pose_idx].f);
+        if (moved[pose_idx] == 0 && (parent < 0 || moved[parent] == 0))
+            continue;
+
+        global_positions[pose_idx] = *solved;
+        local = *solved;
+        if (parent >= 0)
+        {
+            inv_rotation = global_rotations[parent];
+            quat_conj(inv_rotation.f);
+            vec3_sub_vec3(local.f, global_positions[parent].f);
+            vec3_rotate(local.f, inv_rotation.f);
+        }
+
+        local_positions[pose_idx] = local;
+        pose_nodes[pose_idx]->position = local;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_scatter_pose(struct chain_flat_t* flat,
+                        uint8_t solver_flags,
+                        const ik_vec3_t* positions,
+                        const ik_quat_t* local_rotations)
+{
+    struct ik_node_t** pose_nodes = chain_flat_data(flat, pose_nodes, struct ik_node_t*);
+    const uint32_t* pose_slots = chain_flat_data(flat, pose_slots, uint32_t);
+    ik_vec3_t* slot_positions = chain_flat_data(flat, positions, ik_vec3_t);
+    uint32_t pose_count = vector_count(&flat->pose_nodes);
+    uint32_t pose_idx;
+
+    if (solver_flags & IK_ENABLE_JOINT_ROTATIONS)
+    {
+        for (pose_idx = 0; pose_idx != pose_count; ++pose_idx)
+            pose_nodes[pose_idx]->rotation = local_rotations[pose_idx];
+    }
+    else
+    {
+        for (pose_idx = 0; pose_idx != pose_count; ++pose_idx)
+            slot_positions[pose_slots[pose_idx]] = positions[pose_idx];
+        chain_flat_scatter_local(flat);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_gather_array(struct chain_flat_t* flat,
+                        uint8_t solver_flags,
+                        const ik_vec3_t* positions,
+                        const ik_vec3_t* targets,
+                        const ik_quat_t* target_rotations)
+{
+    const uint32_t* slot_pose_index = chain_flat_data(flat, slot_pose_index, uint32_t);
+    ik_vec3_t* flat_positions = chain_flat_data(flat, positions, ik_vec3_t);
+    uint32_t slot_idx = vector_count(&flat->nodes);
+
+    while (slot_idx-- > 0)
+        flat_positions[slot_idx] = positions[slot_pose_index[slot_idx]];
+
+    memcpy(flat->effector_targets.data, targets,
+           sizeof(ik_vec3_t) * vector_count(&flat->effector_targets));
+
+    if (solver_flags & IK_ENABLE_TARGET_ROTATIONS)
+    {
+        gather_rotation_weights(flat);
+        calculate_directions(flat, target_rotations);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void
+chain_flat_scatter_array(const struct chain_flat_t* flat, ik_vec3_t* positions)
+{
+    const uint32_t* slot_pose_index = chain_flat_data(flat, slot_pose_index, uint32_t);
+    const ik_vec3_t* flat_positions = chain_flat_data(flat, positions, ik_vec3_t);
+    uint32_t slot_idx = vector_count(&flat->nodes);
+
+    while (slot_idx-- > 0)
+        positions[slot_pose_index[slot_idx]] = flat_positions[slot_idx];
+}
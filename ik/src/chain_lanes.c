@@ -0,0 +1,47 @@
+#include "ik/chain_lanes.h"
+#include "ik/chain_flat.h"
+#include <string.h>
+#include <math.h>
+
+#define LANES_REAL   ikreal_t
+#define LANES_WIDTH  CHAIN_LANES_WIDTH
+#define LANES_VEC3   struct chain_lanes_vec3_t
+#define LANES_SQRT   sqrt
+#define LANES_FN(fn) fn
+#include "ik/chain_lanes_scalar_template.h"
+#undef LANES_REAL
+#undef LANES_WIDTH
+#undef LANES_VEC3
+#undef LANES_SQRT
+#undef LANES_FN
+
+#define LANES_REAL   float
+#define LANES_WIDTH  CHAIN_LANES_FLOAT_WIDTH
+#define LANES_VEC3   struct chain_lanes_vec3f_t
+#define LANES_SQRT   sqrtf
+#define LANES_FN(fn) fn##_float
+#include "ik/chain_lanes_scalar_template.h"
+#undef LANES_REAL
+#undef LANES_WIDTH
+#undef LANES_VEC3
+#undef LANES_SQRT
+#undef LANES_FN
+
+static const struct chain_lanes_kernel_t chain_lanes_kernel_scalar = {
+    "scalar",
+    solve_forwards_scalar,
+    solve_backwards_scalar,
+    solve_forwards_scalar_float,
+    solve_backwards_scalar_float
+};
+
+/* ------------------------------------------------------------------------- */
+const struct chain_lanes_kernel_t*
+chain_lanes_kernel(void)
+{
+#if defined(IK_SIMD_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        return &chain_lanes_kernel_avx2;
+#endif
+    return &chain_lanes_kernel_scalar;
+}
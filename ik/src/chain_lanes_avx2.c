@@ -0,0 +1,74 @@
+#include "ik/chain_lanes.h"
+#include "ik/chain_flat.h"
+#include <immintrin.h>
+#include <string.h>
+
+/*
+ * This file is compiled with -mavx2. Nothing in here may be called unless
+ * chain_lanes_kernel() determined that the CPU supports AVX2.
+ */
+
+#define lane_t           __m256
+#define lane_load        _mm256_loadu_ps
+#define lane_store       _mm256_storeu_ps
+#define lane_set1        _mm256_set1_ps
+#define lane_add         _mm256_add_ps
+#define lane_sub         _mm256_sub_ps
+#define lane_mul         _mm256_mul_ps
+#define lane_div         _mm256_div_ps
+#define lane_sqrt        _mm256_sqrt_ps
+#define lane_not_zero(a) _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_NEQ_OQ)
+#define lane_select      _mm256_blendv_ps
+
+/* Float lanes */
+#define LANES_REAL   float
+#define LANES_WIDTH  CHAIN_LANES_FLOAT_WIDTH
+#define LANES_VEC3   struct chain_lanes_vec3f_t
+#define LANES_FN(fn) fn##_float
+#include "ik/chain_lanes_avx2_template.h"
+#undef LANES_REAL
+#undef LANES_WIDTH
+#undef LANES_VEC3
+#undef LANES_FN
+
+/* ikreal_t lanes. With float precision, the above intrinsics apply as well */
+#if defined(IK_PRECISION_DOUBLE)
+#   undef lane_t
+#   undef lane_load
+#   undef lane_store
+#   undef lane_set1
+#   undef lane_add
+#   undef lane_sub
+#   undef lane_mul
+#   undef lane_div
+#   undef lane_sqrt
+#   undef lane_not_zero
+#   undef lane_select
+#   define lane_t           __m256d
+#   define lane_load        _mm256_loadu_pd
+#   define lane_store       _mm256_storeu_pd
+#   define lane_set1        _mm256_set1_pd
+#   define lane_add         _mm256_add_pd
+#   define lane_sub         _mm256_sub_pd
+#   define lane_mul         _mm256_mul_pd
+#   define lane_div         _mm256_div_pd
+#   define lane_sqrt        _mm256_sqrt_pd
+#   define lane_not_zero(a) _mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_NEQ_OQ)
+#   define lane_select      _mm256_blendv_pd
+#elif !defined(IK_PRECISION_FLOAT)
+#   error The AVX2 kernel only supports float and double precision
+#endif
+
+#define LANES_REAL   ikreal_t
+#define LANES_WIDTH  CHAIN_LANES_WIDTH
+#define LANES_VEC3   struct chain_lanes_vec3_t
+#define LANES_FN(fn) fn
+#include "ik/chain_lanes_avx2_template.h"
+
+const struct chain_lanes_kernel_t chain_lanes_kernel_avx2 = {
+    "avx2",
+    solve_forwards_avx2,
+    solve_backwards_avx2,
+    solve_forwards_avx2_float,
+    solve_backwards_avx2_float
+};
@@ -12,9 +12,13 @@
 #include "ik/solver_ONE_BONE.h"
 #include "ik/solver_TWO_BONE.h"
 #include "ik/solver_FABRIK.h"
+#include "ik/solver_HYBRID.h"
+#include "ik/solver_DLS.h"
+#include "ik/solver_CCD.h"
 #include "ik/solver_MSS.h"
 #include "ik/tests_static.h"
 #include "ik/vec3_static.h"
+#include <assert.h>
 #include <stddef.h>
 #include <stdio.h>
 
@@ -30,13 +34,22 @@ log_stdout_callback(const char* msg)
 /* ------------------------------------------------------------------------- */
 static const struct ik_callback_interface_t dummy_callbacks = {
     log_stdout_callback,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
     NULL
 };
 static void
 ik_implement_callbacks(const struct ik_callback_interface_t* callbacks)
 {
     if (callbacks)
+    {
+        /* Allocator functions only make sense together */
+        assert((callbacks->on_malloc != NULL) == (callbacks->on_free != NULL));
+        assert((callbacks->on_malloc != NULL) == (callbacks->on_realloc != NULL));
         IKAPI.internal.callbacks = callbacks;
+    }
     else
         IKAPI.internal.callbacks = &dummy_callbacks;
 }
@@ -56,11 +69,16 @@ ik_init(void)
 static uintptr_t
 ik_deinit(void)
 {
+    uintptr_t leaks;
+
     if (--g_init_counter != 0)
         return 0;
 
+    /* Pool blocks have to be returned to the allocator they came from */
+    leaks = pool_deinit();
+    leaks += ik_memory_deinit();
     ik_implement_callbacks(NULL);
-    return ik_memory_deinit();
+    return leaks;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -1,6 +1,7 @@
 #include "ik/memory.h"
 #include "ik/bstv.h"
 #include "ik/backtrace.h"
+#include "ik/ik.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -8,9 +9,41 @@
 
 #define BACKTRACE_OMIT_COUNT 2
 
+/* ------------------------------------------------------------------------- */
+void*
+ik_malloc(uintptr_t size)
+{
+    const struct ik_callback_interface_t* callbacks = IKAPI.internal.callbacks;
+    if (callbacks->on_malloc != NULL)
+        return callbacks->on_malloc(callbacks->allocator_context, size);
+    return malloc(size);
+}
+
+/* ------------------------------------------------------------------------- */
+void*
+ik_realloc(void* ptr, uintptr_t size)
+{
+    const struct ik_callback_interface_t* callbacks = IKAPI.internal.callbacks;
+    if (callbacks->on_realloc != NULL)
+        return callbacks->on_realloc(callbacks->allocator_context, ptr, size);
+    return realloc(ptr, size);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_free(void* ptr)
+{
+    const struct ik_callback_interface_t* callbacks = IKAPI.internal.callbacks;
+    if (callbacks->on_free != NULL)
+        callbacks->on_free(callbacks->allocator_context, ptr);
+    else
+        free(ptr);
+}
+
 #ifdef IK_MEMORY_DEBUGGING
 static uintptr_t g_allocations = 0;
 static uintptr_t d_deg_allocations = 0;
+static uintptr_t g_reallocations = 0;
 static uintptr_t g_ignore_bstv_malloc = 0;
 static struct bstv_t report;
 
@@ -30,6 +63,7 @@ ik_memory_init(void)
 {
     g_allocations = 0;
     d_deg_allocations = 0;
+    g_reallocations = 0;
 
     /*
      * Init bst vector of report objects and force it to allocate by adding
@@ -52,8 +86,11 @@ malloc_wrapper(intptr_t size)
     /* breaking from this will clean up and return NULL */
     for (;;)
     {
-        /* allocate */
-        p = malloc(size);
+        /*
+         * Allocations of the report itself always go to libc, since the
+         * report outlives any custom allocator.
+         */
+        p = g_ignore_bstv_malloc ? malloc(size) : ik_malloc(size);
         if (p)
             ++g_allocations;
         else
@@ -124,7 +161,7 @@ malloc_wrapper(intptr_t size)
     /* failure */
     if (p)
     {
-        free(p);
+        ik_free(p);
         --g_allocations;
     }
 
@@ -185,12 +222,80 @@ free_wrapper(void* ptr)
     if (ptr)
     {
         ++d_deg_allocations;
-        free(ptr);
+        if (g_ignore_bstv_malloc)
+            free(ptr);
+        else
+            ik_free(ptr);
     }
     else
         fprintf(stderr, "Warning: free(NULL)\n");
 }
 
+/* ------------------------------------------------------------------------- */
+void*
+realloc_wrapper(void* ptr, intptr_t size)
+{
+    void* p;
+    report_info_t* info;
+
+    if (ptr == NULL)
+        return malloc_wrapper(size);
+
+    /* The report's own buffers were allocated with libc and aren't tracked */
+    if (g_ignore_bstv_malloc)
+        return realloc(ptr, size);
+
+    info = (report_info_t*)bstv_find(&report, (uintptr_t)ptr);
+    if (info == NULL)
+    {
+        fprintf(stderr, "[memory] ERROR: realloc() on something that was never allocated\n");
+        return NULL;
+    }
+
+    if ((p = ik_realloc(ptr, size)) == NULL)
+        return NULL;
+    ++g_reallocations;
+
+    /*
+     * Move the report entry over to the new location. Call to bstv may
+     * allocate memory, so set flag to ignore the call to realloc().
+     */
+    info->location = (uintptr_t)p;
+    info->size = size;
+    if (p != ptr)
+    {
+        g_ignore_bstv_malloc = 1;
+        bstv_erase(&report, (uintptr_t)ptr);
+        if (bstv_insert(&report, (uintptr_t)p, info) == 1)
+            fprintf(stderr, "[memory] WARNING: Hash collision occurred when re-inserting\n"
+                "into memory report bstv after realloc()\n");
+        g_ignore_bstv_malloc = 0;
+    }
+
+    return p;
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_memory_allocation_count(void)
+{
+    return g_allocations;
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_memory_reallocation_count(void)
+{
+    return g_reallocations;
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_memory_deallocation_count(void)
+{
+    return d_deg_allocations;
+}
+
 /* ------------------------------------------------------------------------- */
 uintptr_t
 ik_memory_deinit(void)
@@ -0,0 +1,172 @@
+#include "ik/pool.h"
+#include "ik/memory.h"
+#include <assert.h>
+
+#if defined(IK_THREADS)
+#   include <pthread.h>
+#endif
+
+#define POOL_ALIGNMENT         16
+#define POOL_SIZE_CLASS        64  /* object sizes (including header) are rounded up to this */
+#define POOL_SIZE_CLASS_COUNT  8
+#define POOL_OBJECTS_PER_BLOCK 128
+
+struct pool_t;
+
+/* Prefixed to every object. Padded so the object itself stays aligned */
+union pool_header_t
+{
+    struct pool_t* pool; /* NULL if the object was allocated with MALLOC() */
+    char align[POOL_ALIGNMENT];
+};
+
+union pool_block_t
+{
+    union pool_block_t* next;
+    char align[POOL_ALIGNMENT];
+};
+
+struct pool_t
+{
+    union pool_block_t* blocks;
+    union pool_header_t* free_list; /* next pointer is stored in the object after the header */
+    uintptr_t live_count;
+};
+
+static struct pool_t g_pools[POOL_SIZE_CLASS_COUNT];
+#if defined(IK_THREADS)
+static pthread_mutex_t g_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+#   define POOL_LOCK()   pthread_mutex_lock(&g_pool_mutex)
+#   define POOL_UNLOCK() pthread_mutex_unlock(&g_pool_mutex)
+#else
+#   define POOL_LOCK()
+#   define POOL_UNLOCK()
+#endif
+
+#define FREE_LIST_NEXT(header) (*(union pool_header_t**)((header) + 1))
+
+/* ------------------------------------------------------------------------- */
+static int
+pool_grow(struct pool_t* pool, uintptr_t object_size)
+{
+    uintptr_t i;
+    char* objects;
+    union pool_block_t* block = MALLOC(sizeof(union pool_block_t) +
+                                       object_size * POOL_OBJECTS_PER_BLOCK);
+    if (block == NULL)
+        return 0;
+
+    block->next = pool->blocks;
+    pool->blocks = block;
+
+    /* Push objects in reverse so they are handed out in address order */
+    objects = (char*)(block + 1);
+    for (i = POOL_OBJECTS_PER_BLOCK; i-- > 0;)
+    {
+        union pool_header_t* header = (union pool_header_t*)(objects + i * object_size);
+        header->pool = pool;
+        FREE_LIST_NEXT(header) = pool->free_list;
+        pool->free_list = header;
+    }
+
+    return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void*
+pool_malloc(uintptr_t size)
+{
+    union pool_header_t* header;
+    struct pool_t* pool;
+    uintptr_t size_class = (size + sizeof(union pool_header_t) + POOL_SIZE_CLASS - 1) / POOL_SIZE_CLASS;
+
+    if (size_class > POOL_SIZE_CLASS_COUNT)
+    {
+        header = MALLOC(sizeof(union pool_header_t) + size);
+        if (header == NULL)
+            return NULL;
+        header->pool = NULL;
+        return header + 1;
+    }
+
+    pool = &g_pools[size_class - 1];
+
+    POOL_LOCK();
+    if (pool->free_list == NULL && !pool_grow(pool, size_class * POOL_SIZE_CLASS))
+    {
+        POOL_UNLOCK();
+        return NULL;
+    }
+    header = pool->free_list;
+    pool->free_list = FREE_LIST_NEXT(header);
+    ++pool->live_count;
+    POOL_UNLOCK();
+
+    return header + 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+pool_free(void* ptr)
+{
+    union pool_header_t* header = (union pool_header_t*)ptr - 1;
+    struct pool_t* pool = header->pool;
+
+    if (pool == NULL)
+    {
+        FREE(header);
+        return;
+    }
+
+    POOL_LOCK();
+    assert(pool->live_count > 0);
+    FREE_LIST_NEXT(header) = pool->free_list;
+    pool->free_list = header;
+    --pool->live_count;
+    POOL_UNLOCK();
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+pool_live_objects(void)
+{
+    int i;
+    uintptr_t count = 0;
+
+    POOL_LOCK();
+    for (i = 0; i != POOL_SIZE_CLASS_COUNT; ++i)
+        count += g_pools[i].live_count;
+    POOL_UNLOCK();
+
+    return count;
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+pool_deinit(void)
+{
+    int i;
+    uintptr_t leaks = 0;
+
+    POOL_LOCK();
+    for (i = 0; i != POOL_SIZE_CLASS_COUNT; ++i)
+    {
+        struct pool_t* pool = &g_pools[i];
+        if (pool->live_count > 0)
+        {
+            leaks += pool->live_count;
+            continue;
+        }
+
+        while (pool->blocks)
+        {
+            union pool_block_t* next = pool->blocks->next;
+            FREE(pool->blocks);
+            pool->blocks = next;
+        }
+        pool->free_list = NULL;
+    }
+    POOL_UNLOCK();
+
+    return leaks;
+}
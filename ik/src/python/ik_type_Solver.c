@@ -185,6 +185,58 @@ Solver_setenable_joint_rotations(ik_Solver* self, PyObject* value, void* closure
     return 0;
 }
 
+/* ------------------------------------------------------------------------- */
+static PyObject*
+Solver_getenable_warm_start(ik_Solver* self, void* closure)
+{
+    (void)closure;
+    if (self->solver->flags & IK_ENABLE_WARM_START)
+        Py_RETURN_TRUE;
+    Py_RETURN_FALSE;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+Solver_setenable_warm_start(ik_Solver* self, PyObject* value, void* closure)
+{
+    (void)closure;
+    if (!PyBool_Check(value))
+    {
+        PyErr_SetString(PyExc_TypeError, "Expected a bool");
+        return -1;
+    }
+    self->solver->flags &= ~IK_ENABLE_WARM_START;
+    if (PyObject_IsTrue(value))
+        self->solver->flags |= IK_ENABLE_WARM_START;
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static PyObject*
+Solver_getenable_fast_math(ik_Solver* self, void* closure)
+{
+    (void)closure;
+    if (self->solver->flags & IK_ENABLE_FAST_MATH)
+        Py_RETURN_TRUE;
+    Py_RETURN_FALSE;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+Solver_setenable_fast_math(ik_Solver* self, PyObject* value, void* closure)
+{
+    (void)closure;
+    if (!PyBool_Check(value))
+    {
+        PyErr_SetString(PyExc_TypeError, "Expected a bool");
+        return -1;
+    }
+    self->solver->flags &= ~IK_ENABLE_FAST_MATH;
+    if (PyObject_IsTrue(value))
+        self->solver->flags |= IK_ENABLE_FAST_MATH;
+    return 0;
+}
+
 /* ------------------------------------------------------------------------- */
 static PyObject*
 Solver_gettree(ik_Solver* self, void* closure)
@@ -230,6 +282,8 @@ static PyGetSetDef Solver_getsetters[] = {
     {"enable_constraints",      (getter)Solver_getenable_constraints,      (setter)Solver_setenable_constraints, "Enable or disable constraint support"},
     {"enable_target_rotations", (getter)Solver_getenable_target_rotations, (setter)Solver_setenable_target_rotations, "Enable or disable target rotation support"},
     {"enable_joint_rotations",  (getter)Solver_getenable_joint_rotations,  (setter)Solver_setenable_joint_rotations, "Enable or disable joint rotation support"},
+    {"enable_warm_start",       (getter)Solver_getenable_warm_start,       (setter)Solver_setenable_warm_start, "Enable or disable starting from the previous solution"},
+    {"enable_fast_math",        (getter)Solver_getenable_fast_math,        (setter)Solver_setenable_fast_math, "Enable or disable approximate square roots and trig-free rotations"},
     {"tree",                    (getter)Solver_gettree,                    (setter)Solver_settree, "The solver's tree"},
     {NULL}
 };
@@ -1,5 +1,6 @@
 #include "ik/quat_static.h"
 #include "ik/vec3_static.h"
+#include "ik/math_inline.h"
 #include <math.h>
 #include <string.h>
 
@@ -27,10 +28,7 @@ ik_quat_static_set_identity(ikreal_t q[4])
 void
 ik_quat_static_set(ikreal_t q[4], const ikreal_t src[4])
 {
-    q[0] = src[0];
-    q[1] = src[1];
-    q[2] = src[2];
-    q[3] = src[3];
+    quat_set(q, src);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -47,16 +45,14 @@ ik_quat_static_add_quat(ikreal_t q1[4], const ikreal_t q2[4])
 ikreal_t
 ik_quat_static_mag(const ikreal_t q[4])
 {
-    return sqrt(q[3]*q[3] + q[2]*q[2] + q[1]*q[1] + q[0]*q[0]);
+    return quat_mag(q);
 }
 
 /* ------------------------------------------------------------------------- */
 void
 ik_quat_static_conj(ikreal_t q[4])
 {
-    q[0] = -q[0];
-    q[1] = -q[1];
-    q[2] = -q[2];
+    quat_conj(q);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -74,36 +70,17 @@ ik_quat_static_invert_sign(ikreal_t q[4])
 void
 ik_quat_static_normalize(ikreal_t q[4])
 {
-    ikreal_t mag = ik_quat_static_mag(q);
-    if (mag != 0.0)
-        mag = 1.0 / mag;
-    q[0] *= mag;
-    q[1] *= mag;
-    q[2] *= mag;
-    q[3] *= mag;
+    quat_normalize(q);
 }
 
 /* ------------------------------------------------------------------------- */
-static void
-mul_ik_quat_static_no_normalize(ikreal_t q1[4], const ikreal_t q2[4])
-{
-    ik_vec3_t v1;
-    ik_vec3_t v2;
-    ik_vec3_static_set(v1.f, q1);
-    ik_vec3_static_set(v2.f, q2);
-
-    ik_vec3_static_mul_scalar(v1.f, q2[3]);
-    ik_vec3_static_mul_scalar(v2.f, q1[3]);
-    q1[3] = q1[3]*q2[3] - ik_vec3_static_dot(q1, q2);
-    ik_vec3_static_cross(q1, q2);
-    ik_vec3_static_add_vec3(q1, v1.f);
-    ik_vec3_static_add_vec3(q1, v2.f);
-}
 void
 ik_quat_static_mul_quat(ikreal_t q1[4], const ikreal_t q2[4])
 {
-    mul_ik_quat_static_no_normalize(q1, q2);
-    ik_quat_static_normalize(q1);
+    /* q2 may overlap with q1, see vec3_static.c */
+    ik_quat_t copy;
+    quat_set(copy.f, q2);
+    quat_mul_quat(q1, copy.f);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -136,10 +113,7 @@ ik_quat_static_div_scalar(ikreal_t q[4], ikreal_t scalar)
 ikreal_t
 ik_quat_static_dot(const ikreal_t q1[4], const ikreal_t q2[4])
 {
-    return q1[0] * q2[0] +
-           q1[1] * q2[1] +
-           q1[2] * q2[2] +
-           q1[3] * q2[3];
+    return quat_dot(q1, q2);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -0,0 +1,415 @@
+#include "ik/solver_CCD.h"
+#include "ik/chain_flat.h"
+#include "ik/ik.h"
+#include "ik/math_inline.h"
+#include "ik/quat_static.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+/*
+ * Cyclic coordinate descent.
+ *
+ * Every iteration visits the joints of an island from the tips towards the
+ * base and rotates each joint so the effectors below it point at their
+ * targets as seen from the joint. If a joint moves several effectors (a
+ * sub-base), the rotations for the individual effectors are averaged.
+ *
+ * Rotating a joint doesn't move its ancestors, so the global transforms
+ * computed at the beginning of the iteration stay valid for every joint
+ * that hasn't been visited yet. Only the effector positions are updated as
+ * the joints are rotated. This means an iteration costs one pass over the
+ * joints plus one pass to recompute the global pose, and the result is a
+ * set of local rotations. Unlike FABRIK, no positions have to be converted
+ * to rotations after solving.
+ */
+
+struct ccd_solver_t
+{
+    IK_SOLVER_HEAD
+
+    /*
+     * The effectors moved by the joint with pose index p, i.e. the effectors
+     * of which it is an ancestor, are listed in entries joint_entries[p] to
+     * joint_entries[p+1].
+     */
+    struct vector_t joint_entries;    /* uint32_t, per pose + 1 */
+    struct vector_t entry_effectors;  /* uint32_t, per entry. Effector index */
+    struct vector_t effector_poses;   /* uint32_t, per effector. Pose index of the effector's node */
+    struct vector_t effector_positions; /* ik_vec3_t, per effector, global */
+
+    /* Per pose index */
+    struct vector_t positions;        /* ik_vec3_t, global */
+    struct vector_t rotations;        /* ik_quat_t, global */
+    struct vector_t local_rotations;  /* ik_quat_t */
+};
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_solver_CCD_type_size(void)
+{
+    return sizeof(struct ccd_solver_t);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_CCD_construct(struct ik_solver_t* solver)
+{
+    struct ccd_solver_t* ccd = (struct ccd_solver_t*)solver;
+
+    solver->tolerance = 1e-3;
+    solver->stall_ratio = 1e-3;
+
+    vector_construct(&ccd->joint_entries, sizeof(uint32_t));
+    vector_construct(&ccd->entry_effectors, sizeof(uint32_t));
+    vector_construct(&ccd->effector_poses, sizeof(uint32_t));
+    vector_construct(&ccd->effector_positions, sizeof(ik_vec3_t));
+    vector_construct(&ccd->positions, sizeof(ik_vec3_t));
+    vector_construct(&ccd->rotations, sizeof(ik_quat_t));
+    vector_construct(&ccd->local_rotations, sizeof(ik_quat_t));
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_CCD_destruct(struct ik_solver_t* solver)
+{
+    struct ccd_solver_t* ccd = (struct ccd_solver_t*)solver;
+
+    vector_clear_free(&ccd->local_rotations);
+    vector_clear_free(&ccd->rotations);
+    vector_clear_free(&ccd->positions);
+    vector_clear_free(&ccd->effector_positions);
+    vector_clear_free(&ccd->effector_poses);
+    vector_clear_free(&ccd->entry_effectors);
+    vector_clear_free(&ccd->joint_entries);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_CCD_rebuild(struct ik_solver_t* solver)
+{
+    ikret_t result;
+    struct ccd_solver_t* ccd = (struct ccd_solver_t*)solver;
+    struct chain_flat_t* flat = solver->chain_flat;
+    const uint32_t* effector_slots = chain_flat_data(flat, effector_slots, uint32_t);
+    const uint32_t* slot_pose_index = chain_flat_data(flat, slot_pose_index, uint32_t);
+    const int32_t* parents = chain_flat_data(flat, pose_parents, int32_t);
+    uint32_t effector_count = vector_count(&flat->effector_slots);
+    uint32_t pose_count = vector_count(&flat->pose_nodes);
+    uint32_t* joint_entries;
+    uint32_t* effector_poses;
+    uint32_t entry_count = 0;
+    uint32_t i;
+
+    if ((result = vector_resize(&ccd->joint_entries, pose_count + 1)) != IK_OK) return result;
+    if ((result = vector_resize(&ccd->effector_poses, effector_count)) != IK_OK) return result;
+    if ((result = vector_resize(&ccd->effector_positions, effector_count)) != IK_OK) return result;
+    if ((result = vector_resize(&ccd->positions, pose_count)) != IK_OK) return result;
+    if ((result = vector_resize(&ccd->rotations, pose_count)) != IK_OK) return result;
+    if ((result = vector_resize(&ccd->local_rotations, pose_count)) != IK_OK) return result;
+
+    /* Count the effectors below every joint, then turn the counts into offsets */
+    joint_entries = (uint32_t*)ccd->joint_entries.data;
+    effector_poses = (uint32_t*)ccd->effector_poses.data;
+    memset(joint_entries, 0, sizeof(uint32_t) * (pose_count + 1));
+    for (i = 0; i != effector_count; ++i)
+    {
+        int32_t joint;
+        effector_poses[i] = slot_pose_index[effector_slots[i]];
+        for (joint = parents[effector_poses[i]]; joint >= 0; joint = parents[joint])
+            joint_entries[joint]++;
+    }
+    for (i = 0; i != pose_count + 1; ++i)
+    {
+        uint32_t count = joint_entries[i];
+        joint_entries[i] = entry_count;
+        entry_count += count;
+    }
+
+    if ((result = vector_resize(&ccd->entry_effectors, entry_count)) != IK_OK) return result;
+
+    /* joint_entries[p] is used as the insertion point and ends up at the offset of p+1 */
+    for (i = 0; i != effector_count; ++i)
+    {
+        int32_t joint;
+        for (joint = parents[effector_poses[i]]; joint >= 0; joint = parents[joint])
+            ((uint32_t*)ccd->entry_effectors.data)[joint_entries[joint]++] = i;
+    }
+    i = pose_count;
+    while (i-- > 0)
+        joint_entries[i + 1] = joint_entries[i];
+    joint_entries[0] = 0;
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Recomputes the global pose of an island from its local transforms. The
+ * global rotations are only scratch space and are recomputed from the
+ * (normalized) local rotations every iteration, so they aren't normalized.
+ */
+static void
+update_island_pose(struct ccd_solver_t* ccd, const struct chain_flat_island_t* island)
+{
+    chain_flat_forward_kinematics(ccd->chain_flat,
+                                  island->pose_begin,
+                                  island->pose_end,
+                                  (const ik_quat_t*)ccd->local_rotations.data,
+                                  (ik_vec3_t*)ccd->positions.data,
+                                  (ik_quat_t*)ccd->rotations.data,
+                                  0);
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Copies the effector positions of the island out of the global pose and
+ * sums up their squared distances to the targets. Returns non-zero if all
+ * effectors are within tolerance.
+ */
+static int
+gather_effectors(struct ccd_solver_t* ccd,
+                 const struct chain_flat_island_t* flat_island,
+                 ikreal_t* error)
+{
+    const struct chain_flat_t* flat = ccd->chain_flat;
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    const uint32_t* effector_slots = chain_flat_data(flat, effector_slots, uint32_t);
+    const ik_vec3_t* targets = chain_flat_data(flat, effector_targets, ik_vec3_t);
+    const uint32_t* effector_poses = (const uint32_t*)ccd->effector_poses.data;
+    const ik_vec3_t* positions = (const ik_vec3_t*)ccd->positions.data;
+    ik_vec3_t* effector_positions = (ik_vec3_t*)ccd->effector_positions.data;
+    uint32_t effector_end = flat_island->effector_begin + flat_island->effector_count;
+    uint32_t effector_idx;
+    int all_in_range = 1;
+
+    *error = 0;
+    for (effector_idx = flat_island->effector_begin; effector_idx != effector_end; ++effector_idx)
+    {
+        const struct ik_effector_t* effector = nodes[effector_slots[effector_idx]]->effector;
+        ikreal_t tolerance = effector->tolerance > 0 ? effector->tolerance : ccd->tolerance;
+        ik_vec3_t diff = targets[effector_idx];
+        ikreal_t distance_squared;
+
+        effector_positions[effector_idx] = positions[effector_poses[effector_idx]];
+        vec3_sub_vec3(diff.f, effector_positions[effector_idx].f);
+        distance_squared = vec3_length_squared(diff.f);
+        *error += distance_squared;
+        if (distance_squared > tolerance * tolerance)
+            all_in_range = 0;
+    }
+
+    return all_in_range;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Shortest rotation turning the direction v1 onto the direction v2 */
+static void
+rotation_between(ikreal_t* q, const ikreal_t* v1, const ikreal_t* v2, int fast_math)
+{
+    ikreal_t length_product_squared;
+    ikreal_t magnitude_squared;
+
+    if (fast_math)
+    {
+        quat_angle_fast(q, v1, v2);
+        return;
+    }
+
+    /* See quat_angle_fast(), but with a precise normalization */
+    length_product_squared = vec3_length_squared(v1) * vec3_length_squared(v2);
+    vec3_set(q, v1);
+    vec3_cross(q, v2);
+    q[3] = sqrt(length_product_squared) + vec3_dot(v1, v2);
+    magnitude_squared = quat_dot(q, q);
+    if (magnitude_squared > length_product_squared * IK_EPSILON)
+        quat_normalize(q);
+    else
+        quat_angle_fast(q, v1, v2);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Visits every joint of the island once, from the tips towards the base */
+static void
+iterate_island(struct ccd_solver_t* ccd,
+               const struct chain_flat_island_t* flat_island,
+               int fast_math)
+{
+    const int32_t* parents = chain_flat_data(ccd->chain_flat, pose_parents, int32_t);
+    const ik_vec3_t* targets = chain_flat_data(ccd->chain_flat, effector_targets, ik_vec3_t);
+    const uint32_t* joint_entries = (const uint32_t*)ccd->joint_entries.data;
+    const uint32_t* entry_effectors = (const uint32_t*)ccd->entry_effectors.data;
+    const ik_vec3_t* positions = (const ik_vec3_t*)ccd->positions.data;
+    const ik_quat_t* rotations = (const ik_quat_t*)ccd->rotations.data;
+    ik_quat_t* local_rotations = (ik_quat_t*)ccd->local_rotations.data;
+    ik_vec3_t* effector_positions = (ik_vec3_t*)ccd->effector_positions.data;
+    uint32_t pose_idx = flat_island->pose_end;
+
+    /* Pose indices list parents first, so iterating backwards visits children first */
+    while (pose_idx-- > flat_island->pose_begin)
+    {
+        uint32_t entry_begin = joint_entries[pose_idx];
+        uint32_t entry_end = joint_entries[pose_idx + 1];
+        const ik_vec3_t* joint = &positions[pose_idx];
+        ik_quat_t rotation;
+        uint32_t entry;
+        int32_t parent;
+
+        /* Not an ancestor of any effector */
+        if (entry_begin == entry_end)
+            continue;
+
+        if (entry_end - entry_begin == 1)
+        {
+            /*
+             * The common case of a joint moving only one effector. The
+             * effector ends up on the line towards the target, so it isn't
+             * rotated. The rotation doesn't have to be normalized either,
+             * because the local rotation is normalized in the end anyway.
+             */
+            uint32_t effector_idx = entry_effectors[entry_begin];
+            ik_vec3_t* effector_position = &effector_positions[effector_idx];
+            ik_vec3_t to_effector = *effector_position;
+            ik_vec3_t to_target = targets[effector_idx];
+            ikreal_t effector_distance_squared, target_distance_squared;
+
+            vec3_sub_vec3(to_effector.f, joint->f);
+            vec3_sub_vec3(to_target.f, joint->f);
+            effector_distance_squared = vec3_length_squared(to_effector.f);
+            target_distance_squared = vec3_length_squared(to_target.f);
+            if (effector_distance_squared == 0.0 || target_distance_squared == 0.0)
+                continue;
+
+            vec3_set(rotation.f, to_effector.f);
+            vec3_cross(rotation.f, to_target.f);
+            rotation.w = sqrt(effector_distance_squared * target_distance_squared) + vec3_dot(to_effector.f, to_target.f);
+            if (quat_dot(rotation.f, rotation.f) <= effector_distance_squared * target_distance_squared * IK_EPSILON)
+                quat_angle_fast(rotation.f, to_effector.f, to_target.f);
+
+            vec3_mul_scalar(to_target.f, sqrt(effector_distance_squared / target_distance_squared));
+            vec3_add_vec3(to_target.f, joint->f);
+            *effector_position = to_target;
+        }
+        else
+        {
+            /*
+             * Averaging quaternions taken from here
+             * http://wiki.unity3d.com/index.php/Averaging_Quaternions_and_Vectors
+             */
+            ik_quat_t effector_rotation;
+            rotation.x = rotation.y = rotation.z = rotation.w = 0.0;
+            for (entry = entry_begin; entry != entry_end; ++entry)
+            {
+                uint32_t effector_idx = entry_effectors[entry];
+                ik_vec3_t to_effector = effector_positions[effector_idx];
+                ik_vec3_t to_target = targets[effector_idx];
+                vec3_sub_vec3(to_effector.f, joint->f);
+                vec3_sub_vec3(to_target.f, joint->f);
+                rotation_between(effector_rotation.f, to_effector.f, to_target.f, fast_math);
+                ik_quat_static_normalize_sign(effector_rotation.f);
+                rotation.x += effector_rotation.x;
+                rotation.y += effector_rotation.y;
+                rotation.z += effector_rotation.z;
+                rotation.w += effector_rotation.w;
+            }
+            quat_normalize(rotation.f);
+
+            /* The effectors below this joint move along with it */
+            for (entry = entry_begin; entry != entry_end; ++entry)
+            {
+                ik_vec3_t* effector_position = &effector_positions[entry_effectors[entry]];
+                vec3_sub_vec3(effector_position->f, joint->f);
+                vec3_rotate(effector_position->f, rotation.f);
+                vec3_add_vec3(effector_position->f, joint->f);
+            }
+        }
+
+        /*
+         * The rotation was found in global space, so the new global rotation
+         * of the joint is rotation * G. The new local rotation is
+         * G_parent^-1 * rotation * G.
+         */
+        quat_mul_no_normalize(rotation.f, rotations[pose_idx].f);
+        parent = parents[pose_idx];
+        if (parent >= 0)
+        {
+            ik_quat_t inv_parent = rotations[parent];
+            quat_conj(inv_parent.f);
+            quat_mul_no_normalize(inv_parent.f, rotation.f);
+            rotation = inv_parent;
+        }
+        quat_normalize(rotation.f);
+        local_rotations[pose_idx] = rotation;
+    }
+
+    update_island_pose(ccd, flat_island);
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+solve_island(struct ccd_solver_t* ccd,
+             struct chain_flat_island_t* flat_island,
+             int fast_math)
+{
+    int iteration;
+    int in_range;
+    ikreal_t error, previous_error;
+
+    in_range = gather_effectors(ccd, flat_island, &error);
+    for (iteration = 0; in_range == 0 && iteration < ccd->max_iterations; ++iteration)
+    {
+        previous_error = error;
+        iterate_island(ccd, flat_island, fast_math);
+        in_range = gather_effectors(ccd, flat_island, &error);
+
+        /* Out of reach */
+        if (in_range == 0 && ccd->stall_ratio > 0 &&
+            previous_error - error <= previous_error * ccd->stall_ratio)
+        {
+            iteration++;
+            break;
+        }
+    }
+
+    flat_island->result = in_range ? IK_RESULT_CONVERGED : IK_OK;
+    flat_island->iterations_used = iteration;
+    return flat_island->result;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_CCD_solve(struct ik_solver_t* solver)
+{
+    struct ccd_solver_t* ccd = (struct ccd_solver_t*)solver;
+    struct chain_flat_t* flat = solver->chain_flat;
+    struct chain_flat_island_t* flat_islands = chain_flat_data(flat, islands, struct chain_flat_island_t);
+    uint32_t pose_count = vector_count(&flat->pose_nodes);
+    int fast_math = solver->flags & IK_ENABLE_FAST_MATH;
+    uint32_t island_idx;
+    ikret_t result = IK_RESULT_CONVERGED;
+
+    chain_flat_update_global_pose(flat);
+    chain_flat_gather(flat, solver->flags);
+
+    memcpy(ccd->positions.data, flat->pose_global_positions.data, sizeof(ik_vec3_t) * pose_count);
+    memcpy(ccd->rotations.data, flat->pose_global_rotations.data, sizeof(ik_quat_t) * pose_count);
+    memcpy(ccd->local_rotations.data, flat->pose_local_rotations.data, sizeof(ik_quat_t) * pose_count);
+
+    solver->iterations_used = 0;
+    for (island_idx = 0; island_idx != vector_count(&flat->islands); ++island_idx)
+    {
+        if (solve_island(ccd, &flat_islands[island_idx], fast_math) != IK_RESULT_CONVERGED)
+            result = IK_OK;
+        if (solver->iterations_used < flat_islands[island_idx].iterations_used)
+            solver->iterations_used = flat_islands[island_idx].iterations_used;
+    }
+
+    chain_flat_scatter_pose(flat,
+                            solver->flags,
+                            (const ik_vec3_t*)ccd->positions.data,
+                            (const ik_quat_t*)ccd->local_rotations.data);
+
+    return result;
+}
@@ -0,0 +1,709 @@
+#include "ik/solver_DLS.h"
+#include "ik/chain_flat.h"
+#include "ik/ik.h"
+#include "ik/math_inline.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+/*
+ * Damped least squares (Levenberg-Marquardt) inverse kinematics.
+ *
+ * Every node of the chains which has child nodes is a ball joint with three
+ * rotational degrees of freedom, expressed as a rotation vector w in global
+ * space. Each effector contributes 3 rows to the Jacobian J (its position)
+ * and, if IK_ENABLE_TARGET_ROTATIONS is set, 3 more rows (the direction of
+ * its segment). A joint only moves the effectors below it, so J is block
+ * sparse: The 3x3 block of effector a and joint j is
+ *
+ *   position:  -[r]x    with r = (effector position - joint position)
+ *   direction:  I * rotation_weight
+ *
+ * and zero if j isn't an ancestor of a. These blocks are never stored.
+ * Instead, JJ^T + lambda^2 I is assembled directly from the offsets r (see
+ * assemble_matrix()), which is only as large as the number of effector
+ * rows, factorized with Cholesky and the step is recovered as
+ * w = J^T (JJ^T + lambda^2 I)^-1 e.
+ *
+ * Joints are rotated by changing the local rotations of the nodes, so
+ * segment lengths are preserved exactly. Every island is solved on its own.
+ */
+
+struct dls_solver_t
+{
+    IK_SOLVER_DLS_HEAD
+
+    /*
+     * The joints moving effector e, i.e. its ancestors, are listed from the
+     * effector's parent up to the island base in entries
+     * effector_entries[e] to effector_entries[e+1].
+     */
+    struct vector_t effector_entries; /* uint32_t, per effector + 1 */
+    struct vector_t effector_poses;   /* uint32_t, per effector. Pose index of the effector's node */
+    struct vector_t effector_chains;  /* uint32_t, per effector. Chain whose tip holds the effector */
+    struct vector_t entry_joints;     /* uint32_t, per entry. Pose index of the joint */
+    struct vector_t entry_offsets;    /* ik_vec3_t, per entry. Effector position relative to the joint */
+
+    /* Per pose index */
+    struct vector_t positions;        /* ik_vec3_t, global */
+    struct vector_t rotations;        /* ik_quat_t, global */
+    struct vector_t local_rotations;  /* ik_quat_t */
+    struct vector_t saved_rotations;  /* ik_quat_t, local rotations before the current step */
+    struct vector_t steps;            /* ik_vec3_t, rotation vector of every joint */
+
+    /* Sized for the island with the most effectors */
+    struct vector_t matrix;           /* ikreal_t, rows x rows, JJ^T + lambda^2 I and its factorization */
+    struct vector_t errors;           /* ikreal_t, rows. Error, then the solution of the system */
+    struct vector_t residuals;        /* ikreal_t, rows. Error predicted for the next pose */
+};
+
+/*
+ * A single step never rotates any joint by more than this many radians. Larger
+ * steps are scaled down as a whole so the direction of the step is kept.
+ */
+#define MAX_JOINT_STEP 0.5
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_solver_DLS_type_size(void)
+{
+    return sizeof(struct dls_solver_t);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_DLS_construct(struct ik_solver_t* solver)
+{
+    struct dls_solver_t* dls = (struct dls_solver_t*)solver;
+
+    /* Converges quadratically close to the targets, so fewer iterations are needed than for FABRIK */
+    solver->max_iterations = 10;
+    solver->tolerance = 1e-3;
+    solver->stall_ratio = 1e-3;
+    dls->lambda_min = 0.1;
+
+    vector_construct(&dls->effector_entries, sizeof(uint32_t));
+    vector_construct(&dls->effector_poses, sizeof(uint32_t));
+    vector_construct(&dls->effector_chains, sizeof(uint32_t));
+    vector_construct(&dls->entry_joints, sizeof(uint32_t));
+    vector_construct(&dls->entry_offsets, sizeof(ik_vec3_t));
+    vector_construct(&dls->positions, sizeof(ik_vec3_t));
+    vector_construct(&dls->rotations, sizeof(ik_quat_t));
+    vector_construct(&dls->local_rotations, sizeof(ik_quat_t));
+    vector_construct(&dls->saved_rotations, sizeof(ik_quat_t));
+    vector_construct(&dls->steps, sizeof(ik_vec3_t));
+    vector_construct(&dls->matrix, sizeof(ikreal_t));
+    vector_construct(&dls->errors, sizeof(ikreal_t));
+    vector_construct(&dls->residuals, sizeof(ikreal_t));
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_DLS_destruct(struct ik_solver_t* solver)
+{
+    struct dls_solver_t* dls = (struct dls_solver_t*)solver;
+
+    vector_clear_free(&dls->residuals);
+    vector_clear_free(&dls->errors);
+    vector_clear_free(&dls->matrix);
+    vector_clear_free(&dls->steps);
+    vector_clear_free(&dls->saved_rotations);
+    vector_clear_free(&dls->local_rotations);
+    vector_clear_free(&dls->rotations);
+    vector_clear_free(&dls->positions);
+    vector_clear_free(&dls->entry_offsets);
+    vector_clear_free(&dls->entry_joints);
+    vector_clear_free(&dls->effector_chains);
+    vector_clear_free(&dls->effector_poses);
+    vector_clear_free(&dls->effector_entries);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_DLS_rebuild(struct ik_solver_t* solver)
+{
+    ikret_t result;
+    struct dls_solver_t* dls = (struct dls_solver_t*)solver;
+    struct chain_flat_t* flat = solver->chain_flat;
+    const struct chain_flat_island_t* flat_islands = chain_flat_data(flat, islands, struct chain_flat_island_t);
+    const struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    const uint32_t* effector_slots = chain_flat_data(flat, effector_slots, uint32_t);
+    const uint32_t* slot_pose_index = chain_flat_data(flat, slot_pose_index, uint32_t);
+    const int32_t* parents = chain_flat_data(flat, pose_parents, int32_t);
+    uint32_t island_count = vector_count(&flat->islands);
+    uint32_t chain_count = vector_count(&flat->chains);
+    uint32_t effector_count = vector_count(&flat->effector_slots);
+    uint32_t pose_count = vector_count(&flat->pose_nodes);
+    uint32_t max_rows = 0;
+    uint32_t entry_count = 0;
+    uint32_t i;
+
+    if ((result = vector_resize(&dls->effector_entries, effector_count + 1)) != IK_OK) return result;
+    if ((result = vector_resize(&dls->effector_poses, effector_count)) != IK_OK) return result;
+    if ((result = vector_resize(&dls->effector_chains, effector_count)) != IK_OK) return result;
+    if ((result = vector_resize(&dls->positions, pose_count)) != IK_OK) return result;
+    if ((result = vector_resize(&dls->rotations, pose_count)) != IK_OK) return result;
+    if ((result = vector_resize(&dls->local_rotations, pose_count)) != IK_OK) return result;
+    if ((result = vector_resize(&dls->saved_rotations, pose_count)) != IK_OK) return result;
+    if ((result = vector_resize(&dls->steps, pose_count)) != IK_OK) return result;
+
+    for (i = 0; i != island_count; ++i)
+        if (max_rows < 6 * flat_islands[i].effector_count)
+            max_rows = 6 * flat_islands[i].effector_count;
+
+    for (i = 0; i != chain_count; ++i)
+        if (chains[i].effector_index >= 0)
+            ((uint32_t*)dls->effector_chains.data)[chains[i].effector_index] = i;
+
+    /* Count the ancestors of every effector node */
+    for (i = 0; i != effector_count; ++i)
+    {
+        uint32_t pose_idx = slot_pose_index[effector_slots[i]];
+        int32_t joint;
+
+        ((uint32_t*)dls->effector_poses.data)[i] = pose_idx;
+        ((uint32_t*)dls->effector_entries.data)[i] = entry_count;
+        for (joint = parents[pose_idx]; joint >= 0; joint = parents[joint])
+            entry_count++;
+    }
+    ((uint32_t*)dls->effector_entries.data)[effector_count] = entry_count;
+
+    if ((result = vector_resize(&dls->entry_joints, entry_count)) != IK_OK) return result;
+    if ((result = vector_resize(&dls->entry_offsets, entry_count)) != IK_OK) return result;
+    if ((result = vector_resize(&dls->matrix, max_rows * max_rows)) != IK_OK) return result;
+    if ((result = vector_resize(&dls->errors, max_rows)) != IK_OK) return result;
+    if ((result = vector_resize(&dls->residuals, max_rows)) != IK_OK) return result;
+
+    entry_count = 0;
+    for (i = 0; i != effector_count; ++i)
+    {
+        int32_t joint;
+        for (joint = parents[((uint32_t*)dls->effector_poses.data)[i]]; joint >= 0; joint = parents[joint])
+            ((uint32_t*)dls->entry_joints.data)[entry_count++] = (uint32_t)joint;
+    }
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Writes the rotation described by the rotation vector w to q */
+static void
+quat_from_rotation_vector(ikreal_t* q, const ikreal_t* w)
+{
+    ikreal_t angle = vec3_length(w);
+    ikreal_t s;
+
+    if (angle == 0.0)
+    {
+        q[0] = 0.0; q[1] = 0.0; q[2] = 0.0; q[3] = 1.0;
+        return;
+    }
+
+    s = sin(angle * 0.5) / angle;
+    q[0] = w[0] * s;
+    q[1] = w[1] * s;
+    q[2] = w[2] * s;
+    q[3] = cos(angle * 0.5);
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Rotation vector rotating the (normalized) direction d onto the normalized
+ * direction t.
+ */
+static void
+direction_error(ikreal_t* error, const ikreal_t* d, const ikreal_t* t)
+{
+    ikreal_t sin_angle, cos_angle;
+
+    vec3_set(error, d);
+    vec3_cross(error, t);
+    sin_angle = vec3_length(error);
+    cos_angle = vec3_dot(d, t);
+
+    if (sin_angle < 1e-12)
+    {
+        if (cos_angle > 0.0)
+        {
+            vec3_set_zero(error);
+            return;
+        }
+
+        /* Turned around completely, any axis perpendicular to d will do */
+        error[0] = 0; error[1] = 0; error[2] = 0;
+        error[ik_fabs(d[0]) < ik_fabs(d[1]) ? 0 : 1] = 1;
+        vec3_cross(error, d);
+        sin_angle = vec3_length(error);
+    }
+
+    vec3_mul_scalar(error, atan2(sin_angle, cos_angle) / sin_angle);
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Adds the 3x3 block B_a * B_b^T of one joint shared by the effectors a and
+ * b to the matrix at the specified row and column. B is -[r]x for position
+ * rows and w * I for direction rows, so these reduce to:
+ *
+ *   position  x position:  (r_a . r_b) I - r_b r_a^T
+ *   position  x direction: -w_b [r_a]x
+ *   direction x position:   w_a [r_b]x
+ *   direction x direction:  w_a w_b I
+ */
+static inline void
+accumulate_position_position(ikreal_t* m, uint32_t stride, const ikreal_t* ra, const ikreal_t* rb)
+{
+    ikreal_t dot = vec3_dot(ra, rb);
+    int i, k;
+    for (i = 0; i != 3; ++i)
+        for (k = 0; k != 3; ++k)
+            m[i*stride + k] += (i == k ? dot : 0.0) - rb[i] * ra[k];
+}
+
+static inline void
+accumulate_cross(ikreal_t* m, uint32_t stride, const ikreal_t* r, ikreal_t scale)
+{
+    /* m += scale * [r]x */
+    m[0*stride + 1] -= scale * r[2];
+    m[0*stride + 2] += scale * r[1];
+    m[1*stride + 0] += scale * r[2];
+    m[1*stride + 2] -= scale * r[0];
+    m[2*stride + 0] -= scale * r[1];
+    m[2*stride + 1] += scale * r[0];
+}
+
+static inline void
+accumulate_diagonal(ikreal_t* m, uint32_t stride, ikreal_t value)
+{
+    m[0*stride + 0] += value;
+    m[1*stride + 1] += value;
+    m[2*stride + 2] += value;
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Solves m x = b in place for a symmetric positive definite n x n matrix m,
+ * of which only the lower triangle is read. m is overwritten with its
+ * Cholesky factor and b with x.
+ */
+static void
+cholesky_solve(ikreal_t* m, ikreal_t* b, uint32_t n)
+{
+    uint32_t i, j, k;
+
+    for (j = 0; j != n; ++j)
+    {
+        ikreal_t diagonal = m[j*n + j];
+        for (k = 0; k != j; ++k)
+            diagonal -= m[j*n + k] * m[j*n + k];
+
+        /* Only happens if the damping is 0 and the effectors are out of reach */
+        diagonal = diagonal > 1e-12 ? sqrt(diagonal) : 1e-6;
+        m[j*n + j] = diagonal;
+
+        for (i = j + 1; i != n; ++i)
+        {
+            ikreal_t value = m[i*n + j];
+            for (k = 0; k != j; ++k)
+                value -= m[i*n + k] * m[j*n + k];
+            m[i*n + j] = value / diagonal;
+        }
+    }
+
+    /* L y = b */
+    for (i = 0; i != n; ++i)
+    {
+        for (k = 0; k != i; ++k)
+            b[i] -= m[i*n + k] * b[k];
+        b[i] /= m[i*n + i];
+    }
+
+    /* L^T x = y */
+    i = n;
+    while (i-- > 0)
+    {
+        for (k = i + 1; k != n; ++k)
+            b[i] -= m[k*n + i] * b[k];
+        b[i] /= m[i*n + i];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Recomputes the global pose of an island from its local transforms */
+static void
+update_island_pose(struct dls_solver_t* dls, const struct chain_flat_island_t* island)
+{
+    chain_flat_forward_kinematics(dls->chain_flat,
+                                  island->pose_begin,
+                                  island->pose_end,
+                                  (const ik_quat_t*)dls->local_rotations.data,
+                                  (ik_vec3_t*)dls->positions.data,
+                                  (ik_quat_t*)dls->rotations.data,
+                                  1);
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Writes the weighted error of every effector of the island to dls->errors
+ * and its squared length to error_sum. Returns non-zero if all effectors are
+ * within tolerance.
+ */
+static int
+calculate_errors(struct dls_solver_t* dls,
+                 const struct chain_flat_island_t* flat_island,
+                 uint32_t rows_per_effector,
+                 ikreal_t* error_sum)
+{
+    const struct chain_flat_t* flat = dls->chain_flat;
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    const uint32_t* effector_slots = chain_flat_data(flat, effector_slots, uint32_t);
+    const ik_vec3_t* targets = chain_flat_data(flat, effector_targets, ik_vec3_t);
+    const ik_vec3_t* directions = chain_flat_data(flat, directions, ik_vec3_t);
+    const int32_t* parents = chain_flat_data(flat, pose_parents, int32_t);
+    const uint32_t* effector_poses = (const uint32_t*)dls->effector_poses.data;
+    const uint32_t* effector_chains = (const uint32_t*)dls->effector_chains.data;
+    const ik_vec3_t* positions = (const ik_vec3_t*)dls->positions.data;
+    ikreal_t* errors = (ikreal_t*)dls->errors.data;
+    uint32_t effector_end = flat_island->effector_begin + flat_island->effector_count;
+    uint32_t effector_idx;
+    int all_in_range = 1;
+
+    *error_sum = 0;
+    for (effector_idx = flat_island->effector_begin; effector_idx != effector_end; ++effector_idx)
+    {
+        const struct ik_effector_t* effector = nodes[effector_slots[effector_idx]]->effector;
+        uint32_t pose_idx = effector_poses[effector_idx];
+        ikreal_t* error = errors + (effector_idx - flat_island->effector_begin) * rows_per_effector;
+        ikreal_t tolerance = effector->tolerance > 0 ? effector->tolerance : dls->tolerance;
+        ikreal_t distance_squared;
+
+        vec3_set(error, targets[effector_idx].f);
+        vec3_sub_vec3(error, positions[pose_idx].f);
+        distance_squared = vec3_length_squared(error);
+        *error_sum += distance_squared;
+        if (distance_squared > tolerance * tolerance)
+            all_in_range = 0;
+
+        if (rows_per_effector == 6)
+        {
+            ik_vec3_t direction = positions[pose_idx];
+            ikreal_t angle;
+
+            vec3_sub_vec3(direction.f, positions[parents[pose_idx]].f);
+            vec3_normalize(direction.f);
+            direction_error(error + 3, direction.f, directions[effector_chains[effector_idx]].f);
+            angle = vec3_length(error + 3);
+            if (angle * effector->rotation_weight > tolerance)
+                all_in_range = 0;
+            vec3_mul_scalar(error + 3, effector->rotation_weight);
+            *error_sum += vec3_length_squared(error + 3);
+        }
+    }
+
+    return all_in_range;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Assembles JJ^T + lambda^2 I for all effectors of the island */
+static void
+assemble_matrix(struct dls_solver_t* dls,
+                const struct chain_flat_island_t* flat_island,
+                uint32_t rows_per_effector,
+                ikreal_t lambda)
+{
+    const struct chain_flat_t* flat = dls->chain_flat;
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    const uint32_t* effector_slots = chain_flat_data(flat, effector_slots, uint32_t);
+    const uint32_t* effector_entries = (const uint32_t*)dls->effector_entries.data;
+    const uint32_t* entry_joints = (const uint32_t*)dls->entry_joints.data;
+    const ik_vec3_t* offsets = (const ik_vec3_t*)dls->entry_offsets.data;
+    ikreal_t* matrix = (ikreal_t*)dls->matrix.data;
+    uint32_t effector_begin = flat_island->effector_begin;
+    uint32_t rows = flat_island->effector_count * rows_per_effector;
+    uint32_t a, b, row;
+
+    memset(matrix, 0, sizeof(ikreal_t) * rows * rows);
+
+    /* Only the lower triangle is needed by cholesky_solve() */
+    for (a = 0; a != flat_island->effector_count; ++a)
+        for (b = 0; b <= a; ++b)
+        {
+            uint32_t ea = effector_begin + a;
+            uint32_t eb = effector_begin + b;
+            uint32_t entry_a = effector_entries[ea + 1];
+            uint32_t entry_b = effector_entries[eb + 1];
+            ikreal_t* block = matrix + a * rows_per_effector * rows + b * rows_per_effector;
+            ikreal_t wa = 0.0, wb = 0.0;
+            uint32_t shared = 0;
+
+            if (rows_per_effector == 6)
+            {
+                wa = nodes[effector_slots[ea]]->effector->rotation_weight;
+                wb = nodes[effector_slots[eb]]->effector->rotation_weight;
+            }
+
+            /*
+             * Ancestors are listed up to the island base, so the joints both
+             * effectors share are at the end of both lists.
+             */
+            while (entry_a-- > effector_entries[ea] && entry_b-- > effector_entries[eb])
+            {
+                const ikreal_t* ra = offsets[entry_a].f;
+                const ikreal_t* rb = offsets[entry_b].f;
+                if (entry_joints[entry_a] != entry_joints[entry_b])
+                    break;
+
+                accumulate_position_position(block, rows, ra, rb);
+                if (rows_per_effector == 6)
+                {
+                    accumulate_cross(block + 3, rows, ra, -wb);
+                    accumulate_cross(block + 3*rows, rows, rb, wa);
+                }
+                shared++;
+            }
+
+            if (rows_per_effector == 6)
+                accumulate_diagonal(block + 3*rows + 3, rows, wa * wb * shared);
+        }
+
+    for (row = 0; row != rows; ++row)
+        matrix[row * rows + row] += lambda * lambda;
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Performs one damped least squares step. dls->errors must contain the
+ * current error of the island. Returns the squared error the linearization
+ * predicts for the new pose.
+ */
+static ikreal_t
+iterate_island(struct dls_solver_t* dls,
+               const struct chain_flat_island_t* flat_island,
+               uint32_t rows_per_effector,
+               ikreal_t lambda)
+{
+    const int32_t* parents = chain_flat_data(dls->chain_flat, pose_parents, int32_t);
+    const uint32_t* effector_poses = (const uint32_t*)dls->effector_poses.data;
+    const uint32_t* effector_entries = (const uint32_t*)dls->effector_entries.data;
+    const uint32_t* entry_joints = (const uint32_t*)dls->entry_joints.data;
+    struct ik_node_t** nodes = chain_flat_data(dls->chain_flat, nodes, struct ik_node_t*);
+    const uint32_t* effector_slots = chain_flat_data(dls->chain_flat, effector_slots, uint32_t);
+    ik_vec3_t* offsets = (ik_vec3_t*)dls->entry_offsets.data;
+    const ik_vec3_t* positions = (const ik_vec3_t*)dls->positions.data;
+    const ik_quat_t* rotations = (const ik_quat_t*)dls->rotations.data;
+    ik_quat_t* local_rotations = (ik_quat_t*)dls->local_rotations.data;
+    ik_vec3_t* steps = (ik_vec3_t*)dls->steps.data;
+    ikreal_t* solution = (ikreal_t*)dls->errors.data;
+    ikreal_t* residuals = (ikreal_t*)dls->residuals.data;
+    uint32_t rows = flat_island->effector_count * rows_per_effector;
+    uint32_t effector_end = flat_island->effector_begin + flat_island->effector_count;
+    uint32_t effector_idx, entry, pose_idx, row;
+    ikreal_t predicted_error = 0.0;
+    ikreal_t max_angle_squared = 0.0;
+
+    for (effector_idx = flat_island->effector_begin; effector_idx != effector_end; ++effector_idx)
+        for (entry = effector_entries[effector_idx]; entry != effector_entries[effector_idx + 1]; ++entry)
+        {
+            offsets[entry] = positions[effector_poses[effector_idx]];
+            vec3_sub_vec3(offsets[entry].f, positions[entry_joints[entry]].f);
+        }
+
+    memcpy(residuals, solution, sizeof(ikreal_t) * rows);
+    assemble_matrix(dls, flat_island, rows_per_effector, lambda);
+    cholesky_solve((ikreal_t*)dls->matrix.data, solution, rows);
+
+    /* w = J^T y. The transpose of -[r]x is [r]x, so every position block contributes r x y */
+    memset(steps + flat_island->pose_begin, 0, sizeof(ik_vec3_t) * (flat_island->pose_end - flat_island->pose_begin));
+    for (effector_idx = flat_island->effector_begin; effector_idx != effector_end; ++effector_idx)
+    {
+        const ikreal_t* y = solution + (effector_idx - flat_island->effector_begin) * rows_per_effector;
+        ikreal_t weight = rows_per_effector == 6 ?
+            nodes[effector_slots[effector_idx]]->effector->rotation_weight : 0.0;
+
+        for (entry = effector_entries[effector_idx]; entry != effector_entries[effector_idx + 1]; ++entry)
+        {
+            ik_vec3_t step = offsets[entry];
+            vec3_cross(step.f, y);
+            if (rows_per_effector == 6)
+            {
+                step.x += y[3] * weight;
+                step.y += y[4] * weight;
+                step.z += y[5] * weight;
+            }
+            vec3_add_vec3(steps[entry_joints[entry]].f, step.f);
+        }
+    }
+
+    for (pose_idx = flat_island->pose_begin; pose_idx != flat_island->pose_end; ++pose_idx)
+    {
+        ikreal_t angle_squared = vec3_length_squared(steps[pose_idx].f);
+        if (max_angle_squared < angle_squared)
+            max_angle_squared = angle_squared;
+    }
+    if (max_angle_squared > MAX_JOINT_STEP * MAX_JOINT_STEP)
+    {
+        ikreal_t scale = MAX_JOINT_STEP / sqrt(max_angle_squared);
+        for (pose_idx = flat_island->pose_begin; pose_idx != flat_island->pose_end; ++pose_idx)
+            vec3_mul_scalar(steps[pose_idx].f, scale);
+    }
+
+    /* Residual e - J w of the linearization */
+    for (effector_idx = flat_island->effector_begin; effector_idx != effector_end; ++effector_idx)
+    {
+        ikreal_t* residual = residuals + (effector_idx - flat_island->effector_begin) * rows_per_effector;
+        ikreal_t weight = rows_per_effector == 6 ?
+            nodes[effector_slots[effector_idx]]->effector->rotation_weight : 0.0;
+
+        for (entry = effector_entries[effector_idx]; entry != effector_entries[effector_idx + 1]; ++entry)
+        {
+            ik_vec3_t moved = steps[entry_joints[entry]];
+            vec3_cross(moved.f, offsets[entry].f);
+            vec3_sub_vec3(residual, moved.f);
+            if (rows_per_effector == 6)
+            {
+                residual[3] -= steps[entry_joints[entry]].x * weight;
+                residual[4] -= steps[entry_joints[entry]].y * weight;
+                residual[5] -= steps[entry_joints[entry]].z * weight;
+            }
+        }
+    }
+    for (row = 0; row != rows; ++row)
+        predicted_error += residuals[row] * residuals[row];
+
+    /*
+     * Rotating a joint by w in global space is the same as rotating its
+     * local rotation by w expressed in the parent's space.
+     */
+    for (pose_idx = flat_island->pose_begin; pose_idx != flat_island->pose_end; ++pose_idx)
+    {
+        ik_vec3_t* step = &steps[pose_idx];
+        ik_quat_t rotation;
+        int32_t parent = parents[pose_idx];
+
+        if (vec3_length_squared(step->f) == 0.0)
+            continue;
+
+        if (parent >= 0)
+        {
+            ik_quat_t inv_parent = rotations[parent];
+            quat_conj(inv_parent.f);
+            vec3_rotate(step->f, inv_parent.f);
+        }
+
+        quat_from_rotation_vector(rotation.f, step->f);
+        quat_mul_quat(rotation.f, local_rotations[pose_idx].f);
+        local_rotations[pose_idx] = rotation;
+    }
+
+    update_island_pose(dls, flat_island);
+    return predicted_error;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+save_island_rotations(struct dls_solver_t* dls, const struct chain_flat_island_t* island, int restore)
+{
+    ik_quat_t* local_rotations = (ik_quat_t*)dls->local_rotations.data + island->pose_begin;
+    ik_quat_t* saved_rotations = (ik_quat_t*)dls->saved_rotations.data + island->pose_begin;
+    uint32_t size = sizeof(ik_quat_t) * (island->pose_end - island->pose_begin);
+
+    if (restore)
+        memcpy(local_rotations, saved_rotations, size);
+    else
+        memcpy(saved_rotations, local_rotations, size);
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+solve_island(struct dls_solver_t* dls,
+             struct chain_flat_island_t* flat_island,
+             uint32_t rows_per_effector)
+{
+    int iteration;
+    int in_range;
+    ikreal_t error, new_error, predicted_error, gain;
+    ikreal_t lambda = dls->lambda_min;
+
+    in_range = calculate_errors(dls, flat_island, rows_per_effector, &error);
+    for (iteration = 0; in_range == 0 && iteration < dls->max_iterations; ++iteration)
+    {
+        save_island_rotations(dls, flat_island, 0);
+        predicted_error = iterate_island(dls, flat_island, rows_per_effector, lambda);
+        in_range = calculate_errors(dls, flat_island, rows_per_effector, &new_error);
+
+        /*
+         * Far from the targets (or close to singular poses) the linearization
+         * isn't accurate and the step can overshoot. The damping is adjusted
+         * depending on how well the actual improvement matched the predicted
+         * one, as in Levenberg-Marquardt. Steps which made things worse are
+         * undone. Close to the targets the prediction is accurate and the
+         * damping drops back to lambda_min, which is where the solver
+         * converges quadratically.
+         */
+        if (new_error >= error)
+        {
+            save_island_rotations(dls, flat_island, 1);
+            update_island_pose(dls, flat_island);
+            in_range = calculate_errors(dls, flat_island, rows_per_effector, &new_error);
+            lambda *= 4.0;
+            continue;
+        }
+
+        gain = error > predicted_error ? (error - new_error) / (error - predicted_error) : 1.0;
+        if (gain < 0.25)
+            lambda *= 2.0;
+        else if (gain > 0.75)
+            lambda = lambda / 3.0 > dls->lambda_min ? lambda / 3.0 : dls->lambda_min;
+
+        /* Out of reach */
+        if (in_range == 0 && dls->stall_ratio > 0 &&
+            error - new_error <= error * dls->stall_ratio)
+        {
+            iteration++;
+            break;
+        }
+        error = new_error;
+    }
+
+    flat_island->result = in_range ? IK_RESULT_CONVERGED : IK_OK;
+    flat_island->iterations_used = iteration;
+    return flat_island->result;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_DLS_solve(struct ik_solver_t* solver)
+{
+    struct dls_solver_t* dls = (struct dls_solver_t*)solver;
+    struct chain_flat_t* flat = solver->chain_flat;
+    struct chain_flat_island_t* flat_islands = chain_flat_data(flat, islands, struct chain_flat_island_t);
+    uint32_t pose_count = vector_count(&flat->pose_nodes);
+    uint32_t rows_per_effector = solver->flags & IK_ENABLE_TARGET_ROTATIONS ? 6 : 3;
+    uint32_t island_idx;
+    ikret_t result = IK_RESULT_CONVERGED;
+
+    chain_flat_update_global_pose(flat);
+    chain_flat_gather(flat, solver->flags);
+
+    memcpy(dls->positions.data, flat->pose_global_positions.data, sizeof(ik_vec3_t) * pose_count);
+    memcpy(dls->rotations.data, flat->pose_global_rotations.data, sizeof(ik_quat_t) * pose_count);
+    memcpy(dls->local_rotations.data, flat->pose_local_rotations.data, sizeof(ik_quat_t) * pose_count);
+
+    solver->iterations_used = 0;
+    for (island_idx = 0; island_idx != vector_count(&flat->islands); ++island_idx)
+    {
+        if (solve_island(dls, &flat_islands[island_idx], rows_per_effector) != IK_RESULT_CONVERGED)
+            result = IK_OK;
+        if (solver->iterations_used < flat_islands[island_idx].iterations_used)
+            solver->iterations_used = flat_islands[island_idx].iterations_used;
+    }
+
+    chain_flat_scatter_pose(flat,
+                            solver->flags,
+                            (const ik_vec3_t*)dls->positions.data,
+                            (const ik_quat_t*)dls->local_rotations.data);
+
+    return result;
+}
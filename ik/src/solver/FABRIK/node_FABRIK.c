@@ -7,7 +7,7 @@
 struct ik_node_t*
 ik_node_FABRIK_create(uint32_t guid)
 {
-    struct ik_node_FABRIK_t* node = MALLOC(sizeof *node);
+    struct ik_node_FABRIK_t* node = MALLOC_OBJECT(sizeof *node);
     if (node == NULL)
     {
         IKAPI.log.message("fFailed to allocate node: Ran out of memory");
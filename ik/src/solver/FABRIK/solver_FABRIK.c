@@ -1,10 +1,14 @@
 #include "ik/solver_FABRIK.h"
 #include "ik/bstv.h"
 #include "ik/chain.h"
+#include "ik/chain_flat.h"
+#include "ik/chain_lanes.h"
 #include "ik/ik.h"
+#include "ik/math_inline.h"
 #include "ik/memory.h"
 #include "ik/node_FABRIK.h"
 #include "ik/quat_static.h"
+#include "ik/thread_pool.h"
 #include "ik/transform.h"
 #include "ik/vec3_static.h"
 #include <assert.h>
@@ -41,13 +45,13 @@ solve_chain_forwards_with_target_rotation(struct chain_t* chain)
     /*
      * Target position (and direction) is the average of all solved child chain base positions.
      */
-    ik_vec3_static_set_zero(target.position.f);
-    ik_vec3_static_set_zero(target.direction.f);
+    vec3_set_zero(target.position.f);
+    vec3_set_zero(target.direction.f);
     average_count = 0;
     CHAIN_FOR_EACH_CHILD(chain, child)
         struct position_direction_t child_posdir = solve_chain_forwards_with_target_rotation(child);
-        ik_vec3_static_add_vec3(target.position.f, child_posdir.position.f);
-        ik_vec3_static_add_vec3(target.direction.f, child_posdir.direction.f);
+        vec3_add_vec3(target.position.f, child_posdir.position.f);
+        vec3_add_vec3(target.direction.f, child_posdir.direction.f);
         ++average_count;
     CHAIN_END_EACH
 
@@ -70,12 +74,12 @@ solve_chain_forwards_with_target_rotation(struct chain_t* chain)
         target.direction.x = 0.0;
         target.direction.y = 0.0;
         target.direction.z = 1.0;
-        ik_vec3_static_rotate(target.direction.f, effector->target_rotation.f);
+        vec3_rotate(target.direction.f, effector->target_rotation.f);
     }
     else
     {
-        ik_vec3_static_div_scalar(target.position.f, average_count);
-        ik_vec3_static_normalize(target.direction.f);
+        vec3_div_scalar(target.position.f, average_count);
+        vec3_normalize(target.direction.f);
     }
 
     /*
@@ -91,17 +95,17 @@ solve_chain_forwards_with_target_rotation(struct chain_t* chain)
         child_node->position = target.position;
 
         /* lerp between direction vector and segment vector */
-        ik_vec3_static_sub_vec3(target.position.f, parent_node->position.f);        /* segment vector */
-        ik_vec3_static_normalize(target.position.f);                                /* normalizeso we have segment direction vector */
-        ik_vec3_static_sub_vec3(target.position.f, target.direction.f);             /* for lerp, subtract target direction... */
-        ik_vec3_static_mul_scalar(target.position.f, parent_node->rotation_weight); /* ...mul with weight... */
-        ik_vec3_static_add_vec3(target.position.f, parent_node->position.f);        /* ...and attach this lerp'd direction to the parent node */
+        vec3_sub_vec3(target.position.f, parent_node->position.f);        /* segment vector */
+        vec3_normalize(target.position.f);                                /* normalizeso we have segment direction vector */
+        vec3_sub_vec3(target.position.f, target.direction.f);             /* for lerp, subtract target direction... */
+        vec3_mul_scalar(target.position.f, parent_node->rotation_weight); /* ...mul with weight... */
+        vec3_add_vec3(target.position.f, parent_node->position.f);        /* ...and attach this lerp'd direction to the parent node */
 
         /* point segment to previous node */
-        ik_vec3_static_sub_vec3(target.position.f, child_node->position.f);         /* this computes the correct direction the segment should have */
-        ik_vec3_static_normalize(target.position.f);
-        ik_vec3_static_mul_scalar(target.position.f, child_node->dist_to_parent);
-        ik_vec3_static_add_vec3(target.position.f, child_node->position.f);         /* attach to child -- this is the new target for the next segment */
+        vec3_sub_vec3(target.position.f, child_node->position.f);         /* this computes the correct direction the segment should have */
+        vec3_normalize(target.position.f);
+        vec3_mul_scalar(target.position.f, child_node->dist_to_parent);
+        vec3_add_vec3(target.position.f, child_node->position.f);         /* attach to child -- this is the new target for the next segment */
     }
 
     return target;
@@ -118,11 +122,11 @@ solve_chain_forwards_with_constraints(struct chain_t* chain)
     /*
      * Target position is the average of all solved child chain base positions.
      */
-    ik_vec3_static_set_zero(target_position.f);
+    vec3_set_zero(target_position.f);
     average_count = 0;
     CHAIN_FOR_EACH_CHILD(chain, child)
         ik_vec3_t child_base_position = solve_chain_forwards_with_constraints(child);
-        ik_vec3_static_add_vec3(target_position.f, child_base_position.f);
+        vec3_add_vec3(target_position.f, child_base_position.f);
         ++average_count;
     CHAIN_END_EACH
 
@@ -143,7 +147,7 @@ solve_chain_forwards_with_constraints(struct chain_t* chain)
     }
     else
     {
-        ik_vec3_static_div_scalar(target_position.f, average_count);
+        vec3_div_scalar(target_position.f, average_count);
     }
 
     /*
@@ -160,9 +164,9 @@ solve_chain_forwards_with_constraints(struct chain_t* chain)
          * Need the initial (unsolved) segment so we can calculate joint
          * rotation for constraints.
          */
-        ik_vec3_static_set(initial_segment.f, child_node->initial_position.f);
-        ik_vec3_static_sub_vec3(initial_segment.f, parent_node->initial_position.f);
-        ik_vec3_static_normalize(initial_segment.f);
+        vec3_set(initial_segment.f, child_node->initial_position.f);
+        vec3_sub_vec3(initial_segment.f, parent_node->initial_position.f);
+        vec3_normalize(initial_segment.f);
 
         /* move node to target */
         child_node->position = target_position;
@@ -171,24 +175,24 @@ solve_chain_forwards_with_constraints(struct chain_t* chain)
          * target_position will be a directional vector pointing from the new
          * target position to the previous node,
          */
-        ik_vec3_static_sub_vec3(target_position.f, parent_node->position.f);        /* parent points to child */
-        ik_vec3_static_normalize(target_position.f);                                /* normalise */
-        ik_vec3_static_mul_scalar(target_position.f, -child_node->dist_to_parent);  /* child points to parent */
-        ik_vec3_static_add_vec3(target_position.f, child_node->position.f);         /* attach to child -- this is the new target for the next segment */
+        vec3_sub_vec3(target_position.f, parent_node->position.f);        /* parent points to child */
+        vec3_normalize(target_position.f);                                /* normalise */
+        vec3_mul_scalar(target_position.f, -child_node->dist_to_parent);  /* child points to parent */
+        vec3_add_vec3(target_position.f, child_node->position.f);         /* attach to child -- this is the new target for the next segment */
 
         /* Calculate global rotation of parent node *
         segment_original = child_node->initial_position;
         segment_current  = child_node->position;
-        ik_vec3_static_sub_vec3(segment_original.f, parent_node->initial_position.f);
-        ik_vec3_static_sub_vec3(segment_current.f, target_position.f);
+        vec3_sub_vec3(segment_original.f, parent_node->initial_position.f);
+        vec3_sub_vec3(segment_current.f, target_position.f);
         ik_vec3_static_angle(parent_node->rotation.f, segment_original.f, segment_current.f);
-        ik_quat_static_mul_quat(parent_node->rotation.f, parent_node->initial_rotation.f);
+        quat_mul_quat(parent_node->rotation.f, parent_node->initial_rotation.f);
 
         * Convert global transform to local *
         inv_rotation = accumulated.rotation;
-        ik_quat_static_conj(inv_rotation.f);
-        ik_quat_static_mul_quat(parent_node->rotation.f, inv_rotation.f);
-        ik_vec3_static_sub_vec3(parent_node->position.f, accumulated.position.f);
+        quat_conj(inv_rotation.f);
+        quat_mul_quat(parent_node->rotation.f, inv_rotation.f);
+        vec3_sub_vec3(parent_node->position.f, accumulated.position.f);
         ik_quat_static_rotate_vec(parent_node->position.f, inv_rotation.f);
 
         if (child_node->constraint != NULL)
@@ -197,24 +201,24 @@ solve_chain_forwards_with_constraints(struct chain_t* chain)
         * Accumulate local rotation and translation for deeper nodes *after*
          * constraint was applied *
         accumulated_previous = accumulated;
-        ik_quat_static_mul_quat(accumulated.rotation.f, parent_node->rotation.f);
-        ik_vec3_static_add_vec3(accumulated.position.f, parent_node->position.f);
+        quat_mul_quat(accumulated.rotation.f, parent_node->rotation.f);
+        vec3_add_vec3(accumulated.position.f, parent_node->position.f);
 
         * Convert local transform back to global *
         ik_quat_static_rotate_vec(parent_node->position.f, accumulated_previous.rotation.f);
-        ik_vec3_static_add_vec3(parent_node->position.f, accumulated_previous.position.f);
-        ik_quat_static_mul_quat(parent_node->rotation.f, accumulated_previous.rotation.f);
+        vec3_add_vec3(parent_node->position.f, accumulated_previous.position.f);
+        quat_mul_quat(parent_node->rotation.f, accumulated_previous.rotation.f);
 
         if (child_node->constraint != NULL)
         {
             * XXX combine this? *
             inv_rotation = parent_node->initial_rotation;
-            ik_quat_static_conj(inv_rotation.f);
-            ik_quat_static_mul_quat(parent_node->rotation.f, inv_rotation.f);
+            quat_conj(inv_rotation.f);
+            quat_mul_quat(parent_node->rotation.f, inv_rotation.f);
 
             target_position = parent_node->position;
             ik_quat_static_rotate_vec(segment_original.f, parent_node->rotation.f);
-            ik_vec3_static_add_vec3(target_position.f, segment_original.f);
+            vec3_add_vec3(target_position.f, segment_original.f);
         }*/
     }
 
@@ -232,11 +236,11 @@ solve_chain_forwards(struct chain_t* chain)
     /*
      * Target position is the average of all solved child chain base positions.
      */
-    ik_vec3_static_set_zero(target_position.f);
+    vec3_set_zero(target_position.f);
     average_count = 0;
     CHAIN_FOR_EACH_CHILD(chain, child)
         ik_vec3_t child_base_position = solve_chain_forwards(child);
-        ik_vec3_static_add_vec3(target_position.f, child_base_position.f);
+        vec3_add_vec3(target_position.f, child_base_position.f);
         ++average_count;
     CHAIN_END_EACH
 
@@ -254,7 +258,7 @@ solve_chain_forwards(struct chain_t* chain)
     }
     else
     {
-        ik_vec3_static_div_scalar(target_position.f, average_count);
+        vec3_div_scalar(target_position.f, average_count);
     }
 
     /*
@@ -270,10 +274,7 @@ solve_chain_forwards(struct chain_t* chain)
         child_node->position = target_position;
 
         /* point segment to previous node and set target position to its end */
-        ik_vec3_static_sub_vec3(target_position.f, parent_node->position.f);        /* parent points to child */
-        ik_vec3_static_normalize(target_position.f);                                /* normalise */
-        ik_vec3_static_mul_scalar(target_position.f, -child_node->dist_to_parent);  /* child points to parent */
-        ik_vec3_static_add_vec3(target_position.f, child_node->position.f);         /* attach to child -- this is the new target for next iteration */
+        vec3_point_towards(target_position.f, child_node->position.f, parent_node->position.f, child_node->dist_to_parent);
     }
 
     return target_position;
@@ -307,30 +308,30 @@ solve_chain_backwards_with_constraints(struct chain_t* chain,
         struct ik_node_t* parent_node = chain_get_node(chain, node_idx + 1);
 
         /* point segment to child node and set target position to its beginning */
-        ik_vec3_static_sub_vec3(target_position.f, child_node->position.f);         /* child points to parent */
-        ik_vec3_static_normalize(target_position.f);                                /* normalise */
-        ik_vec3_static_mul_scalar(target_position.f, -child_node->dist_to_parent);  /* parent points to child */
-        ik_vec3_static_add_vec3(target_position.f, parent_node->position.f);        /* attach to parent -- this is the new target */
+        vec3_sub_vec3(target_position.f, child_node->position.f);         /* child points to parent */
+        vec3_normalize(target_position.f);                                /* normalise */
+        vec3_mul_scalar(target_position.f, -child_node->dist_to_parent);  /* parent points to child */
+        vec3_add_vec3(target_position.f, parent_node->position.f);        /* attach to parent -- this is the new target */
 
         /* target_position is now where the position of child_node should be. */
 
         /* Calculate delta rotation of parent node *
         segment_original = child_node->initial_position;
         segment_current  = target_position;
-        ik_vec3_static_sub_vec3(segment_original.f, parent_node->initial_position.f);
-        ik_vec3_static_sub_vec3(segment_current.f, parent_node->position.f);
+        vec3_sub_vec3(segment_original.f, parent_node->initial_position.f);
+        vec3_sub_vec3(segment_current.f, parent_node->position.f);
         ik_vec3_static_angle(parent_node->rotation.f, segment_original.f, segment_current.f);
 
         *
          * Since the initial rotation is in local space temporarily (see
          * solve() entry point on why), we now have the rotation in local space
          *
-        ik_quat_static_mul_quat(parent_node->rotation.f, parent_node->initial_rotation.f);
+        quat_mul_quat(parent_node->rotation.f, parent_node->initial_rotation.f);
 
         * Convert global translation to local *
         inv_rotation = accumulated_positions.rotation;
-        ik_quat_static_conj(inv_rotation.f);
-        ik_vec3_static_sub_vec3(parent_node->position.f, accumulated_positions.position.f);
+        quat_conj(inv_rotation.f);
+        vec3_sub_vec3(parent_node->position.f, accumulated_positions.position.f);
         ik_quat_static_rotate_vec(parent_node->position.f, inv_rotation.f);
 
         if (child_node->constraint != NULL)
@@ -339,23 +340,23 @@ solve_chain_backwards_with_constraints(struct chain_t* chain,
         * Accumulate local rotation and translation for deeper nodes *after*
          * constraint was applied *
         accumulated_previous = accumulated_positions;
-        ik_vec3_static_add_vec3(accumulated_positions.position.f, parent_node->position.f);
+        vec3_add_vec3(accumulated_positions.position.f, parent_node->position.f);
 
         * Convert local transform back to global *
         ik_quat_static_rotate_vec(parent_node->position.f, accumulated_previous.rotation.f);
-        ik_vec3_static_add_vec3(parent_node->position.f, accumulated_previous.position.f);
-        ik_quat_static_mul_quat(parent_node->rotation.f, accumulated_previous.rotation.f);
+        vec3_add_vec3(parent_node->position.f, accumulated_previous.position.f);
+        quat_mul_quat(parent_node->rotation.f, accumulated_previous.rotation.f);
 
         if (child_node->constraint != NULL)
         {
             * XXX combine this? *
             inv_rotation = parent_node->initial_rotation;
-            ik_quat_static_conj(inv_rotation.f);
-            ik_quat_static_mul_quat(parent_node->rotation.f, inv_rotation.f);
+            quat_conj(inv_rotation.f);
+            quat_mul_quat(parent_node->rotation.f, inv_rotation.f);
 
             target_position = parent_node->position;
             ik_quat_static_rotate_vec(segment_original.f, parent_node->rotation.f);
-            ik_vec3_static_add_vec3(target_position.f, segment_original.f);
+            vec3_add_vec3(target_position.f, segment_original.f);
         }*/
 
         /* move node to target */
@@ -368,43 +369,465 @@ solve_chain_backwards_with_constraints(struct chain_t* chain,
 }
 
 /* ------------------------------------------------------------------------- */
+typedef ik_vec3_t (*solve_flat_chain_forwards_func)(struct chain_flat_t* flat, uint32_t chain_idx);
+typedef void (*solve_flat_chain_backwards_func)(struct chain_flat_t* flat, uint32_t chain_idx);
+
+/*
+ * Each of the following is implemented once with a fast_math argument, and
+ * wrapped once for each value of it. The wrappers are selected through the
+ * above function pointers, so the choice isn't made again for every segment.
+ */
+
+/* ------------------------------------------------------------------------- */
+static inline ik_vec3_t
+solve_flat_chain_forwards_impl(struct chain_flat_t* flat, uint32_t chain_idx, int fast_math)
+{
+    const struct chain_flat_chain_t* chain = chain_flat_data(flat, chains, struct chain_flat_chain_t) + chain_idx;
+    const ikreal_t* segment_lengths = chain_flat_data(flat, segment_lengths, ikreal_t);
+    ik_vec3_t* positions = chain_flat_data(flat, positions, ik_vec3_t);
+    uint32_t slot = chain->slot_begin;
+    uint32_t slot_base = chain->slot_begin + chain->slot_count - 1;
+    ik_vec3_t target_position;
+
+    /*
+     * If there are no child chains, then the first node in the chain must
+     * contain an effector. The target position is the effector's target
+     * position. Otherwise, average the data we've been accumulating from the
+     * child chains.
+     */
+    if (chain->child_count == 0)
+    {
+        target_position = chain_flat_data(flat, effector_targets, ik_vec3_t)[chain->effector_index];
+    }
+    else
+    {
+        target_position = chain_flat_data(flat, accumulators, ik_vec3_t)[chain_idx];
+        vec3_div_scalar(target_position.f, chain->child_count);
+    }
+
+    for (; slot != slot_base; ++slot)
+    {
+        /* move node to target */
+        positions[slot] = target_position;
+
+        /* point segment to previous node and set target position to its end */
+        if (fast_math)
+            vec3_point_towards_fast(target_position.f, positions[slot].f, positions[slot + 1].f, segment_lengths[slot]);
+        else
+            vec3_point_towards(target_position.f, positions[slot].f, positions[slot + 1].f, segment_lengths[slot]);
+    }
+
+    return target_position;
+}
+static ik_vec3_t
+solve_flat_chain_forwards(struct chain_flat_t* flat, uint32_t chain_idx)
+{
+    return solve_flat_chain_forwards_impl(flat, chain_idx, 0);
+}
+static ik_vec3_t
+solve_flat_chain_forwards_fast(struct chain_flat_t* flat, uint32_t chain_idx)
+{
+    return solve_flat_chain_forwards_impl(flat, chain_idx, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+static inline ik_vec3_t
+solve_flat_chain_forwards_with_target_rotation_impl(struct chain_flat_t* flat, uint32_t chain_idx, int fast_math)
+{
+    const struct chain_flat_chain_t* chain = chain_flat_data(flat, chains, struct chain_flat_chain_t) + chain_idx;
+    const ikreal_t* segment_lengths = chain_flat_data(flat, segment_lengths, ikreal_t);
+    const ikreal_t* rotation_weights = chain_flat_data(flat, rotation_weights, ikreal_t);
+    const ik_vec3_t* target_direction = chain_flat_data(flat, directions, ik_vec3_t) + chain_idx;
+    ik_vec3_t* positions = chain_flat_data(flat, positions, ik_vec3_t);
+    uint32_t slot = chain->slot_begin;
+    uint32_t slot_base = chain->slot_begin + chain->slot_count - 1;
+    ik_vec3_t target_position;
+
+    /* Target directions were already averaged by chain_flat_gather() */
+    if (chain->child_count == 0)
+    {
+        target_position = chain_flat_data(flat, effector_targets, ik_vec3_t)[chain->effector_index];
+    }
+    else
+    {
+        target_position = chain_flat_data(flat, accumulators, ik_vec3_t)[chain_idx];
+        vec3_div_scalar(target_position.f, chain->child_count);
+    }
+
+    for (; slot != slot_base; ++slot)
+    {
+        ik_vec3_t* child_position  = &positions[slot + 0];
+        ik_vec3_t* parent_position = &positions[slot + 1];
+
+        /* move node to target */
+        *child_position = target_position;
+
+        /* lerp between direction vector and segment vector */
+        vec3_sub_vec3(target_position.f, parent_position->f);          /* segment vector */
+        if (fast_math)                                                /* normalize so we have segment direction vector */
+            vec3_normalize_fast(target_position.f);
+        else
+            vec3_normalize(target_position.f);
+        vec3_sub_vec3(target_position.f, target_direction->f);        /* for lerp, subtract target direction... */
+        vec3_mul_scalar(target_position.f, rotation_weights[slot + 1]); /* ...mul with weight... */
+        vec3_add_vec3(target_position.f, parent_position->f);          /* ...and attach this lerp'd direction to the parent node */
+
+        /* point segment to previous node */
+        vec3_sub_vec3(target_position.f, child_position->f);          /* this computes the correct direction the segment should have */
+        if (fast_math)
+            vec3_normalize_fast(target_position.f);
+        else
+            vec3_normalize(target_position.f);
+        vec3_mul_scalar(target_position.f, segment_lengths[slot]);
+        vec3_add_vec3(target_position.f, child_position->f);          /* attach to child -- this is the new target for the next segment */
+    }
+
+    return target_position;
+}
+static ik_vec3_t
+solve_flat_chain_forwards_with_target_rotation(struct chain_flat_t* flat, uint32_t chain_idx)
+{
+    return solve_flat_chain_forwards_with_target_rotation_impl(flat, chain_idx, 0);
+}
+static ik_vec3_t
+solve_flat_chain_forwards_with_target_rotation_fast(struct chain_flat_t* flat, uint32_t chain_idx)
+{
+    return solve_flat_chain_forwards_with_target_rotation_impl(flat, chain_idx, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+static inline void
+solve_flat_chain_backwards_impl(struct chain_flat_t* flat, uint32_t chain_idx, int fast_math)
+{
+    const struct chain_flat_chain_t* chain = chain_flat_data(flat, chains, struct chain_flat_chain_t) + chain_idx;
+    const ikreal_t* segment_lengths = chain_flat_data(flat, segment_lengths, ikreal_t);
+    ik_vec3_t* positions = chain_flat_data(flat, positions, ik_vec3_t);
+    uint32_t slot = chain->slot_begin + chain->slot_count - 1;
+    ik_vec3_t target_position;
+
+    /* The base node of island chains stays where it is */
+    if (chain->parent >= 0)
+        positions[slot] = positions[chain->base_source];
+    target_position = positions[slot];
+
+    while (slot-- > chain->slot_begin)
+    {
+        /* point segment to child node and set target position to its beginning */
+        if (fast_math)
+            vec3_point_towards_fast(target_position.f, positions[slot + 1].f, positions[slot].f, segment_lengths[slot]);
+        else
+            vec3_point_towards(target_position.f, positions[slot + 1].f, positions[slot].f, segment_lengths[slot]);
+
+        /* move node to target */
+        positions[slot] = target_position;
+    }
+}
 static void
-solve_chain_backwards(struct chain_t* chain, ik_vec3_t target_position)
+solve_flat_chain_backwards(struct chain_flat_t* flat, uint32_t chain_idx)
 {
-    int node_idx = chain_length(chain) - 1;
+    solve_flat_chain_backwards_impl(flat, chain_idx, 0);
+}
+static void
+solve_flat_chain_backwards_fast(struct chain_flat_t* flat, uint32_t chain_idx)
+{
+    solve_flat_chain_backwards_impl(flat, chain_idx, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Places the mid and tip nodes of a two bone chain with the law of cosines,
+ * given the base position. The limb keeps bending in the plane spanned by the
+ * target direction and the current mid node. If the target is out of reach,
+ * the limb is stretched towards it.
+ */
+static inline void
+solve_flat_two_bone(ik_vec3_t* positions,
+                    const ikreal_t* segment_lengths,
+                    uint32_t slot_tip,
+                    const ik_vec3_t* target,
+                    int fast_math)
+{
+    const ik_vec3_t* base = &positions[slot_tip + 2];
+    ik_vec3_t* mid = &positions[slot_tip + 1];
+    ik_vec3_t* tip = &positions[slot_tip + 0];
+    ikreal_t upper = segment_lengths[slot_tip + 1];
+    ikreal_t lower = segment_lengths[slot_tip + 0];
+    ik_vec3_t direction, bend;
+    ikreal_t distance, cos_a, sin_a;
+
+    direction = *target;
+    vec3_sub_vec3(direction.f, base->f);
+    distance = vec3_length(direction.f);
+
+    if (distance >= upper + lower || distance < IK_EPSILON)
+    {
+        /* Unreachable: Stretch the limb, vec3_point_towards() handles distance == 0 */
+        vec3_point_towards(mid->f, base->f, target->f, upper);
+        vec3_point_towards(tip->f, mid->f, target->f, lower);
+        return;
+    }
+    vec3_div_scalar(direction.f, distance);
 
     /*
-     * The base node must be set to the target position before iterating.
-     * XXX: Why is this conditional?
+     * Bend direction is the part of the current upper segment orthogonal to
+     * the target direction. A straight limb has no bend plane, so pick any
+     * axis orthogonal to the target direction.
      */
-    if (node_idx > 1)
+    bend = *mid;
+    vec3_sub_vec3(bend.f, base->f);
     {
-        struct ik_node_t* base_node = chain_get_node(chain, node_idx);
-        base_node->position = target_position;
+        ik_vec3_t along = direction;
+        vec3_mul_scalar(along.f, vec3_dot(bend.f, direction.f));
+        vec3_sub_vec3(bend.f, along.f);
+    }
+    if (vec3_length_squared(bend.f) < upper * upper * 1e-6)
+    {
+        bend.x = 1; bend.y = 0; bend.z = 0;
+        if (direction.x * direction.x > 0.5)
+        {
+            bend.x = 0;
+            bend.y = 1;
+        }
+        vec3_cross(bend.f, direction.f);
     }
+    if (fast_math)
+        vec3_normalize_fast(bend.f);
+    else
+        vec3_normalize(bend.f);
+
+    /* Angle between the target direction and the upper segment. Clamped for targets closer than |upper - lower| */
+    cos_a = (upper * upper + distance * distance - lower * lower) / (2 * upper * distance);
+    if (cos_a > 1) cos_a = 1;
+    if (cos_a < -1) cos_a = -1;
+    sin_a = sqrt(1 - cos_a * cos_a);
+
+    vec3_mul_scalar(direction.f, cos_a * upper);
+    vec3_mul_scalar(bend.f, sin_a * upper);
+    *mid = *base;
+    vec3_add_vec3(mid->f, direction.f);
+    vec3_add_vec3(mid->f, bend.f);
+
+    if (fast_math)
+        vec3_point_towards_fast(tip->f, mid->f, target->f, lower);
+    else
+        vec3_point_towards(tip->f, mid->f, target->f, lower);
+}
+
+/*
+ * Backwards pass of the hybrid solver. Chains tagged by
+ * chain_flat_select_analytic_kernels() are solved in closed form, everything
+ * else falls back to the FABRIK backwards pass.
+ */
+static inline void
+solve_flat_chain_backwards_analytic_impl(struct chain_flat_t* flat, uint32_t chain_idx, int fast_math)
+{
+    const struct chain_flat_chain_t* chain = chain_flat_data(flat, chains, struct chain_flat_chain_t) + chain_idx;
+    const ikreal_t* segment_lengths = chain_flat_data(flat, segment_lengths, ikreal_t);
+    ik_vec3_t* positions = chain_flat_data(flat, positions, ik_vec3_t);
+    const ik_vec3_t* target;
+    uint32_t slot_base = chain->slot_begin + chain->slot_count - 1;
+
+    if (chain->kernel == CHAIN_FLAT_KERNEL_ITERATIVE)
+    {
+        solve_flat_chain_backwards_impl(flat, chain_idx, fast_math);
+        return;
+    }
+
+    if (chain->parent >= 0)
+        positions[slot_base] = positions[chain->base_source];
+    target = chain_flat_data(flat, effector_targets, ik_vec3_t) + chain->effector_index;
+
+    if (chain->kernel == CHAIN_FLAT_KERNEL_TWO_BONE)
+        solve_flat_two_bone(positions, segment_lengths, chain->slot_begin, target, fast_math);
+    else if (fast_math)
+        vec3_point_towards_fast(positions[chain->slot_begin].f, positions[slot_base].f, target->f, segment_lengths[chain->slot_begin]);
+    else
+        vec3_point_towards(positions[chain->slot_begin].f, positions[slot_base].f, target->f, segment_lengths[chain->slot_begin]);
+}
+static void
+solve_flat_chain_backwards_analytic(struct chain_flat_t* flat, uint32_t chain_idx)
+{
+    solve_flat_chain_backwards_analytic_impl(flat, chain_idx, 0);
+}
+static void
+solve_flat_chain_backwards_analytic_fast(struct chain_flat_t* flat, uint32_t chain_idx)
+{
+    solve_flat_chain_backwards_analytic_impl(flat, chain_idx, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+solve_flat_branch_forwards(struct chain_flat_t* flat,
+                           struct chain_flat_branch_t* branch,
+                           solve_flat_chain_forwards_func solve_chain)
+{
+    const struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    ik_vec3_t* accumulators = chain_flat_data(flat, accumulators, ik_vec3_t);
+    uint32_t chain_idx = branch->chain_begin + branch->chain_count;
 
     /*
-     * Iterate through each segment the other way around and apply the FABRIK
-     * algorithm.
+     * The first chain's parent is part of the trunk and is shared with the
+     * sibling branches, which may be running concurrently. Its result is
+     * accumulated by solve_flat_forwards() after joining.
      */
-    while (node_idx-- > 0)
+    while (--chain_idx != branch->chain_begin)
     {
-        struct ik_node_t* child_node  = chain_get_node(chain, node_idx + 0);
-        struct ik_node_t* parent_node = chain_get_node(chain, node_idx + 1);
+        ik_vec3_t target_position = solve_chain(flat, chain_idx);
+        vec3_add_vec3(accumulators[chains[chain_idx].parent].f, target_position.f);
+    }
+    branch->base_target = solve_chain(flat, branch->chain_begin);
+}
 
-        /* point segment to child node and set target position to its beginning */
-        ik_vec3_static_sub_vec3(target_position.f, child_node->position.f); /* child points to parent */
-        ik_vec3_static_normalize(target_position.f);                                  /* normalise */
-        ik_vec3_static_mul_scalar(target_position.f, -child_node->dist_to_parent);    /* parent points to child */
-        ik_vec3_static_add_vec3(target_position.f, parent_node->position.f);/* attach to parent -- this is the new target */
+/* ------------------------------------------------------------------------- */
+static void
+solve_flat_branch_backwards(struct chain_flat_t* flat,
+                            const struct chain_flat_branch_t* branch,
+                            solve_flat_chain_backwards_func solve_chain)
+{
+    uint32_t chain_end = branch->chain_begin + branch->chain_count;
+    uint32_t chain_idx;
 
-        /* move node to target */
-        child_node->position = target_position;
+    for (chain_idx = branch->chain_begin; chain_idx != chain_end; ++chain_idx)
+        solve_chain(flat, chain_idx);
+}
+
+/* ------------------------------------------------------------------------- */
+struct branch_context_t
+{
+    struct chain_flat_t* flat;
+    const struct chain_flat_island_t* island;
+    solve_flat_chain_forwards_func solve_chain_forwards;
+    solve_flat_chain_backwards_func solve_chain_backwards;
+};
+
+static void
+solve_flat_branch_forwards_task(void* context, uint32_t task_idx)
+{
+    struct branch_context_t* ctx = context;
+    struct chain_flat_branch_t* branches = chain_flat_data(ctx->flat, branches, struct chain_flat_branch_t);
+    solve_flat_branch_forwards(ctx->flat, &branches[ctx->island->branch_begin + task_idx], ctx->solve_chain_forwards);
+}
+
+static void
+solve_flat_branch_backwards_task(void* context, uint32_t task_idx)
+{
+    struct branch_context_t* ctx = context;
+    const struct chain_flat_branch_t* branches = chain_flat_data(ctx->flat, branches, struct chain_flat_branch_t);
+    solve_flat_branch_backwards(ctx->flat, &branches[ctx->island->branch_begin + task_idx], ctx->solve_chain_backwards);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+solve_flat_forwards(struct chain_flat_t* flat,
+                    const struct chain_flat_island_t* island,
+                    solve_flat_chain_forwards_func solve_chain,
+                    struct thread_pool_t* pool)
+{
+    const struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    const struct chain_flat_branch_t* branches = chain_flat_data(flat, branches, struct chain_flat_branch_t);
+    ik_vec3_t* accumulators = chain_flat_data(flat, accumulators, ik_vec3_t);
+    uint32_t chain_idx = island->chain_begin + island->chain_count;
+
+    memset(accumulators + island->chain_begin, 0, sizeof(ik_vec3_t) * island->chain_count);
+
+    /* Fork: Branches only write to their own chains */
+    if (island->branch_count > 0)
+    {
+        struct branch_context_t ctx;
+        ctx.flat = flat;
+        ctx.island = island;
+        ctx.solve_chain_forwards = solve_chain;
+        ctx.solve_chain_backwards = NULL;
+        if (pool != NULL)
+        {
+            thread_pool_run(pool, island->branch_count, solve_flat_branch_forwards_task, &ctx);
+        }
+        else
+        {
+            uint32_t task_idx;
+            for (task_idx = 0; task_idx != island->branch_count; ++task_idx)
+                solve_flat_branch_forwards_task(&ctx, task_idx);
+        }
     }
 
-    CHAIN_FOR_EACH_CHILD(chain, child)
-        solve_chain_backwards(child, target_position);
-    CHAIN_END_EACH
+    /*
+     * Join: Solve the trunk. Chains are stored in pre-order, so iterating
+     * them backwards guarantees that all child chains were solved before
+     * their parent chain. Branches are skipped as a whole, but their results
+     * are accumulated at the position they would have been solved at, so
+     * the sums don't depend on whether the island has branches.
+     */
+    while (chain_idx-- > island->chain_begin)
+    {
+        const struct chain_flat_chain_t* chain = &chains[chain_idx];
+        ik_vec3_t target_position;
+
+        if (chain->branch >= 0)
+        {
+            const struct chain_flat_branch_t* branch = &branches[chain->branch];
+            chain_idx = branch->chain_begin;
+            chain = &chains[chain_idx];
+            target_position = branch->base_target;
+        }
+        else
+        {
+            target_position = solve_chain(flat, chain_idx);
+        }
+
+        if (chain->parent >= 0)
+            vec3_add_vec3(accumulators[chain->parent].f, target_position.f);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+solve_flat_backwards(struct chain_flat_t* flat,
+                     const struct chain_flat_island_t* island,
+                     solve_flat_chain_backwards_func solve_chain,
+                     struct thread_pool_t* pool)
+{
+    const struct chain_flat_chain_t* chains = chain_flat_data(flat, chains, struct chain_flat_chain_t);
+    const struct chain_flat_branch_t* branches = chain_flat_data(flat, branches, struct chain_flat_branch_t);
+    uint32_t chain_end = island->chain_begin + island->chain_count;
+    uint32_t chain_idx;
+
+    /*
+     * Parent chains come before their children, so by the time a child chain
+     * is processed, its base node (our tip node) has already been solved.
+     * Solve the trunk first, which fixes the base positions of all branches.
+     */
+    for (chain_idx = island->chain_begin; chain_idx != chain_end; ++chain_idx)
+    {
+        const struct chain_flat_chain_t* chain = &chains[chain_idx];
+        if (chain->branch >= 0)
+        {
+            const struct chain_flat_branch_t* branch = &branches[chain->branch];
+            chain_idx = branch->chain_begin + branch->chain_count - 1;
+            continue;
+        }
+
+        solve_chain(flat, chain_idx);
+    }
+
+    /* Fork: The branches are independent once their base positions are known */
+    if (island->branch_count > 0)
+    {
+        struct branch_context_t ctx;
+        ctx.flat = flat;
+        ctx.island = island;
+        ctx.solve_chain_forwards = NULL;
+        ctx.solve_chain_backwards = solve_chain;
+        if (pool != NULL)
+        {
+            thread_pool_run(pool, island->branch_count, solve_flat_branch_backwards_task, &ctx);
+        }
+        else
+        {
+            uint32_t task_idx;
+            for (task_idx = 0; task_idx != island->branch_count; ++task_idx)
+                solve_flat_branch_backwards_task(&ctx, task_idx);
+        }
+    }
 }
 
 /* ------------------------------------------------------------------------- */
@@ -414,6 +837,7 @@ ik_solver_FABRIK_construct(struct ik_solver_t* solver)
     /* typical default values */
     solver->max_iterations = 20;
     solver->tolerance = 1e-3;
+    solver->stall_ratio = 1e-3;
 
     return IK_OK;
 }
@@ -426,31 +850,30 @@ ik_solver_FABRIK_destruct(struct ik_solver_t* solver)
 
 /* ------------------------------------------------------------------------- */
 static void
-store_initial_transform_for_chain(struct chain_t* chain)
+store_initial_transform(struct chain_flat_t* flat)
 {
-    CHAIN_FOR_EACH_NODE(chain, node_base)
-        struct ik_node_FABRIK_t* node = (struct ik_node_FABRIK_t*)node_base;
-        node->initial_position = node->position;
-        node->initial_rotation = node->rotation;
-    CHAIN_END_EACH
+    struct ik_node_t** pose_nodes = chain_flat_data(flat, pose_nodes, struct ik_node_t*);
+    const ik_vec3_t* global_positions = chain_flat_data(flat, pose_global_positions, ik_vec3_t);
+    uint32_t pose_idx = vector_count(&flat->pose_nodes);
 
-    CHAIN_FOR_EACH_CHILD(chain, child)
-        store_initial_transform_for_chain(child);
-    CHAIN_END_EACH
-}
-static void
-store_initial_transform(const struct vector_t* chain_list)
-{
-    VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
-        store_initial_transform_for_chain(chain);
-    VECTOR_END_EACH
+    /*
+     * Every node referenced by the chains appears exactly once in the pose
+     * arrays, so there's no need to walk the chain tree. Positions are taken
+     * from the cached global pose, rotations are stored as they are.
+     */
+    while (pose_idx-- > 0)
+    {
+        struct ik_node_FABRIK_t* node = (struct ik_node_FABRIK_t*)pose_nodes[pose_idx];
+        node->initial_position = global_positions[pose_idx];
+        node->initial_rotation = node->rotation;
+    }
 }
 
 /* ------------------------------------------------------------------------- */
 static void
-calculate_joint_rotations_for_chain(struct chain_t* chain);
+calculate_joint_rotations_for_chain(struct chain_t* chain, int fast_math);
 static void
-recurse_into_children(struct chain_t* chain)
+recurse_into_children(struct chain_t* chain, int fast_math)
 {
     int average_count = 0;
     ik_quat_t average_rotation = ik_quat_static_quat(0, 0, 0, 0);
@@ -458,7 +881,7 @@ recurse_into_children(struct chain_t* chain)
     /* Recurse into children chains */
     CHAIN_FOR_EACH_CHILD(chain, child)
         ik_quat_t rotation;
-        calculate_joint_rotations_for_chain(child);
+        calculate_joint_rotations_for_chain(child, fast_math);
 
         rotation = chain_get_base_node(chain)->rotation;
 
@@ -480,14 +903,14 @@ recurse_into_children(struct chain_t* chain)
     if (average_count > 0)
     {
         ik_quat_static_div_scalar(average_rotation.f, average_count);
-        ik_quat_static_normalize(average_rotation.f);
+        quat_normalize(average_rotation.f);
         chain_get_tip_node(chain)->rotation = average_rotation;
     }
 }
 
 /* ------------------------------------------------------------------------- */
 static void
-calculate_delta_rotation_of_each_segment(struct chain_t* chain)
+calculate_delta_rotation_of_each_segment(struct chain_t* chain, int fast_math)
 {
     /*
      * Calculate all of the delta rotations of the joints and store them into
@@ -502,15 +925,18 @@ calculate_delta_rotation_of_each_segment(struct chain_t* chain)
         /* calculate vectors for original and solved segments */
         ik_vec3_t segment_original = child_node->initial_position;
         ik_vec3_t segment_solved   = child_node->position;
-        ik_vec3_static_sub_vec3(segment_original.f, parent_node->initial_position.f);
-        ik_vec3_static_sub_vec3(segment_solved.f, parent_node->position.f);
-        ik_quat_static_angle(parent_node->rotation.f, segment_original.f, segment_solved.f);
+        vec3_sub_vec3(segment_original.f, parent_node->initial_position.f);
+        vec3_sub_vec3(segment_solved.f, parent_node->position.f);
+        if (fast_math)
+            quat_angle_fast(parent_node->rotation.f, segment_original.f, segment_solved.f);
+        else
+            ik_quat_static_angle(parent_node->rotation.f, segment_original.f, segment_solved.f);
     }
 }
 
 /* ------------------------------------------------------------------------- */
 static void
-calculate_joint_rotations_for_chain(struct chain_t* chain)
+calculate_joint_rotations_for_chain(struct chain_t* chain, int fast_math)
 {
     struct ik_node_t* effector_node;
 
@@ -531,8 +957,8 @@ calculate_joint_rotations_for_chain(struct chain_t* chain)
      * The rotation of the base joint in the chain is returned so it can be
      * averaged by parent chains.
      */
-    recurse_into_children(chain);
-    calculate_delta_rotation_of_each_segment(chain);
+    recurse_into_children(chain, fast_math);
+    calculate_delta_rotation_of_each_segment(chain, fast_math);
 
     /*
      * It's not possible to calculate rotations for the end effector nodes,
@@ -554,39 +980,110 @@ calculate_joint_rotations_for_chain(struct chain_t* chain)
      */
     CHAIN_FOR_EACH_NODE(chain, node_base)
         struct ik_node_FABRIK_t* node = (struct ik_node_FABRIK_t*)node_base;
-        ik_quat_static_mul_quat(node->rotation.f, node->initial_rotation.f);
+        quat_mul_quat(node->rotation.f, node->initial_rotation.f);
     CHAIN_END_EACH
 }
 static void
-calculate_joint_rotations(struct vector_t* chain_list)
+calculate_joint_rotations(struct vector_t* chain_list, int fast_math)
 {
     VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
-        calculate_joint_rotations_for_chain(chain);
+        calculate_joint_rotations_for_chain(chain, fast_math);
     VECTOR_END_EACH
 }
 
 /* ------------------------------------------------------------------------- */
-ikret_t
-ik_solver_FABRIK_solve(struct ik_solver_t* solver)
+struct convergence_t
 {
-    ikret_t result = IK_OK;
-    int iteration = solver->max_iterations;
-    ikreal_t tolerance_squared = solver->tolerance * solver->tolerance;
+    /* sum of squared distances of all effectors to their actual targets */
+    ikreal_t error;
+    ikreal_t previous_error;
+    /* set to 0 as soon as one effector lies outside of its tolerance */
+    int all_in_range;
+};
 
-    /* Tree is in local space -- FABRIK needs only global node positions */
-    ik_transform_chain_list(&solver->chain_list, TR_L2G | TR_TRANSLATIONS);
+static void
+convergence_begin_iteration(struct convergence_t* convergence)
+{
+    convergence->previous_error = convergence->error;
+    convergence->error = 0;
+    convergence->all_in_range = 1;
+}
+
+static void
+convergence_add_effector(struct convergence_t* convergence,
+                         const struct ik_solver_t* solver,
+                         const struct ik_effector_t* effector,
+                         const ik_vec3_t* position,
+                         const ik_vec3_t* target)
+{
+    ikreal_t distance_squared;
+    ikreal_t tolerance = effector->tolerance > 0 ? effector->tolerance : solver->tolerance;
+    ik_vec3_t diff = *position;
+
+    vec3_sub_vec3(diff.f, target->f);
+    distance_squared = vec3_length_squared(diff.f);
+
+    convergence->error += distance_squared;
+    if (distance_squared > tolerance * tolerance)
+        convergence->all_in_range = 0;
+}
+
+/*!
+ * Returns non-zero if the solver should stop iterating. Iteration stops if
+ * every effector is within its tolerance (in which case *result is set to
+ * IK_RESULT_CONVERGED), or if the error didn't improve by at least
+ * solver->stall_ratio compared to the previous iteration.
+ */
+static int
+convergence_should_terminate(const struct convergence_t* convergence,
+                             const struct ik_solver_t* solver,
+                             int iteration,
+                             ikret_t* result)
+{
+    if (convergence->all_in_range)
+    {
+        *result = IK_RESULT_CONVERGED;
+        return 1;
+    }
+
+    if (iteration > 0 && solver->stall_ratio > 0 &&
+        convergence->previous_error - convergence->error <= convergence->previous_error * solver->stall_ratio)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+solve_chain_tree(struct ik_solver_t* solver)
+{
+    ikret_t result = IK_OK;
+    int iteration;
+    struct chain_flat_t* flat = solver->chain_flat;
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    struct convergence_t convergence;
 
     /*
-     * Joint rotations are calculated by comparing positional differences
-     * before and after solving the tree. This comparison needs to occur in
-     * global space (doesn't work in local as far as I can see). Store the
-     * positions and locations before solving for later.
+     * Constraints operate on ik_node_t objects, so this path works directly
+     * on the chain tree.
      */
-    if (solver->flags & IK_ENABLE_JOINT_ROTATIONS)
-        store_initial_transform(&solver->chain_list);
-
-    while (iteration-- > 0)
+    convergence.error = 0;
+    for (iteration = 0; ; ++iteration)
     {
+        /* Check if all effectors are within range */
+        convergence_begin_iteration(&convergence);
+        VECTOR_FOR_EACH(&flat->effector_slots, uint32_t, slot)
+            struct ik_node_t* node = nodes[*slot];
+            convergence_add_effector(&convergence, solver, node->effector,
+                                     &node->position, &node->effector->_actual_target);
+        VECTOR_END_EACH
+        if (convergence_should_terminate(&convergence, solver, iteration, &result))
+            break;
+        if (iteration >= solver->max_iterations)
+            break;
+
         /* Actual algorithm here */
         SOLVER_FOR_EACH_CHAIN(solver, chain)
             struct  ik_node_t* base_node;
@@ -607,29 +1104,440 @@ ik_solver_FABRIK_solve(struct ik_solver_t* solver)
             else
                 solve_chain_forwards(chain);
 
-            if (solver->flags & IK_ENABLE_CONSTRAINTS)
-                solve_chain_backwards_with_constraints(chain, base_node->position, base_node->rotation, base_node->position);
-            else
-                solve_chain_backwards(chain, base_node->position);
+            solve_chain_backwards_with_constraints(chain, base_node->position, base_node->rotation, base_node->position);
         SOLVER_END_EACH
+    }
+
+    solver->iterations_used = iteration;
+
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+iterate_island(struct ik_solver_t* solver,
+               struct chain_flat_island_t* island,
+               struct thread_pool_t* branch_pool)
+{
+    ikret_t result = IK_OK;
+    int iteration;
+    struct chain_flat_t* flat = solver->chain_flat;
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    const ik_vec3_t* positions = chain_flat_data(flat, positions, ik_vec3_t);
+    const ik_vec3_t* effector_targets = chain_flat_data(flat, effector_targets, ik_vec3_t);
+    const uint32_t* effector_slots = chain_flat_data(flat, effector_slots, uint32_t);
+    uint32_t effector_end = island->effector_begin + island->effector_count;
+    struct convergence_t convergence;
+    solve_flat_chain_forwards_func solve_forwards;
+    solve_flat_chain_backwards_func solve_backwards;
+    int analytic_only;
+
+    /*
+     * Analytic kernels (see chain_flat_select_analytic_kernels()) only place
+     * nodes by position, so they are not used with target rotations.
+     */
+    int analytic = island->analytic_chain_count > 0 && (solver->flags & IK_ENABLE_TARGET_ROTATIONS) == 0;
+
+    if (solver->flags & IK_ENABLE_FAST_MATH)
+    {
+        solve_forwards = (solver->flags & IK_ENABLE_TARGET_ROTATIONS) ?
+            solve_flat_chain_forwards_with_target_rotation_fast : solve_flat_chain_forwards_fast;
+        solve_backwards = analytic ? solve_flat_chain_backwards_analytic_fast : solve_flat_chain_backwards_fast;
+    }
+    else
+    {
+        solve_forwards = (solver->flags & IK_ENABLE_TARGET_ROTATIONS) ?
+            solve_flat_chain_forwards_with_target_rotation : solve_flat_chain_forwards;
+        solve_backwards = analytic ? solve_flat_chain_backwards_analytic : solve_flat_chain_backwards;
+    }
+
+    /*
+     * Analytic chains are leaf chains, so this can only be an island
+     * consisting of a single one. Its base doesn't move, so a single
+     * backwards pass solves it exactly and there's nothing to iterate on.
+     */
+    analytic_only = analytic && island->analytic_chain_count == island->chain_count;
+
+    convergence.error = 0;
+    for (iteration = 0; ; ++iteration)
+    {
+        uint32_t effector_idx;
 
         /* Check if all effectors are within range */
-        SOLVER_FOR_EACH_EFFECTOR_NODE(solver, node)
-            ik_vec3_t diff = node->position;
-            ik_vec3_static_sub_vec3(diff.f, node->effector->target_position.f);
-            if (ik_vec3_static_length_squared(diff.f) > tolerance_squared)
+        convergence_begin_iteration(&convergence);
+        for (effector_idx = island->effector_begin; effector_idx != effector_end; ++effector_idx)
+        {
+            uint32_t slot = effector_slots[effector_idx];
+            convergence_add_effector(&convergence, solver, nodes[slot]->effector,
+                                     &positions[slot], &effector_targets[effector_idx]);
+        }
+        if (convergence_should_terminate(&convergence, solver, iteration, &result))
+            break;
+        if (iteration >= solver->max_iterations || (analytic_only && iteration > 0))
+            break;
+
+        if (!analytic_only)
+            solve_flat_forwards(flat, island, solve_forwards, branch_pool);
+        solve_flat_backwards(flat, island, solve_backwards, branch_pool);
+    }
+
+    island->result = result;
+    island->iterations_used = iteration;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+iterate_island_task(void* context, uint32_t island_idx)
+{
+    struct ik_solver_t* solver = context;
+    iterate_island(solver, chain_flat_data(solver->chain_flat, islands, struct chain_flat_island_t) + island_idx, NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+iterate_chain_flat(struct ik_solver_t* solver, int32_t* iterations_used)
+{
+    ikret_t result = IK_RESULT_CONVERGED;
+    struct chain_flat_t* flat = solver->chain_flat;
+
+    /*
+     * Islands don't share any data in the flat arrays and each one checks for
+     * convergence on its own, so they can be solved in any order or in
+     * parallel. The results are reduced afterwards.
+     *
+     * The pool can't be used for islands and branches at the same time. If
+     * there are fewer islands than threads, the pool is better spent on
+     * solving the branches of each island in parallel instead.
+     */
+    if (solver->thread_pool != NULL &&
+        (vector_count(&flat->branches) == 0 ||
+         vector_count(&flat->islands) >= thread_pool_thread_count(solver->thread_pool)))
+    {
+        thread_pool_run(solver->thread_pool, vector_count(&flat->islands), iterate_island_task, solver);
+    }
+    else
+    {
+        VECTOR_FOR_EACH(&flat->islands, struct chain_flat_island_t, island)
+            iterate_island(solver, island, solver->thread_pool);
+        VECTOR_END_EACH
+    }
+
+    *iterations_used = 0;
+    VECTOR_FOR_EACH(&flat->islands, struct chain_flat_island_t, island)
+        if (island->result != IK_RESULT_CONVERGED)
+            result = IK_OK;
+        if (island->iterations_used > *iterations_used)
+            *iterations_used = island->iterations_used;
+    VECTOR_END_EACH
+
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+solve_chain_flat(struct ik_solver_t* solver)
+{
+    ikret_t result;
+
+    /*
+     * Load positions and targets into the flat arrays once and iterate on
+     * them linearly. The caller writes the results back to the nodes.
+     */
+    chain_flat_gather(solver->chain_flat, solver->flags);
+
+    /* Start from the previous solution instead of the pose that was passed in */
+    if (solver->flags & IK_ENABLE_WARM_START)
+        chain_flat_warm_start(solver->chain_flat, solver->warm_start_blend, solver->warm_start_threshold);
+    else
+        solver->chain_flat->has_warm_start = 0;
+
+    result = iterate_chain_flat(solver, &solver->iterations_used);
+
+    if (solver->flags & IK_ENABLE_WARM_START)
+        chain_flat_store_warm_start(solver->chain_flat);
+
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_FABRIK_solve(struct ik_solver_t* solver)
+{
+    ikret_t result;
+    struct chain_flat_t* flat = solver->chain_flat;
+
+    /*
+     * Tree is in local space -- FABRIK needs only global node positions. These
+     * are cached between solves and only re-derived for sub-trees whose local
+     * transforms changed since the last solve.
+     */
+    chain_flat_update_global_pose(flat);
+
+    /*
+     * Without constraints and joint rotations the nodes never have to be in
+     * global space. Only the local positions of nodes that were actually moved
+     * are written back.
+     */
+    if ((solver->flags & (IK_ENABLE_CONSTRAINTS | IK_ENABLE_JOINT_ROTATIONS)) == 0)
+    {
+        result = solve_chain_flat(solver);
+        chain_flat_scatter_local(flat);
+        return result;
+    }
+
+    /*
+     * Joint rotations are calculated by comparing positional differences
+     * before and after solving the tree. This comparison needs to occur in
+     * global space (doesn't work in local as far as I can see). Store the
+     * positions and locations before solving for later. If rotations are
+     * still pending from previous solves, the transform they are relative to
+     * was already stored and is kept.
+     */
+    if ((solver->flags & IK_ENABLE_JOINT_ROTATIONS) && flat->has_pending_rotations == 0)
+        store_initial_transform(flat);
+
+    /*
+     * Lazy rotations: Only the positions are written back, relative to the
+     * unchanged rotations, same as without joint rotations. The rotations
+     * are calculated by ik_solver_FABRIK_update_rotations().
+     */
+    if ((solver->flags & (IK_ENABLE_CONSTRAINTS | IK_ENABLE_LAZY_ROTATIONS)) == IK_ENABLE_LAZY_ROTATIONS)
+    {
+        flat->has_pending_rotations = 1;
+        result = solve_chain_flat(solver);
+        chain_flat_scatter_local(flat);
+        return result;
+    }
+    flat->has_pending_rotations = 0;
+
+    chain_flat_load_global_pose(flat);
+
+    if (solver->flags & IK_ENABLE_CONSTRAINTS)
+        result = solve_chain_tree(solver);
+    else
+    {
+        result = solve_chain_flat(solver);
+        chain_flat_scatter(flat);
+    }
+
+    if (solver->flags & IK_ENABLE_JOINT_ROTATIONS)
+        calculate_joint_rotations(&solver->chain_list, solver->flags & IK_ENABLE_FAST_MATH);
+
+    /*
+     * Transform back to local space now that solving is complete. The cache
+     * notices the changed local transforms during the next solve.
+     */
+    chain_flat_transform(flat, TR_G2L | TR_TRANSLATIONS);
+
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_FABRIK_update_rotations(struct ik_solver_t* solver)
+{
+    struct chain_flat_t* flat = solver->chain_flat;
+
+    if (flat->has_pending_rotations == 0)
+        return IK_OK;
+
+    /*
+     * The nodes hold the solved positions in local space relative to the old
+     * rotations, and the initial transform of the first lazy solve. From here
+     * on this is the same as the end of a solve with joint rotations.
+     */
+    chain_flat_update_global_pose(flat);
+    chain_flat_load_global_pose(flat);
+    calculate_joint_rotations(&solver->chain_list, solver->flags & IK_ENABLE_FAST_MATH);
+    chain_flat_transform(flat, TR_G2L | TR_TRANSLATIONS);
+    flat->has_pending_rotations = 0;
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+solve_instances_lanes_island(struct ik_solver_t* solver,
+                             struct ik_instances_t* instances,
+                             uint32_t first_instance,
+                             uint32_t lane_count,
+                             const struct chain_flat_island_t* island,
+                             const struct chain_lanes_kernel_t* kernel,
+                             int float_lanes)
+{
+    int iteration;
+    uint32_t lane;
+    uint32_t active_lanes = lane_count;
+    int lane_active[CHAIN_LANES_FLOAT_WIDTH];
+    struct convergence_t convergence[CHAIN_LANES_FLOAT_WIDTH];
+    struct chain_flat_t* flat = solver->chain_flat;
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    const uint32_t* effector_slots = chain_flat_data(flat, effector_slots, uint32_t);
+    const struct chain_lanes_vec3_t* positions = chain_flat_data(flat, lane_positions, struct chain_lanes_vec3_t);
+    const struct chain_lanes_vec3_t* targets = chain_flat_data(flat, lane_targets, struct chain_lanes_vec3_t);
+    const struct chain_lanes_vec3f_t* positions_float = chain_flat_data(flat, lane_positions, struct chain_lanes_vec3f_t);
+    const struct chain_lanes_vec3f_t* targets_float = chain_flat_data(flat, lane_targets, struct chain_lanes_vec3f_t);
+    uint32_t effector_end = island->effector_begin + island->effector_count;
+
+    for (lane = 0; lane != lane_count; ++lane)
+    {
+        lane_active[lane] = 1;
+        convergence[lane].error = 0;
+    }
+
+    /*
+     * Every lane runs the same passes, but each one terminates on its own.
+     * As soon as a lane is done, its positions are written out and further
+     * results computed for it are ignored.
+     */
+    for (iteration = 0; ; ++iteration)
+    {
+        for (lane = 0; lane != lane_count; ++lane)
+        {
+            uint32_t effector_idx;
+            uint32_t instance_idx = first_instance + lane;
+            ikret_t lane_result = IK_OK;
+
+            if (lane_active[lane] == 0)
+                continue;
+
+            convergence_begin_iteration(&convergence[lane]);
+            for (effector_idx = island->effector_begin; effector_idx != effector_end; ++effector_idx)
             {
-                result = IK_RESULT_CONVERGED;
-                break;
+                uint32_t slot = effector_slots[effector_idx];
+                ik_vec3_t position, target;
+                if (float_lanes)
+                {
+                    position = chain_lanes_get_float(&positions_float[slot], lane);
+                    target = chain_lanes_get_float(&targets_float[effector_idx], lane);
+                }
+                else
+                {
+                    position = chain_lanes_get(&positions[slot], lane);
+                    target = chain_lanes_get(&targets[effector_idx], lane);
+                }
+                convergence_add_effector(&convergence[lane], solver, nodes[slot]->effector, &position, &target);
             }
-        SOLVER_END_EACH
+            if (convergence_should_terminate(&convergence[lane], solver, iteration, &lane_result) == 0 &&
+                iteration < solver->max_iterations)
+            {
+                continue;
+            }
+
+            /* Same reduction as iterate_chain_flat() */
+            if (float_lanes)
+                chain_lanes_scatter_float(flat, island, lane, instances->positions + instance_idx * instances->node_count);
+            else
+                chain_lanes_scatter(flat, island, lane, instances->positions + instance_idx * instances->node_count);
+            if (lane_result != IK_RESULT_CONVERGED)
+                instances->results[instance_idx] = IK_OK;
+            if (iteration > instances->iterations_used[instance_idx])
+                instances->iterations_used[instance_idx] = iteration;
+            lane_active[lane] = 0;
+            --active_lanes;
+        }
+        if (active_lanes == 0)
+            break;
+
+        if (float_lanes)
+        {
+            kernel->solve_forwards_float(flat, island);
+            kernel->solve_backwards_float(flat, island);
+        }
+        else
+        {
+            kernel->solve_forwards(flat, island);
+            kernel->solve_backwards(flat, island);
+        }
     }
+}
 
-    if (solver->flags & IK_ENABLE_JOINT_ROTATIONS)
-        calculate_joint_rotations(&solver->chain_list);
+/* ------------------------------------------------------------------------- */
+static void
+solve_instances_lanes(struct ik_solver_t* solver,
+                      struct ik_instances_t* instances,
+                      uint32_t first_instance,
+                      uint32_t lane_count,
+                      const struct chain_lanes_kernel_t* kernel,
+                      int float_lanes)
+{
+    uint32_t lane;
+    struct chain_flat_t* flat = solver->chain_flat;
+    const ik_vec3_t* positions = instances->positions + first_instance * instances->node_count;
+    const ik_vec3_t* targets = instances->targets + first_instance * instances->effector_count;
+
+    if (float_lanes)
+        chain_lanes_gather_float(flat, positions, instances->node_count, targets, instances->effector_count, lane_count);
+    else
+        chain_lanes_gather(flat, positions, instances->node_count, targets, instances->effector_count, lane_count);
+
+    for (lane = 0; lane != lane_count; ++lane)
+    {
+        instances->results[first_instance + lane] = IK_RESULT_CONVERGED;
+        instances->iterations_used[first_instance + lane] = 0;
+    }
+
+    VECTOR_FOR_EACH(&flat->islands, struct chain_flat_island_t, island)
+        solve_instances_lanes_island(solver, instances, first_instance, lane_count, island, kernel, float_lanes);
+    VECTOR_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_FABRIK_solve_instances(struct ik_solver_t* solver, struct ik_instances_t* instances)
+{
+    uint32_t instance_idx;
+    ikret_t result = IK_RESULT_CONVERGED;
+    struct chain_flat_t* flat = solver->chain_flat;
+
+    if (instances->node_count != vector_count(&flat->pose_nodes) ||
+        instances->effector_count != vector_count(&flat->effector_slots))
+    {
+        IKAPI.log.message("Instances don't match the solver's tree. Did you rebuild the solver after creating them?");
+        return IK_INSTANCES_DONT_MATCH_TREE;
+    }
+
+    /*
+     * All instances share the same flattened chain program (segment lengths,
+     * rotation weights, effector tolerances). Without target rotations,
+     * CHAIN_LANES_WIDTH (or CHAIN_LANES_FLOAT_WIDTH) instances are solved at
+     * once using SIMD.
+     */
+    if ((solver->flags & IK_ENABLE_TARGET_ROTATIONS) == 0)
+    {
+        const struct chain_lanes_kernel_t* kernel = chain_lanes_kernel();
+        int float_lanes = (solver->flags & IK_ENABLE_FLOAT_INSTANCES) != 0;
+        uint32_t width = float_lanes ? CHAIN_LANES_FLOAT_WIDTH : CHAIN_LANES_WIDTH;
+        for (instance_idx = 0; instance_idx < instances->count; instance_idx += width)
+        {
+            uint32_t lane_count = instances->count - instance_idx;
+            if (lane_count > width)
+                lane_count = width;
+            solve_instances_lanes(solver, instances, instance_idx, lane_count, kernel, float_lanes);
+        }
+    }
+    else
+    {
+        /*
+         * Target directions are calculated per instance, so only positions and
+         * targets are swapped in and out of the flat arrays for each instance.
+         */
+        for (instance_idx = 0; instance_idx != instances->count; ++instance_idx)
+        {
+            ik_vec3_t* positions = instances->positions + instance_idx * instances->node_count;
+            uint32_t effector_offset = instance_idx * instances->effector_count;
+
+            chain_flat_gather_array(flat, solver->flags, positions,
+                                    instances->targets + effector_offset,
+                                    instances->target_rotations + effector_offset);
+            instances->results[instance_idx] = iterate_chain_flat(solver, &instances->iterations_used[instance_idx]);
+            chain_flat_scatter_array(flat, positions);
+        }
+    }
 
-    /* Transform back to local space now that solving is complete */
-    ik_transform_chain_list(&solver->chain_list, TR_G2L | TR_TRANSLATIONS);
+    for (instance_idx = 0; instance_idx != instances->count; ++instance_idx)
+        if (instances->results[instance_idx] != IK_RESULT_CONVERGED)
+            result = IK_OK;
 
     return result;
 }
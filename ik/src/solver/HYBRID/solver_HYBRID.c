@@ -0,0 +1,23 @@
+#include "ik/solver_HYBRID.h"
+#include "ik/chain_flat.h"
+
+/*
+ * Hybrid analytic/iterative solver.
+ *
+ * Behaves exactly like FABRIK, except that leaf chains with one or two
+ * segments (the limbs hanging off a spine, in the case of a humanoid) are
+ * placed in closed form during the backwards pass, using the same math as the
+ * ONE_BONE and TWO_BONE solvers. Unlike those, the hybrid solver accepts any
+ * tree: All remaining chains are solved with FABRIK and the forwards pass
+ * still lets the limbs pull on the chains they are attached to.
+ *
+ * Islands made of a single such limb don't need to iterate at all.
+ */
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_HYBRID_rebuild(struct ik_solver_t* solver)
+{
+    chain_flat_select_analytic_kernels(solver->chain_flat);
+    return IK_OK;
+}
@@ -1,12 +1,94 @@
 #include "ik/solver_MSS.h"
+#include "ik/chain_flat.h"
 #include "ik/ik.h"
+#include "ik/math_inline.h"
 #include <math.h>
+#include <string.h>
+
+/*
+ * Every node referenced by the chains is a point mass and every segment is a
+ * damped spring between a node and its parent. Effectors pull their nodes
+ * towards their targets with springs of the same stiffness. Island base
+ * nodes are animated, not simulated, i.e. they follow the pose passed in.
+ *
+ * The state of the whole system is stored in a single contiguous array of
+ * 6 * node_count reals: All positions (indexed by pose index, see
+ * chain_flat.h) followed by all velocities. The integrator only ever combines
+ * such arrays element-wise, which the compiler turns into SIMD loops, and
+ * all arrays are allocated by rebuild() so solve() doesn't allocate.
+ */
+
+enum mss_array_e
+{
+    MSS_STATE,      /* positions followed by velocities */
+    MSS_DERIVATIVE, /* derivative of the state, k1 */
+    MSS_K2,
+    MSS_K3,
+    MSS_K4,
+    MSS_K5,
+    MSS_K6,
+    MSS_STAGE,      /* state the next derivative is evaluated at */
+    MSS_RESULT,     /* state after the step */
+    MSS_ERROR,      /* estimated error of the step */
+
+    MSS_ARRAY_COUNT
+};
 
 struct mss_solver_t
 {
-    IK_SOLVER_HEAD
+    IK_SOLVER_MSS_HEAD
+
+    /* Number of simulated nodes (length of pose_nodes) */
+    uint32_t node_count;
+    /* MSS_ARRAY_COUNT arrays of 6 * node_count reals, see enum mss_array_e */
+    struct vector_t arrays;
+    /* ikreal_t, per node. 0 for island bases, 1 for all other nodes */
+    struct vector_t inverse_masses;
+    /* ikreal_t, per node. Length of the segment to the parent node */
+    struct vector_t rest_lengths;
+    /* uint32_t, per effector. Pose index of the effector's node */
+    struct vector_t effector_nodes;
+    /* Step size the adaptive integrator starts with, from the last solve */
+    ikreal_t step_size;
+    /* Whether the state holds the result of the previous solve */
+    int has_state;
 };
 
+/* Cash-Karp Runge-Kutta coefficients */
+#define b21 (1.0 / 5.0)
+#define b31 (3.0 / 40.0)
+#define b32 (9.0 / 40.0)
+#define b41 (3.0 / 10.0)
+#define b42 (-9.0 / 10.0)
+#define b43 (6.0 / 5.0)
+#define b51 (-11.0 / 54.0)
+#define b52 (5.0 / 2.0)
+#define b53 (-70.0 / 27.0)
+#define b54 (35.0 / 27.0)
+#define b61 (1631.0 / 55296.0)
+#define b62 (175.0 / 512.0)
+#define b63 (575.0 / 13824.0)
+#define b64 (44275.0 / 110592.0)
+#define b65 (253.0 / 4096.0)
+#define c1  (37.0 / 378.0)
+#define c3  (250.0 / 621.0)
+#define c4  (125.0 / 594.0)
+#define c6  (512.0 / 1771.0)
+#define dc1 (c1 - 2825.0 / 27648.0)
+#define dc3 (c3 - 18575.0 / 48384.0)
+#define dc4 (c4 - 13525.0 / 55296.0)
+#define dc5 (-277.0 / 14336.0)
+#define dc6 (c6 - 1.0 / 4.0)
+
+/* Step size control */
+#define SAFETY 0.9
+#define PGROW  -0.2
+#define PSHRNK -0.25
+#define ERRCON 1.89e-4  /* (5/SAFETY) raised to the power (1/PGROW) */
+
+#define mss_array(mss, array) \
+    (((ikreal_t*)(mss)->arrays.data) + (array) * 6 * (mss)->node_count)
+
 /* ------------------------------------------------------------------------- */
 uintptr_t
 ik_solver_MSS_type_size(void)
@@ -18,6 +100,29 @@ ik_solver_MSS_type_size(void)
 ikret_t
 ik_solver_MSS_construct(struct ik_solver_t* solver)
 {
+    struct mss_solver_t* mss = (struct mss_solver_t*)solver;
+
+    /* Upper bound for the number of adaptive steps per solve */
+    solver->max_iterations = 100;
+    solver->tolerance = 1e-3;
+
+    mss->timestep = 1.0 / 60;
+    mss->substeps = 0;
+    mss->error_tolerance = 1e-3;
+    mss->stiffness = 1000;
+    mss->damping = 10;
+    mss->gravity.x = 0;
+    mss->gravity.y = 0;
+    mss->gravity.z = 0;
+
+    mss->node_count = 0;
+    mss->step_size = 0;
+    mss->has_state = 0;
+    vector_construct(&mss->arrays, sizeof(ikreal_t));
+    vector_construct(&mss->inverse_masses, sizeof(ikreal_t));
+    vector_construct(&mss->rest_lengths, sizeof(ikreal_t));
+    vector_construct(&mss->effector_nodes, sizeof(uint32_t));
+
     return IK_OK;
 }
 
@@ -25,249 +130,362 @@ ik_solver_MSS_construct(struct ik_solver_t* solver)
 void
 ik_solver_MSS_destruct(struct ik_solver_t* solver)
 {
+    struct mss_solver_t* mss = (struct mss_solver_t*)solver;
+
+    vector_clear_free(&mss->effector_nodes);
+    vector_clear_free(&mss->rest_lengths);
+    vector_clear_free(&mss->inverse_masses);
+    vector_clear_free(&mss->arrays);
 }
 
 /* ------------------------------------------------------------------------- */
 ikret_t
 ik_solver_MSS_rebuild(struct ik_solver_t* solver)
 {
+    ikret_t result;
+    struct mss_solver_t* mss = (struct mss_solver_t*)solver;
+    struct chain_flat_t* flat = solver->chain_flat;
+    const int32_t* parents = chain_flat_data(flat, pose_parents, int32_t);
+    const uint32_t* effector_slots = chain_flat_data(flat, effector_slots, uint32_t);
+    const uint32_t* slot_pose_index = chain_flat_data(flat, slot_pose_index, uint32_t);
+    uint32_t node_count = vector_count(&flat->pose_nodes);
+    uint32_t effector_count = vector_count(&flat->effector_slots);
+    uint32_t i;
+
+    /* Memory is kept across rebuilds, so this only allocates if the tree grew */
+    if ((result = vector_resize(&mss->arrays, MSS_ARRAY_COUNT * 6 * node_count)) != IK_OK)
+        return result;
+    if ((result = vector_resize(&mss->inverse_masses, node_count)) != IK_OK)
+        return result;
+    if ((result = vector_resize(&mss->rest_lengths, node_count)) != IK_OK)
+        return result;
+    if ((result = vector_resize(&mss->effector_nodes, effector_count)) != IK_OK)
+        return result;
+
+    for (i = 0; i != node_count; ++i)
+        ((ikreal_t*)mss->inverse_masses.data)[i] = parents[i] < 0 ? 0.0 : 1.0;
+    for (i = 0; i != effector_count; ++i)
+        ((uint32_t*)mss->effector_nodes.data)[i] = slot_pose_index[effector_slots[i]];
+
+    /* The simulation starts over from the pose passed to the next solve */
+    mss->node_count = node_count;
+    mss->step_size = 0;
+    mss->has_state = 0;
+
     return IK_OK;
 }
 
-
 /* ------------------------------------------------------------------------- */
-ikret_t
-ik_solver_MSS_solve(struct ik_solver_t* solver)
+/*
+ * Writes the time derivative of the state y to dydx, i.e. the velocities
+ * followed by the accelerations. Every node has unit mass, so the
+ * accelerations are the forces.
+ */
+static void
+calculate_derivative(const struct mss_solver_t* mss,
+                     const ikreal_t* IK_RESTRICT y,
+                     ikreal_t* IK_RESTRICT dydx)
 {
-    return IK_OK;
+    const struct chain_flat_t* flat = mss->chain_flat;
+    const int32_t* parents = chain_flat_data(flat, pose_parents, int32_t);
+    const ik_vec3_t* targets = chain_flat_data(flat, effector_targets, ik_vec3_t);
+    const ikreal_t* inverse_masses = (const ikreal_t*)mss->inverse_masses.data;
+    const ikreal_t* rest_lengths = (const ikreal_t*)mss->rest_lengths.data;
+    const uint32_t* effector_nodes = (const uint32_t*)mss->effector_nodes.data;
+    uint32_t effector_count = vector_count(&mss->effector_nodes);
+    uint32_t n = mss->node_count;
+    const ikreal_t* positions = y;
+    const ikreal_t* velocities = y + 3*n;
+    ikreal_t* accelerations = dydx + 3*n;
+    uint32_t i, j;
+
+    /* Island bases don't move, everything else falls */
+    for (i = 0; i != n; ++i)
+        for (j = 0; j != 3; ++j)
+        {
+            dydx[i*3 + j] = velocities[i*3 + j] * inverse_masses[i];
+            accelerations[i*3 + j] = mss->gravity.f[j] * inverse_masses[i];
+        }
+
+    /* Segments */
+    for (i = 0; i != n; ++i)
+    {
+        ikreal_t delta[3], force[3];
+        ikreal_t length, spring;
+        int32_t parent = parents[i];
+        if (parent < 0)
+            continue;
+
+        for (j = 0; j != 3; ++j)
+            delta[j] = positions[i*3 + j] - positions[parent*3 + j];
+        length = vec3_length(delta);
+        spring = length > 0.0 ? mss->stiffness * (rest_lengths[i] - length) / length : 0.0;
+
+        for (j = 0; j != 3; ++j)
+        {
+            force[j] = delta[j] * spring
+                     - (velocities[i*3 + j] - velocities[parent*3 + j]) * mss->damping;
+            accelerations[i*3 + j] += force[j] * inverse_masses[i];
+            accelerations[parent*3 + j] -= force[j] * inverse_masses[parent];
+        }
+    }
+
+    /* Effectors. Their actual targets already take the effector weight into account */
+    for (i = 0; i != effector_count; ++i)
+    {
+        uint32_t node = effector_nodes[i];
+        for (j = 0; j != 3; ++j)
+            accelerations[node*3 + j] += (targets[i].f[j] - positions[node*3 + j])
+                                       * mss->stiffness * inverse_masses[node];
+    }
 }
 
-#if 0
+/* ------------------------------------------------------------------------- */
+/*
+ * Advances the state by h with the fifth order Cash-Karp Runge-Kutta method,
+ * given its derivative in MSS_DERIVATIVE. The result is written to
+ * MSS_RESULT and, if estimate_error is set, the difference to the embedded
+ * fourth order solution is written to MSS_ERROR.
+ */
+static void
+cash_karp_step(struct mss_solver_t* mss, ikreal_t h, int estimate_error)
+{
+    const ikreal_t* IK_RESTRICT y  = mss_array(mss, MSS_STATE);
+    const ikreal_t* IK_RESTRICT k1 = mss_array(mss, MSS_DERIVATIVE);
+    ikreal_t* IK_RESTRICT k2 = mss_array(mss, MSS_K2);
+    ikreal_t* IK_RESTRICT k3 = mss_array(mss, MSS_K3);
+    ikreal_t* IK_RESTRICT k4 = mss_array(mss, MSS_K4);
+    ikreal_t* IK_RESTRICT k5 = mss_array(mss, MSS_K5);
+    ikreal_t* IK_RESTRICT k6 = mss_array(mss, MSS_K6);
+    ikreal_t* IK_RESTRICT stage = mss_array(mss, MSS_STAGE);
+    ikreal_t* IK_RESTRICT result = mss_array(mss, MSS_RESULT);
+    ikreal_t* IK_RESTRICT error = mss_array(mss, MSS_ERROR);
+    uint32_t count = 6 * mss->node_count;
+    uint32_t i;
 
-#define SAFETY 0.9
-#define PGROW -0.2
-#define PSHRNK -0.25
-#define ERRCON 1.89e-4
-
-#define a2  (0.2)
-#define a3  (0.3)
-#define a4  (0.6)
-#define a5  (1.0)
-#define a6  (0.875)
-#define b21 (0.2)
-#define b31 (3.0 / 40.0)
-#define b32 (9.0 / 40.0)
-#define b41 (0.3)
-#define b42 (-0.9)
-#define b43 (1.2)
-#define b51 (-11.0 / 54.0)
-#define b52 (2.5)
-#define b53 (-70.0 / 27.0)
-#define b54 (35.0 / 27.0)
-#define b61 (1631.0 / 55296.0)
-#define b62 (175.0 / 512.0)
-#define b63 (575.0 / 13824.0)
-#define b64 (44275.0 / 110592.0)
-#define b65 (253.0 / 4096.0)
-#define c1  (37.0 / 378.0)
-#define c3  (250.0 / 621.0)
-#define c4  (125.0 / 594.0)
-#define c6  (512.0 / 1771.0)
-#define dc1 (c1 - 2825.0 / 27648.0)
-#define dc3 (c3 - 18575.0 / 48384.0)
-#define dc4 (c4 - 13525.0 / 55296.0)
-#define dc5 (-277.00 / 14336.0)
-#define dc6 (c6 - 0.25)
+    for (i = 0; i != count; ++i)
+        stage[i] = y[i] + h*b21*k1[i];
+    calculate_derivative(mss, stage, k2);
 
-/* The value ERRCON equals (5/SAFETY) raised to the power (1/PGROW), see use below. */
+    for (i = 0; i != count; ++i)
+        stage[i] = y[i] + h*(b31*k1[i] + b32*k2[i]);
+    calculate_derivative(mss, stage, k3);
 
-/* Given values for n variables y[1..n] and their derivatives dydx[1..n] known at x, use
-the fifth-order Cash-Karp Runge-Kutta method to advance the solution over an interval h
-and return the incremented variables as yout[1..n]. Also return an estimate of the local
-truncation error in yout using the embedded fourth-order method. The user supplies the routine
-derivs(x,y,dydx), which returns derivatives dydx at x. */
+    for (i = 0; i != count; ++i)
+        stage[i] = y[i] + h*(b41*k1[i] + b42*k2[i] + b43*k3[i]);
+    calculate_derivative(mss, stage, k4);
 
-void rkck(float y[], float dydx[], int n, float x, float h, float yout[],
-          float yerr[], void (*derivs)(float, float [], float []))
+    for (i = 0; i != count; ++i)
+        stage[i] = y[i] + h*(b51*k1[i] + b52*k2[i] + b53*k3[i] + b54*k4[i]);
+    calculate_derivative(mss, stage, k5);
 
+    for (i = 0; i != count; ++i)
+        stage[i] = y[i] + h*(b61*k1[i] + b62*k2[i] + b63*k3[i] + b64*k4[i] + b65*k5[i]);
+    calculate_derivative(mss, stage, k6);
+
+    for (i = 0; i != count; ++i)
+        result[i] = y[i] + h*(c1*k1[i] + c3*k3[i] + c4*k4[i] + c6*k6[i]);
+
+    if (estimate_error)
+        for (i = 0; i != count; ++i)
+            error[i] = h*(dc1*k1[i] + dc3*k3[i] + dc4*k4[i] + dc5*k5[i] + dc6*k6[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+accept_step(struct mss_solver_t* mss)
 {
-    int i;
-
-    float *ak2,*ak3,*ak4,*ak5,*ak6,*ytemp; /*
-    ak2=vector(1,n);
-    ak3=vector(1,n);
-    ak4=vector(1,n);
-    ak5=vector(1,n);
-    ak6=vector(1,n);
-    ytemp=vector(1,n);*/
-
-    for (i=1;i<=n;i++) /*First step.*/
-        ytemp[i]=y[i]+b21*h*dydx[i];
-    (*derivs)(x+a2*h,ytemp,ak2); /*Second step.*/
-    for (i=1;i<=n;i++)
-        ytemp[i]=y[i]+h*(b31*dydx[i]+b32*ak2[i]);
-    (*derivs)(x+a3*h,ytemp,ak3); /*Third step.*/
-    for (i=1;i<=n;i++)
-        ytemp[i]=y[i]+h*(b41*dydx[i]+b42*ak2[i]+b43*ak3[i]);
-    (*derivs)(x+a4*h,ytemp,ak4); /*Fourth step.*/
-    for (i=1;i<=n;i++)
-        ytemp[i]=y[i]+h*(b51*dydx[i]+b52*ak2[i]+b53*ak3[i]+b54*ak4[i]);
-    (*derivs)(x+a5*h,ytemp,ak5); /*Fifth step.*/
-    for (i=1;i<=n;i++)
-        ytemp[i]=y[i]+h*(b61*dydx[i]+b62*ak2[i]+b63*ak3[i]+b64*ak4[i]+b65*ak5[i]);
-    (*derivs)(x+a6*h,ytemp,ak6); /*Sixth step.*/
-    for (i=1;i<=n;i++) /*Accumulate increments with proper weights.*/
-        yout[i]=y[i]+h*(c1*dydx[i]+c3*ak3[i]+c4*ak4[i]+c6*ak6[i]);
-    /* Estimate error as difference between fourth and fifth order methods. */
-    for (i=1;i<=n;i++)
-        yerr[i]=h*(dc1*dydx[i]+dc3*ak3[i]+dc4*ak4[i]+dc5*ak5[i]+dc6*ak6[i]);
-    /*
-    free_vector(ytemp,1,n);
-    free_vector(ak6,1,n);
-    free_vector(ak5,1,n);
-    free_vector(ak4,1,n);
-    free_vector(ak3,1,n);
-    free_vector(ak2,1,n);*/
+    memcpy(mss_array(mss, MSS_STATE), mss_array(mss, MSS_RESULT),
+           sizeof(ikreal_t) * 6 * mss->node_count);
 }
 
-/*
- Fifth-order Runge-Kutta step with monitoring of local truncation error to ensure accuracy and
- adjust stepsize. Input are the dependent variable vector y[1..n] and its derivative dydx[1..n]
- at the starting value of the independent variable x. Also input are the stepsize to be attempted
- htry, the required accuracy eps, and the vector yscal[1..n] against which the error is
- scaled. On output, y and x are replaced by their new values, hdid is the stepsize that was
- actually accomplished, and hnext is the estimated next stepsize. derivs is the user-supplied
- routine that computes the right-hand side derivatives.*/
-
-void rkqs(float y[], float dydx[], int n, float *x, float htry, float eps,
-          float yscal[], float *hdid, float *hnext,
-          void (*derivs)(float, float [], float []))
+/* ------------------------------------------------------------------------- */
+/* Largest error of any position relative to the error tolerance */
+static ikreal_t
+scaled_error(const struct mss_solver_t* mss)
 {
-    int i;
-    float errmax,h,htemp,xnew,*yerr,*ytemp;
-    /*
-    yerr=vector(1,n);
-    ytemp=vector(1,n);*/
+    const ikreal_t* error = mss_array(mss, MSS_ERROR);
+    uint32_t count = 3 * mss->node_count;
+    uint32_t i;
+    ikreal_t max_error = 0.0;
+
+    for (i = 0; i != count; ++i)
+        max_error = ik_fmax(max_error, ik_fabs(error[i]));
 
-    h = htry; /* Set stepsize to the initial trial value. */
-    for (;;)
+    return max_error / mss->error_tolerance;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+integrate_fixed(struct mss_solver_t* mss)
+{
+    ikreal_t h = mss->timestep / mss->substeps;
+    int32_t step;
+
+    for (step = 0; step != mss->substeps; ++step)
     {
-        rkck(y,dydx,n,*x,h,ytemp,yerr,derivs); /* Take a step. */
-        errmax = 0.0; /* Evaluate accuracy. */
-        for (i = 1; i <= n; i++)
-            errmax = fmax(errmax, fabs(yerr[i]/yscal[i]));
-        errmax /= eps; /* Scale relative to required tolerance. */
-        if (errmax <= 1.0)
-            break; /* Step succeeded. Compute size of next step. */
-        htemp=SAFETY*h*pow(errmax, PSHRNK);
-        /* Truncation error too large, reduce stepsize. */
-        h = (h >= 0.0 ? fmax(htemp, 0.1*h) : fmin(htemp, 0.1*h));
-        /* No more than a factor of 10. */
-        xnew = (*x)+h;
-        if (xnew == *x)
-        {
-            ik.log.message("stepsize underflow in rkqs");
-            return;
-        }
+        calculate_derivative(mss, mss_array(mss, MSS_STATE), mss_array(mss, MSS_DERIVATIVE));
+        cash_karp_step(mss, h, 0);
+        accept_step(mss);
     }
 
-    if (errmax > ERRCON)
-        *hnext=SAFETY*h*pow(errmax,PGROW);
-    else
-        *hnext=5.0*h; /* No more than a factor of 5 increase. */
-    *x += (*hdid=h);
-    for (i=1;i<=n;i++)
-        y[i]=ytemp[i];
-    /*
-    free_vector(ytemp,1,n);
-    free_vector(yerr,1,n);*/
+    mss->iterations_used = mss->substeps;
 }
 
-#define MAXSTP 10000
-#define TINY 1.0e-30
-#define SIGN(x) (((x) > 0) - ((x) < 0))
+/* ------------------------------------------------------------------------- */
+static void
+integrate_adaptive(struct mss_solver_t* mss)
+{
+    ikreal_t t = 0.0;
+    ikreal_t h = mss->step_size > 0.0 ? mss->step_size : mss->timestep;
+    ikreal_t min_step_size = mss->timestep * 1e-6;
+
+    mss->iterations_used = 0;
+    while (t < mss->timestep)
+    {
+        ikreal_t error;
+        ikreal_t h_next;
+        int last_step = 0;
 
+        /* Out of budget. The rest of the time step is skipped */
+        if (mss->iterations_used >= mss->max_iterations)
+            return;
 
-/* User storage for intermediate results. Preset kmax and dxsav in the calling program. If kmax 6=
-0 results are stored at approximate intervals dxsav in the arrays xp[1..kount], yp[1..nvar]
-[1..kount], where kount is output by odeint. Defining declarations for these variables, with
-memory allocations xp[1..kmax] and yp[1..nvar][1..kmax] for the arrays, should be in
-the calling program. */
+        if (t + h >= mss->timestep)
+        {
+            h = mss->timestep - t;
+            last_step = 1;
+        }
 
-extern int kmax,kount;
-extern float *xp,**yp,dxsav;
+        calculate_derivative(mss, mss_array(mss, MSS_STATE), mss_array(mss, MSS_DERIVATIVE));
 
-/* Runge-Kutta driver with adaptive stepsize control. Integrate starting values ystart[1..nvar]
-from x1 to x2 with accuracy eps, storing intermediate results in global variables. h1 should
-be set as a guessed first stepsize, hmin as the minimum allowed stepsize (can be zero). On
-output nok and nbad are the number of good and bad (but retried and fixed) steps taken, and
-ystart is replaced by values at the end of the integration interval. derivs is the user-supplied
-routine for calculating the right-hand side derivative, while rkqs is the name of the stepper
-routine to be used. */
+        /* Shrink the step until the error is within the error tolerance, but no more than a factor of 10 at once */
+        for (;;)
+        {
+            cash_karp_step(mss, h, 1);
+            error = scaled_error(mss);
+            if (error <= 1.0 || h <= min_step_size)
+                break;
+            h = ik_fmax(SAFETY * h * pow(error, PSHRNK), 0.1 * h);
+            last_step = 0;
+        }
+
+        accept_step(mss);
+        t += h;
+        mss->iterations_used++;
 
-void odeint(float ystart[], int nvar, float x1, float x2, float eps, float h1,
-            float hmin, int *nok, int *nbad,
-            void (*derivs)(float, float [], float []))
+        /* Grow the next step, but no more than a factor of 5 */
+        h_next = error > ERRCON ? SAFETY * h * pow(error, PGROW) : 5.0 * h;
+
+        /* Truncating the last step says nothing about the step size the system needs */
+        if (!last_step || h_next < mss->step_size)
+            mss->step_size = h_next;
+        h = h_next;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+load_state(struct mss_solver_t* mss)
 {
-    int nstp,i;
-    float xsav,x,hnext,hdid,h;
-    float *yscal,*y,*dydx;
+    struct chain_flat_t* flat = mss->chain_flat;
+    const ik_vec3_t* global_positions = chain_flat_data(flat, pose_global_positions, ik_vec3_t);
+    const uint32_t* pose_slots = chain_flat_data(flat, pose_slots, uint32_t);
+    const ikreal_t* segment_lengths = chain_flat_data(flat, segment_lengths, ikreal_t);
+    const ikreal_t* inverse_masses = (const ikreal_t*)mss->inverse_masses.data;
+    ikreal_t* rest_lengths = (ikreal_t*)mss->rest_lengths.data;
+    ikreal_t* positions = mss_array(mss, MSS_STATE);
+    ikreal_t* velocities = positions + 3 * mss->node_count;
+    uint32_t i;
+
+    for (i = 0; i != mss->node_count; ++i)
+        rest_lengths[i] = segment_lengths[pose_slots[i]];
+
     /*
-    yscal=vector(1,nvar);
-    y=vector(1,nvar);
-    dydx=vector(1,nvar);*/
-    x=x1;
-    /*h=SIGN(h1,x2-x1);*/
-    h=h1;
-    *nok = (*nbad) = kount = 0;
-    for (i=1;i<=nvar;i++)
-        y[i]=ystart[i];
-    if (kmax > 0) xsav=x-dxsav*2.0;   /*Assures storage of first step.*/
-    for (nstp=1;nstp<=MAXSTP;nstp++)  /*Take at most MAXSTP steps.*/
+     * The first solve starts at rest in the pose passed in. After that, only
+     * the island bases follow the pose, and the rest of the nodes carry on
+     * from where the previous solve left them.
+     */
+    if (mss->has_state == 0)
     {
-        (*derivs)(x,y,dydx);
-        /*Scaling used to monitor accuracy. This general-purpose choice can be modified
-        if need be.*/
-        for (i=1;i<=nvar;i++)
-            yscal[i]=fabs(y[i])+fabs(dydx[i]*h)+TINY;
-        if (kmax > 0 && kount < kmax-1 && fabs(x-xsav) > fabs(dxsav))
-        {
-            xp[++kount]=x; /*Store intermediate results.*/
-            for (i=1;i<=nvar;i++)
-                yp[i][kount]=y[i];
-            xsav=x;
-        }
-        if ((x+h-x2)*(x+h-x1) > 0.0)
-            h=x2-x; /*If stepsize can overshoot, decrease*/
-        rkqs(y,dydx,nvar,&x,h,eps,yscal,&hdid,&hnext,derivs);
-        if (hdid == h)
-            ++(*nok);
-        else
-            ++(*nbad);
-        if ((x-x2)*(x2-x1) >= 0.0) /*Are we done?*/
-        {
-            for (i=1;i<=nvar;i++)
-                ystart[i]=y[i];
-            if (kmax)
-            {
-                xp[++kount]=x; /*Save final step.*/
-                for (i=1;i<=nvar;i++)
-                    yp[i][kount]=y[i];
-            }
-            /*
-            free_vector(dydx,1,nvar);
-            free_vector(y,1,nvar);
-            free_vector(yscal,1,nvar);*/
-            return; /*Normal exit.*/
-        }
-        if (fabs(hnext) <= hmin)
+        memcpy(positions, global_positions, sizeof(ikreal_t) * 3 * mss->node_count);
+        memset(velocities, 0, sizeof(ikreal_t) * 3 * mss->node_count);
+        mss->has_state = 1;
+        return;
+    }
+
+    for (i = 0; i != mss->node_count; ++i)
+        if (inverse_masses[i] == 0.0)
         {
-            ik.log.message("Step size too small in odeint");
-            return;
+            vec3_set(positions + i*3, global_positions[i].f);
+            vec3_set_zero(velocities + i*3);
         }
-        h=hnext;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+store_state(struct mss_solver_t* mss)
+{
+    struct chain_flat_t* flat = mss->chain_flat;
+    const uint32_t* pose_slots = chain_flat_data(flat, pose_slots, uint32_t);
+    ik_vec3_t* slot_positions = chain_flat_data(flat, positions, ik_vec3_t);
+    const ikreal_t* positions = mss_array(mss, MSS_STATE);
+    uint32_t i;
+
+    for (i = 0; i != mss->node_count; ++i)
+        vec3_set(slot_positions[pose_slots[i]].f, positions + i*3);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Returns non-zero if all effectors are within tolerance of their targets */
+static int
+effectors_in_range(const struct mss_solver_t* mss)
+{
+    const struct chain_flat_t* flat = mss->chain_flat;
+    struct ik_node_t** nodes = chain_flat_data(flat, nodes, struct ik_node_t*);
+    const uint32_t* effector_slots = chain_flat_data(flat, effector_slots, uint32_t);
+    const ik_vec3_t* targets = chain_flat_data(flat, effector_targets, ik_vec3_t);
+    const uint32_t* effector_nodes = (const uint32_t*)mss->effector_nodes.data;
+    const ikreal_t* positions = mss_array(mss, MSS_STATE);
+    uint32_t effector_count = vector_count(&flat->effector_slots);
+    uint32_t effector_idx;
+
+    for (effector_idx = 0; effector_idx != effector_count; ++effector_idx)
+    {
+        const struct ik_effector_t* effector = nodes[effector_slots[effector_idx]]->effector;
+        ikreal_t tolerance = effector->tolerance > 0 ? effector->tolerance : mss->tolerance;
+        ik_vec3_t diff = targets[effector_idx];
+
+        vec3_sub_vec3(diff.f, positions + effector_nodes[effector_idx] * 3);
+        if (vec3_length_squared(diff.f) > tolerance * tolerance)
+            return 0;
     }
 
-    ik.log.message("Too many steps in routine odeint");
+    return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_MSS_solve(struct ik_solver_t* solver)
+{
+    struct mss_solver_t* mss = (struct mss_solver_t*)solver;
+
+    if (mss->node_count == 0 || mss->timestep <= 0.0)
+        return IK_OK;
+
+    /* Global positions of the animated pose and the effector targets */
+    chain_flat_update_global_pose(solver->chain_flat);
+    chain_flat_gather(solver->chain_flat, 0);
+
+    load_state(mss);
+    if (mss->substeps > 0)
+        integrate_fixed(mss);
+    else
+        integrate_adaptive(mss);
+    store_state(mss);
+
+    /* Only positions are simulated, so the local rotations stay untouched */
+    chain_flat_scatter_local(solver->chain_flat);
+
+    return effectors_in_range(mss) ? IK_RESULT_CONVERGED : IK_OK;
 }
-#endif
@@ -1,7 +1,7 @@
 #include "ik/solver_ONE_BONE.h"
 #include "ik/ik.h"
 #include "ik/chain.h"
-#include "ik/vec3_static.h"
+#include "ik/math_inline.h"
 #include <stddef.h>
 #include <assert.h>
 
@@ -64,10 +64,10 @@ ik_solver_ONE_BONE_solve(struct ik_solver_t* solver)
         assert(node_tip->effector != NULL);
         node_tip->position = node_tip->effector->target_position;
 
-        ik_vec3_static_sub_vec3(node_tip->position.f, node_base->position.f);
-        ik_vec3_static_normalize(node_tip->position.f);
-        ik_vec3_static_mul_scalar(node_tip->position.f, node_tip->dist_to_parent);
-        ik_vec3_static_add_vec3(node_tip->position.f, node_base->position.f);
+        vec3_sub_vec3(node_tip->position.f, node_base->position.f);
+        vec3_normalize(node_tip->position.f);
+        vec3_mul_scalar(node_tip->position.f, node_tip->dist_to_parent);
+        vec3_add_vec3(node_tip->position.f, node_base->position.f);
     SOLVER_END_EACH
 
     return 0;
@@ -1,7 +1,8 @@
 #include "ik/solver_TWO_BONE.h"
 #include "ik/chain.h"
-#include "ik/vec3_static.h"
+#include "ik/math_inline.h"
 #include "ik/ik.h"
+#include "ik/two_bone_lanes.h"
 #include <assert.h>
 #include <math.h>
 #include <stddef.h>
@@ -50,10 +51,22 @@ ik_solver_TWO_BONE_data(struct ik_solver_t* solver)
     return 0;
 }
 
+/* ------------------------------------------------------------------------- */
+static void
+normalize(ikreal_t v[3], int fast_math)
+{
+    if (fast_math)
+        vec3_normalize_fast(v);
+    else
+        vec3_normalize(v);
+}
+
 /* ------------------------------------------------------------------------- */
 int
 ik_solver_TWO_BONE_solve(struct ik_solver_t* solver)
 {
+    int fast_math = solver->flags & IK_ENABLE_FAST_MATH;
+
     SOLVER_FOR_EACH_CHAIN(solver, chain)
         struct ik_node_t* node_tip;
         struct ik_node_t* node_mid;
@@ -68,7 +81,7 @@ ik_solver_TWO_BONE_solve(struct ik_solver_t* solver)
 
         assert(node_tip->effector != NULL);
         to_target = node_tip->effector->target_position;
-        ik_vec3_static_sub_vec3(to_target.f, node_base->position.f);
+        vec3_sub_vec3(to_target.f, node_base->position.f);
 
         /*
          * Form a triangle from the two segment lengths so we can calculate the
@@ -86,53 +99,72 @@ ik_solver_TWO_BONE_solve(struct ik_solver_t* solver)
         b = node_mid->dist_to_parent;
         aa = a*a;
         bb = b*b;
-        cc = ik_vec3_static_length_squared(to_target.f);
-        c = sqrt(cc);
+        cc = vec3_length_squared(to_target.f);
+        c = fast_math ? fast_sqrt(cc) : sqrt(cc);
 
         /* check if in reach */
         if (c < a + b)
         {
             /* Cosine law to get base angle (alpha) */
             ik_quat_t alpha_rotation;
-            ikreal_t alpha = acos((bb + cc - aa) / (2.0 * node_mid->dist_to_parent * sqrt(cc)));
-            ikreal_t cos_a = cos(alpha * 0.5);
-            ikreal_t sin_a = sin(alpha * 0.5);
+            ikreal_t cos_alpha = (bb + cc - aa) / (2.0 * node_mid->dist_to_parent * c);
+            ikreal_t cos_a, sin_a;
+            if (fast_math)
+            {
+                /* Half-angle identities, alpha lies within [0, pi] */
+                cos_a = fast_sqrt((1.0 + cos_alpha) * 0.5);
+                sin_a = fast_sqrt((1.0 - cos_alpha) * 0.5);
+            }
+            else
+            {
+                ikreal_t alpha = acos(cos_alpha);
+                cos_a = cos(alpha * 0.5);
+                sin_a = sin(alpha * 0.5);
+            }
 
             /* Cross product of both segment vectors defines axis of rotation */
             alpha_rotation.v = node_tip->position;
-            ik_vec3_static_sub_vec3(alpha_rotation.f, node_mid->position.f);  /* top segment */
-            ik_vec3_static_sub_vec3(node_mid->position.f, node_base->position.f);  /* bottom segment */
-            ik_vec3_static_cross(alpha_rotation.f, node_mid->position.f);
+            vec3_sub_vec3(alpha_rotation.f, node_mid->position.f);  /* top segment */
+            vec3_sub_vec3(node_mid->position.f, node_base->position.f);  /* bottom segment */
+            vec3_cross(alpha_rotation.f, node_mid->position.f);
 
             /*
              * Set up quaternion describing the rotation of alpha. Need to
              * normalise vec3 component of quaternion so rotation is correct.
              */
-            ik_vec3_static_normalize(alpha_rotation.f);
-            ik_vec3_static_mul_scalar(alpha_rotation.f, sin_a);
+            normalize(alpha_rotation.f, fast_math);
+            vec3_mul_scalar(alpha_rotation.f, sin_a);
             alpha_rotation.w = cos_a;
 
             /* Rotate side c and scale to length of side b to get the unknown position */
             node_mid->position = to_target;
-            ik_vec3_static_normalize(node_mid->position.f);
-            ik_vec3_static_mul_scalar(node_mid->position.f, node_mid->dist_to_parent);
-            ik_vec3_static_rotate(node_mid->position.f, alpha_rotation.f);
-            ik_vec3_static_add_vec3(node_mid->position.f, node_base->position.f);
+            normalize(node_mid->position.f, fast_math);
+            vec3_mul_scalar(node_mid->position.f, node_mid->dist_to_parent);
+            vec3_rotate(node_mid->position.f, alpha_rotation.f);
+            vec3_add_vec3(node_mid->position.f, node_base->position.f);
 
             node_tip->position = node_tip->effector->target_position;
         }
         else
         {
             /* Just point both segments at target */
-            ik_vec3_static_normalize(to_target.f);
+            normalize(to_target.f, fast_math);
             node_mid->position = to_target;
             node_tip->position = to_target;
-            ik_vec3_static_mul_scalar(node_mid->position.f, node_mid->dist_to_parent);
-            ik_vec3_static_mul_scalar(node_tip->position.f, node_tip->dist_to_parent);
-            ik_vec3_static_add_vec3(node_mid->position.f, node_base->position.f);
-            ik_vec3_static_add_vec3(node_tip->position.f, node_mid->position.f);
+            vec3_mul_scalar(node_mid->position.f, node_mid->dist_to_parent);
+            vec3_mul_scalar(node_tip->position.f, node_tip->dist_to_parent);
+            vec3_add_vec3(node_mid->position.f, node_base->position.f);
+            vec3_add_vec3(node_tip->position.f, node_mid->position.f);
         }
     SOLVER_END_EACH
 
     return 0;
 }
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_TWO_BONE_solve_limbs(struct ik_solver_t* solver, struct ik_limbs_t* limbs)
+{
+    uint32_t out_of_reach = two_bone_lanes_kernel()->solve(limbs);
+    return out_of_reach == 0 ? IK_RESULT_CONVERGED : IK_OK;
+}
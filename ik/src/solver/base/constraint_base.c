@@ -122,7 +122,7 @@ ik_constraint_base_attach(struct ik_constraint_t* constraint, struct ik_node_t*
 struct ik_constraint_t*
 ik_constraint_base_create(enum ik_constraint_type_e constraint_type)
 {
-    struct ik_constraint_t* constraint = MALLOC(sizeof *constraint);
+    struct ik_constraint_t* constraint = MALLOC_OBJECT(sizeof *constraint);
     if (constraint == NULL)
     {
         IKAPI.log.message("Failed to allocate constraint: Out of memory");
@@ -141,5 +141,5 @@ void
 ik_constraint_base_destroy(struct ik_constraint_t* constraint)
 {
     constraint->v->detach(constraint);
-    FREE(constraint);
+    FREE_OBJECT(constraint);
 }
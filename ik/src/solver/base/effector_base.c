@@ -1,6 +1,7 @@
 #include "ik/effector_base.h"
 #include "ik/ik.h"
 #include "ik/memory.h"
+#include "ik/node.h"
 #include "ik/vec3_static.h"
 #include "ik/quat_static.h"
 #include <string.h>
@@ -9,7 +10,7 @@
 struct ik_effector_t*
 ik_effector_base_create(void)
 {
-    struct ik_effector_t* effector = MALLOC(sizeof *effector);
+    struct ik_effector_t* effector = MALLOC_OBJECT(sizeof *effector);
     if (effector == NULL)
         return NULL;
 
@@ -29,7 +30,7 @@ void
 ik_effector_base_destroy(struct ik_effector_t* effector)
 {
     ik_effector_base_detach(effector);
-    FREE(effector);
+    FREE_OBJECT(effector);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -51,6 +52,7 @@ ik_effector_base_attach(struct ik_effector_t* effector, struct ik_node_t* node)
 
     node->effector = effector;
     effector->node = node;
+    node->v->mark_dirty(node, IK_NODE_DIRTY_EFFECTOR);
 
     return 0;
 }
@@ -63,5 +65,6 @@ ik_effector_base_detach(struct ik_effector_t* effector)
         return;
 
     effector->node->effector = NULL;
+    effector->node->v->mark_dirty(effector->node, IK_NODE_DIRTY_EFFECTOR);
     effector->node = NULL;
 }
@@ -11,7 +11,7 @@
 struct ik_node_t*
 ik_node_base_create(uint32_t guid)
 {
-    struct ik_node_t* node = MALLOC(sizeof *node);
+    struct ik_node_t* node = MALLOC_OBJECT(sizeof *node);
     if (node == NULL)
     {
         IKAPI.log.message("fFailed to allocate node: Ran out of memory");
@@ -27,7 +27,6 @@ ikret_t
 ik_node_base_construct(struct ik_node_t* node, uint32_t guid)
 {
     memset(node, 0, sizeof *node);
-    bstv_construct(&node->children);
     node->v = &IKAPI.internal.node_base;
     node->guid = guid;
     ik_quat_static_set_identity(node->rotation.f);
@@ -40,25 +39,33 @@ ik_node_base_construct(struct ik_node_t* node, uint32_t guid)
 static void
 destroy_recursive(struct ik_node_t* node);
 static void
-destruct_recursive(struct ik_node_t* node)
+destroy_children(struct ik_node_t* node)
 {
-    NODE_FOR_EACH(node, guid, child)
+    /* Can't use NODE_FOR_EACH, the child is gone before moving to the next */
+    struct ik_node_t* child = node->first_child;
+    while (child != NULL)
+    {
+        struct ik_node_t* next = child->next_sibling;
         destroy_recursive(child);
-    NODE_END_EACH
+        child = next;
+    }
+    node->first_child = NULL;
+    node->last_child = NULL;
+}
+static void
+destruct_recursive(struct ik_node_t* node)
+{
+    destroy_children(node);
 
     if (node->effector)
         node->effector->v->destroy(node->effector);
     if (node->constraint)
         node->constraint->v->destroy(node->constraint);
-
-    bstv_clear_free(&node->children);
 }
 void
 ik_node_base_destruct(struct ik_node_t* node)
 {
-    NODE_FOR_EACH(node, guid, child)
-        destroy_recursive(child);
-    NODE_END_EACH
+    destroy_children(node);
 
     if (node->effector)
         node->effector->v->destroy(node->effector);
@@ -66,7 +73,6 @@ ik_node_base_destruct(struct ik_node_t* node)
         node->constraint->v->destroy(node->constraint);
 
     node->v->unlink(node);
-    bstv_clear_free(&node->children);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -74,7 +80,7 @@ static void
 destroy_recursive(struct ik_node_t* node)
 {
     destruct_recursive(node);
-    FREE(node);
+    FREE_OBJECT(node);
 }
 void
 ik_node_base_destroy(struct ik_node_t* node)
@@ -82,17 +88,39 @@ ik_node_base_destroy(struct ik_node_t* node)
     if (IKAPI.internal.callbacks->on_node_destroy != NULL)
         IKAPI.internal.callbacks->on_node_destroy(node);
     node->v->destruct(node);
-    FREE(node);
+    FREE_OBJECT(node);
 }
 
 /* ------------------------------------------------------------------------- */
 ikret_t
 ik_node_base_add_child(struct ik_node_t* node, struct ik_node_t* child)
 {
-    ikret_t result;
-    if ((result = bstv_insert(&node->children, child->guid, child)) != IK_OK)
-        return result;
+    struct ik_node_t* sibling;
+
+    /* Siblings are told apart by their guid, see find_child() */
+    for (sibling = node->first_child; sibling != NULL; sibling = sibling->next_sibling)
+    {
+        if (sibling != child && sibling->guid == child->guid)
+        {
+            IKAPI.log.message("Node already has a child with guid %d", child->guid);
+            return IK_DUPLICATE_GUID;
+        }
+    }
+
+    /* A node can only be in one list of children */
+    if (child->parent != NULL)
+        child->v->unlink(child);
+
+    child->next_sibling = NULL;
+    child->prev_sibling = node->last_child;
+    if (node->last_child != NULL)
+        node->last_child->next_sibling = child;
+    else
+        node->first_child = child;
+    node->last_child = child;
+
     child->parent = node;
+    node->v->mark_dirty(node, IK_NODE_DIRTY_CHILDREN);
     return IK_OK;
 }
 
@@ -119,7 +147,18 @@ ik_node_base_unlink(struct ik_node_t* node)
     if (node->parent == NULL)
         return;
 
-    bstv_erase(&node->parent->children, node->guid);
+    if (node->prev_sibling != NULL)
+        node->prev_sibling->next_sibling = node->next_sibling;
+    else
+        node->parent->first_child = node->next_sibling;
+    if (node->next_sibling != NULL)
+        node->next_sibling->prev_sibling = node->prev_sibling;
+    else
+        node->parent->last_child = node->prev_sibling;
+    node->next_sibling = NULL;
+    node->prev_sibling = NULL;
+
+    node->v->mark_dirty(node->parent, IK_NODE_DIRTY_CHILDREN);
     node->parent = NULL;
 }
 
@@ -127,9 +166,12 @@ ik_node_base_unlink(struct ik_node_t* node)
 struct ik_node_t*
 ik_node_base_find_child(const struct ik_node_t* node, uint32_t guid)
 {
-    struct ik_node_t* found = bstv_find(&node->children, guid);
-    if (found != NULL)
-        return found;
+    struct ik_node_t* found;
+
+    NODE_FOR_EACH(node, child_guid, child)
+        if (child_guid == guid)
+            return child;
+    NODE_END_EACH
 
     if (node->guid == guid)
         return (struct ik_node_t*)node;
@@ -224,3 +266,21 @@ ik_node_base_dump_to_dot(struct ik_node_t* node, const char* file_name)
 
     fclose(fp);
 }
+
+/* ------------------------------------------------------------------------- */
+void
+ik_node_base_mark_dirty(struct ik_node_t* node, uint8_t flags)
+{
+    node->dirty |= flags;
+
+    /*
+     * Parents are flagged so rebuild() can walk down to the dirty nodes from
+     * the root. If a parent is already flagged, so are all of its parents.
+     */
+    for (node = node->parent; node != NULL; node = node->parent)
+    {
+        if (node->dirty & IK_NODE_DIRTY_DESCENDANT)
+            break;
+        node->dirty |= IK_NODE_DIRTY_DESCENDANT;
+    }
+}
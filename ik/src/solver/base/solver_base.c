@@ -1,9 +1,12 @@
 #include "ik/ik.h"
 #include "ik/solver_base.h"
 #include "ik/chain.h"
+#include "ik/chain_flat.h"
+#include "ik/math_inline.h"
 #include "ik/memory.h"
 #include "ik/quat_static.h"
-#include "ik/transform.h"
+#include "ik/thread_pool.h"
+#include "ik/tree_flat.h"
 #include "ik/vec3_static.h"
 #include <string.h>
 #include <assert.h>
@@ -40,10 +43,25 @@ ik_solver_base_construct(struct ik_solver_t* solver)
 {
     solver->max_iterations = 20;
     solver->tolerance = 1e-2;
+    solver->stall_ratio = 0;
     solver->flags = IK_ENABLE_JOINT_ROTATIONS;
+    solver->thread_count = 1;
+    solver->fork_threshold = 512;
+    solver->warm_start_blend = 1;
+    solver->warm_start_threshold = 1;
+    solver->thread_pool = NULL;
     vector_construct(&solver->effector_nodes_list, sizeof(struct ik_node_t*));
     vector_construct(&solver->chain_list, sizeof(struct chain_t));
+    vector_construct(&solver->spare_chains, sizeof(struct chain_t));
+    vector_construct(&solver->changed_nodes, sizeof(struct ik_node_t*));
+    if ((solver->chain_flat = chain_flat_create()) == NULL)
+        goto create_chain_flat_failed;
+    if ((solver->tree_flat = tree_flat_create()) == NULL)
+        goto create_tree_flat_failed;
     return IK_OK;
+
+    create_tree_flat_failed  : chain_flat_destroy(solver->chain_flat);
+    create_chain_flat_failed : return IK_RAN_OUT_OF_MEMORY;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -57,6 +75,19 @@ ik_solver_base_destruct(struct ik_solver_t* solver)
         chain_destruct(chain);
     SOLVER_END_EACH
     vector_clear_free(&solver->chain_list);
+    VECTOR_FOR_EACH(&solver->spare_chains, struct chain_t, chain)
+        chain_destruct(chain);
+    VECTOR_END_EACH
+    vector_clear_free(&solver->spare_chains);
+    vector_clear_free(&solver->changed_nodes);
+
+    if (solver->chain_flat)
+        chain_flat_destroy(solver->chain_flat);
+    if (solver->tree_flat)
+        tree_flat_destroy(solver->tree_flat);
+
+    if (solver->thread_pool)
+        thread_pool_destroy(solver->thread_pool);
 
     vector_clear_free(&solver->effector_nodes_list);
 }
@@ -75,6 +106,7 @@ ik_solver_base_unlink_tree(struct ik_solver_t* solver)
      * them.
      */
     vector_clear(&solver->effector_nodes_list);
+    tree_flat_clear(solver->tree_flat);
 
     return base;
 }
@@ -95,21 +127,63 @@ ik_solver_base_set_tree(struct ik_solver_t* solver, struct ik_node_t* base)
 {
     solver->v->destroy_tree(solver);
     solver->tree = base;
+
+    /* The solver's chains were built for a different tree */
+    if (base != NULL)
+        base->v->mark_dirty(base, IK_NODE_DIRTY_CHILDREN);
 }
 
 /* ------------------------------------------------------------------------- */
-int
-ik_solver_base_rebuild(struct ik_solver_t* solver)
+static void
+update_thread_pool(struct ik_solver_t* solver)
 {
-    ikret_t result;
+    if (solver->thread_pool != NULL &&
+        thread_pool_thread_count(solver->thread_pool) == solver->thread_count)
+        return;
 
-    /* If the solver has no tree, then there's nothing to do */
-    if (solver->tree == NULL)
+    if (solver->thread_pool != NULL)
     {
-        IKAPI.log.message("No tree to work with. Did you forget to set the tree with ik_solver_set_tree()?");
-        return IK_SOLVER_HAS_NO_TREE;
+        thread_pool_destroy(solver->thread_pool);
+        solver->thread_pool = NULL;
     }
 
+    /* Not being able to start threads isn't fatal, islands are solved serially instead */
+    if (solver->thread_count > 1)
+        solver->thread_pool = thread_pool_create(solver->thread_count);
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+collect_dirty_nodes(struct ik_node_t* node, struct vector_t* dirty_nodes, int* children_changed)
+{
+    uint8_t dirty = node->dirty;
+    node->dirty = 0;
+
+    if (dirty & IK_NODE_DIRTY_CHILDREN)
+        *children_changed = 1;
+    if (dirty & IK_NODE_DIRTY_EFFECTOR)
+        if (vector_push(dirty_nodes, &node) != IK_OK)
+            return IK_RAN_OUT_OF_MEMORY;
+
+    if (dirty & IK_NODE_DIRTY_DESCENDANT)
+        NODE_FOR_EACH(node, guid, child)
+            if (child->dirty)
+            {
+                ikret_t result;
+                if ((result = collect_dirty_nodes(child, dirty_nodes, children_changed)) != IK_OK)
+                    return result;
+            }
+        NODE_END_EACH
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+rebuild_all_chains(struct ik_solver_t* solver)
+{
+    ikret_t result;
+
     /*
      * Traverse the entire tree and generate a list of the effectors. This
      * makes the process of building the chain list for FABRIK much easier.
@@ -124,9 +198,14 @@ ik_solver_base_rebuild(struct ik_solver_t* solver)
         return result;
     }
 
+    /* Nodes were added or removed, so the flat tree is out of date */
+    if ((result = tree_flat_build(solver->tree_flat, solver->tree)) != IK_OK)
+        return result;
+
     /* now build the chain tree */
     if ((result = chain_tree_rebuild(
             &solver->chain_list,
+            &solver->spare_chains,
             solver->tree,
             &solver->effector_nodes_list)) != IK_OK)
         return result;
@@ -136,11 +215,118 @@ ik_solver_base_rebuild(struct ik_solver_t* solver)
     return IK_OK;
 }
 
+/* ------------------------------------------------------------------------- */
+static int
+is_in_node_list(const struct vector_t* node_list, const struct ik_node_t* node)
+{
+    VECTOR_FOR_EACH(node_list, struct ik_node_t*, p_node)
+        if (*p_node == node)
+            return 1;
+    VECTOR_END_EACH
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+rebuild_changed_chains(struct ik_solver_t* solver, struct vector_t* changed_nodes)
+{
+    uint32_t idx;
+
+    /*
+     * Drop nodes whose effectors were detached from the list. Changing the
+     * chain length doesn't mark anything dirty, so compare it here.
+     */
+    for (idx = 0; idx < vector_count(&solver->effector_nodes_list); )
+    {
+        struct ik_node_t* node =
+            *(struct ik_node_t**)vector_get_element(&solver->effector_nodes_list, idx);
+        if (node->effector == NULL)
+        {
+            vector_erase_index(&solver->effector_nodes_list, idx);
+            continue;
+        }
+        if (node->effector->_built_chain_length != node->effector->chain_length)
+        {
+            node->effector->_built_chain_length = node->effector->chain_length;
+            if (vector_push(changed_nodes, &node) != IK_OK)
+                return IK_RAN_OUT_OF_MEMORY;
+        }
+        ++idx;
+    }
+
+    /* Add newly attached effectors */
+    VECTOR_FOR_EACH(changed_nodes, struct ik_node_t*, p_node)
+        if ((*p_node)->effector == NULL || is_in_node_list(&solver->effector_nodes_list, *p_node))
+            continue;
+        (*p_node)->effector->_built_chain_length = (*p_node)->effector->chain_length;
+        if (vector_push(&solver->effector_nodes_list, p_node) != IK_OK)
+            return IK_RAN_OUT_OF_MEMORY;
+    VECTOR_END_EACH
+
+    return chain_tree_rebuild_partial(
+            &solver->chain_list,
+            &solver->spare_chains,
+            &solver->effector_nodes_list,
+            changed_nodes);
+}
+
+/* ------------------------------------------------------------------------- */
+int
+ik_solver_base_rebuild(struct ik_solver_t* solver)
+{
+    ikret_t result;
+    int children_changed = 0;
+    struct vector_t* changed_nodes = &solver->changed_nodes;
+
+    /* If the solver has no tree, then there's nothing to do */
+    if (solver->tree == NULL)
+    {
+        IKAPI.log.message("No tree to work with. Did you forget to set the tree with ik_solver_set_tree()?");
+        return IK_SOLVER_HAS_NO_TREE;
+    }
+
+    /*
+     * Adding or removing nodes can change chains anywhere in the tree, so that
+     * means starting from scratch. Attaching and detaching effectors or
+     * changing their chain length only needs the chains around those nodes
+     * to be rebuilt, which matters for rigs that grab things at runtime.
+     */
+    vector_clear(changed_nodes);
+    if ((result = collect_dirty_nodes(solver->tree, changed_nodes, &children_changed)) != IK_OK)
+        goto rebuild_failed;
+
+    if (children_changed)
+        result = rebuild_all_chains(solver);
+    else
+        result = rebuild_changed_chains(solver, changed_nodes);
+    if (result != IK_OK)
+        goto rebuild_failed;
+
+    /* Compile the chain tree into a form solvers can iterate linearly */
+    if (children_changed || vector_count(changed_nodes) > 0)
+        if ((result = chain_flat_build(solver->chain_flat, &solver->chain_list)) != IK_OK)
+            goto rebuild_failed;
+
+    update_thread_pool(solver);
+
+    /* Sub-trees are only split if there are threads to solve them */
+    if ((result = chain_flat_find_branches(solver->chain_flat,
+            solver->thread_pool != NULL ? solver->fork_threshold : 0)) != IK_OK)
+        goto rebuild_failed;
+
+    return IK_OK;
+
+    /* The chains are in an undefined state now, so next time start from scratch */
+    rebuild_failed : solver->tree->v->mark_dirty(solver->tree, IK_NODE_DIRTY_CHILDREN);
+    return result;
+}
+
 /* ------------------------------------------------------------------------- */
 void
 ik_solver_base_update_distances(struct ik_solver_t* solver)
 {
     update_distances(&solver->chain_list);
+    chain_flat_update_distances(solver->chain_flat);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -213,6 +399,165 @@ ik_solver_base_solve(struct ik_solver_t* solver)
     return IK_OK;
 }
 
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_base_update_rotations(struct ik_solver_t* solver)
+{
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_instances_t*
+ik_solver_base_create_instances(struct ik_solver_t* solver, uint32_t count)
+{
+    struct ik_instances_t* instances;
+    struct chain_flat_t* flat = solver->chain_flat;
+    uint32_t node_count = vector_count(&flat->pose_nodes);
+    uint32_t effector_count = vector_count(&flat->effector_slots);
+    uint32_t instance_idx, i;
+    uint8_t* memory;
+
+    if (node_count == 0)
+    {
+        IKAPI.log.message("Can't create instances: Solver has no chains. Did you forget to call ik_solver_rebuild()?");
+        return NULL;
+    }
+
+    /* All arrays are allocated in a single block following the struct */
+    memory = MALLOC(sizeof *instances
+        + sizeof(struct ik_node_t*) * node_count
+        + sizeof(struct ik_effector_t*) * effector_count
+        + sizeof(ik_vec3_t) * node_count * count
+        + sizeof(ik_vec3_t) * effector_count * count
+        + sizeof(ik_quat_t) * effector_count * count
+        + sizeof(ikret_t) * count
+        + sizeof(int32_t) * count);
+    if (memory == NULL)
+    {
+        IKAPI.log.message("Failed to allocate instances: ran out of memory");
+        return NULL;
+    }
+
+    instances = (struct ik_instances_t*)memory;               memory += sizeof *instances;
+    instances->nodes = (struct ik_node_t**)memory;            memory += sizeof(struct ik_node_t*) * node_count;
+    instances->effectors = (struct ik_effector_t**)memory;    memory += sizeof(struct ik_effector_t*) * effector_count;
+    instances->positions = (ik_vec3_t*)memory;                memory += sizeof(ik_vec3_t) * node_count * count;
+    instances->targets = (ik_vec3_t*)memory;                  memory += sizeof(ik_vec3_t) * effector_count * count;
+    instances->target_rotations = (ik_quat_t*)memory;         memory += sizeof(ik_quat_t) * effector_count * count;
+    instances->results = (ikret_t*)memory;                    memory += sizeof(ikret_t) * count;
+    instances->iterations_used = (int32_t*)memory;
+    instances->count = count;
+    instances->node_count = node_count;
+    instances->effector_count = effector_count;
+
+    memcpy(instances->nodes, flat->pose_nodes.data, sizeof(struct ik_node_t*) * node_count);
+    for (i = 0; i != effector_count; ++i)
+    {
+        uint32_t slot = *(uint32_t*)vector_get_element(&flat->effector_slots, i);
+        instances->effectors[i] = chain_flat_data(flat, nodes, struct ik_node_t*)[slot]->effector;
+    }
+
+    /* Initialize every instance with the template's global pose and targets */
+    chain_flat_update_global_pose(flat);
+    for (instance_idx = 0; instance_idx != count; ++instance_idx)
+    {
+        memcpy(instances->positions + instance_idx * node_count, flat->pose_global_positions.data,
+               sizeof(ik_vec3_t) * node_count);
+        for (i = 0; i != effector_count; ++i)
+        {
+            instances->targets[instance_idx * effector_count + i] = instances->effectors[i]->target_position;
+            instances->target_rotations[instance_idx * effector_count + i] = instances->effectors[i]->target_rotation;
+        }
+        instances->results[instance_idx] = IK_OK;
+        instances->iterations_used[instance_idx] = 0;
+    }
+
+    return instances;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_base_destroy_instances(struct ik_instances_t* instances)
+{
+    FREE(instances);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_base_solve_instances(struct ik_solver_t* solver, struct ik_instances_t* instances)
+{
+    IKAPI.log.message("This solver doesn't support solving instances");
+    return IK_SOLVER_DOESNT_SUPPORT_INSTANCES;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikreal_t*
+carve_vec3_array(struct ik_vec3_array_t* array, ikreal_t* memory, uint32_t count)
+{
+    array->x = memory; memory += count;
+    array->y = memory; memory += count;
+    array->z = memory; memory += count;
+    return memory;
+}
+static ikreal_t*
+carve_quat_array(struct ik_quat_array_t* array, ikreal_t* memory, uint32_t count)
+{
+    array->x = memory; memory += count;
+    array->y = memory; memory += count;
+    array->z = memory; memory += count;
+    array->w = memory; memory += count;
+    return memory;
+}
+struct ik_limbs_t*
+ik_solver_base_create_limbs(uint32_t count)
+{
+    struct ik_limbs_t* limbs;
+    ikreal_t* memory;
+    uint32_t i;
+
+    /* 5 vec3 and 2 quat arrays. All arrays are allocated in a single block following the struct */
+    limbs = MALLOC(sizeof *limbs + sizeof(ikreal_t) * count * (5*3 + 2*4));
+    if (limbs == NULL)
+    {
+        IKAPI.log.message("Failed to allocate limbs: ran out of memory");
+        return NULL;
+    }
+
+    memory = (ikreal_t*)(limbs + 1);
+    memset(memory, 0, sizeof(ikreal_t) * count * (5*3 + 2*4));
+    memory = carve_vec3_array(&limbs->bases, memory, count);
+    memory = carve_vec3_array(&limbs->mids, memory, count);
+    memory = carve_vec3_array(&limbs->tips, memory, count);
+    memory = carve_vec3_array(&limbs->targets, memory, count);
+    memory = carve_vec3_array(&limbs->poles, memory, count);
+    memory = carve_quat_array(&limbs->base_rotations, memory, count);
+    carve_quat_array(&limbs->mid_rotations, memory, count);
+    limbs->count = count;
+
+    for (i = 0; i != count; ++i)
+    {
+        limbs->base_rotations.w[i] = 1;
+        limbs->mid_rotations.w[i] = 1;
+    }
+
+    return limbs;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_base_destroy_limbs(struct ik_limbs_t* limbs)
+{
+    FREE(limbs);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_base_solve_limbs(struct ik_solver_t* solver, struct ik_limbs_t* limbs)
+{
+    IKAPI.log.message("This solver doesn't support solving limbs");
+    return IK_SOLVER_DOESNT_SUPPORT_LIMBS;
+}
+
 /* ------------------------------------------------------------------------- */
 static void
 iterate_tree_recursive(struct ik_node_t* node,
@@ -228,13 +573,23 @@ void
 ik_solver_base_iterate_all_nodes(struct ik_solver_t* solver,
                                  ik_solver_iterate_node_cb_func callback)
 {
+    uint32_t idx;
+
     if (solver->tree == NULL)
     {
         IKAPI.log.message("Warning: Tried iterating the tree, but no tree was set");
         return;
     }
 
-    iterate_tree_recursive(solver->tree, callback);
+    /* The flat tree is only up to date if nothing changed since the last rebuild */
+    if (solver->tree->dirty)
+    {
+        iterate_tree_recursive(solver->tree, callback);
+        return;
+    }
+
+    for (idx = 0; idx != tree_flat_node_count(solver->tree_flat); ++idx)
+        callback(tree_flat_get_node(solver->tree_flat, idx));
 }
 
 /* ------------------------------------------------------------------------- */
@@ -287,9 +642,15 @@ ik_solver_base_iterate_base_nodes(struct ik_solver_t* solver,
 static int
 recursively_get_all_effector_nodes(struct ik_node_t* node, struct vector_t* effector_nodes_list)
 {
+    /* The whole tree is rebuilt, so nothing is dirty anymore */
+    node->dirty = 0;
+
     if (node->effector != NULL)
+    {
+        node->effector->_built_chain_length = node->effector->chain_length;
         if (vector_push(effector_nodes_list, &node) < 0)
             return -1;
+    }
 
     NODE_FOR_EACH(node, guid, child)
         if (recursively_get_all_effector_nodes(child, effector_nodes_list) < 0)
@@ -298,3 +659,159 @@ recursively_get_all_effector_nodes(struct ik_node_t* node, struct vector_t* effe
 
     return 0;
 }
+
+/* ------------------------------------------------------------------------- */
+struct ik_node_t*
+ik_solver_base_find_node(struct ik_solver_t* solver, uint32_t guid)
+{
+    if (solver->tree == NULL)
+        return NULL;
+
+    /* The flat tree is only up to date if nothing changed since the last rebuild */
+    if (solver->tree->dirty)
+        return solver->tree->v->find_child(solver->tree, guid);
+
+    return tree_flat_find(solver->tree_flat, guid);
+}
+
+/* ------------------------------------------------------------------------- */
+uint32_t
+ik_solver_base_node_count(struct ik_solver_t* solver)
+{
+    if (solver->tree == NULL || solver->tree->dirty)
+        return 0;
+
+    return tree_flat_node_count(solver->tree_flat);
+}
+
+/* ------------------------------------------------------------------------- */
+int32_t
+ik_solver_base_find_node_index(struct ik_solver_t* solver, uint32_t guid)
+{
+    if (solver->tree == NULL || solver->tree->dirty)
+        return -1;
+
+    return tree_flat_find_index(solver->tree_flat, guid);
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+check_pose_tree(const struct ik_solver_t* solver)
+{
+    if (solver->tree == NULL)
+    {
+        IKAPI.log.message("No tree to work with. Did you forget to set the tree with ik_solver_set_tree()?");
+        return IK_SOLVER_HAS_NO_TREE;
+    }
+
+    /* Node indices refer to the flat tree, which is only up to date after a rebuild */
+    if (solver->tree->dirty)
+    {
+        IKAPI.log.message("The tree changed since the last rebuild. Call ik_solver_rebuild() before accessing the pose");
+        return IK_TREE_NOT_REBUILT;
+    }
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+#define POSE_TRANSFORM(type, buffer, stride, idx) \
+    ((type*)((uintptr_t)(buffer) + (uintptr_t)(idx) * (stride)))
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_base_set_pose(struct ik_solver_t* solver,
+                        const ikreal_t* transforms,
+                        uint32_t stride,
+                        uint8_t flags)
+{
+    const int32_t* parents;
+    uint32_t count, idx;
+    ikret_t result;
+
+    if ((result = check_pose_tree(solver)) != IK_OK)
+        return result;
+
+    if (stride == 0)
+        stride = sizeof(ikreal_t) * 7;
+
+    count = tree_flat_node_count(solver->tree_flat);
+    parents = (const int32_t*)solver->tree_flat->parents.data;
+    for (idx = 0; idx != count; ++idx)
+    {
+        struct ik_node_t* node = tree_flat_get_node(solver->tree_flat, idx);
+        const ikreal_t* transform = POSE_TRANSFORM(const ikreal_t, transforms, stride, idx);
+        const ikreal_t* parent_transform;
+        ik_quat_t inv_parent;
+
+        memcpy(node->transform, transform, sizeof(ikreal_t) * 7);
+        if ((flags & IK_POSE_GLOBAL) == 0 || parents[idx] < 0)
+            continue;
+
+        /*
+         * Undo the accumulation done by ik_solver_get_pose(). The parent's
+         * global transform is read from the buffer as well, so every node
+         * only needs its own and its parent's entry.
+         */
+        parent_transform = POSE_TRANSFORM(const ikreal_t, transforms, stride, parents[idx]);
+        memcpy(inv_parent.f, parent_transform, sizeof(ikreal_t) * 4);
+        quat_conj(inv_parent.f);
+        vec3_sub_vec3(node->position.f, parent_transform + 4);
+        vec3_rotate(node->position.f, inv_parent.f);
+        quat_mul_quat(inv_parent.f, node->rotation.f);
+        node->rotation = inv_parent;
+    }
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_base_get_pose(struct ik_solver_t* solver,
+                        ikreal_t* transforms,
+                        uint32_t stride,
+                        uint8_t flags)
+{
+    const int32_t* parents;
+    uint32_t count, idx;
+    ikret_t result;
+
+    if ((result = check_pose_tree(solver)) != IK_OK)
+        return result;
+
+    if (stride == 0)
+        stride = sizeof(ikreal_t) * 7;
+
+    count = tree_flat_node_count(solver->tree_flat);
+    parents = (const int32_t*)solver->tree_flat->parents.data;
+    for (idx = 0; idx != count; ++idx)
+    {
+        const struct ik_node_t* node = tree_flat_get_node(solver->tree_flat, idx);
+        ikreal_t* transform = POSE_TRANSFORM(ikreal_t, transforms, stride, idx);
+        const ikreal_t* parent_transform;
+        ik_quat_t rotation;
+        ik_vec3_t position;
+
+        if ((flags & IK_POSE_GLOBAL) == 0 || parents[idx] < 0)
+        {
+            memcpy(transform, node->transform, sizeof(ikreal_t) * 7);
+            continue;
+        }
+
+        /*
+         * Parents come before their children, so the parent's global
+         * transform was already written to the buffer. Same math as
+         * chain_flat_update_global_pose().
+         */
+        parent_transform = POSE_TRANSFORM(const ikreal_t, transforms, stride, parents[idx]);
+        memcpy(rotation.f, parent_transform, sizeof(ikreal_t) * 4);
+        position = node->position;
+        vec3_rotate(position.f, rotation.f);
+        vec3_add_vec3(position.f, parent_transform + 4);
+        quat_mul_quat(rotation.f, node->rotation.f);
+        memcpy(transform, rotation.f, sizeof(ikreal_t) * 4);
+        memcpy(transform + 4, position.f, sizeof(ikreal_t) * 3);
+    }
+
+    return IK_OK;
+}
@@ -94,6 +94,55 @@ ik_solver_static_solve(struct ik_solver_t* solver)
     return solver->v->solve(solver);
 }
 
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_static_update_rotations(struct ik_solver_t* solver)
+{
+    return solver->v->update_rotations(solver);
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_instances_t*
+ik_solver_static_create_instances(struct ik_solver_t* solver, uint32_t count)
+{
+    return solver->v->create_instances(solver, count);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_static_destroy_instances(struct ik_instances_t* instances)
+{
+    IKAPI.internal.solver_base.destroy_instances(instances);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_static_solve_instances(struct ik_solver_t* solver, struct ik_instances_t* instances)
+{
+    return solver->v->solve_instances(solver, instances);
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_limbs_t*
+ik_solver_static_create_limbs(uint32_t count)
+{
+    return IKAPI.internal.solver_base.create_limbs(count);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_static_destroy_limbs(struct ik_limbs_t* limbs)
+{
+    IKAPI.internal.solver_base.destroy_limbs(limbs);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_static_solve_limbs(struct ik_solver_t* solver, struct ik_limbs_t* limbs)
+{
+    return solver->v->solve_limbs(solver, limbs);
+}
+
 /* ------------------------------------------------------------------------- */
 void
 ik_solver_static_set_tree(struct ik_solver_t* solver, struct ik_node_t* base)
@@ -135,3 +184,38 @@ ik_solver_static_iterate_base_nodes(struct ik_solver_t* solver, ik_solver_iterat
 {
     solver->v->iterate_base_nodes(solver, callback);
 }
+
+/* ------------------------------------------------------------------------- */
+struct ik_node_t*
+ik_solver_static_find_node(struct ik_solver_t* solver, uint32_t guid)
+{
+    return solver->v->find_node(solver, guid);
+}
+
+/* ------------------------------------------------------------------------- */
+uint32_t
+ik_solver_static_node_count(struct ik_solver_t* solver)
+{
+    return solver->v->node_count(solver);
+}
+
+/* ------------------------------------------------------------------------- */
+int32_t
+ik_solver_static_find_node_index(struct ik_solver_t* solver, uint32_t guid)
+{
+    return solver->v->find_node_index(solver, guid);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_static_set_pose(struct ik_solver_t* solver, const ikreal_t* transforms, uint32_t stride, uint8_t flags)
+{
+    return solver->v->set_pose(solver, transforms, stride, flags);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_static_get_pose(struct ik_solver_t* solver, ikreal_t* transforms, uint32_t stride, uint8_t flags)
+{
+    return solver->v->get_pose(solver, transforms, stride, flags);
+}
@@ -0,0 +1,64 @@
+#ifndef IK_TESTS_POSE_HELPERS_HPP
+#define IK_TESTS_POSE_HELPERS_HPP
+
+#include "ik/ik.h"
+
+/*
+ * Creates a straight chain of segment_count segments with length 1 along the
+ * Y axis and makes it the solver's tree. nodes needs room for
+ * segment_count + 1 nodes. nodes[0] is the base and every node's guid is its
+ * index.
+ */
+inline void
+build_straight_chain(ik_solver_t* solver, ik_node_t** nodes, uint32_t segment_count)
+{
+    nodes[0] = solver->node->create(0);
+    IKAPI.solver.set_tree(solver, nodes[0]);
+    for (uint32_t guid = 1; guid <= segment_count; ++guid)
+    {
+        nodes[guid] = solver->node->create_child(nodes[guid - 1], guid);
+        nodes[guid]->position.y = 1;
+    }
+}
+
+/*
+ * Accumulates the local transforms from the root down to the node. Every node
+ * is relative to its parent's accumulated rotation and global position.
+ */
+inline void
+global_transform(const ik_node_t* node, ik_quat_t* rotation, ik_vec3_t* position)
+{
+    if (node->parent == NULL)
+    {
+        *rotation = node->rotation;
+        *position = node->position;
+        return;
+    }
+
+    global_transform(node->parent, rotation, position);
+    ik_vec3_t local = node->position;
+    IKAPI.vec3.rotate(local.f, rotation->f);
+    IKAPI.vec3.add_vec3(position->f, local.f);
+    IKAPI.quat.mul_quat(rotation->f, node->rotation.f);
+}
+
+inline ik_vec3_t
+global_position(const ik_node_t* node)
+{
+    ik_quat_t rotation;
+    ik_vec3_t position;
+    global_transform(node, &rotation, &position);
+    return position;
+}
+
+/* The segment between the node and its parent, in global space */
+inline ik_vec3_t
+global_segment(const ik_node_t* node)
+{
+    ik_vec3_t segment = global_position(node);
+    ik_vec3_t parent = global_position(node->parent);
+    IKAPI.vec3.sub_vec3(segment.f, parent.f);
+    return segment;
+}
+
+#endif /* IK_TESTS_POSE_HELPERS_HPP */
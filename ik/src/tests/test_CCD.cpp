@@ -0,0 +1,171 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include "pose_helpers.hpp"
+#include <cmath>
+
+#define NAME CCD
+
+using namespace ::testing;
+
+class CCD_chain : public Test
+{
+public:
+    CCD_chain() : solver(NULL), effector(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_CCD);
+        solver->flags = IK_ENABLE_JOINT_ROTATIONS;
+
+        build_straight_chain(solver, nodes, 8);
+
+        effector = solver->effector->create();
+        solver->effector->attach(effector, nodes[8]);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_effector_t* effector;
+    ik_node_t* nodes[9];
+};
+
+TEST_F(CCD_chain, reachable_target_is_reached_by_rotating_joints)
+{
+    effector->target_position = IKAPI.vec3.vec3(3, 4, 2);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    ik_vec3_t tip = global_position(nodes[8]);
+    EXPECT_THAT(tip.x, DoubleNear(3, 1e-3));
+    EXPECT_THAT(tip.y, DoubleNear(4, 1e-3));
+    EXPECT_THAT(tip.z, DoubleNear(2, 1e-3));
+    for (uint32_t i = 1; i != 9; ++i)
+    {
+        EXPECT_THAT(nodes[i]->position.x, DoubleNear(0, 1e-12));
+        EXPECT_THAT(nodes[i]->position.y, DoubleNear(1, 1e-12));
+        EXPECT_THAT(nodes[i]->position.z, DoubleNear(0, 1e-12));
+    }
+}
+
+TEST_F(CCD_chain, without_joint_rotations_only_positions_are_written)
+{
+    solver->flags = 0;
+    effector->target_position = IKAPI.vec3.vec3(3, 4, 2);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    ik_vec3_t tip = global_position(nodes[8]);
+    EXPECT_THAT(tip.x, DoubleNear(3, 1e-3));
+    EXPECT_THAT(tip.y, DoubleNear(4, 1e-3));
+    EXPECT_THAT(tip.z, DoubleNear(2, 1e-3));
+    for (uint32_t i = 0; i != 9; ++i)
+        EXPECT_THAT(nodes[i]->rotation.w, DoubleEq(1));
+    for (uint32_t i = 1; i != 9; ++i)
+        EXPECT_THAT(IKAPI.vec3.length(global_segment(nodes[i]).f), DoubleNear(1, 1e-9));
+}
+
+TEST_F(CCD_chain, chain_length_limits_the_rotated_joints)
+{
+    /* Like the node positions, the target is relative to the parent of the chain's base (node 4) */
+    effector->chain_length = 3;
+    effector->target_position = IKAPI.vec3.vec3(1, 3, 1);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    for (uint32_t i = 0; i != 5; ++i)
+        EXPECT_THAT(nodes[i]->rotation.w, DoubleEq(1));
+    ik_vec3_t tip = global_position(nodes[8]);
+    EXPECT_THAT(tip.x, DoubleNear(1, 1e-3));
+    EXPECT_THAT(tip.y, DoubleNear(7, 1e-3));
+    EXPECT_THAT(tip.z, DoubleNear(1, 1e-3));
+}
+
+TEST_F(CCD_chain, unreachable_target_terminates_on_stall)
+{
+    effector->target_position = IKAPI.vec3.vec3(20, 0, 0);
+    solver->max_iterations = 100;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+    EXPECT_THAT(solver->iterations_used, Lt(100));
+
+    ik_vec3_t tip = global_position(nodes[8]);
+    EXPECT_THAT(tip.x, Gt(7.9));
+    EXPECT_THAT(tip.y, DoubleNear(0, 0.5));
+}
+
+TEST_F(CCD_chain, fast_math_is_close_to_precise_solve)
+{
+    effector->target_position = IKAPI.vec3.vec3(-2, 3, 4);
+    solver->flags |= IK_ENABLE_FAST_MATH;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    ik_vec3_t tip = global_position(nodes[8]);
+    EXPECT_THAT(tip.x, DoubleNear(-2, 1e-3));
+    EXPECT_THAT(tip.y, DoubleNear(3, 1e-3));
+    EXPECT_THAT(tip.z, DoubleNear(4, 1e-3));
+}
+
+TEST(NAME, two_arms_share_the_trunk)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_CCD);
+    ik_node_t* n[7];
+    ik_effector_t* e[2];
+    solver->flags = 0;
+
+    /* Trunk of 2 segments splitting into two arms with 2 segments each */
+    n[0] = solver->node->create(0);
+    IKAPI.solver.set_tree(solver, n[0]);
+    n[1] = solver->node->create_child(n[0], 1);
+    n[2] = solver->node->create_child(n[1], 2);
+    n[3] = solver->node->create_child(n[2], 3);
+    n[4] = solver->node->create_child(n[3], 4);
+    n[5] = solver->node->create_child(n[2], 5);
+    n[6] = solver->node->create_child(n[5], 6);
+    n[1]->position.y = 1;
+    n[2]->position.y = 1;
+    n[3]->position.x = -1;
+    n[4]->position.x = -1;
+    n[5]->position.x = 1;
+    n[6]->position.x = 1;
+
+    e[0] = solver->effector->create();
+    e[1] = solver->effector->create();
+    solver->effector->attach(e[0], n[4]);
+    solver->effector->attach(e[1], n[6]);
+    e[0]->target_position = IKAPI.vec3.vec3(-1, 2, 1);
+    e[1]->target_position = IKAPI.vec3.vec3(1, 3, -1);
+    solver->max_iterations = 100;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    /* No joint rotations, so local positions add up */
+    ik_vec3_t tip0 = n[4]->position;
+    ik_vec3_t tip1 = n[6]->position;
+    for (int i = 0; i != 3; ++i)
+    {
+        IKAPI.vec3.add_vec3(tip0.f, n[i]->position.f);
+        IKAPI.vec3.add_vec3(tip1.f, n[i]->position.f);
+    }
+    IKAPI.vec3.add_vec3(tip0.f, n[3]->position.f);
+    IKAPI.vec3.add_vec3(tip1.f, n[5]->position.f);
+    EXPECT_THAT(tip0.x, DoubleNear(-1, 1e-3));
+    EXPECT_THAT(tip0.y, DoubleNear(2, 1e-3));
+    EXPECT_THAT(tip0.z, DoubleNear(1, 1e-3));
+    EXPECT_THAT(tip1.x, DoubleNear(1, 1e-3));
+    EXPECT_THAT(tip1.y, DoubleNear(3, 1e-3));
+    EXPECT_THAT(tip1.z, DoubleNear(-1, 1e-3));
+
+    IKAPI.solver.destroy(solver);
+}
@@ -0,0 +1,230 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include "pose_helpers.hpp"
+#include <cmath>
+
+#define NAME DLS
+
+using namespace ::testing;
+
+class DLS_chain : public Test
+{
+public:
+    DLS_chain() : solver(NULL), effector(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_DLS);
+        solver->flags = 0;
+
+        build_straight_chain(solver, nodes, 4);
+
+        effector = solver->effector->create();
+        solver->effector->attach(effector, nodes[4]);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_effector_t* effector;
+    ik_node_t* nodes[5];
+};
+
+TEST_F(DLS_chain, reachable_target_converges_in_few_iterations)
+{
+    effector->target_position = IKAPI.vec3.vec3(2, 2, 1);
+    solver->tolerance = 1e-6;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Le(8));
+
+    ik_vec3_t tip = global_position(nodes[4]);
+    EXPECT_THAT(tip.x, DoubleNear(2, 1e-6));
+    EXPECT_THAT(tip.y, DoubleNear(2, 1e-6));
+    EXPECT_THAT(tip.z, DoubleNear(1, 1e-6));
+    for (uint32_t i = 1; i != 5; ++i)
+        EXPECT_THAT(IKAPI.vec3.length(global_segment(nodes[i]).f), DoubleNear(1, 1e-9));
+}
+
+TEST_F(DLS_chain, larger_lambda_min_takes_more_iterations)
+{
+    ik_solver_DLS_t* dls = (ik_solver_DLS_t*)solver;
+    EXPECT_THAT(dls->lambda_min, DoubleEq(0.1));
+
+    effector->target_position = IKAPI.vec3.vec3(2, 2, 1);
+    solver->tolerance = 1e-6;
+    solver->max_iterations = 100;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    int32_t iterations = solver->iterations_used;
+
+    for (uint32_t guid = 1; guid != 5; ++guid)
+    {
+        nodes[guid]->position = IKAPI.vec3.vec3(0, 1, 0);
+        IKAPI.quat.set_identity(nodes[guid]->rotation.f);
+    }
+    dls->lambda_min = 2;
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Gt(iterations));
+}
+
+TEST_F(DLS_chain, target_already_reached_needs_no_iterations)
+{
+    effector->target_position = IKAPI.vec3.vec3(0, 4, 0);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Eq(0));
+}
+
+TEST_F(DLS_chain, unreachable_target_stretches_chain_towards_target)
+{
+    effector->target_position = IKAPI.vec3.vec3(10, 0, 0);
+    solver->max_iterations = 50;
+    solver->stall_ratio = 0;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+    EXPECT_THAT(solver->iterations_used, Eq(50));
+
+    ik_vec3_t tip = global_position(nodes[4]);
+    EXPECT_THAT(tip.x, DoubleNear(4, 5e-2));
+    EXPECT_THAT(tip.y, DoubleNear(0, 1e-1));
+}
+
+TEST_F(DLS_chain, joint_rotations_move_the_chain_without_changing_local_positions)
+{
+    effector->target_position = IKAPI.vec3.vec3(-1, 2, -2);
+    solver->flags = IK_ENABLE_JOINT_ROTATIONS;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    for (uint32_t i = 1; i != 5; ++i)
+    {
+        EXPECT_THAT(nodes[i]->position.x, DoubleNear(0, 1e-12));
+        EXPECT_THAT(nodes[i]->position.y, DoubleNear(1, 1e-12));
+        EXPECT_THAT(nodes[i]->position.z, DoubleNear(0, 1e-12));
+    }
+    ik_vec3_t tip = global_position(nodes[4]);
+    EXPECT_THAT(tip.x, DoubleNear(-1, 1e-3));
+    EXPECT_THAT(tip.y, DoubleNear(2, 1e-3));
+    EXPECT_THAT(tip.z, DoubleNear(-2, 1e-3));
+}
+
+TEST_F(DLS_chain, target_rotation_aligns_tip_segment)
+{
+    ik_vec3_t z = IKAPI.vec3.vec3(0, 0, 1);
+    ik_vec3_t x = IKAPI.vec3.vec3(1, 0, 0);
+    IKAPI.quat.angle(effector->target_rotation.f, z.f, x.f);
+    effector->target_position = IKAPI.vec3.vec3(2, 2, 0);
+    solver->flags = IK_ENABLE_TARGET_ROTATIONS;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    ik_vec3_t tip = global_position(nodes[4]);
+    ik_vec3_t direction = global_segment(nodes[4]);
+    EXPECT_THAT(tip.x, DoubleNear(2, 1e-3));
+    EXPECT_THAT(tip.y, DoubleNear(2, 1e-3));
+    EXPECT_THAT(direction.x, DoubleNear(1, 1e-3));
+    EXPECT_THAT(direction.y, DoubleNear(0, 1e-3));
+    EXPECT_THAT(direction.z, DoubleNear(0, 1e-3));
+}
+
+class DLS_tree : public Test
+{
+public:
+    DLS_tree() : solver(NULL) {}
+
+    /* Trunk of 2 segments splitting into two arms with 2 segments each */
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_DLS);
+        solver->flags = 0;
+        n[0] = solver->node->create(0);
+        IKAPI.solver.set_tree(solver, n[0]);
+        n[1] = solver->node->create_child(n[0], 1);
+        n[2] = solver->node->create_child(n[1], 2);
+        n[3] = solver->node->create_child(n[2], 3);
+        n[4] = solver->node->create_child(n[3], 4);
+        n[5] = solver->node->create_child(n[2], 5);
+        n[6] = solver->node->create_child(n[5], 6);
+        n[1]->position.y = 1;
+        n[2]->position.y = 1;
+        n[3]->position.x = -1;
+        n[4]->position.x = -1;
+        n[5]->position.x = 1;
+        n[6]->position.x = 1;
+
+        e[0] = solver->effector->create();
+        e[1] = solver->effector->create();
+        solver->effector->attach(e[0], n[4]);
+        solver->effector->attach(e[1], n[6]);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_node_t* n[7];
+    ik_effector_t* e[2];
+};
+
+TEST_F(DLS_tree, both_arms_reach_their_targets)
+{
+    e[0]->target_position = IKAPI.vec3.vec3(-1, 2, 1);
+    e[1]->target_position = IKAPI.vec3.vec3(1, 3, -1);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    ik_vec3_t tip0 = global_position(n[4]);
+    ik_vec3_t tip1 = global_position(n[6]);
+    EXPECT_THAT(tip0.x, DoubleNear(-1, 1e-3));
+    EXPECT_THAT(tip0.y, DoubleNear(2, 1e-3));
+    EXPECT_THAT(tip0.z, DoubleNear(1, 1e-3));
+    EXPECT_THAT(tip1.x, DoubleNear(1, 1e-3));
+    EXPECT_THAT(tip1.y, DoubleNear(3, 1e-3));
+    EXPECT_THAT(tip1.z, DoubleNear(-1, 1e-3));
+    for (uint32_t i = 1; i != 7; ++i)
+        EXPECT_THAT(IKAPI.vec3.length(n[i]->position.f), DoubleNear(1, 1e-9));
+}
+
+TEST_F(DLS_tree, separate_islands_are_solved_independently)
+{
+    /*
+     * Only the arms are solved, so each arm is an island of its own. The
+     * trunk is collapsed so the bases of the islands are at the origin.
+     */
+    n[1]->position.y = 0;
+    n[2]->position.y = 0;
+    n[3]->position = IKAPI.vec3.vec3(0, 0, 0);
+    n[5]->position = IKAPI.vec3.vec3(0, 0, 0);
+    n[4]->position = IKAPI.vec3.vec3(-1, 0, 0);
+    n[6]->position = IKAPI.vec3.vec3(1, 0, 0);
+    e[0]->chain_length = 1;
+    e[1]->chain_length = 1;
+    e[0]->target_position = IKAPI.vec3.vec3(0, 1, 0);
+    e[1]->target_position = IKAPI.vec3.vec3(0, 0, -1);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    ik_vec3_t tip0 = global_position(n[4]);
+    ik_vec3_t tip1 = global_position(n[6]);
+    EXPECT_THAT(tip0.x, DoubleNear(0, 1e-3));
+    EXPECT_THAT(tip0.y, DoubleNear(1, 1e-3));
+    EXPECT_THAT(tip0.z, DoubleNear(0, 1e-3));
+    EXPECT_THAT(tip1.x, DoubleNear(0, 1e-3));
+    EXPECT_THAT(tip1.y, DoubleNear(0, 1e-3));
+    EXPECT_THAT(tip1.z, DoubleNear(-1, 1e-3));
+}
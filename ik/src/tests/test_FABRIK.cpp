@@ -1,5 +1,8 @@
 #include "gmock/gmock.h"
 #include "ik/ik.h"
+#include "pose_helpers.hpp"
+#include <cmath>
+#include <vector>
 
 #define NAME FABRIK
 
@@ -10,6 +13,901 @@ TEST(NAME, todo)
     ASSERT_TRUE(0);
 }
 
+class FABRIK_convergence : public Test
+{
+public:
+    FABRIK_convergence() : solver(NULL), effector(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_FABRIK);
+
+        ik_node_t* nodes[5];
+        build_straight_chain(solver, nodes, 4);
+
+        effector = solver->effector->create();
+        solver->effector->attach(effector, nodes[4]);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_effector_t* effector;
+};
+
+TEST_F(FABRIK_convergence, reachable_target_terminates_early)
+{
+    effector->target_position.x = 2;
+    effector->target_position.y = 2;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Gt(0));
+    EXPECT_THAT(solver->iterations_used, Lt(solver->max_iterations));
+}
+
+TEST_F(FABRIK_convergence, unreachable_target_terminates_on_stall)
+{
+    effector->target_position.x = 50;
+    effector->target_position.y = 50;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+    EXPECT_THAT(solver->iterations_used, Lt(solver->max_iterations));
+}
+
+TEST_F(FABRIK_convergence, unreachable_target_uses_all_iterations_if_stall_check_is_disabled)
+{
+    effector->target_position.x = 50;
+    effector->target_position.y = 50;
+    solver->stall_ratio = 0;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+    EXPECT_THAT(solver->iterations_used, Eq(solver->max_iterations));
+}
+
+TEST_F(FABRIK_convergence, effector_tolerance_overrides_solver_tolerance)
+{
+    effector->target_position.x = 0.5;
+    effector->target_position.y = 4;
+    effector->tolerance = 1;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Eq(0));
+}
+
+class FABRIK_instances : public Test
+{
+public:
+    FABRIK_instances() : solver(NULL), instances(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_FABRIK);
+        solver->flags = 0;
+
+        /* Trunk of 2 segments splitting into two arms with 2 segments each */
+        ik_node_t* root = solver->node->create(0);
+        IKAPI.solver.set_tree(solver, root);
+        ik_node_t* trunk1 = solver->node->create_child(root, 1);
+        ik_node_t* trunk2 = solver->node->create_child(trunk1, 2);
+        ik_node_t* left1 = solver->node->create_child(trunk2, 3);
+        ik_node_t* left2 = solver->node->create_child(left1, 4);
+        ik_node_t* right1 = solver->node->create_child(trunk2, 5);
+        ik_node_t* right2 = solver->node->create_child(right1, 6);
+        trunk1->position.y = 1;
+        trunk2->position.y = 1;
+        left1->position.x = -1;
+        left2->position.x = -1;
+        right1->position.x = 1;
+        right2->position.x = 1;
+
+        left = solver->effector->create();
+        right = solver->effector->create();
+        solver->effector->attach(left, left2);
+        solver->effector->attach(right, right2);
+        left->target_position = IKAPI.vec3.vec3(-2, 1, 1);
+        right->target_position = IKAPI.vec3.vec3(2, 1, 1);
+    }
+
+    virtual void TearDown()
+    {
+        if (instances != NULL)
+            IKAPI.solver.destroy_instances(instances);
+        IKAPI.solver.destroy(solver);
+    }
+
+    uint32_t node_index(const ik_node_t* node)
+    {
+        for (uint32_t i = 0; i != instances->node_count; ++i)
+            if (instances->nodes[i] == node)
+                return i;
+        return (uint32_t)-1;
+    }
+
+    uint32_t effector_index(const ik_effector_t* effector)
+    {
+        for (uint32_t i = 0; i != instances->effector_count; ++i)
+            if (instances->effectors[i] == effector)
+                return i;
+        return (uint32_t)-1;
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_instances_t* instances;
+    ik_effector_t* left;
+    ik_effector_t* right;
+};
+
+TEST_F(FABRIK_instances, create_copies_template_pose_and_targets)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    instances = IKAPI.solver.create_instances(solver, 3);
+    ASSERT_THAT(instances, NotNull());
+    EXPECT_THAT(instances->count, Eq(3u));
+    EXPECT_THAT(instances->node_count, Eq(7u));
+    EXPECT_THAT(instances->effector_count, Eq(2u));
+
+    uint32_t left2 = node_index(left->node);
+    ASSERT_THAT(left2, Lt(instances->node_count));
+    for (uint32_t i = 0; i != instances->count; ++i)
+    {
+        /* Positions are global */
+        const ik_vec3_t& pos = instances->positions[i * instances->node_count + left2];
+        EXPECT_THAT(pos.x, DoubleEq(-2));
+        EXPECT_THAT(pos.y, DoubleEq(2));
+        EXPECT_THAT(pos.z, DoubleEq(0));
+
+        const ik_vec3_t& target = instances->targets[i * instances->effector_count + effector_index(left)];
+        EXPECT_THAT(target.x, DoubleEq(-2));
+        EXPECT_THAT(target.z, DoubleEq(1));
+    }
+}
+
+TEST_F(FABRIK_instances, first_instance_matches_solving_the_template)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    instances = IKAPI.solver.create_instances(solver, 2);
+    ASSERT_THAT(instances, NotNull());
+    instances->targets[instances->effector_count + effector_index(right)] = IKAPI.vec3.vec3(0, 4, 0);
+
+    IKAPI.solver.solve_instances(solver, instances);
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(instances->results[0]));
+
+    /*
+     * The template tree is in local space after solving. Joint rotations are
+     * disabled, so global positions are the sum of all parent positions.
+     */
+    for (uint32_t i = 0; i != instances->node_count; ++i)
+    {
+        ik_vec3_t global = IKAPI.vec3.vec3(0, 0, 0);
+        for (const ik_node_t* node = instances->nodes[i]; node != NULL; node = node->parent)
+            IKAPI.vec3.add_vec3(global.f, node->position.f);
+
+        EXPECT_THAT(instances->positions[i].x, DoubleNear(global.x, 1e-5));
+        EXPECT_THAT(instances->positions[i].y, DoubleNear(global.y, 1e-5));
+        EXPECT_THAT(instances->positions[i].z, DoubleNear(global.z, 1e-5));
+    }
+}
+
+TEST_F(FABRIK_instances, instances_are_solved_independently)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    instances = IKAPI.solver.create_instances(solver, 4);
+    ASSERT_THAT(instances, NotNull());
+    for (uint32_t i = 0; i != instances->count; ++i)
+    {
+        instances->targets[i * instances->effector_count + effector_index(left)] = IKAPI.vec3.vec3(-1.5, 2.5, 0.25 * i);
+        instances->targets[i * instances->effector_count + effector_index(right)] = IKAPI.vec3.vec3(1.5, 2.5, -0.25 * i);
+    }
+
+    EXPECT_THAT(IKAPI.solver.solve_instances(solver, instances), Eq(IK_RESULT_CONVERGED));
+
+    for (uint32_t i = 0; i != instances->count; ++i)
+    {
+        EXPECT_THAT(instances->results[i], Eq(IK_RESULT_CONVERGED));
+        EXPECT_THAT(instances->iterations_used[i], Lt(solver->max_iterations));
+
+        const ik_vec3_t& pos = instances->positions[i * instances->node_count + node_index(left->node)];
+        EXPECT_THAT(pos.x, DoubleNear(-1.5, 1e-2));
+        EXPECT_THAT(pos.y, DoubleNear(2.5, 1e-2));
+        EXPECT_THAT(pos.z, DoubleNear(0.25 * i, 1e-2));
+    }
+}
+
+TEST_F(FABRIK_instances, partially_filled_lanes_match_solving_each_instance_individually)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    /* Odd count so the last group of instances doesn't fill all SIMD lanes */
+    instances = IKAPI.solver.create_instances(solver, 11);
+    ASSERT_THAT(instances, NotNull());
+    for (uint32_t i = 0; i != instances->count; ++i)
+    {
+        instances->targets[i * instances->effector_count + effector_index(left)] = IKAPI.vec3.vec3(-1.5, 2.5 - 0.1 * i, 0.2 * i);
+        instances->targets[i * instances->effector_count + effector_index(right)] = IKAPI.vec3.vec3(0.5 * i, 1, -1);
+    }
+    IKAPI.solver.solve_instances(solver, instances);
+
+    std::vector<ik_vec3_t> initial_pose;
+    for (uint32_t n = 0; n != instances->node_count; ++n)
+        initial_pose.push_back(instances->nodes[n]->position);
+
+    for (uint32_t i = 0; i != instances->count; ++i)
+    {
+        for (uint32_t n = 0; n != instances->node_count; ++n)
+            instances->nodes[n]->position = initial_pose[n];
+        left->target_position = instances->targets[i * instances->effector_count + effector_index(left)];
+        right->target_position = instances->targets[i * instances->effector_count + effector_index(right)];
+
+        EXPECT_THAT(IKAPI.solver.solve(solver), Eq(instances->results[i]));
+        EXPECT_THAT(solver->iterations_used, Eq(instances->iterations_used[i]));
+        for (uint32_t n = 0; n != instances->node_count; ++n)
+        {
+            ik_vec3_t global = IKAPI.vec3.vec3(0, 0, 0);
+            for (const ik_node_t* node = instances->nodes[n]; node != NULL; node = node->parent)
+                IKAPI.vec3.add_vec3(global.f, node->position.f);
+
+            const ik_vec3_t& pos = instances->positions[i * instances->node_count + n];
+            EXPECT_THAT(pos.x, DoubleNear(global.x, 1e-9));
+            EXPECT_THAT(pos.y, DoubleNear(global.y, 1e-9));
+            EXPECT_THAT(pos.z, DoubleNear(global.z, 1e-9));
+        }
+    }
+}
+
+TEST_F(FABRIK_instances, float_instances_are_close_to_full_precision_instances)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    /* Odd count so the last group of float lanes isn't full either */
+    instances = IKAPI.solver.create_instances(solver, 37);
+    ASSERT_THAT(instances, NotNull());
+    for (uint32_t i = 0; i != instances->count; ++i)
+    {
+        instances->targets[i * instances->effector_count + effector_index(left)] = IKAPI.vec3.vec3(-1.5, 2.5 - 0.05 * i, 0.1 * i);
+        instances->targets[i * instances->effector_count + effector_index(right)] = IKAPI.vec3.vec3(0.2 * i, 1, -1);
+    }
+    std::vector<ik_vec3_t> initial_positions(instances->positions, instances->positions + instances->count * instances->node_count);
+
+    IKAPI.solver.solve_instances(solver, instances);
+    std::vector<ik_vec3_t> expected(instances->positions, instances->positions + instances->count * instances->node_count);
+
+    std::copy(initial_positions.begin(), initial_positions.end(), instances->positions);
+    solver->flags |= IK_ENABLE_FLOAT_INSTANCES;
+    IKAPI.solver.solve_instances(solver, instances);
+
+    /* Either may stop iterating anywhere within the solver's tolerance */
+    for (uint32_t i = 0; i != instances->count * instances->node_count; ++i)
+    {
+        EXPECT_THAT(instances->positions[i].x, DoubleNear(expected[i].x, 1e-3));
+        EXPECT_THAT(instances->positions[i].y, DoubleNear(expected[i].y, 1e-3));
+        EXPECT_THAT(instances->positions[i].z, DoubleNear(expected[i].z, 1e-3));
+    }
+}
+
+TEST_F(FABRIK_instances, solving_after_tree_changed_fails)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    instances = IKAPI.solver.create_instances(solver, 2);
+    ASSERT_THAT(instances, NotNull());
+
+    ik_node_t* extra = solver->node->create_child(right->node, 7);
+    solver->effector->detach(right);
+    solver->effector->attach(right, extra);
+    extra->position.x = 1;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve_instances(solver, instances), Eq(IK_INSTANCES_DONT_MATCH_TREE));
+}
+
+class FABRIK_islands : public Test
+{
+public:
+    FABRIK_islands() : solver(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_FABRIK);
+        solver->flags = 0;
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+    }
+
+    /* Every arm attached to the root is its own island */
+    void build_arms(int arm_count)
+    {
+        uint32_t guid = 0;
+        ik_node_t* root = solver->node->create(guid++);
+        IKAPI.solver.set_tree(solver, root);
+        for (int arm = 0; arm != arm_count; ++arm)
+        {
+            ik_node_t* parent = root;
+            for (int i = 0; i != 3 + arm % 4; ++i)
+            {
+                parent = solver->node->create_child(parent, guid++);
+                parent->position = IKAPI.vec3.vec3(arm % 2 ? 1 : -1, 1, 0.1 * arm);
+            }
+            ik_effector_t* effector = solver->effector->create();
+            solver->effector->attach(effector, parent);
+            /* Some arms can reach their target, some can't */
+            effector->target_position = IKAPI.vec3.vec3(arm - arm_count / 2.0, arm % 3, 2 * (arm % 2));
+        }
+    }
+
+    std::vector<ik_vec3_t> solve_and_get_positions()
+    {
+        std::vector<ik_vec3_t> positions;
+        result = IKAPI.solver.solve(solver);
+        for (uint32_t guid = 1; ; ++guid)
+        {
+            ik_node_t* node = solver->node->find_child(solver->tree, guid);
+            if (node == NULL)
+                break;
+            positions.push_back(node->position);
+        }
+        return positions;
+    }
+
+protected:
+    ik_solver_t* solver;
+    ikret_t result;
+};
+
+TEST_F(FABRIK_islands, threaded_solve_matches_serial_solve)
+{
+    build_arms(9);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    std::vector<ik_vec3_t> serial = solve_and_get_positions();
+    ikret_t serial_result = result;
+    int32_t serial_iterations = solver->iterations_used;
+
+    IKAPI.solver.destroy(solver);
+    solver = IKAPI.solver.create(IK_FABRIK);
+    solver->flags = 0;
+    solver->thread_count = 4;
+    build_arms(9);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    std::vector<ik_vec3_t> threaded = solve_and_get_positions();
+
+    EXPECT_THAT(result, Eq(serial_result));
+    EXPECT_THAT(solver->iterations_used, Eq(serial_iterations));
+    ASSERT_THAT(serial.size(), Gt(0u));
+    ASSERT_THAT(threaded.size(), Eq(serial.size()));
+    for (size_t i = 0; i != serial.size(); ++i)
+    {
+        EXPECT_THAT(threaded[i].x, DoubleEq(serial[i].x));
+        EXPECT_THAT(threaded[i].y, DoubleEq(serial[i].y));
+        EXPECT_THAT(threaded[i].z, DoubleEq(serial[i].z));
+    }
+}
+
+class FABRIK_branches : public Test
+{
+public:
+    FABRIK_branches() : solver(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_FABRIK);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+    }
+
+    /*
+     * A stem with a cluster of tentacles attached to its tip. Every tentacle
+     * forks into two more tentacles, so the tree is a single island with
+     * sub-bases on two levels.
+     */
+    void build_tentacles(uint8_t flags, uint32_t thread_count, uint32_t fork_threshold)
+    {
+        IKAPI.solver.destroy(solver);
+        solver = IKAPI.solver.create(IK_FABRIK);
+        solver->flags = flags;
+        solver->thread_count = thread_count;
+        solver->fork_threshold = fork_threshold;
+
+        uint32_t guid = 0;
+        ik_node_t* stem = solver->node->create(guid++);
+        IKAPI.solver.set_tree(solver, stem);
+        for (int i = 0; i != 3; ++i)
+        {
+            stem = solver->node->create_child(stem, guid++);
+            stem->position = IKAPI.vec3.vec3(0, 1, 0);
+        }
+        for (int tentacle = 0; tentacle != 6; ++tentacle)
+        {
+            ik_node_t* parent = stem;
+            for (int i = 0; i != 4; ++i)
+            {
+                parent = solver->node->create_child(parent, guid++);
+                parent->position = IKAPI.vec3.vec3(tentacle % 3 - 1, 1, tentacle / 3 - 0.5);
+            }
+            for (int tip = 0; tip != 2; ++tip)
+            {
+                ik_node_t* tip_parent = parent;
+                for (int i = 0; i != 3; ++i)
+                {
+                    tip_parent = solver->node->create_child(tip_parent, guid++);
+                    tip_parent->position = IKAPI.vec3.vec3(tip ? 0.5 : -0.5, 1, 0);
+                }
+                ik_effector_t* effector = solver->effector->create();
+                solver->effector->attach(effector, tip_parent);
+                effector->target_position = IKAPI.vec3.vec3(tentacle - 3 + tip, 8 + tip, tentacle % 2);
+                effector->target_rotation = IKAPI.quat.quat(0, 0, 0.3826834, 0.9238795);
+            }
+        }
+        ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    }
+
+    std::vector<ik_vec3_t> solve_and_get_positions()
+    {
+        std::vector<ik_vec3_t> positions;
+        result = IKAPI.solver.solve(solver);
+        for (uint32_t guid = 1; ; ++guid)
+        {
+            ik_node_t* node = solver->node->find_child(solver->tree, guid);
+            if (node == NULL)
+                break;
+            positions.push_back(node->position);
+        }
+        return positions;
+    }
+
+    void expect_branched_solve_matches_serial_solve(uint8_t flags)
+    {
+        build_tentacles(flags, 1, 0);
+        std::vector<ik_vec3_t> serial = solve_and_get_positions();
+        ikret_t serial_result = result;
+        int32_t serial_iterations = solver->iterations_used;
+
+        /* Splits the stem's sub-base and the sub-base of every tentacle */
+        build_tentacles(flags, 4, 8);
+        std::vector<ik_vec3_t> branched = solve_and_get_positions();
+
+        EXPECT_THAT(result, Eq(serial_result));
+        EXPECT_THAT(solver->iterations_used, Eq(serial_iterations));
+        ASSERT_THAT(serial.size(), Gt(0u));
+        ASSERT_THAT(branched.size(), Eq(serial.size()));
+        for (size_t i = 0; i != serial.size(); ++i)
+        {
+            EXPECT_THAT(branched[i].x, DoubleEq(serial[i].x));
+            EXPECT_THAT(branched[i].y, DoubleEq(serial[i].y));
+            EXPECT_THAT(branched[i].z, DoubleEq(serial[i].z));
+        }
+    }
+
+protected:
+    ik_solver_t* solver;
+    ikret_t result;
+};
+
+TEST_F(FABRIK_branches, branched_solve_matches_serial_solve)
+{
+    expect_branched_solve_matches_serial_solve(0);
+}
+
+TEST_F(FABRIK_branches, branched_solve_with_target_rotations_matches_serial_solve)
+{
+    expect_branched_solve_matches_serial_solve(IK_ENABLE_TARGET_ROTATIONS);
+}
+
+class FABRIK_warm_start : public Test
+{
+public:
+    FABRIK_warm_start() : solver(NULL), effector(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_FABRIK);
+        solver->flags = IK_ENABLE_WARM_START;
+        solver->stall_ratio = 0;
+        solver->max_iterations = 100;
+
+        /* Straight chain of 4 segments with length 1 along the Y axis */
+        ik_node_t* parent = solver->node->create(0);
+        IKAPI.solver.set_tree(solver, parent);
+        for (uint32_t guid = 1; guid != 5; ++guid)
+            parent = solver->node->create_child(parent, guid);
+        reset_pose();
+
+        effector = solver->effector->create();
+        solver->effector->attach(effector, parent);
+        effector->target_position = IKAPI.vec3.vec3(2, 2, 0);
+        ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+    }
+
+    /* Restores the animation pose, which the solver overwrote */
+    void reset_pose(ikreal_t offset = 0)
+    {
+        for (uint32_t guid = 1; guid != 5; ++guid)
+            solver->node->find_child(solver->tree, guid)->position = IKAPI.vec3.vec3(offset, 1, 0);
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_effector_t* effector;
+};
+
+TEST_F(FABRIK_warm_start, unchanged_target_needs_no_iterations)
+{
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Gt(2));
+
+    reset_pose();
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Eq(0));
+}
+
+TEST_F(FABRIK_warm_start, moving_target_needs_fewer_iterations_than_cold_start)
+{
+    int32_t warm_iterations;
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    effector->target_position = IKAPI.vec3.vec3(2.01, 2, 0);
+
+    reset_pose();
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    warm_iterations = solver->iterations_used;
+    EXPECT_THAT(warm_iterations, Le(2));
+
+    solver->flags = 0;
+    reset_pose();
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Gt(warm_iterations));
+}
+
+TEST_F(FABRIK_warm_start, pose_jump_falls_back_to_cold_start)
+{
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    /* The tip moves by more than the threshold */
+    solver->warm_start_threshold = 0.5;
+    reset_pose(0.2);
+    effector->target_position = IKAPI.vec3.vec3(2, 2, 0);
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Gt(0));
+
+    /* The same jump with fallback disabled warm starts and is already solved */
+    solver->warm_start_threshold = 0;
+    reset_pose(0.4);
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Eq(0));
+}
+
+class FABRIK_global_pose : public Test
+{
+public:
+    FABRIK_global_pose() : solver(NULL), reference(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = create_solver(nodes, effectors);
+        reference = create_solver(reference_nodes, reference_effectors);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(reference);
+        IKAPI.solver.destroy(solver);
+    }
+
+    /* Trunk of 2 segments splitting into two arms with 2 segments each */
+    static ik_solver_t* create_solver(ik_node_t* n[7], ik_effector_t* e[2])
+    {
+        ik_solver_t* s = IKAPI.solver.create(IK_FABRIK);
+        s->flags = 0;
+        n[0] = s->node->create(0);
+        IKAPI.solver.set_tree(s, n[0]);
+        n[1] = s->node->create_child(n[0], 1);
+        n[2] = s->node->create_child(n[1], 2);
+        n[3] = s->node->create_child(n[2], 3);
+        n[4] = s->node->create_child(n[3], 4);
+        n[5] = s->node->create_child(n[2], 5);
+        n[6] = s->node->create_child(n[5], 6);
+        n[1]->position.y = 1;
+        n[2]->position.y = 1;
+        n[3]->position.x = -1;
+        n[4]->position.x = -1;
+        n[5]->position.x = 1;
+        n[6]->position.x = 1;
+
+        e[0] = s->effector->create();
+        e[1] = s->effector->create();
+        s->effector->attach(e[0], n[4]);
+        s->effector->attach(e[1], n[6]);
+        e[0]->target_position = IKAPI.vec3.vec3(-2, 1, 1);
+        e[1]->target_position = IKAPI.vec3.vec3(2, 1, 1);
+        return s;
+    }
+
+    /* The reference solver has never solved before, so its cache is empty */
+    void copy_pose_to_reference()
+    {
+        for (int i = 0; i != 7; ++i)
+        {
+            reference_nodes[i]->position = nodes[i]->position;
+            reference_nodes[i]->rotation = nodes[i]->rotation;
+        }
+        for (int i = 0; i != 2; ++i)
+            reference_effectors[i]->target_position = effectors[i]->target_position;
+    }
+
+    void expect_same_pose_as_reference()
+    {
+        for (int i = 0; i != 7; ++i)
+        {
+            EXPECT_THAT(nodes[i]->position.x, DoubleNear(reference_nodes[i]->position.x, 1e-5));
+            EXPECT_THAT(nodes[i]->position.y, DoubleNear(reference_nodes[i]->position.y, 1e-5));
+            EXPECT_THAT(nodes[i]->position.z, DoubleNear(reference_nodes[i]->position.z, 1e-5));
+        }
+    }
+
+    void solve_moved_pose_again(uint8_t flags)
+    {
+        solver->flags = flags;
+        reference->flags = flags;
+        ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+        ASSERT_THAT(IKAPI.solver.rebuild(reference), Eq(IK_OK));
+        IKAPI.solver.solve(solver);
+
+        /* Continue from the pose the solver wrote back */
+        effectors[0]->target_position = IKAPI.vec3.vec3(-1, 2, 1);
+        effectors[1]->target_position = IKAPI.vec3.vec3(1, 3, -1);
+        copy_pose_to_reference();
+
+        IKAPI.solver.solve(solver);
+        IKAPI.solver.solve(reference);
+        expect_same_pose_as_reference();
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_solver_t* reference;
+    ik_node_t* nodes[7];
+    ik_node_t* reference_nodes[7];
+    ik_effector_t* effectors[2];
+    ik_effector_t* reference_effectors[2];
+};
+
+TEST_F(FABRIK_global_pose, changed_local_transforms_are_picked_up)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    ASSERT_THAT(IKAPI.solver.rebuild(reference), Eq(IK_OK));
+    IKAPI.solver.solve(solver);
+
+    /* Rotate the trunk by 90 degrees around Z and bend one arm */
+    nodes[1]->rotation = IKAPI.quat.quat(0, 0, sqrt(0.5), sqrt(0.5));
+    nodes[3]->position = IKAPI.vec3.vec3(-1, 0, 0.5);
+    copy_pose_to_reference();
+
+    IKAPI.solver.solve(solver);
+    IKAPI.solver.solve(reference);
+    expect_same_pose_as_reference();
+}
+
+TEST_F(FABRIK_global_pose, solving_written_back_pose_matches_fresh_solve)
+{
+    solve_moved_pose_again(0);
+}
+
+TEST_F(FABRIK_global_pose, solving_written_back_pose_with_joint_rotations_matches_fresh_solve)
+{
+    solve_moved_pose_again(IK_ENABLE_JOINT_ROTATIONS);
+}
+
+TEST_F(FABRIK_global_pose, very_long_chain_transforms_back_to_local_space)
+{
+    ik_solver_t* rope = IKAPI.solver.create(IK_FABRIK);
+    rope->flags = IK_ENABLE_JOINT_ROTATIONS;
+
+    ik_node_t* parent = rope->node->create(0);
+    IKAPI.solver.set_tree(rope, parent);
+    for (uint32_t guid = 1; guid != 20000; ++guid)
+    {
+        parent = rope->node->create_child(parent, guid);
+        parent->position.y = 1;
+    }
+    ik_effector_t* effector = rope->effector->create();
+    rope->effector->attach(effector, parent);
+    effector->target_position = IKAPI.vec3.vec3(5000, 5000, 0);
+
+    ASSERT_THAT(IKAPI.solver.rebuild(rope), Eq(IK_OK));
+    IKAPI.solver.solve(rope);
+
+    /* Segment lengths are preserved in local space */
+    for (ik_node_t* node = parent; node->parent != NULL; node = node->parent)
+        ASSERT_THAT(IKAPI.vec3.length(node->position.f), DoubleNear(1, 1e-3));
+
+    IKAPI.solver.destroy(rope);
+}
+
+TEST_F(FABRIK_global_pose, unchanged_island_base_keeps_its_local_position)
+{
+    nodes[0]->position = IKAPI.vec3.vec3(0.1, 0.2, 0.3);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    IKAPI.solver.solve(solver);
+    IKAPI.solver.solve(solver);
+
+    EXPECT_THAT(nodes[0]->position.x, Eq(0.1));
+    EXPECT_THAT(nodes[0]->position.y, Eq(0.2));
+    EXPECT_THAT(nodes[0]->position.z, Eq(0.3));
+}
+
+class FABRIK_lazy_rotations : public FABRIK_global_pose
+{
+public:
+    void expect_same_global_pose_as_reference()
+    {
+        for (int i = 0; i != 7; ++i)
+        {
+            ik_vec3_t position = global_position(nodes[i]);
+            ik_vec3_t expected = global_position(reference_nodes[i]);
+            EXPECT_THAT(position.x, DoubleNear(expected.x, 1e-9));
+            EXPECT_THAT(position.y, DoubleNear(expected.y, 1e-9));
+            EXPECT_THAT(position.z, DoubleNear(expected.z, 1e-9));
+        }
+    }
+};
+
+TEST_F(FABRIK_lazy_rotations, solve_only_writes_positions)
+{
+    solver->flags = IK_ENABLE_JOINT_ROTATIONS | IK_ENABLE_LAZY_ROTATIONS;
+    reference->flags = 0;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    ASSERT_THAT(IKAPI.solver.rebuild(reference), Eq(IK_OK));
+
+    IKAPI.solver.solve(solver);
+    IKAPI.solver.solve(reference);
+
+    expect_same_pose_as_reference();
+    for (int i = 0; i != 7; ++i)
+        EXPECT_THAT(nodes[i]->rotation.w, DoubleEq(1));
+}
+
+TEST_F(FABRIK_lazy_rotations, updated_rotations_match_joint_rotations)
+{
+    solver->flags = IK_ENABLE_JOINT_ROTATIONS | IK_ENABLE_LAZY_ROTATIONS;
+    reference->flags = IK_ENABLE_JOINT_ROTATIONS;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    ASSERT_THAT(IKAPI.solver.rebuild(reference), Eq(IK_OK));
+
+    IKAPI.solver.solve(solver);
+    IKAPI.solver.solve(reference);
+    EXPECT_THAT(IKAPI.solver.update_rotations(solver), Eq(IK_OK));
+
+    for (int i = 0; i != 7; ++i)
+    {
+        for (int j = 0; j != 3; ++j)
+            EXPECT_THAT(nodes[i]->position.f[j], DoubleNear(reference_nodes[i]->position.f[j], 1e-12));
+        for (int j = 0; j != 4; ++j)
+            EXPECT_THAT(nodes[i]->rotation.f[j], DoubleNear(reference_nodes[i]->rotation.f[j], 1e-12));
+    }
+}
+
+TEST_F(FABRIK_lazy_rotations, several_solves_are_updated_at_once)
+{
+    solver->flags = IK_ENABLE_JOINT_ROTATIONS | IK_ENABLE_LAZY_ROTATIONS;
+    reference->flags = 0;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    ASSERT_THAT(IKAPI.solver.rebuild(reference), Eq(IK_OK));
+
+    IKAPI.solver.solve(solver);
+    IKAPI.solver.solve(reference);
+    effectors[0]->target_position = reference_effectors[0]->target_position = IKAPI.vec3.vec3(-1, 2, 1);
+    effectors[1]->target_position = reference_effectors[1]->target_position = IKAPI.vec3.vec3(1, 3, -1);
+    IKAPI.solver.solve(solver);
+    IKAPI.solver.solve(reference);
+    EXPECT_THAT(IKAPI.solver.update_rotations(solver), Eq(IK_OK));
+
+    /* The rotated tree ends up where the positions-only solve put it */
+    EXPECT_THAT(nodes[0]->rotation.w, Lt(1));
+    expect_same_global_pose_as_reference();
+}
+
+TEST_F(FABRIK_lazy_rotations, update_without_pending_rotations_does_nothing)
+{
+    solver->flags = IK_ENABLE_JOINT_ROTATIONS;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    IKAPI.solver.solve(solver);
+    copy_pose_to_reference();
+
+    EXPECT_THAT(IKAPI.solver.update_rotations(solver), Eq(IK_OK));
+    for (int i = 0; i != 7; ++i)
+    {
+        for (int j = 0; j != 3; ++j)
+            EXPECT_THAT(nodes[i]->position.f[j], Eq(reference_nodes[i]->position.f[j]));
+        for (int j = 0; j != 4; ++j)
+            EXPECT_THAT(nodes[i]->rotation.f[j], Eq(reference_nodes[i]->rotation.f[j]));
+    }
+}
+
+class FABRIK_fast_math : public FABRIK_global_pose
+{
+public:
+    void solve_with_and_without_fast_math(uint8_t flags)
+    {
+        solver->flags = flags | IK_ENABLE_FAST_MATH;
+        reference->flags = flags;
+        ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+        ASSERT_THAT(IKAPI.solver.rebuild(reference), Eq(IK_OK));
+
+        effectors[0]->target_position = reference_effectors[0]->target_position = IKAPI.vec3.vec3(-1.3, 2.2, 0.7);
+        effectors[1]->target_position = reference_effectors[1]->target_position = IKAPI.vec3.vec3(0.9, 2.8, -1.1);
+        IKAPI.solver.solve(solver);
+        IKAPI.solver.solve(reference);
+        expect_same_pose_as_reference();
+    }
+
+    void expect_same_rotations_as_reference()
+    {
+        for (int i = 0; i != 7; ++i)
+            for (int j = 0; j != 4; ++j)
+                EXPECT_THAT(nodes[i]->rotation.f[j], DoubleNear(reference_nodes[i]->rotation.f[j], 1e-5));
+    }
+};
+
+TEST_F(FABRIK_fast_math, positions_are_within_error_bound_of_precise_solve)
+{
+    solve_with_and_without_fast_math(0);
+}
+
+TEST_F(FABRIK_fast_math, target_rotations_are_within_error_bound_of_precise_solve)
+{
+    solve_with_and_without_fast_math(IK_ENABLE_TARGET_ROTATIONS);
+}
+
+TEST_F(FABRIK_fast_math, joint_rotations_are_within_error_bound_of_precise_solve)
+{
+    solve_with_and_without_fast_math(IK_ENABLE_JOINT_ROTATIONS);
+    expect_same_rotations_as_reference();
+}
+
+TEST_F(FABRIK_fast_math, segment_turned_around_gets_a_valid_rotation)
+{
+    ik_solver_t* rope = IKAPI.solver.create(IK_FABRIK);
+    rope->flags = IK_ENABLE_JOINT_ROTATIONS | IK_ENABLE_FAST_MATH;
+
+    ik_node_t* base = rope->node->create(0);
+    IKAPI.solver.set_tree(rope, base);
+    ik_node_t* mid = rope->node->create_child(base, 1);
+    ik_node_t* tip = rope->node->create_child(mid, 2);
+    mid->position.y = 1;
+    tip->position.y = 1;
+    ik_effector_t* effector = rope->effector->create();
+    rope->effector->attach(effector, tip);
+
+    /* Pulls the rope straight down, so both segments end up exactly reversed */
+    effector->target_position = IKAPI.vec3.vec3(0, -2, 0);
+    ASSERT_THAT(IKAPI.solver.rebuild(rope), Eq(IK_OK));
+    IKAPI.solver.solve(rope);
+
+    ik_vec3_t segment = IKAPI.vec3.vec3(0, 1, 0);
+    EXPECT_THAT(IKAPI.quat.mag(base->rotation.f), DoubleNear(1, 1e-5));
+    IKAPI.vec3.rotate(segment.f, base->rotation.f);
+    EXPECT_THAT(segment.x, DoubleNear(0, 1e-5));
+    EXPECT_THAT(segment.y, DoubleNear(-1, 1e-5));
+    EXPECT_THAT(segment.z, DoubleNear(0, 1e-5));
+
+    IKAPI.solver.destroy(rope);
+}
+
 /*
 class NAME : public Test
 {
@@ -409,3 +1307,174 @@ TEST_F(NAME, binary_tree_with_short_chains)
     ik.solver.solve(solver);
 }
 */
+
+class FABRIK_incremental_rebuild : public Test
+{
+public:
+    FABRIK_incremental_rebuild() : solver(NULL), reference(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = create_solver();
+        reference = create_solver();
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+        IKAPI.solver.destroy(reference);
+    }
+
+    /*
+     * Trunk of 2 segments splitting into three arms at node 2. The middle arm
+     * splits again at node 8:
+     *   0 - 1 - 2 - 3 - 4 - 5 - 6
+     *           2 - 7 - 8 - 9 - 10
+     *                   8 - 11 - 12
+     *           2 - 13 - 14 - 15 - 16
+     */
+    ik_solver_t* create_solver()
+    {
+        static const uint32_t parents[] = {0, 0, 1, 2, 3, 4, 5, 2, 7, 8, 9, 8, 11, 2, 13, 14, 15};
+        ik_solver_t* new_solver = IKAPI.solver.create(IK_FABRIK);
+        new_solver->flags = 0;
+        ik_node_t* root = new_solver->node->create(0);
+        IKAPI.solver.set_tree(new_solver, root);
+        for (uint32_t guid = 1; guid != 17; ++guid)
+        {
+            ik_node_t* parent = new_solver->node->find_child(root, parents[guid]);
+            ik_node_t* child = new_solver->node->create_child(parent, guid);
+            child->position = IKAPI.vec3.vec3((int)(guid % 3) - 1, 1, 0.1 * guid);
+        }
+        return new_solver;
+    }
+
+    ik_node_t* find(ik_solver_t* s, uint32_t guid)
+    {
+        return s->node->find_child(s->tree, guid);
+    }
+
+    ik_effector_t* attach(ik_solver_t* s, uint32_t guid, uint16_t chain_length)
+    {
+        ik_effector_t* effector = s->effector->create();
+        s->effector->attach(effector, find(s, guid));
+        effector->chain_length = chain_length;
+        effector->target_position = IKAPI.vec3.vec3(0.3 * guid - 2, 3, 1);
+        return effector;
+    }
+
+    std::vector<ik_vec3_t> solve_and_get_positions(ik_solver_t* s)
+    {
+        std::vector<ik_vec3_t> positions;
+        IKAPI.solver.solve(s);
+        for (uint32_t guid = 1; guid != 17; ++guid)
+            positions.push_back(find(s, guid)->position);
+        return positions;
+    }
+
+    /* The reference solver was built from scratch with the final effectors */
+    void expect_same_solution()
+    {
+        ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+        ASSERT_THAT(IKAPI.solver.rebuild(reference), Eq(IK_OK));
+        EXPECT_THAT(vector_count(&solver->effector_nodes_list),
+                    Eq(vector_count(&reference->effector_nodes_list)));
+
+        std::vector<ik_vec3_t> incremental = solve_and_get_positions(solver);
+        std::vector<ik_vec3_t> full = solve_and_get_positions(reference);
+        EXPECT_THAT(solver->iterations_used, Eq(reference->iterations_used));
+        for (size_t i = 0; i != full.size(); ++i)
+        {
+            EXPECT_THAT(incremental[i].x, DoubleEq(full[i].x));
+            EXPECT_THAT(incremental[i].y, DoubleEq(full[i].y));
+            EXPECT_THAT(incremental[i].z, DoubleEq(full[i].z));
+        }
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_solver_t* reference;
+};
+
+TEST_F(FABRIK_incremental_rebuild, attaching_effectors_matches_full_rebuild)
+{
+    attach(solver, 6, 0);
+    attach(solver, 16, 2);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    /* One joins the root island, one becomes a new island */
+    attach(solver, 10, 3);
+    attach(solver, 12, 1);
+
+    attach(reference, 6, 0);
+    attach(reference, 16, 2);
+    attach(reference, 10, 3);
+    attach(reference, 12, 1);
+    expect_same_solution();
+}
+
+TEST_F(FABRIK_incremental_rebuild, detaching_effectors_matches_full_rebuild)
+{
+    attach(solver, 6, 0);
+    ik_effector_t* middle = attach(solver, 10, 0);
+    ik_effector_t* side = attach(solver, 12, 2);
+    attach(solver, 16, 2);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    solver->effector->destroy(middle);
+    solver->effector->detach(side);
+    solver->effector->attach(side, find(solver, 15));
+
+    attach(reference, 6, 0);
+    attach(reference, 16, 2);
+    attach(reference, 15, 2)->target_position = side->target_position;
+    expect_same_solution();
+}
+
+TEST_F(FABRIK_incremental_rebuild, changing_chain_length_matches_full_rebuild)
+{
+    ik_effector_t* first = attach(solver, 6, 2);
+    attach(solver, 10, 0);
+    ik_effector_t* last = attach(solver, 16, 2);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    first->chain_length = 0;
+    last->chain_length = 5;
+
+    attach(reference, 6, 0);
+    attach(reference, 10, 0);
+    attach(reference, 16, 5);
+    expect_same_solution();
+}
+
+TEST_F(FABRIK_incremental_rebuild, unaffected_chains_are_not_rebuilt)
+{
+    attach(solver, 6, 2);
+    attach(solver, 16, 2);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    ikreal_t dist_to_parent = find(solver, 16)->dist_to_parent;
+
+    /* Only the island of node 16 would pick up the new segment length */
+    find(solver, 16)->position = IKAPI.vec3.vec3(0, 5, 0);
+    attach(solver, 12, 2);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    EXPECT_THAT(find(solver, 16)->dist_to_parent, DoubleEq(dist_to_parent));
+    EXPECT_THAT(find(solver, 12)->dist_to_parent, Gt(0));
+
+    /* Adding a node rebuilds everything */
+    solver->node->create_child(find(solver, 16), 17);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    EXPECT_THAT(find(solver, 16)->dist_to_parent, DoubleEq(5));
+}
+
+TEST_F(FABRIK_incremental_rebuild, chain_reaching_past_shorter_chain_is_marked_to_the_end)
+{
+    /* The chain of node 12 joins the chain of node 10 at node 8, but reaches further */
+    attach(solver, 10, 3);
+    attach(solver, 12, 0);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    ik_vec3_t trunk = find(solver, 1)->position;
+    solve_and_get_positions(solver);
+    EXPECT_THAT(find(solver, 1)->position.x, Not(DoubleEq(trunk.x)));
+}
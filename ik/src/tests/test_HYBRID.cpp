@@ -0,0 +1,214 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include "pose_helpers.hpp"
+
+#define NAME HYBRID
+
+using namespace ::testing;
+
+class HYBRID_limb : public Test
+{
+public:
+    HYBRID_limb() : solver(NULL), effector(NULL) {}
+
+    /* Upper segment along Y, lower segment bent along X */
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_HYBRID);
+        solver->flags = 0;
+        n[0] = solver->node->create(0);
+        IKAPI.solver.set_tree(solver, n[0]);
+        n[1] = solver->node->create_child(n[0], 1);
+        n[2] = solver->node->create_child(n[1], 2);
+        n[1]->position.y = 1;
+        n[2]->position.x = 1;
+
+        effector = solver->effector->create();
+        solver->effector->attach(effector, n[2]);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_effector_t* effector;
+    ik_node_t* n[3];
+};
+
+TEST_F(HYBRID_limb, reachable_target_is_solved_in_one_iteration)
+{
+    effector->target_position = IKAPI.vec3.vec3(1, 1, 1);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Eq(1));
+
+    ik_vec3_t tip = global_position(n[2]);
+    EXPECT_THAT(tip.x, DoubleNear(1, 1e-9));
+    EXPECT_THAT(tip.y, DoubleNear(1, 1e-9));
+    EXPECT_THAT(tip.z, DoubleNear(1, 1e-9));
+    EXPECT_THAT(IKAPI.vec3.length(n[1]->position.f), DoubleNear(1, 1e-9));
+    EXPECT_THAT(IKAPI.vec3.length(n[2]->position.f), DoubleNear(1, 1e-9));
+}
+
+TEST_F(HYBRID_limb, limb_keeps_bending_in_the_same_plane)
+{
+    effector->target_position = IKAPI.vec3.vec3(0.5, 1.5, 0);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    /* The elbow stays in the XY plane, on the same side of the line to the target as before */
+    ik_vec3_t mid = global_position(n[1]);
+    EXPECT_THAT(mid.z, DoubleNear(0, 1e-9));
+    EXPECT_THAT(mid.x, Lt(0.5 * mid.y / 1.5));
+}
+
+TEST_F(HYBRID_limb, unreachable_target_stretches_limb_without_iterating)
+{
+    effector->target_position = IKAPI.vec3.vec3(0, 0, 5);
+    solver->stall_ratio = 0;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+    EXPECT_THAT(solver->iterations_used, Eq(1));
+
+    ik_vec3_t mid = global_position(n[1]);
+    ik_vec3_t tip = global_position(n[2]);
+    EXPECT_THAT(mid.z, DoubleNear(1, 1e-9));
+    EXPECT_THAT(tip.x, DoubleNear(0, 1e-9));
+    EXPECT_THAT(tip.y, DoubleNear(0, 1e-9));
+    EXPECT_THAT(tip.z, DoubleNear(2, 1e-9));
+}
+
+TEST_F(HYBRID_limb, joint_rotations_are_calculated)
+{
+    effector->target_position = IKAPI.vec3.vec3(-1, 0.5, 1);
+    solver->flags = IK_ENABLE_JOINT_ROTATIONS;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Eq(1));
+
+    ik_vec3_t tip = global_position(n[2]);
+    for (uint32_t i = 1; i != 3; ++i)
+        EXPECT_THAT(IKAPI.vec3.length(n[i]->position.f), DoubleNear(1, 1e-9));
+    EXPECT_THAT(tip.x, DoubleNear(-1, 1e-6));
+    EXPECT_THAT(tip.y, DoubleNear(0.5, 1e-6));
+    EXPECT_THAT(tip.z, DoubleNear(1, 1e-6));
+}
+
+class HYBRID_humanoid : public Test
+{
+public:
+    /*
+     * Spine of 2 segments with two arms of 2 segments each, bent downwards,
+     * and a head of 1 segment attached to the top of the spine.
+     */
+    ik_solver_t* build(enum ik_algorithm_e algorithm)
+    {
+        ik_solver_t* solver = IKAPI.solver.create(algorithm);
+        solver->flags = 0;
+        solver->tolerance = 1e-6;
+        solver->max_iterations = 100;
+        n[0] = solver->node->create(0);
+        IKAPI.solver.set_tree(solver, n[0]);
+        n[1] = solver->node->create_child(n[0], 1);
+        n[2] = solver->node->create_child(n[1], 2);
+        n[3] = solver->node->create_child(n[2], 3);
+        n[4] = solver->node->create_child(n[3], 4);
+        n[5] = solver->node->create_child(n[2], 5);
+        n[6] = solver->node->create_child(n[5], 6);
+        n[7] = solver->node->create_child(n[2], 7);
+        n[1]->position.y = 1;
+        n[2]->position.y = 1;
+        n[3]->position.x = -1;
+        n[4]->position.y = -1;
+        n[5]->position.x = 1;
+        n[6]->position.y = -1;
+        n[7]->position.y = 0.5;
+
+        for (int i = 0; i != 3; ++i)
+            e[i] = solver->effector->create();
+        solver->effector->attach(e[0], n[4]);
+        solver->effector->attach(e[1], n[6]);
+        solver->effector->attach(e[2], n[7]);
+        e[0]->target_position = IKAPI.vec3.vec3(-1.5, 2.5, 0.5);
+        e[1]->target_position = IKAPI.vec3.vec3(1, 3, -1);
+        e[2]->target_position = IKAPI.vec3.vec3(0.2, 2.4, 0);
+        return solver;
+    }
+
+protected:
+    ik_node_t* n[8];
+    ik_effector_t* e[3];
+};
+
+TEST_F(HYBRID_humanoid, limbs_reach_their_targets_in_fewer_iterations_than_FABRIK)
+{
+    ik_solver_t* fabrik = build(IK_FABRIK);
+    ASSERT_THAT(IKAPI.solver.rebuild(fabrik), Eq(IK_OK));
+    EXPECT_THAT(IKAPI.solver.solve(fabrik), Eq(IK_RESULT_CONVERGED));
+    int32_t fabrik_iterations = fabrik->iterations_used;
+    IKAPI.solver.destroy(fabrik);
+
+    ik_solver_t* solver = build(IK_HYBRID);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    EXPECT_THAT(solver->iterations_used, Lt(fabrik_iterations));
+
+    ik_vec3_t tip0 = global_position(n[4]);
+    ik_vec3_t tip1 = global_position(n[6]);
+    ik_vec3_t tip2 = global_position(n[7]);
+    EXPECT_THAT(tip0.x, DoubleNear(-1.5, 1e-6));
+    EXPECT_THAT(tip0.y, DoubleNear(2.5, 1e-6));
+    EXPECT_THAT(tip0.z, DoubleNear(0.5, 1e-6));
+    EXPECT_THAT(tip1.x, DoubleNear(1, 1e-6));
+    EXPECT_THAT(tip1.y, DoubleNear(3, 1e-6));
+    EXPECT_THAT(tip1.z, DoubleNear(-1, 1e-6));
+    EXPECT_THAT(tip2.x, DoubleNear(0.2, 1e-6));
+    EXPECT_THAT(tip2.y, DoubleNear(2.4, 1e-6));
+    EXPECT_THAT(tip2.z, DoubleNear(0, 1e-6));
+    for (uint32_t i = 1; i != 7; ++i)
+        EXPECT_THAT(IKAPI.vec3.length(n[i]->position.f), DoubleNear(1, 1e-9));
+    EXPECT_THAT(IKAPI.vec3.length(n[7]->position.f), DoubleNear(0.5, 1e-9));
+
+    IKAPI.solver.destroy(solver);
+}
+
+TEST(NAME, target_rotations_solve_like_FABRIK)
+{
+    ik_vec3_t results[2][3];
+    enum ik_algorithm_e algorithms[2] = { IK_FABRIK, IK_HYBRID };
+
+    for (int i = 0; i != 2; ++i)
+    {
+        ik_solver_t* solver = IKAPI.solver.create(algorithms[i]);
+        ik_node_t* n[3];
+        solver->flags = IK_ENABLE_TARGET_ROTATIONS;
+        n[0] = solver->node->create(0);
+        IKAPI.solver.set_tree(solver, n[0]);
+        n[1] = solver->node->create_child(n[0], 1);
+        n[2] = solver->node->create_child(n[1], 2);
+        n[1]->position.y = 1;
+        n[2]->position.x = 1;
+        ik_effector_t* effector = solver->effector->create();
+        solver->effector->attach(effector, n[2]);
+        effector->target_position = IKAPI.vec3.vec3(0.5, 1, 0.5);
+        ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+        IKAPI.solver.solve(solver);
+        for (int j = 0; j != 3; ++j)
+            results[i][j] = n[j]->position;
+        IKAPI.solver.destroy(solver);
+    }
+
+    for (int j = 0; j != 3; ++j)
+    {
+        EXPECT_THAT(results[1][j].x, DoubleEq(results[0][j].x));
+        EXPECT_THAT(results[1][j].y, DoubleEq(results[0][j].y));
+        EXPECT_THAT(results[1][j].z, DoubleEq(results[0][j].z));
+    }
+}
@@ -0,0 +1,175 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include "pose_helpers.hpp"
+#include <cmath>
+
+#define NAME MSS
+
+using namespace ::testing;
+
+class MSS_chain : public Test
+{
+public:
+    MSS_chain() : solver(NULL), mss(NULL), effector(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_MSS);
+        mss = (ik_solver_MSS_t*)solver;
+        solver->flags = 0;
+
+        build_straight_chain(solver, nodes, 4);
+
+        effector = solver->effector->create();
+        solver->effector->attach(effector, nodes[4]);
+        effector->target_position = IKAPI.vec3.vec3(0, 4, 0);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+    }
+
+    void simulate(ikreal_t seconds)
+    {
+        for (ikreal_t t = 0; t < seconds; t += mss->timestep)
+            IKAPI.solver.solve(solver);
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_solver_MSS_t* mss;
+    ik_effector_t* effector;
+    ik_node_t* nodes[5];
+};
+
+TEST_F(MSS_chain, chain_at_rest_stays_at_rest)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    for (uint32_t i = 0; i != 5; ++i)
+    {
+        ik_vec3_t position = global_position(nodes[i]);
+        EXPECT_THAT(position.x, DoubleNear(0, 1e-9));
+        EXPECT_THAT(position.y, DoubleNear(i, 1e-9));
+        EXPECT_THAT(position.z, DoubleNear(0, 1e-9));
+    }
+}
+
+TEST_F(MSS_chain, effector_pulls_tip_to_reachable_target)
+{
+    effector->target_position = IKAPI.vec3.vec3(2, 2, 0);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    simulate(5);
+
+    ik_vec3_t tip = global_position(nodes[4]);
+    EXPECT_THAT(tip.x, DoubleNear(2, 1e-2));
+    EXPECT_THAT(tip.y, DoubleNear(2, 1e-2));
+    EXPECT_THAT(tip.z, DoubleNear(0, 1e-2));
+    for (uint32_t i = 1; i != 5; ++i)
+        EXPECT_THAT(IKAPI.vec3.length(nodes[i]->position.f), DoubleNear(1, 1e-2));
+}
+
+TEST_F(MSS_chain, gravity_makes_chain_sag)
+{
+    mss->gravity = IKAPI.vec3.vec3(0, -9.81, 0);
+    effector->target_position = IKAPI.vec3.vec3(4, 0, 0);
+    nodes[1]->position = IKAPI.vec3.vec3(1, 0, 0);
+    for (uint32_t i = 2; i != 5; ++i)
+        nodes[i]->position = IKAPI.vec3.vec3(1, 0, 0);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    simulate(2);
+
+    /* Both ends are held, so the middle hangs below them */
+    EXPECT_THAT(global_position(nodes[0]).y, DoubleNear(0, 1e-9));
+    EXPECT_THAT(global_position(nodes[2]).y, Lt(-1e-3));
+    EXPECT_THAT(global_position(nodes[4]).y, Gt(global_position(nodes[2]).y));
+}
+
+TEST_F(MSS_chain, base_follows_the_animated_pose)
+{
+    effector->target_position = IKAPI.vec3.vec3(2, 2, 0);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    simulate(0.5);
+
+    nodes[0]->position = IKAPI.vec3.vec3(1, 0, 0);
+    IKAPI.solver.solve(solver);
+
+    EXPECT_THAT(nodes[0]->position.x, DoubleNear(1, 1e-9));
+    EXPECT_THAT(nodes[0]->position.y, DoubleNear(0, 1e-9));
+    EXPECT_THAT(nodes[0]->position.z, DoubleNear(0, 1e-9));
+}
+
+TEST_F(MSS_chain, converges_once_the_tip_settles_at_the_target)
+{
+    solver->tolerance = 1e-2;
+    effector->target_position = IKAPI.vec3.vec3(2, 2, 0);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    /* A single time step only starts moving the tip */
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+
+    simulate(5);
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+}
+
+TEST_F(MSS_chain, fixed_substeps_are_used_exactly)
+{
+    mss->substeps = 4;
+    effector->target_position = IKAPI.vec3.vec3(2, 2, 0);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+    EXPECT_THAT(solver->iterations_used, Eq(4));
+
+    simulate(5);
+    ik_vec3_t tip = global_position(nodes[4]);
+    EXPECT_THAT(tip.x, DoubleNear(2, 1e-2));
+    EXPECT_THAT(tip.y, DoubleNear(2, 1e-2));
+}
+
+TEST_F(MSS_chain, fixed_steps_match_adaptive_steps)
+{
+    ik_solver_t* adaptive = IKAPI.solver.create(IK_MSS);
+    ik_node_t* adaptive_nodes[5];
+    adaptive->flags = 0;
+    ((ik_solver_MSS_t*)adaptive)->error_tolerance = 1e-6;
+    build_straight_chain(adaptive, adaptive_nodes, 4);
+    ik_effector_t* adaptive_effector = adaptive->effector->create();
+    adaptive->effector->attach(adaptive_effector, adaptive_nodes[4]);
+    adaptive_effector->target_position = IKAPI.vec3.vec3(2, 2, 0);
+
+    mss->substeps = 16;
+    effector->target_position = IKAPI.vec3.vec3(2, 2, 0);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    ASSERT_THAT(IKAPI.solver.rebuild(adaptive), Eq(IK_OK));
+
+    for (int frame = 0; frame != 10; ++frame)
+    {
+        IKAPI.solver.solve(solver);
+        IKAPI.solver.solve(adaptive);
+    }
+
+    for (uint32_t i = 0; i != 5; ++i)
+    {
+        EXPECT_THAT(nodes[i]->position.x, DoubleNear(adaptive_nodes[i]->position.x, 1e-4));
+        EXPECT_THAT(nodes[i]->position.y, DoubleNear(adaptive_nodes[i]->position.y, 1e-4));
+        EXPECT_THAT(nodes[i]->position.z, DoubleNear(adaptive_nodes[i]->position.z, 1e-4));
+    }
+
+    IKAPI.solver.destroy(adaptive);
+}
+
+TEST_F(MSS_chain, adaptive_steps_are_bounded_by_max_iterations)
+{
+    mss->stiffness = 1e6;
+    solver->max_iterations = 3;
+    effector->target_position = IKAPI.vec3.vec3(2, 2, 0);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+    EXPECT_THAT(solver->iterations_used, Eq(3));
+}
@@ -0,0 +1,225 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include <cmath>
+
+#define NAME TWO_BONE
+
+using namespace ::testing;
+
+class TWO_BONE_limbs : public Test
+{
+public:
+    TWO_BONE_limbs() : solver(NULL), limbs(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_TWO_BONE);
+    }
+
+    virtual void TearDown()
+    {
+        if (limbs != NULL)
+            IKAPI.solver.destroy_limbs(limbs);
+        IKAPI.solver.destroy(solver);
+    }
+
+    static void set(ik_vec3_array_t* array, uint32_t idx, ikreal_t x, ikreal_t y, ikreal_t z)
+    {
+        array->x[idx] = x;
+        array->y[idx] = y;
+        array->z[idx] = z;
+    }
+
+    static ik_vec3_t get(const ik_vec3_array_t* array, uint32_t idx)
+    {
+        return IKAPI.vec3.vec3(array->x[idx], array->y[idx], array->z[idx]);
+    }
+
+    static ik_quat_t get(const ik_quat_array_t* array, uint32_t idx)
+    {
+        return IKAPI.quat.quat(array->x[idx], array->y[idx], array->z[idx], array->w[idx]);
+    }
+
+    static ik_vec3_t sub(ik_vec3_t a, const ik_vec3_t& b)
+    {
+        IKAPI.vec3.sub_vec3(a.f, b.f);
+        return a;
+    }
+
+    /*
+     * Upper segment of length 2 and lower segment of length 1 + idx/10,
+     * bent in the XY plane and moved along Z by idx.
+     */
+    void set_limb(uint32_t idx)
+    {
+        set(&limbs->bases, idx, 0, 0, idx);
+        set(&limbs->mids, idx, 0, 2, idx);
+        set(&limbs->tips, idx, 1 + idx * 0.1, 2, idx);
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_limbs_t* limbs;
+};
+
+TEST_F(TWO_BONE_limbs, reachable_targets_are_reached_and_segment_lengths_are_kept)
+{
+    const uint32_t count = 11; /* Not a multiple of any lane width */
+    limbs = IKAPI.solver.create_limbs(count);
+    ASSERT_THAT(limbs, NotNull());
+
+    for (uint32_t i = 0; i != count; ++i)
+    {
+        set_limb(i);
+        set(&limbs->targets, i, 1 + i * 0.05, 1 - i * 0.1, i + 0.5);
+        set(&limbs->poles, i, -1, 0, i + 5);
+    }
+
+    EXPECT_THAT(IKAPI.solver.solve_limbs(solver, limbs), Eq(IK_RESULT_CONVERGED));
+
+    for (uint32_t i = 0; i != count; ++i)
+    {
+        ik_vec3_t base = get(&limbs->bases, i);
+        ik_vec3_t mid = get(&limbs->mids, i);
+        ik_vec3_t tip = get(&limbs->tips, i);
+        ik_vec3_t target = get(&limbs->targets, i);
+        ik_vec3_t upper = sub(mid, base);
+        ik_vec3_t lower = sub(tip, mid);
+
+        EXPECT_THAT(tip.x, DoubleNear(target.x, 1e-9));
+        EXPECT_THAT(tip.y, DoubleNear(target.y, 1e-9));
+        EXPECT_THAT(tip.z, DoubleNear(target.z, 1e-9));
+        EXPECT_THAT(IKAPI.vec3.length(upper.f), DoubleNear(2, 1e-9));
+        EXPECT_THAT(IKAPI.vec3.length(lower.f), DoubleNear(1 + i * 0.1, 1e-9));
+    }
+}
+
+TEST_F(TWO_BONE_limbs, limbs_bend_towards_their_poles)
+{
+    const uint32_t count = 5;
+    limbs = IKAPI.solver.create_limbs(count);
+    ASSERT_THAT(limbs, NotNull());
+
+    /* Target straight below the base, poles in front of or behind it */
+    for (uint32_t i = 0; i != count; ++i)
+    {
+        set_limb(i);
+        set(&limbs->targets, i, 0, -2, i);
+        set(&limbs->poles, i, 0, 0, i % 2 ? i + 3.0 : i - 3.0);
+    }
+
+    EXPECT_THAT(IKAPI.solver.solve_limbs(solver, limbs), Eq(IK_RESULT_CONVERGED));
+
+    for (uint32_t i = 0; i != count; ++i)
+    {
+        ik_vec3_t mid = get(&limbs->mids, i);
+        EXPECT_THAT(mid.x, DoubleNear(0, 1e-9));
+        if (i % 2)
+            EXPECT_THAT(mid.z, Gt(i));
+        else
+            EXPECT_THAT(mid.z, Lt(i));
+    }
+}
+
+TEST_F(TWO_BONE_limbs, pole_on_target_line_keeps_current_bend_plane)
+{
+    limbs = IKAPI.solver.create_limbs(1);
+    ASSERT_THAT(limbs, NotNull());
+
+    set_limb(0);
+    set(&limbs->targets, 0, 0, 2, 0);
+    set(&limbs->poles, 0, 0, 5, 0);
+
+    EXPECT_THAT(IKAPI.solver.solve_limbs(solver, limbs), Eq(IK_RESULT_CONVERGED));
+
+    /*
+     * The mid node lies on the -X side of the line from the base to the tip,
+     * so it has to stay on the -X side of the line from the base to the target
+     */
+    ik_vec3_t mid = get(&limbs->mids, 0);
+    EXPECT_THAT(mid.x, Lt(0));
+    EXPECT_THAT(mid.z, DoubleNear(0, 1e-9));
+}
+
+TEST_F(TWO_BONE_limbs, unreachable_targets_stretch_the_limb_towards_the_target)
+{
+    const uint32_t count = 6;
+    limbs = IKAPI.solver.create_limbs(count);
+    ASSERT_THAT(limbs, NotNull());
+
+    for (uint32_t i = 0; i != count; ++i)
+    {
+        set_limb(i);
+        set(&limbs->targets, i, 10, 0, i);
+        set(&limbs->poles, i, 0, 5, i);
+    }
+    /* One limb can reach its target */
+    set(&limbs->targets, 3, 1, 1, 3);
+
+    EXPECT_THAT(IKAPI.solver.solve_limbs(solver, limbs), Eq(IK_OK));
+
+    for (uint32_t i = 0; i != count; ++i)
+    {
+        if (i == 3)
+            continue;
+        ik_vec3_t mid = get(&limbs->mids, i);
+        ik_vec3_t tip = get(&limbs->tips, i);
+        EXPECT_THAT(mid.x, DoubleNear(2, 1e-9));
+        EXPECT_THAT(mid.y, DoubleNear(0, 1e-9));
+        EXPECT_THAT(tip.x, DoubleNear(3 + i * 0.1, 1e-9));
+        EXPECT_THAT(tip.y, DoubleNear(0, 1e-9));
+    }
+}
+
+TEST_F(TWO_BONE_limbs, rotations_rotate_segments_onto_solved_segments)
+{
+    const uint32_t count = 9;
+    limbs = IKAPI.solver.create_limbs(count);
+    ASSERT_THAT(limbs, NotNull());
+
+    ik_vec3_t upper_before[count];
+    ik_vec3_t lower_before[count];
+    for (uint32_t i = 0; i != count; ++i)
+    {
+        set_limb(i);
+        set(&limbs->targets, i, -1.5, 1 - i * 0.2, i - 0.5);
+        set(&limbs->poles, i, 0, 3, i + 4);
+        upper_before[i] = sub(get(&limbs->mids, i), get(&limbs->bases, i));
+        lower_before[i] = sub(get(&limbs->tips, i), get(&limbs->mids, i));
+    }
+    /* The upper segment of this limb has to turn around completely */
+    set(&limbs->targets, 4, 0, -3.4, 4);
+
+    IKAPI.solver.solve_limbs(solver, limbs);
+
+    for (uint32_t i = 0; i != count; ++i)
+    {
+        ik_vec3_t upper = sub(get(&limbs->mids, i), get(&limbs->bases, i));
+        ik_vec3_t lower = sub(get(&limbs->tips, i), get(&limbs->mids, i));
+        ik_quat_t base_rotation = get(&limbs->base_rotations, i);
+        ik_quat_t mid_rotation = get(&limbs->mid_rotations, i);
+
+        EXPECT_THAT(IKAPI.quat.mag(base_rotation.f), DoubleNear(1, 1e-9));
+        EXPECT_THAT(IKAPI.quat.mag(mid_rotation.f), DoubleNear(1, 1e-9));
+
+        IKAPI.vec3.rotate(upper_before[i].f, base_rotation.f);
+        IKAPI.vec3.rotate(lower_before[i].f, mid_rotation.f);
+        EXPECT_THAT(upper_before[i].x, DoubleNear(upper.x, 1e-6));
+        EXPECT_THAT(upper_before[i].y, DoubleNear(upper.y, 1e-6));
+        EXPECT_THAT(upper_before[i].z, DoubleNear(upper.z, 1e-6));
+        EXPECT_THAT(lower_before[i].x, DoubleNear(lower.x, 1e-6));
+        EXPECT_THAT(lower_before[i].y, DoubleNear(lower.y, 1e-6));
+        EXPECT_THAT(lower_before[i].z, DoubleNear(lower.z, 1e-6));
+    }
+}
+
+TEST_F(TWO_BONE_limbs, other_solvers_dont_support_limbs)
+{
+    ik_solver_t* fabrik = IKAPI.solver.create(IK_FABRIK);
+    limbs = IKAPI.solver.create_limbs(1);
+    ASSERT_THAT(limbs, NotNull());
+
+    EXPECT_THAT(IKAPI.solver.solve_limbs(fabrik, limbs), Eq(IK_SOLVER_DOESNT_SUPPORT_LIMBS));
+
+    IKAPI.solver.destroy(fabrik);
+}
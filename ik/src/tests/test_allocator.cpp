@@ -0,0 +1,205 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include "ik/memory.h"
+#include "ik/vector.h"
+#include <stdlib.h>
+
+#define NAME allocator
+
+using namespace ::testing;
+
+struct allocator_stats
+{
+    int mallocs;
+    int reallocs;
+    int frees;
+    int wrong_context;
+};
+
+static allocator_stats* stats_from(void* context)
+{
+    return static_cast<allocator_stats*>(context);
+}
+
+static void* counting_malloc(void* context, uintptr_t size)
+{
+    stats_from(context)->mallocs++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* context, void* ptr, uintptr_t size)
+{
+    stats_from(context)->reallocs++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void* context, void* ptr)
+{
+    stats_from(context)->frees++;
+    free(ptr);
+}
+
+class NAME : public Test
+{
+public:
+    virtual void SetUp()
+    {
+        stats = allocator_stats();
+        callbacks = ik_callback_interface_t();
+        callbacks.on_malloc = counting_malloc;
+        callbacks.on_realloc = counting_realloc;
+        callbacks.on_free = counting_free;
+        callbacks.allocator_context = &stats;
+        IKAPI.implement_callbacks(&callbacks);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.implement_callbacks(NULL);
+    }
+
+protected:
+    allocator_stats stats;
+    ik_callback_interface_t callbacks;
+};
+
+TEST_F(NAME, solver_allocations_go_through_callbacks)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* root = solver->node->create(0);
+    ik_node_t* tip = solver->node->create_child(solver->node->create_child(root, 1), 2);
+    ik_effector_t* effector = solver->effector->create();
+    solver->effector->attach(effector, tip);
+    IKAPI.solver.set_tree(solver, root);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    IKAPI.solver.solve(solver);
+    IKAPI.solver.destroy(solver);
+
+    EXPECT_THAT(stats.mallocs, Gt(0));
+    EXPECT_THAT(stats.frees, Gt(0));
+}
+
+TEST_F(NAME, growing_vector_reallocates_through_callbacks)
+{
+    struct vector_t* vec = vector_create(sizeof(int));
+    for (int i = 0; i != 100; ++i)
+        vector_push(vec, &i);
+    vector_destroy(vec);
+
+    EXPECT_THAT(stats.mallocs, Gt(0));
+    EXPECT_THAT(stats.reallocs, Gt(0));
+    EXPECT_THAT(stats.frees, Eq(stats.mallocs));
+}
+
+class allocation_free : public allocator
+{
+public:
+    virtual void SetUp()
+    {
+        allocator::SetUp();
+
+        /* Two branches of a tree with an effector at the end of each */
+        solver = IKAPI.solver.create(IK_FABRIK);
+        ik_node_t* root = solver->node->create(0);
+        ik_node_t* parent = root;
+        for (uint32_t guid = 1; guid != 20; ++guid)
+        {
+            parent = solver->node->create_child(guid == 10 ? root : parent, guid);
+            parent->position = IKAPI.vec3.vec3(0, 0, 1);
+            if (guid == 9 || guid == 19)
+            {
+                ik_effector_t* effector = solver->effector->create();
+                effector->target_position = IKAPI.vec3.vec3(guid == 9 ? 2 : -2, 0, 3);
+                solver->effector->attach(effector, parent);
+            }
+        }
+        IKAPI.solver.set_tree(solver, root);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+        allocator::TearDown();
+    }
+
+    void reset_stats()
+    {
+        stats = allocator_stats();
+#ifdef IK_MEMORY_DEBUGGING
+        allocations = ik_memory_allocation_count();
+        reallocations = ik_memory_reallocation_count();
+        deallocations = ik_memory_deallocation_count();
+#endif
+    }
+
+    void expect_no_allocations()
+    {
+        EXPECT_THAT(stats.mallocs, Eq(0));
+        EXPECT_THAT(stats.reallocs, Eq(0));
+        EXPECT_THAT(stats.frees, Eq(0));
+
+        /* The callbacks miss allocations that bypass ik_malloc() */
+#ifdef IK_MEMORY_DEBUGGING
+        EXPECT_THAT(ik_memory_allocation_count(), Eq(allocations));
+        EXPECT_THAT(ik_memory_reallocation_count(), Eq(reallocations));
+        EXPECT_THAT(ik_memory_deallocation_count(), Eq(deallocations));
+#endif
+    }
+
+protected:
+    ik_solver_t* solver;
+#ifdef IK_MEMORY_DEBUGGING
+    uintptr_t allocations;
+    uintptr_t reallocations;
+    uintptr_t deallocations;
+#endif
+};
+
+TEST_F(allocation_free, solve_does_not_allocate_after_first_call)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    IKAPI.solver.solve(solver);
+
+    reset_stats();
+    for (int i = 0; i != 10; ++i)
+        IKAPI.solver.solve(solver);
+    expect_no_allocations();
+}
+
+TEST_F(allocation_free, rebuilding_unchanged_tree_reuses_memory)
+{
+    ik_node_t* root = solver->tree;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    IKAPI.solver.solve(solver);
+
+    reset_stats();
+    for (int i = 0; i != 10; ++i)
+    {
+        root->v->mark_dirty(root, IK_NODE_DIRTY_CHILDREN);
+        ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+        IKAPI.solver.solve(solver);
+    }
+    expect_no_allocations();
+}
+
+TEST_F(allocation_free, rebuilding_changed_chains_reuses_memory)
+{
+    ik_node_t* tip = solver->node->find_child(solver->tree, 19);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    IKAPI.solver.solve(solver);
+
+    /* Toggle once so both chain layouts have been seen */
+    tip->effector->chain_length = 4;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    tip->effector->chain_length = 0;
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    reset_stats();
+    for (int i = 0; i != 10; ++i)
+    {
+        tip->effector->chain_length = i % 2 ? 0 : 4;
+        ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+        IKAPI.solver.solve(solver);
+    }
+    expect_no_allocations();
+}
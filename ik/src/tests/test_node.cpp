@@ -1,5 +1,7 @@
 #include "gmock/gmock.h"
 #include "ik/ik.h"
+#include <algorithm>
+#include <vector>
 
 #define NAME node
 
@@ -9,3 +11,175 @@ TEST(NAME, todo)
 {
     ASSERT_TRUE(0);
 }
+
+class node_children : public Test
+{
+public:
+    node_children() : solver(NULL), root(NULL) {}
+
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_FABRIK);
+        root = solver->node->create(0);
+        IKAPI.solver.set_tree(solver, root);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+    }
+
+    std::vector<uint32_t> child_guids(ik_node_t* node)
+    {
+        std::vector<uint32_t> guids;
+        NODE_FOR_EACH(node, guid, child)
+            EXPECT_THAT(child->parent, Eq(node));
+            guids.push_back(guid);
+        NODE_END_EACH
+        return guids;
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_node_t* root;
+};
+
+TEST_F(node_children, children_are_iterated_in_the_order_they_were_added)
+{
+    solver->node->create_child(root, 5);
+    solver->node->create_child(root, 2);
+    solver->node->create_child(root, 9);
+
+    EXPECT_THAT(child_guids(root), ElementsAre(5, 2, 9));
+}
+
+TEST_F(node_children, unlinking_keeps_remaining_children_in_order)
+{
+    ik_node_t* first = solver->node->create_child(root, 1);
+    ik_node_t* middle = solver->node->create_child(root, 2);
+    ik_node_t* last = solver->node->create_child(root, 3);
+
+    solver->node->unlink(middle);
+    EXPECT_THAT(child_guids(root), ElementsAre(1, 3));
+    solver->node->unlink(last);
+    EXPECT_THAT(child_guids(root), ElementsAre(1));
+    solver->node->unlink(first);
+    EXPECT_THAT(child_guids(root), ElementsAre());
+
+    solver->node->add_child(root, last);
+    solver->node->add_child(root, middle);
+    EXPECT_THAT(child_guids(root), ElementsAre(3, 2));
+    EXPECT_THAT(first->parent, IsNull());
+    solver->node->destroy(first);
+}
+
+TEST_F(node_children, adding_a_child_moves_it_from_its_previous_parent)
+{
+    ik_node_t* a = solver->node->create_child(root, 1);
+    ik_node_t* b = solver->node->create_child(root, 2);
+    ik_node_t* child = solver->node->create_child(a, 3);
+
+    solver->node->add_child(b, child);
+    EXPECT_THAT(child_guids(a), ElementsAre());
+    EXPECT_THAT(child_guids(b), ElementsAre(3));
+}
+
+TEST_F(node_children, siblings_with_the_same_guid_are_rejected)
+{
+    ik_node_t* a = solver->node->create_child(root, 1);
+    EXPECT_THAT(solver->node->create_child(root, 1), IsNull());
+
+    /* The rejected node stays where it was */
+    ik_node_t* other = solver->node->create_child(a, 1);
+    EXPECT_THAT(solver->node->add_child(root, other), Eq(IK_DUPLICATE_GUID));
+    EXPECT_THAT(other->parent, Eq(a));
+    EXPECT_THAT(child_guids(root), ElementsAre(1));
+
+    /* Adding a node to its own parent again is fine */
+    EXPECT_THAT(solver->node->add_child(root, a), Eq(IK_OK));
+    EXPECT_THAT(child_guids(root), ElementsAre(1));
+}
+
+TEST_F(node_children, destroying_a_node_destroys_all_children)
+{
+    ik_node_t* a = solver->node->create_child(root, 1);
+    solver->node->create_child(solver->node->create_child(a, 2), 3);
+    solver->node->create_child(a, 4);
+
+    solver->node->destroy(a);
+    EXPECT_THAT(child_guids(root), ElementsAre());
+    EXPECT_THAT(solver->node->find_child(root, 3), IsNull());
+}
+
+TEST_F(node_children, solver_finds_nodes_before_and_after_rebuild)
+{
+    ik_node_t* parent = root;
+    for (uint32_t guid = 1; guid != 50; ++guid)
+        parent = solver->node->create_child(guid % 7 ? parent : root, guid);
+
+    /* Not rebuilt yet, has to search the tree */
+    EXPECT_THAT(IKAPI.solver.find_node(solver, 23), Eq(solver->node->find_child(root, 23)));
+
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    for (uint32_t guid = 0; guid != 50; ++guid)
+    {
+        ik_node_t* node = IKAPI.solver.find_node(solver, guid);
+        ASSERT_THAT(node, NotNull());
+        EXPECT_THAT(node->guid, Eq(guid));
+    }
+    EXPECT_THAT(IKAPI.solver.find_node(solver, 50), IsNull());
+
+    /* The new node isn't in the index until the next rebuild */
+    solver->node->create_child(root, 50);
+    EXPECT_THAT(IKAPI.solver.find_node(solver, 50), NotNull());
+}
+
+static std::vector<uint32_t> visited_guids;
+static void visit_node(ik_node_t* node)
+{
+    visited_guids.push_back(node->guid);
+}
+
+TEST_F(node_children, iterating_all_nodes_visits_parents_first)
+{
+    ik_node_t* a = solver->node->create_child(root, 1);
+    solver->node->create_child(root, 2);
+    solver->node->create_child(a, 3);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    visited_guids.clear();
+    IKAPI.solver.iterate_all_nodes(solver, visit_node);
+    EXPECT_THAT(visited_guids, ElementsAre(0, 1, 3, 2));
+}
+
+TEST_F(node_children, destroyed_nodes_are_reused)
+{
+    ik_node_t* a = solver->node->create_child(root, 1);
+    ik_effector_t* e1;
+    ik_effector_t* e2;
+    solver->node->destroy(a);
+    EXPECT_THAT(solver->node->create_child(root, 2), Eq(a));
+
+    e1 = solver->effector->create();
+    solver->effector->destroy(e1);
+    e2 = solver->effector->create();
+    EXPECT_THAT(e2, Eq(e1));
+    solver->effector->destroy(e2);
+}
+
+TEST_F(node_children, destroying_a_large_tree_releases_every_node)
+{
+    std::vector<ik_node_t*> before, after;
+    ik_node_t* parent = solver->node->create_child(root, 1);
+    before.push_back(parent);
+    for (uint32_t guid = 2; guid != 1000; ++guid)
+        before.push_back(solver->node->create_child(guid % 3 ? before[0] : before.back(), guid));
+    solver->node->destroy(before[0]);
+
+    /* All nodes went back to the pool and are handed out again */
+    for (uint32_t guid = 1; guid != 1000; ++guid)
+        after.push_back(solver->node->create_child(root, guid));
+    std::sort(before.begin(), before.end());
+    std::sort(after.begin(), after.end());
+    EXPECT_THAT(after, ContainerEq(before));
+}
@@ -0,0 +1,178 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include "pose_helpers.hpp"
+#include <cmath>
+
+#define NAME solver_pose
+
+using namespace ::testing;
+
+class NAME : public Test
+{
+public:
+    NAME() : solver(NULL) {}
+
+    /*
+     * A rotated root with two branches:
+     *   0 -> 1 -> 2
+     *   0 -> 3
+     */
+    virtual void SetUp()
+    {
+        solver = IKAPI.solver.create(IK_FABRIK);
+        solver->flags = IK_ENABLE_JOINT_ROTATIONS;
+        n[0] = solver->node->create(10);
+        IKAPI.solver.set_tree(solver, n[0]);
+        n[1] = solver->node->create_child(n[0], 11);
+        n[2] = solver->node->create_child(n[1], 12);
+        n[3] = solver->node->create_child(n[0], 13);
+        n[0]->position = IKAPI.vec3.vec3(1, 2, 3);
+        n[0]->rotation = IKAPI.quat.quat(0, 0, std::sin(M_PI / 4), std::cos(M_PI / 4));
+        n[1]->position.y = 1;
+        n[1]->rotation = IKAPI.quat.quat(std::sin(M_PI / 8), 0, 0, std::cos(M_PI / 8));
+        n[2]->position.y = 1;
+        n[3]->position.x = 2;
+
+        effector = solver->effector->create();
+        solver->effector->attach(effector, n[2]);
+    }
+
+    virtual void TearDown()
+    {
+        IKAPI.solver.destroy(solver);
+    }
+
+    int32_t index(uint32_t node)
+    {
+        return IKAPI.solver.find_node_index(solver, n[node]->guid);
+    }
+
+protected:
+    ik_solver_t* solver;
+    ik_effector_t* effector;
+    ik_node_t* n[4];
+};
+
+TEST_F(NAME, node_indices_are_only_valid_after_rebuild)
+{
+    EXPECT_THAT(IKAPI.solver.node_count(solver), Eq(0u));
+    EXPECT_THAT(index(0), Eq(-1));
+
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    EXPECT_THAT(IKAPI.solver.node_count(solver), Eq(4u));
+    EXPECT_THAT(IKAPI.solver.find_node_index(solver, 99), Eq(-1));
+
+    /* Parents come before their children */
+    EXPECT_THAT(index(0), Eq(0));
+    EXPECT_THAT(index(1), Lt(index(2)));
+    EXPECT_THAT(index(3), Gt(0));
+    EXPECT_THAT(index(3), Ne(index(1)));
+    EXPECT_THAT(index(3), Ne(index(2)));
+
+    ikreal_t buffer[4 * 7];
+    solver->node->create_child(n[3], 14);
+    EXPECT_THAT(IKAPI.solver.node_count(solver), Eq(0u));
+    EXPECT_THAT(IKAPI.solver.get_pose(solver, buffer, 0, IK_POSE_LOCAL), Eq(IK_TREE_NOT_REBUILT));
+    EXPECT_THAT(IKAPI.solver.set_pose(solver, buffer, 0, IK_POSE_LOCAL), Eq(IK_TREE_NOT_REBUILT));
+}
+
+TEST_F(NAME, get_local_pose_respects_stride)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    /* Interleave each transform with 2 values that must stay untouched */
+    ikreal_t buffer[4 * 9];
+    for (int i = 0; i != 4 * 9; ++i)
+        buffer[i] = -42;
+    ASSERT_THAT(IKAPI.solver.get_pose(solver, buffer, sizeof(ikreal_t) * 9, IK_POSE_LOCAL), Eq(IK_OK));
+
+    for (uint32_t node = 0; node != 4; ++node)
+    {
+        const ikreal_t* transform = buffer + index(node) * 9;
+        for (int i = 0; i != 7; ++i)
+            EXPECT_THAT(transform[i], DoubleEq(n[node]->transform[i]));
+        EXPECT_THAT(transform[7], DoubleEq(-42));
+        EXPECT_THAT(transform[8], DoubleEq(-42));
+    }
+}
+
+TEST_F(NAME, get_global_pose_accumulates_parents)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    ikreal_t buffer[4 * 7];
+    ASSERT_THAT(IKAPI.solver.get_pose(solver, buffer, 0, IK_POSE_GLOBAL), Eq(IK_OK));
+
+    for (uint32_t node = 0; node != 4; ++node)
+    {
+        ik_quat_t rotation;
+        ik_vec3_t position;
+        const ikreal_t* transform = buffer + index(node) * 7;
+        global_transform(n[node], &rotation, &position);
+        for (int i = 0; i != 4; ++i)
+            EXPECT_THAT(transform[i], DoubleNear(rotation.f[i], 1e-12));
+        for (int i = 0; i != 3; ++i)
+            EXPECT_THAT(transform[4 + i], DoubleNear(position.f[i], 1e-12));
+    }
+
+    /* The root is rotated by 90 degrees around Z, so 3 is on the Y axis */
+    const ikreal_t* transform = buffer + index(3) * 7;
+    EXPECT_THAT(transform[4], DoubleNear(1, 1e-12));
+    EXPECT_THAT(transform[5], DoubleNear(4, 1e-12));
+    EXPECT_THAT(transform[6], DoubleNear(3, 1e-12));
+}
+
+TEST_F(NAME, set_global_pose_round_trips)
+{
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    ikreal_t local[4 * 7];
+    ikreal_t global[4 * 7];
+    ASSERT_THAT(IKAPI.solver.get_pose(solver, local, 0, IK_POSE_LOCAL), Eq(IK_OK));
+    ASSERT_THAT(IKAPI.solver.get_pose(solver, global, 0, IK_POSE_GLOBAL), Eq(IK_OK));
+
+    for (uint32_t node = 0; node != 4; ++node)
+    {
+        IKAPI.quat.set_identity(n[node]->rotation.f);
+        n[node]->position = IKAPI.vec3.vec3(0, 0, 0);
+    }
+    ASSERT_THAT(IKAPI.solver.set_pose(solver, global, 0, IK_POSE_GLOBAL), Eq(IK_OK));
+
+    ikreal_t result[4 * 7];
+    ASSERT_THAT(IKAPI.solver.get_pose(solver, result, 0, IK_POSE_LOCAL), Eq(IK_OK));
+    for (int i = 0; i != 4 * 7; ++i)
+        EXPECT_THAT(result[i], DoubleNear(local[i], 1e-12));
+}
+
+TEST_F(NAME, solved_pose_reaches_target)
+{
+    effector->target_position = IKAPI.vec3.vec3(0, 3, 3.5);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    /* Reset the pose from a buffer, then solve and read the result back */
+    ikreal_t initial[4 * 7];
+    ASSERT_THAT(IKAPI.solver.get_pose(solver, initial, 0, IK_POSE_LOCAL), Eq(IK_OK));
+    for (int frame = 0; frame != 2; ++frame)
+    {
+        ASSERT_THAT(IKAPI.solver.set_pose(solver, initial, 0, IK_POSE_LOCAL), Eq(IK_OK));
+        EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    }
+
+    ikreal_t buffer[4 * 7];
+    ASSERT_THAT(IKAPI.solver.get_pose(solver, buffer, 0, IK_POSE_GLOBAL), Eq(IK_OK));
+    const ikreal_t* tip = buffer + index(2) * 7;
+    EXPECT_THAT(tip[4], DoubleNear(0, 1e-2));
+    EXPECT_THAT(tip[5], DoubleNear(3, 1e-2));
+    EXPECT_THAT(tip[6], DoubleNear(3.5, 1e-2));
+}
+
+TEST(solver_pose_no_tree, returns_error)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ikreal_t buffer[7];
+    EXPECT_THAT(IKAPI.solver.node_count(solver), Eq(0u));
+    EXPECT_THAT(IKAPI.solver.find_node_index(solver, 0), Eq(-1));
+    EXPECT_THAT(IKAPI.solver.get_pose(solver, buffer, 0, IK_POSE_GLOBAL), Eq(IK_SOLVER_HAS_NO_TREE));
+    EXPECT_THAT(IKAPI.solver.set_pose(solver, buffer, 0, IK_POSE_GLOBAL), Eq(IK_SOLVER_HAS_NO_TREE));
+    IKAPI.solver.destroy(solver);
+}
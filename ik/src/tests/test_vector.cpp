@@ -61,6 +61,34 @@ TEST(NAME, clear_keeps_buffer_and_resets_count)
     vector_destroy(vec);
 }
 
+TEST(NAME, resize_after_clear_reuses_buffer)
+{
+    struct vector_t* vec = vector_create(sizeof(int));
+    void* data;
+    vector_resize(vec, 10);
+    data = vec->data;
+    vector_clear(vec);
+    ASSERT_EQ(IK_OK, vector_resize(vec, 7));
+    ASSERT_EQ(7u, vec->count);
+    ASSERT_EQ(10u, vec->capacity);
+    ASSERT_EQ(data, vec->data);
+    vector_destroy(vec);
+}
+
+TEST(NAME, reserve_grows_capacity_but_not_count)
+{
+    struct vector_t* vec = vector_create(sizeof(int));
+    int x = 9;
+    vector_push(vec, &x);
+    ASSERT_EQ(IK_OK, vector_reserve(vec, 20));
+    ASSERT_EQ(1u, vec->count);
+    ASSERT_EQ(20u, vec->capacity);
+    ASSERT_EQ(9, *(int*)vector_get_element(vec, 0));
+    ASSERT_EQ(IK_OK, vector_reserve(vec, 5));
+    ASSERT_EQ(20u, vec->capacity);
+    vector_destroy(vec);
+}
+
 TEST(NAME, clear_free_deletes_buffer_and_resets_count)
 {
     struct vector_t* vec = vector_create(sizeof(int));
@@ -0,0 +1,292 @@
+#include "ik/thread_pool.h"
+#include "ik/ik.h"
+#include "ik/memory.h"
+
+#if defined(IK_THREADS)
+
+#include <pthread.h>
+#include <string.h>
+
+/* Range of task indices owned by one thread. [head, tail) are still to do */
+struct thread_pool_queue_t
+{
+    pthread_mutex_t mutex;
+    uint32_t head;
+    uint32_t tail;
+};
+
+struct thread_pool_worker_t
+{
+    struct thread_pool_t* pool;
+    uint32_t index;
+    pthread_t thread;
+};
+
+struct thread_pool_t
+{
+    uint32_t thread_count;
+    struct thread_pool_queue_t* queues;   /* one per thread, [0] belongs to the calling thread */
+    struct thread_pool_worker_t* workers; /* thread_count-1 worker threads */
+    uint32_t started_count;               /* number of worker threads actually running */
+
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    uint32_t generation; /* incremented every time a batch is started */
+    uint32_t busy;       /* number of worker threads still processing the current batch */
+    int shutdown;
+
+    thread_pool_task_func func;
+    void* context;
+};
+
+/* ------------------------------------------------------------------------- */
+static int
+pop_front(struct thread_pool_queue_t* queue, uint32_t* task_idx)
+{
+    int found = 0;
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->head != queue->tail)
+    {
+        *task_idx = queue->head++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return found;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+pop_back(struct thread_pool_queue_t* queue, uint32_t* task_idx)
+{
+    int found = 0;
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->head != queue->tail)
+    {
+        *task_idx = --queue->tail;
+        found = 1;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return found;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+process_tasks(struct thread_pool_t* pool, uint32_t self)
+{
+    uint32_t task_idx;
+    for (;;)
+    {
+        uint32_t victim;
+
+        if (pop_front(&pool->queues[self], &task_idx))
+        {
+            pool->func(pool->context, task_idx);
+            continue;
+        }
+
+        /* Our own range is exhausted, try to steal from the others */
+        for (victim = 1; victim != pool->thread_count; ++victim)
+            if (pop_back(&pool->queues[(self + victim) % pool->thread_count], &task_idx))
+                break;
+        if (victim == pool->thread_count)
+            return;
+
+        pool->func(pool->context, task_idx);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void*
+worker_main(void* arg)
+{
+    struct thread_pool_worker_t* worker = arg;
+    struct thread_pool_t* pool = worker->pool;
+    uint32_t seen_generation = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->generation == seen_generation && pool->shutdown == 0)
+            pthread_cond_wait(&pool->wake, &pool->mutex);
+        if (pool->shutdown)
+        {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+        seen_generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        process_tasks(pool, worker->index);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+stop_workers(struct thread_pool_t* pool)
+{
+    uint32_t i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i != pool->started_count; ++i)
+        pthread_join(pool->workers[i].thread, NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+struct thread_pool_t*
+thread_pool_create(uint32_t thread_count)
+{
+    uint32_t i;
+    struct thread_pool_t* pool;
+
+    if (thread_count < 1)
+        thread_count = 1;
+
+    /* Allocate the pool, the queues and the workers in one block */
+    pool = MALLOC(sizeof(struct thread_pool_t) +
+                  sizeof(struct thread_pool_queue_t) * thread_count +
+                  sizeof(struct thread_pool_worker_t) * thread_count);
+    if (pool == NULL)
+    {
+        IKAPI.log.message("Failed to allocate thread pool: ran out of memory");
+        return NULL;
+    }
+    memset(pool, 0, sizeof *pool);
+    pool->thread_count = thread_count;
+    pool->queues = (struct thread_pool_queue_t*)(pool + 1);
+    pool->workers = (struct thread_pool_worker_t*)(pool->queues + thread_count);
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (i = 0; i != thread_count; ++i)
+    {
+        pthread_mutex_init(&pool->queues[i].mutex, NULL);
+        pool->queues[i].head = pool->queues[i].tail = 0;
+    }
+
+    for (i = 0; i != thread_count - 1; ++i)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i + 1;
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]) != 0)
+        {
+            IKAPI.log.message("Failed to create worker thread");
+            thread_pool_destroy(pool);
+            return NULL;
+        }
+        ++pool->started_count;
+    }
+
+    return pool;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_pool_destroy(struct thread_pool_t* pool)
+{
+    uint32_t i;
+
+    stop_workers(pool);
+
+    for (i = 0; i != pool->thread_count; ++i)
+        pthread_mutex_destroy(&pool->queues[i].mutex);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->mutex);
+    FREE(pool);
+}
+
+/* ------------------------------------------------------------------------- */
+uint32_t
+thread_pool_thread_count(const struct thread_pool_t* pool)
+{
+    return pool->thread_count;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_pool_run(struct thread_pool_t* pool,
+                uint32_t task_count,
+                thread_pool_task_func func,
+                void* context)
+{
+    uint32_t i;
+
+    if (pool->thread_count < 2 || task_count < 2)
+    {
+        for (i = 0; i != task_count; ++i)
+            func(context, i);
+        return;
+    }
+
+    /* Hand every thread an equally sized, contiguous range of tasks */
+    for (i = 0; i != pool->thread_count; ++i)
+    {
+        pool->queues[i].head = (uint32_t)((uint64_t)task_count * i / pool->thread_count);
+        pool->queues[i].tail = (uint32_t)((uint64_t)task_count * (i + 1) / pool->thread_count);
+    }
+    pool->func = func;
+    pool->context = context;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->busy = pool->thread_count - 1;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    process_tasks(pool, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->busy > 0)
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+#else /* IK_THREADS */
+
+/* ------------------------------------------------------------------------- */
+struct thread_pool_t*
+thread_pool_create(uint32_t thread_count)
+{
+    IKAPI.log.message("Library was built without thread support (IK_THREADS=OFF), solving on the calling thread");
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_pool_destroy(struct thread_pool_t* pool)
+{
+}
+
+/* ------------------------------------------------------------------------- */
+uint32_t
+thread_pool_thread_count(const struct thread_pool_t* pool)
+{
+    return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_pool_run(struct thread_pool_t* pool,
+                uint32_t task_count,
+                thread_pool_task_func func,
+                void* context)
+{
+    uint32_t i;
+    for (i = 0; i != task_count; ++i)
+        func(context, i);
+}
+
+#endif /* IK_THREADS */
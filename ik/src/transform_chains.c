@@ -1,16 +1,15 @@
-#include "ik/bstv.h"
-#include "ik/quat_static.h"
+#include "ik/ik.h"
+#include "ik/memory.h"
 #include "ik/transform.h"
-#include "ik/vec3_static.h"
 #include "ik/chain.h"
 #include "ik/node.h"
 #include <stddef.h>
 #include <assert.h>
-#include <string.h>
 
 /*
- * In all of the following algorithms, we iterate the nodes in a chain starting
- * with the node *after* the base node. This is because the base node is shared
+ * The chains are flattened into parent-first arrays and transformed with
+ * ik_transform_nodes(). When flattening, we store the nodes in a chain
+ * starting with the node *after* the base node. This is because the base node is shared
  * by all chains in the list. If this current chain has children, then
  * transforming our tip is effectively transforming the base node of all of our
  * children. The only node left untransformed will be the root node, which
@@ -18,211 +17,93 @@
  */
 
 /* ------------------------------------------------------------------------- */
-static void
-local_to_global_rotation_recursive(struct chain_t* chain, ikreal_t acc_rot[4])
+static uint32_t
+count_nodes_recursive(const struct chain_t* chain)
 {
-    int idx = chain_length(chain) - 1;
-    assert(idx > 0);
-    while (idx--)
-    {
-        struct ik_node_t* node = chain_get_node(chain, idx);
-
-        ik_quat_t rotation = node->rotation;
-        ik_quat_static_mul_quat(node->rotation.f, acc_rot);
-        ik_quat_static_mul_quat(acc_rot, rotation.f);
-    }
-
-    CHAIN_FOR_EACH_CHILD(chain, child)
-        ikreal_t acc_rot_child[4]; /* Have to copy due to tree structure */
-        ik_quat_static_set(acc_rot_child, acc_rot);
-        local_to_global_rotation_recursive(child, acc_rot_child);
-    CHAIN_END_EACH
-}
-static void
-global_to_local_rotation_recursive(struct chain_t* chain, ikreal_t acc_rot[4])
-{
-    int idx = chain_length(chain) - 1;
-    assert(idx > 0);
-    while (idx--)
-    {
-        struct ik_node_t* node = chain_get_node(chain, idx);
-
-        ik_quat_t inv_rot_acc;
-        ik_quat_static_set(inv_rot_acc.f, acc_rot);
-        ik_quat_static_conj(inv_rot_acc.f);
-        ik_quat_static_mul_quat(node->rotation.f, inv_rot_acc.f);
-        ik_quat_static_mul_quat(acc_rot, node->rotation.f);
-    }
-
+    uint32_t count = chain_length(chain) - 1;
     CHAIN_FOR_EACH_CHILD(chain, child)
-        ikreal_t acc_rot_child[4]; /* Have to copy due to tree structure */
-        ik_quat_static_set(acc_rot_child, acc_rot);
-        global_to_local_rotation_recursive(child, acc_rot_child);
+        count += count_nodes_recursive(child);
     CHAIN_END_EACH
+    return count;
 }
 
 /* ------------------------------------------------------------------------- */
 static void
-local_to_global_translation_recursive(struct chain_t* chain, ikreal_t acc_rot_pos[7])
+flatten_chain_recursive(const struct chain_t* chain,
+                        int32_t base_idx,
+                        struct ik_node_t** nodes,
+                        int32_t* parents,
+                        uint32_t* idx)
 {
-    ik_vec3_t position;
-
-    /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
-    ikreal_t* acc_rot = &acc_rot_pos[0];
-    ikreal_t* acc_pos = &acc_rot_pos[4];
-
-    int idx = chain_length(chain) - 1;
-    assert(idx > 0);
-    while (idx--)
+    /* Nodes are stored from base to tip, so every node follows its parent */
+    int32_t parent_idx = base_idx;
+    int node_idx = chain_length(chain) - 1;
+    assert(node_idx > 0);
+    while (node_idx--)
     {
-        struct ik_node_t* node = chain_get_node(chain, idx);
-
-        ik_vec3_static_rotate(node->position.f, acc_rot);
-        position = node->position;
-        ik_vec3_static_add_vec3(node->position.f, acc_pos);
-        ik_vec3_static_add_vec3(acc_pos, position.f);
-
-        ik_quat_static_mul_quat(acc_rot, node->rotation.f);
+        nodes[*idx] = chain_get_node(chain, node_idx);
+        parents[*idx] = parent_idx;
+        parent_idx = (int32_t)(*idx)++;
     }
 
-    /* Recurse into child chains */
+    /* Our tip is the base of all child chains */
     CHAIN_FOR_EACH_CHILD(chain, child)
-        ikreal_t acc_rot_pos_child[7]; /* Have to copy due to tree structure */
-        ik_quat_static_set(&acc_rot_pos_child[0], acc_rot);
-        ik_vec3_static_set(&acc_rot_pos_child[4], acc_pos);
-        local_to_global_translation_recursive(child, acc_rot_pos_child);
-    CHAIN_END_EACH
-}
-static void
-global_to_local_translation_recursive(struct chain_t* chain, ikreal_t acc_rot_pos[7])
-{
-    /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
-    ikreal_t* acc_rot = &acc_rot_pos[0];
-    ikreal_t* acc_pos = &acc_rot_pos[4];
-
-    int idx = chain_length(chain) - 1;
-    assert(idx > 0);
-    while (idx--)
-    {
-        struct ik_node_t* node = chain_get_node(chain, idx);
-
-        ik_quat_t inv_rot_acc;
-        ik_quat_static_set(inv_rot_acc.f, acc_rot);
-        ik_quat_static_conj(inv_rot_acc.f);
-
-        ik_quat_static_mul_quat(acc_rot, node->rotation.f);
-
-        ik_vec3_static_sub_vec3(node->position.f, acc_pos);
-        ik_vec3_static_add_vec3(acc_pos, node->position.f);
-        ik_vec3_static_rotate(node->position.f, inv_rot_acc.f);
-    }
-
-    CHAIN_FOR_EACH_CHILD(chain, child)
-        ikreal_t acc_rot_pos_child[7]; /* Have to copy due to tree structure */
-        ik_quat_static_set(&acc_rot_pos_child[0], acc_rot);
-        ik_vec3_static_set(&acc_rot_pos_child[4], acc_pos);
-        global_to_local_translation_recursive(child, acc_rot_pos_child);
+        flatten_chain_recursive(child, parent_idx, nodes, parents, idx);
     CHAIN_END_EACH
 }
 
 /* ------------------------------------------------------------------------- */
-static void
-local_to_global_recursive(struct chain_t* chain, ikreal_t acc_rot_pos[7])
+static ikret_t
+transform_islands(const struct chain_t* islands, uint32_t island_count, uint8_t flags)
 {
-    ik_vec3_t position;
-    ik_quat_t rotation;
-
-    /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
-    ikreal_t* acc_rot = &acc_rot_pos[0];
-    ikreal_t* acc_pos = &acc_rot_pos[4];
-
-    int idx = chain_length(chain) - 1;
-    assert(idx > 0);
-    while (idx--)
+    uint32_t i;
+    uint32_t idx = 0;
+    uint32_t count = 0;
+    ikreal_t* accumulators;
+    struct ik_node_t** nodes;
+    int32_t* parents;
+
+    for (i = 0; i != island_count; ++i)
+        count += 1 + count_nodes_recursive(&islands[i]);
+    if (count == 0)
+        return IK_OK;
+
+    /* One block for all arrays, ordered by alignment */
+    accumulators = MALLOC(count * (sizeof(ikreal_t) * 7 + sizeof(struct ik_node_t*) + sizeof(int32_t)));
+    if (accumulators == NULL)
     {
-        struct ik_node_t* node = chain_get_node(chain, idx);
-
-        ik_vec3_static_rotate(node->position.f, acc_rot);
-        position = node->position;
-        ik_vec3_static_add_vec3(node->position.f, acc_pos);
-        ik_vec3_static_add_vec3(acc_pos, position.f);
-
-        rotation = node->rotation;
-        ik_quat_static_mul_quat(node->rotation.f, acc_rot);
-        ik_quat_static_mul_quat(acc_rot, rotation.f);
+        IKAPI.log.message("Failed to transform chains: out of memory");
+        return IK_RAN_OUT_OF_MEMORY;
     }
+    nodes = (struct ik_node_t**)(accumulators + count * 7);
+    parents = (int32_t*)(nodes + count);
 
-    /* Recurse into child chains */
-    CHAIN_FOR_EACH_CHILD(chain, child)
-        ikreal_t acc_rot_pos_child[7]; /* Have to copy due to tree structure */
-        ik_quat_static_set(&acc_rot_pos_child[0], acc_rot);
-        ik_vec3_static_set(&acc_rot_pos_child[4], acc_pos);
-        local_to_global_recursive(child, acc_rot_pos_child);
-    CHAIN_END_EACH
-}
-static void
-global_to_local_recursive(struct chain_t* chain, ikreal_t acc_rot_pos[7])
-{
-    /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
-    ikreal_t* acc_rot = &acc_rot_pos[0];
-    ikreal_t* acc_pos = &acc_rot_pos[4];
-
-    int idx = chain_length(chain) - 1;
-    assert(idx > 0);
-    while (idx--)
+    for (i = 0; i != island_count; ++i)
     {
-        struct ik_node_t* node = chain_get_node(chain, idx);
-
-        ik_quat_t inv_rot_acc;
-        ik_quat_static_set(inv_rot_acc.f, acc_rot);
-        ik_quat_static_conj(inv_rot_acc.f);
-        ik_quat_static_mul_quat(node->rotation.f, inv_rot_acc.f);
-        ik_quat_static_mul_quat(acc_rot, node->rotation.f);
-
-        ik_vec3_static_sub_vec3(node->position.f, acc_pos);
-        ik_vec3_static_add_vec3(acc_pos, node->position.f);
-        ik_vec3_static_rotate(node->position.f, inv_rot_acc.f);
+        int32_t base_idx = (int32_t)idx++;
+        assert(chain_length(&islands[i]) >= 2);
+        nodes[base_idx] = chain_get_base_node(&islands[i]);
+        parents[base_idx] = -1;
+        flatten_chain_recursive(&islands[i], base_idx, nodes, parents, &idx);
     }
+    assert(idx == count);
 
-    CHAIN_FOR_EACH_CHILD(chain, child)
-        ikreal_t acc_rot_pos_child[7]; /* Have to copy due to tree structure */
-        ik_quat_static_set(&acc_rot_pos_child[0], acc_rot);
-        ik_vec3_static_set(&acc_rot_pos_child[4], acc_pos);
-        global_to_local_recursive(child, acc_rot_pos_child);
-    CHAIN_END_EACH
-}
-
-/* ------------------------------------------------------------------------- */
-typedef void (*transform_func)(struct chain_t*, ikreal_t*);
+    ik_transform_nodes(nodes, parents, count, accumulators, flags);
 
-static transform_func transform_table[8] = {
-    global_to_local_recursive,
-    local_to_global_recursive,
-    global_to_local_rotation_recursive,
-    local_to_global_rotation_recursive,
-    global_to_local_translation_recursive,
-    local_to_global_translation_recursive,
-    global_to_local_recursive,
-    local_to_global_recursive,
-};
+    FREE(accumulators);
+    return IK_OK;
+}
 
 /* ------------------------------------------------------------------------- */
-void
+ikret_t
 ik_transform_chain_list(const struct vector_t* chain_list, uint8_t flags)
 {
-    VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
-        ik_transform_chain(chain, flags);
-    VECTOR_END_EACH
+    return transform_islands((const struct chain_t*)chain_list->data, vector_count(chain_list), flags);
 }
 
 /* ------------------------------------------------------------------------- */
-void
+ikret_t
 ik_transform_chain(struct chain_t* chain, uint8_t flags)
 {
-    ikreal_t base_transform[7];
-
-    assert(chain_length(chain) >= 2);
-    memcpy(base_transform, chain_get_base_node(chain)->transform, sizeof(ikreal_t) * 7);
-
-    (*transform_table[flags])(chain, base_transform);
+    return transform_islands(chain, 1, flags);
 }
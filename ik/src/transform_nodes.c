@@ -0,0 +1,153 @@
+#include "ik/math_inline.h"
+#include "ik/transform.h"
+#include "ik/node.h"
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Each of the following functions transforms a single node. acc_rot_pos holds
+ * the accumulated transform of the node's parent on entry, and is updated to
+ * the node's own accumulated transform, which its children continue from.
+ */
+
+/* ------------------------------------------------------------------------- */
+static void
+local_to_global(struct ik_node_t* node, ikreal_t acc_rot_pos[7])
+{
+    ik_vec3_t position;
+    ik_quat_t rotation;
+
+    /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
+    ikreal_t* acc_rot = &acc_rot_pos[0];
+    ikreal_t* acc_pos = &acc_rot_pos[4];
+
+    vec3_rotate(node->position.f, acc_rot);
+    position = node->position;
+    vec3_add_vec3(node->position.f, acc_pos);
+    vec3_add_vec3(acc_pos, position.f);
+
+    rotation = node->rotation;
+    quat_mul_quat(node->rotation.f, acc_rot);
+    quat_mul_quat(acc_rot, rotation.f);
+}
+static void
+global_to_local(struct ik_node_t* node, ikreal_t acc_rot_pos[7])
+{
+    ik_quat_t inv_rot_acc;
+
+    /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
+    ikreal_t* acc_rot = &acc_rot_pos[0];
+    ikreal_t* acc_pos = &acc_rot_pos[4];
+
+    quat_set(inv_rot_acc.f, acc_rot);
+    quat_conj(inv_rot_acc.f);
+    quat_mul_quat(node->rotation.f, inv_rot_acc.f);
+    quat_mul_quat(acc_rot, node->rotation.f);
+
+    vec3_sub_vec3(node->position.f, acc_pos);
+    vec3_add_vec3(acc_pos, node->position.f);
+    vec3_rotate(node->position.f, inv_rot_acc.f);
+}
+static void
+local_to_global_rotation(struct ik_node_t* node, ikreal_t acc_rot[4])
+{
+    ik_quat_t rotation = node->rotation;
+    quat_mul_quat(node->rotation.f, acc_rot);
+    quat_mul_quat(acc_rot, rotation.f);
+}
+static void
+global_to_local_rotation(struct ik_node_t* node, ikreal_t acc_rot[4])
+{
+    ik_quat_t inv_rot_acc;
+    quat_set(inv_rot_acc.f, acc_rot);
+    quat_conj(inv_rot_acc.f);
+    quat_mul_quat(node->rotation.f, inv_rot_acc.f);
+    quat_mul_quat(acc_rot, node->rotation.f);
+}
+static void
+local_to_global_translation(struct ik_node_t* node, ikreal_t acc_rot_pos[7])
+{
+    ik_vec3_t position;
+
+    /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
+    ikreal_t* acc_rot = &acc_rot_pos[0];
+    ikreal_t* acc_pos = &acc_rot_pos[4];
+
+    vec3_rotate(node->position.f, acc_rot);
+    position = node->position;
+    vec3_add_vec3(node->position.f, acc_pos);
+    vec3_add_vec3(acc_pos, position.f);
+
+    quat_mul_quat(acc_rot, node->rotation.f);
+}
+static void
+global_to_local_translation(struct ik_node_t* node, ikreal_t acc_rot_pos[7])
+{
+    ik_quat_t inv_rot_acc;
+
+    /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
+    ikreal_t* acc_rot = &acc_rot_pos[0];
+    ikreal_t* acc_pos = &acc_rot_pos[4];
+
+    quat_set(inv_rot_acc.f, acc_rot);
+    quat_conj(inv_rot_acc.f);
+
+    quat_mul_quat(acc_rot, node->rotation.f);
+
+    vec3_sub_vec3(node->position.f, acc_pos);
+    vec3_add_vec3(acc_pos, node->position.f);
+    vec3_rotate(node->position.f, inv_rot_acc.f);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_transform_nodes(struct ik_node_t* const* nodes,
+                   const int32_t* parents,
+                   uint32_t count,
+                   ikreal_t* accumulators,
+                   uint8_t flags)
+{
+    uint32_t i;
+
+    /*
+     * Parents come before their children, so the accumulated transform of a
+     * node's parent is always ready by the time the node is visited. This
+     * replaces the per-child copy of the accumulator on the stack the
+     * recursive implementation needed.
+     */
+    for (i = 0; i != count; ++i)
+    {
+        struct ik_node_t* node = nodes[i];
+        ikreal_t* acc = &accumulators[i * 7];
+
+        if (parents[i] < 0)
+        {
+            memcpy(acc, node->transform, sizeof(ikreal_t) * 7);
+            continue;
+        }
+
+        memcpy(acc, &accumulators[parents[i] * 7], sizeof(ikreal_t) * 7);
+        switch (flags)
+        {
+            case TR_L2G | TR_TRANSLATIONS:
+                local_to_global_translation(node, acc);
+                break;
+            case TR_G2L | TR_TRANSLATIONS:
+                global_to_local_translation(node, acc);
+                break;
+            case TR_L2G | TR_ROTATIONS:
+                local_to_global_rotation(node, acc);
+                break;
+            case TR_G2L | TR_ROTATIONS:
+                global_to_local_rotation(node, acc);
+                break;
+            case TR_L2G:
+            case TR_L2G | TR_ROTATIONS | TR_TRANSLATIONS:
+                local_to_global(node, acc);
+                break;
+            default:
+                global_to_local(node, acc);
+                break;
+        }
+    }
+}
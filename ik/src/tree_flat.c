@@ -0,0 +1,195 @@
+#include "ik/tree_flat.h"
+#include "ik/ik.h"
+#include "ik/memory.h"
+#include "ik/node.h"
+#include <assert.h>
+
+/* ------------------------------------------------------------------------- */
+struct tree_flat_t*
+tree_flat_create(void)
+{
+    struct tree_flat_t* flat = MALLOC(sizeof *flat);
+    if (flat == NULL)
+    {
+        IKAPI.log.message("Failed to allocate flat tree: out of memory");
+        return NULL;
+    }
+    tree_flat_construct(flat);
+    return flat;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+tree_flat_destroy(struct tree_flat_t* flat)
+{
+    tree_flat_destruct(flat);
+    FREE(flat);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+tree_flat_construct(struct tree_flat_t* flat)
+{
+    vector_construct(&flat->nodes, sizeof(struct ik_node_t*));
+    vector_construct(&flat->parents, sizeof(int32_t));
+    vector_construct(&flat->first_child, sizeof(int32_t));
+    vector_construct(&flat->next_sibling, sizeof(int32_t));
+    vector_construct(&flat->buckets, sizeof(int32_t));
+}
+
+/* ------------------------------------------------------------------------- */
+void
+tree_flat_destruct(struct tree_flat_t* flat)
+{
+    vector_clear_free(&flat->nodes);
+    vector_clear_free(&flat->parents);
+    vector_clear_free(&flat->first_child);
+    vector_clear_free(&flat->next_sibling);
+    vector_clear_free(&flat->buckets);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+tree_flat_clear(struct tree_flat_t* flat)
+{
+    vector_clear(&flat->nodes);
+    vector_clear(&flat->parents);
+    vector_clear(&flat->first_child);
+    vector_clear(&flat->next_sibling);
+    vector_clear(&flat->buckets);
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+count_nodes_recursive(const struct ik_node_t* node)
+{
+    uint32_t count = 1;
+    NODE_FOR_EACH(node, guid, child)
+        count += count_nodes_recursive(child);
+    NODE_END_EACH
+    return count;
+}
+
+/* ------------------------------------------------------------------------- */
+static int32_t
+flatten_node_recursive(struct tree_flat_t* flat,
+                       struct ik_node_t* node,
+                       int32_t parent_idx,
+                       int32_t* node_idx)
+{
+    int32_t idx = (*node_idx)++;
+    int32_t prev_child_idx = -1;
+
+    tree_flat_data(flat, nodes, struct ik_node_t*)[idx] = node;
+    tree_flat_data(flat, parents, int32_t)[idx] = parent_idx;
+    tree_flat_data(flat, first_child, int32_t)[idx] = -1;
+    tree_flat_data(flat, next_sibling, int32_t)[idx] = -1;
+
+    NODE_FOR_EACH(node, guid, child)
+        int32_t child_idx = flatten_node_recursive(flat, child, idx, node_idx);
+        if (prev_child_idx == -1)
+            tree_flat_data(flat, first_child, int32_t)[idx] = child_idx;
+        else
+            tree_flat_data(flat, next_sibling, int32_t)[prev_child_idx] = child_idx;
+        prev_child_idx = child_idx;
+    NODE_END_EACH
+
+    return idx;
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+hash_guid(uint32_t guid, uint32_t bucket_mask)
+{
+    /* Guids are often sequential, so spread them out over the whole table */
+    uint32_t hash = guid * 2654435761u;
+    return (hash ^ (hash >> 16)) & bucket_mask;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+tree_flat_build(struct tree_flat_t* flat, struct ik_node_t* root)
+{
+    ikret_t result;
+    uint32_t node_count = count_nodes_recursive(root);
+    uint32_t bucket_count = 8;
+    uint32_t bucket_mask;
+    int32_t node_idx = 0;
+    struct ik_node_t** nodes;
+    int32_t* buckets;
+    uint32_t idx;
+
+    /* Keep the table at most half full */
+    while (bucket_count < node_count * 2)
+        bucket_count *= 2;
+    bucket_mask = bucket_count - 1;
+
+    tree_flat_clear(flat);
+    if ((result = vector_resize(&flat->nodes, node_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->parents, node_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->first_child, node_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->next_sibling, node_count)) != IK_OK) goto build_failed;
+    if ((result = vector_resize(&flat->buckets, bucket_count)) != IK_OK) goto build_failed;
+
+    flatten_node_recursive(flat, root, -1, &node_idx);
+    assert((uint32_t)node_idx == node_count);
+
+    nodes = tree_flat_data(flat, nodes, struct ik_node_t*);
+    buckets = tree_flat_data(flat, buckets, int32_t);
+    for (idx = 0; idx != bucket_count; ++idx)
+        buckets[idx] = -1;
+    for (idx = 0; idx != node_count; ++idx)
+    {
+        uint32_t guid = nodes[idx]->guid;
+        uint32_t bucket = hash_guid(guid, bucket_mask);
+        while (buckets[bucket] != -1)
+        {
+            if (nodes[buckets[bucket]]->guid == guid)
+            {
+                IKAPI.log.message("Warning: Multiple nodes in the tree have guid %d", guid);
+                break;
+            }
+            bucket = (bucket + 1) & bucket_mask;
+        }
+        if (buckets[bucket] == -1)
+            buckets[bucket] = (int32_t)idx;
+    }
+
+    return IK_OK;
+
+    build_failed : tree_flat_clear(flat);
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+int32_t
+tree_flat_find_index(const struct tree_flat_t* flat, uint32_t guid)
+{
+    struct ik_node_t* const* nodes = tree_flat_data(flat, nodes, struct ik_node_t*);
+    const int32_t* buckets = tree_flat_data(flat, buckets, int32_t);
+    uint32_t bucket_mask;
+    uint32_t bucket;
+    int32_t idx;
+
+    if (vector_count(&flat->buckets) == 0)
+        return -1;
+
+    bucket_mask = vector_count(&flat->buckets) - 1;
+    bucket = hash_guid(guid, bucket_mask);
+    while ((idx = buckets[bucket]) != -1)
+    {
+        if (nodes[idx]->guid == guid)
+            return idx;
+        bucket = (bucket + 1) & bucket_mask;
+    }
+
+    return -1;
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_node_t*
+tree_flat_find(const struct tree_flat_t* flat, uint32_t guid)
+{
+    int32_t idx = tree_flat_find_index(flat, guid);
+    return idx == -1 ? NULL : tree_flat_get_node(flat, (uint32_t)idx);
+}
@@ -0,0 +1,37 @@
+#include "ik/two_bone_lanes.h"
+#include "ik/solver.h"
+#include <math.h>
+
+#define lane_t              ikreal_t
+#define lane_load(p)        (*(p))
+#define lane_store(p, a)    (*(p) = (a))
+#define lane_set1(a)        ((ikreal_t)(a))
+#define lane_add(a, b)      ((a) + (b))
+#define lane_sub(a, b)      ((a) - (b))
+#define lane_mul(a, b)      ((a) * (b))
+#define lane_div(a, b)      ((a) / (b))
+#define lane_sqrt           sqrt
+#define lane_min(a, b)      ((a) < (b) ? (a) : (b))
+#define lane_max(a, b)      ((a) > (b) ? (a) : (b))
+#define lane_gt(a, b)       ((ikreal_t)((a) > (b)))
+#define lane_select(a, b, m) ((m) != 0 ? (b) : (a))
+
+#define LANES_WIDTH  1
+#define LANES_FN(fn) fn##_scalar
+#include "ik/two_bone_lanes_template.h"
+
+static const struct two_bone_lanes_kernel_t two_bone_lanes_kernel_scalar = {
+    "scalar",
+    solve_scalar
+};
+
+/* ------------------------------------------------------------------------- */
+const struct two_bone_lanes_kernel_t*
+two_bone_lanes_kernel(void)
+{
+#if defined(IK_SIMD_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        return &two_bone_lanes_kernel_avx2;
+#endif
+    return &two_bone_lanes_kernel_scalar;
+}
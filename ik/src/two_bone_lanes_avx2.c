@@ -0,0 +1,50 @@
+#include "ik/two_bone_lanes.h"
+#include "ik/solver.h"
+#include <immintrin.h>
+
+/*
+ * This file is compiled with -mavx2. Nothing in here may be called unless
+ * two_bone_lanes_kernel() determined that the CPU supports AVX2.
+ */
+
+#if defined(IK_PRECISION_DOUBLE)
+#   define lane_t            __m256d
+#   define lane_load         _mm256_loadu_pd
+#   define lane_store        _mm256_storeu_pd
+#   define lane_set1         _mm256_set1_pd
+#   define lane_add          _mm256_add_pd
+#   define lane_sub          _mm256_sub_pd
+#   define lane_mul          _mm256_mul_pd
+#   define lane_div          _mm256_div_pd
+#   define lane_sqrt         _mm256_sqrt_pd
+#   define lane_min          _mm256_min_pd
+#   define lane_max          _mm256_max_pd
+#   define lane_gt(a, b)     _mm256_cmp_pd(a, b, _CMP_GT_OQ)
+#   define lane_select       _mm256_blendv_pd
+#   define LANES_WIDTH       4
+#elif defined(IK_PRECISION_FLOAT)
+#   define lane_t            __m256
+#   define lane_load         _mm256_loadu_ps
+#   define lane_store        _mm256_storeu_ps
+#   define lane_set1         _mm256_set1_ps
+#   define lane_add          _mm256_add_ps
+#   define lane_sub          _mm256_sub_ps
+#   define lane_mul          _mm256_mul_ps
+#   define lane_div          _mm256_div_ps
+#   define lane_sqrt         _mm256_sqrt_ps
+#   define lane_min          _mm256_min_ps
+#   define lane_max          _mm256_max_ps
+#   define lane_gt(a, b)     _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#   define lane_select       _mm256_blendv_ps
+#   define LANES_WIDTH       8
+#else
+#   error The AVX2 kernel only supports float and double precision
+#endif
+
+#define LANES_FN(fn) fn##_avx2
+#include "ik/two_bone_lanes_template.h"
+
+const struct two_bone_lanes_kernel_t two_bone_lanes_kernel_avx2 = {
+    "avx2",
+    solve_avx2
+};
@@ -92,13 +92,27 @@ vector_resize(struct vector_t* vector, uint32_t size)
 
     if (vector->count < size)
     {
-        if ((result = vector_expand(vector, VECTOR_ERROR, size)) == IK_OK)
+        /* Reuse existing capacity, e.g. after the vector was cleared */
+        if (vector->capacity < size)
+            result = vector_expand(vector, VECTOR_ERROR, size);
+        if (result == IK_OK)
             vector->count = size;
     }
 
     return result;
 }
 
+/* ------------------------------------------------------------------------- */
+ikret_t
+vector_reserve(struct vector_t* vector, uint32_t capacity)
+{
+    assert(vector);
+
+    if (vector->capacity < capacity)
+        return vector_expand(vector, VECTOR_ERROR, capacity);
+    return IK_OK;
+}
+
 /* ------------------------------------------------------------------------- */
 void*
 vector_push_emplace(struct vector_t* vector)
@@ -324,18 +338,27 @@ vector_expand(struct vector_t *vector,
         return IK_OK;
     }
 
+    /*
+     * If no insertion index is required, let the allocator grow the memory,
+     * possibly in place.
+     */
+    if (insertion_index == VECTOR_ERROR || insertion_index >= new_count)
+    {
+        new_data = REALLOC(vector->data, new_count * vector->element_size);
+        if (!new_data)
+            return IK_RAN_OUT_OF_MEMORY;
+        vector->data = new_data;
+        vector->capacity = new_count;
+        return IK_OK;
+    }
+
     /* prepare for reallocating data */
     old_data = vector->data;
     new_data = MALLOC(new_count * vector->element_size);
     if (!new_data)
         return IK_RAN_OUT_OF_MEMORY;
 
-    /* if (no insertion index is required, copy all data to new memory */
-    if (insertion_index == VECTOR_ERROR || insertion_index >= new_count)
-        memcpy(new_data, old_data, vector->count * vector->element_size);
-
     /* keep space for one element at the insertion index */
-    else
     {
         /* copy old data up until right before insertion offset */
         vector_size_t offset = vector->element_size * insertion_index;